@@ -35,7 +35,24 @@
  * Its size shall be power of two!
  */
 #define PIFS_LOGICAL_PAGE_SIZE_BYTE     256u
+#define PIFS_CACHE_PAGE_NUM             2u   /**< Number of logical pages in page cache. Minimum: 1 */
+#define PIFS_CACHE_RSV_DATA_PAGE_NUM    0u   /**< Cache pages reserved for file data */
+#define PIFS_CACHE_RSV_FSBM_PAGE_NUM    1u   /**< Cache pages reserved for free space bitmap */
+#define PIFS_CACHE_RSV_MAP_PAGE_NUM     0u   /**< Cache pages reserved for map */
+#define PIFS_CACHE_RSV_ENTRY_PAGE_NUM   0u   /**< Cache pages reserved for entry list */
+#define PIFS_CACHE_RSV_DELTA_PAGE_NUM   0u   /**< Cache pages reserved for delta map */
+#define PIFS_CACHE_RSV_WEAR_PAGE_NUM    0u   /**< Cache pages reserved for wear level list */
+#define PIFS_ENABLE_DIRECT_IO           1u   /**< 1: Full data pages bypass page cache on cache miss, 0: all pages are cached */
+#define PIFS_ENABLE_PARTIAL_PROGRAM     1u   /**< 1: Bytes known to be erased are programmed without reading the page on cache miss */
+#define PIFS_ENABLE_FSBM_SHADOW         0u   /**< 1: Keep a copy of free space bitmap in RAM for faster search, 0: read it through page cache */
+#define PIFS_ENABLE_BLOCK_PAGE_CNTR     1u   /**< 1: Count free and to be released pages of every block in RAM, 0: count them from free space bitmap when needed */
+#define PIFS_ENABLE_FREE_EXTENT_INDEX   0u   /**< 1: Keep longest free page run of every data block in RAM for faster allocation (needs PIFS_ENABLE_FSBM_SHADOW), 0: search free space bitmap */
+#define PIFS_READ_AHEAD_PAGE_NUM_MAX    0u   /**< Maximum number of data pages read ahead for sequential reading. 0: disabled */
 #define PIFS_OPEN_FILE_NUM_MAX          4u   /**< Maximum number of opened file */
+#define PIFS_FILE_RESERVE_PAGE_NUM      0u   /**< Number of data pages reserved for a file appended in turn with other files. 0: disabled */
+#define PIFS_FILE_EXTENT_NUM_MAX        0u   /**< Number of map entries of an opened file cached in RAM for seeking, every n-th entry is cached for larger files. 0: disabled */
+#define PIFS_ENABLE_MAP_INDEX           1u   /**< 1: Index pages list map pages of a file for fast seeking in large files, 0: map pages are only linked to each other */
+#define PIFS_ENABLE_MAP_COALESCE        1u   /**< 1: Map entry of appended pages is written when its run of pages ends, 0: every append writes a map entry */
 #define PIFS_OPEN_DIR_NUM_MAX           2u   /**< Maximum number of opened directories */
 #define PIFS_FILENAME_LEN_MAX           32u  /**< Maximum length of file name */
 #define PIFS_PATH_LEN_MAX               128u /**< Maximum length of path. Only relevant if PIFS_ENABLE_DIRECTORIES is 1. */
@@ -48,12 +65,20 @@
 #define PIFS_LEAST_WEARED_BLOCK_NUM     6u   //(PIFS_FLASH_BLOCK_NUM_ALL - PIFS_FLASH_BLOCK_RESERVED_NUM - PIFS_MANAGEMENT_BLOCK_NUM * 2)   /**< Number of stored least weared blocks */
 #define PIFS_MOST_WEARED_BLOCK_NUM      6u   /**< Number of stored most weared blocks */
 #define PIFS_DELTA_MAP_PAGE_NUM         2u   /**< Number of delta page maps */
+#define PIFS_DELTA_MAP_PAGE_NUM_MAX     2u   /**< Maximum number of delta page maps of valid entries, pages above PIFS_DELTA_MAP_PAGE_NUM are chained when needed */
+#define PIFS_DELTA_FOLD_WATERMARK       0u   /**< Delta pages of a file are folded into its map when this percent of delta entries is used, superseded entries are released. 0: disabled */
+#define PIFS_ENABLE_DELTA_HASH_INDEX    0u   /**< 1: Find delta pages by hash table in RAM, 0: scan delta map pages */
+#define PIFS_DELTA_FILTER_SIZE_BYTE     64u  /**< Size of RAM bitmap of pages which have delta page. Pages share bits if it is less than number of pages. 0: disabled */
+#define PIFS_PATCH_LOG_PAGE_NUM         0u   /**< Number of pages of patch log, small overwrites of data pages are stored there. 0: disabled */
+#define PIFS_PATCH_DATA_SIZE_BYTE       8u   /**< Maximum number of bytes in a patch record */
+#define PIFS_PATCH_PER_PAGE_MAX         4u   /**< Maximum number of patch records of a page, page is copied when it is exceeded */
 #define PIFS_ENABLE_CRC                 1u   /**< Use CRC for headers and entries. */
 #define PIFS_CHECKSUM_SIZE              4u   /**< Size of checksum variable in bytes. Valid values are 1, 2 and 4. */
 #define PIFS_MAP_PAGE_COUNT_SIZE        1u   /**< Size of page count variable of map entry in bytes. Valid values are 1, 2 and 4. */
 #define PIFS_ENABLE_CONFIG_IN_FLASH     1u   /**< 1: Store file system's configuration in flash memory */
 #define PIFS_OPTIMIZE_FOR_RAM           1u   /**< 1: Use less RAM, 0: Use more RAM, but faster code execution */
 #define PIFS_CHECK_IF_PAGE_IS_ERASED    1u   /**< 1: Check if page is erased */
+#define PIFS_ENABLE_ERASED_PAGE_BITMAP  0u   /**< 1: Remember erased pages in RAM, flash is only checked if page's state is unknown, 0: always check flash */
 #define PIFS_USE_DELTA_FOR_ENTRIES      0u   /**< 1: Use delta pages for list entries, 0: don't use delta pages */
 #define PIFS_ENABLE_FSEEK_BEYOND_FILE   1u   /**< 1: Enable seeking beyond file size, 0: disable seeking beyond file size */
 #define PIFS_ENABLE_FSEEK_ERASED_VALUE  0u   /**< 1: Write 0xFF values when seeking beyond file size,
@@ -128,6 +128,8 @@
 #define PIFS_FLASH_4BYTE_ADDRESS            1
 #endif
 
+#define PIFS_FLASH_MULTI_PAGE_ENABLED       1       /**< 1: driver implements pifs_flash_read_multi() and pifs_flash_write_multi() */
+#define PIFS_FLASH_ASYNC_ENABLED            0       /**< 1: driver implements pifs_flash_async_submit() and related functions */
 #define PIFS_FLASH_ERASED_BYTE_VALUE        0xFFu
 #define PIFS_FLASH_PROGRAMMED_BYTE_VALUE    (PIFS_FLASH_ERASED_BYTE_VALUE ^ 0xFFu)
 
@@ -0,0 +1,1043 @@
+/**
+ * @file        bench.c
+ * @brief       Benchmarks of Pi file system
+ * @author      Copyright (C) Peter Ivanov, 2017
+ *
+ * Created:     2026-10-16 10:12:40
+ * Last modify: 2026-10-16 10:12:40 ivanovp {Time-stamp}
+ * Licence:     GPL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "api_pifs.h"
+#include "pifs.h"
+#include "pifs_fsbm.h"
+#include "pifs_helper.h"
+#include "pifs_map.h"
+#include "bench.h"
+
+#define BENCH_FILENAME          "bench.dat"
+#define BENCH_BUF_SIZE_BYTE     (16u * PIFS_LOGICAL_PAGE_SIZE_BYTE)
+#define BENCH_FSBM_REPEAT       20u     /**< Number of scans per measurement */
+#define BENCH_FSBM_RUN_PAGES    8u      /**< Length of free page runs to find */
+#define BENCH_FRAGMENT_SEED             1234u   /**< Seed of random generator used to fragment free space */
+#define BENCH_FRAGMENT_HOLE_PERIOD      8u      /**< About one in every n free data pages is made unusable */
+#define BENCH_FRAGMENT_FIND_REPEAT      100u    /**< Number of searches per measurement */
+#define BENCH_FRAGMENT_FIND_PAGE_NUM    32u     /**< Number of free pages to find */
+#define BENCH_INTERLEAVE_FILE_NUM       PIFS_MIN(4u, PIFS_OPEN_FILE_NUM_MAX)  /**< Number of files written at the same time */
+#define BENCH_COUNTER_FILE_SIZE_BYTE    (4u * PIFS_LOGICAL_PAGE_SIZE_BYTE)    /**< Size of file which contains a counter */
+#define BENCH_SEEK_SEED                 4321u   /**< Seed of random generator used to select positions */
+#define BENCH_SEEK_READ_SIZE_BYTE       16u     /**< Number of bytes read after every seek */
+#define BENCH_SEEK_BACK_STEP_BYTE       (3u * PIFS_LOGICAL_PAGE_SIZE_BYTE / 2u)    /**< Distance of backward seeks */
+
+/** Flash geometry used by free space bitmap benchmark */
+typedef struct
+{
+    const char * name;
+    size_t       page_num;      /**< Number of logical pages */
+} bench_geometry_t;
+
+static const bench_geometry_t bench_geometries[] =
+{
+    { "W25Q16",  (2ul * 1024ul * 1024ul) / 256u },
+    { "W25Q64",  (8ul * 1024ul * 1024ul) / 256u },
+    { "W25Q256", (32ul * 1024ul * 1024ul) / 256u },
+};
+
+/** Positions of seek benchmark */
+typedef enum
+{
+    BENCH_SEEK_RANDOM,      /**< Random positions */
+    BENCH_SEEK_BACKWARD,    /**< Positions go backward from end of file by BENCH_SEEK_BACK_STEP_BYTE */
+    BENCH_SEEK_REOPEN,      /**< Random positions, file is opened before every seek */
+} bench_seek_t;
+
+static const char * bench_seek_names[] = { "random", "backward", "reopen" };
+
+/** Result of counting extents of a file */
+typedef struct
+{
+    pifs_block_address_t block_address;     /**< Address of previous data page */
+    pifs_page_address_t  page_address;
+    size_t               extent_cntr;       /**< Number of contiguous runs of data pages */
+    size_t               map_entry_cntr;    /**< Number of map entries */
+    size_t               map_page_cntr;     /**< Number of map pages */
+} bench_extent_t;
+
+static uint8_t bench_buf[BENCH_BUF_SIZE_BYTE];
+
+/**
+ * @brief bench_get_time_us Get monotonic time.
+ *
+ * @return Time in microseconds.
+ */
+static uint64_t bench_get_time_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000u + ts.tv_nsec / 1000u;
+}
+
+/**
+ * @brief bench_create_file Create file for benchmark.
+ *
+ * @param[in] a_filename    Name of file.
+ * @param[in] a_file_size   Size of file in bytes.
+ * @return PIFS_SUCCESS if file was created.
+ */
+static pifs_status_t bench_create_file(const char * a_filename, size_t a_file_size)
+{
+    pifs_status_t ret = PIFS_ERROR_GENERAL;
+    P_FILE      * file;
+    size_t        chunk_size;
+    size_t        i;
+
+    for (i = 0; i < sizeof(bench_buf); i++)
+    {
+        bench_buf[i] = rand();
+    }
+    file = pifs_fopen(a_filename, "w");
+    if (file)
+    {
+        ret = PIFS_SUCCESS;
+        while (a_file_size && ret == PIFS_SUCCESS)
+        {
+            chunk_size = PIFS_MIN(a_file_size, sizeof(bench_buf));
+            if (pifs_fwrite(bench_buf, 1, chunk_size, file) != chunk_size)
+            {
+                printf("Cannot write file: %i!\r\n", pifs_errno);
+                ret = PIFS_ERROR_GENERAL;
+            }
+            a_file_size -= chunk_size;
+        }
+        if (pifs_fclose(file))
+        {
+            ret = PIFS_ERROR_GENERAL;
+        }
+    }
+    else
+    {
+        printf("Cannot open file '%s': %i!\r\n", a_filename, pifs_errno);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief bench_read_file Read file sequentially and print throughput.
+ *
+ * @param[in] a_filename    Name of file.
+ * @param[in] a_chunk_size  Number of bytes read by one pifs_fread() call.
+ * @return PIFS_SUCCESS if file was read.
+ */
+static pifs_status_t bench_read_file(const char * a_filename, size_t a_chunk_size)
+{
+    pifs_status_t ret = PIFS_ERROR_GENERAL;
+    P_FILE      * file;
+    size_t        read_size = 0;
+    size_t        chunk_size;
+    uint64_t      start_us;
+    uint64_t      elapsed_us;
+    uint32_t      hit_cntr;
+    uint32_t      miss_cntr;
+
+    (void) pifs_flush();
+    hit_cntr = pifs.cache_hit_cntr[PIFS_CACHE_CLASS_DATA];
+    miss_cntr = pifs.cache_miss_cntr[PIFS_CACHE_CLASS_DATA];
+    start_us = bench_get_time_us();
+    file = pifs_fopen(a_filename, "r");
+    if (file)
+    {
+        ret = PIFS_SUCCESS;
+        do
+        {
+            chunk_size = pifs_fread(bench_buf, 1, a_chunk_size, file);
+            read_size += chunk_size;
+        } while (chunk_size == a_chunk_size);
+        (void) pifs_fclose(file);
+    }
+    else
+    {
+        printf("Cannot open file '%s': %i!\r\n", a_filename, pifs_errno);
+    }
+    elapsed_us = bench_get_time_us() - start_us;
+    if (ret == PIFS_SUCCESS)
+    {
+        printf("%-10lu | %-10lu | %-10llu | %-10.1f | %-10lu | %lu\r\n",
+               (unsigned long) a_chunk_size,
+               (unsigned long) read_size,
+               (unsigned long long) elapsed_us,
+               elapsed_us ? (read_size * 1000000.0 / 1024.0) / elapsed_us : 0.0,
+               (unsigned long) (pifs.cache_hit_cntr[PIFS_CACHE_CLASS_DATA] - hit_cntr),
+               (unsigned long) (pifs.cache_miss_cntr[PIFS_CACHE_CLASS_DATA] - miss_cntr));
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_bench_read_ahead Measure sequential read throughput with and
+ * without read-ahead.
+ *
+ * @param[in] a_file_size   Size of test file in bytes.
+ * @param[in] a_chunk_size  Number of bytes read by one pifs_fread() call.
+ *                          0: several chunk sizes are measured.
+ * @return PIFS_SUCCESS if benchmark was run successfully.
+ */
+pifs_status_t pifs_bench_read_ahead(size_t a_file_size, size_t a_chunk_size)
+{
+    pifs_status_t ret;
+    size_t        chunk_size_min;
+    size_t        chunk_size_max;
+    size_t        chunk_size;
+    size_t        i;
+
+    a_chunk_size = PIFS_MIN(a_chunk_size, sizeof(bench_buf));
+    chunk_size_min = a_chunk_size ? a_chunk_size : 16u;
+    chunk_size_max = a_chunk_size ? a_chunk_size : sizeof(bench_buf);
+    ret = bench_create_file(BENCH_FILENAME, a_file_size);
+    /* First pass without read-ahead, second pass with maximum read-ahead */
+    for (i = 0; i < 2 && ret == PIFS_SUCCESS; i++)
+    {
+#if PIFS_READ_AHEAD_PAGE_NUM_MAX
+        pifs_set_read_ahead_page_num(i * PIFS_READ_AHEAD_PAGE_NUM_MAX);
+#else
+        printf("Read-ahead is disabled in pifs_config.h!\r\n");
+        i++;
+#endif
+        printf("Read-ahead: max %lu pages\r\n", (unsigned long) (i * PIFS_READ_AHEAD_PAGE_NUM_MAX));
+        printf("Chunk      | Bytes      | Time [us]  | KiB/s      | Data hit   | Data miss\r\n");
+        for (chunk_size = chunk_size_min; chunk_size <= chunk_size_max && ret == PIFS_SUCCESS;
+             chunk_size *= 4)
+        {
+            ret = bench_read_file(BENCH_FILENAME, chunk_size);
+        }
+    }
+#if PIFS_READ_AHEAD_PAGE_NUM_MAX
+    pifs_set_read_ahead_page_num(PIFS_READ_AHEAD_PAGE_NUM_MAX);
+#endif
+    (void) pifs_remove(BENCH_FILENAME);
+
+    return ret;
+}
+
+/**
+ * @brief bench_fsbm_fill Fill free space bitmap with a used file system's
+ * pattern: runs of used, to be released and free pages with random length.
+ *
+ * @param[out] a_bitmap     Free space bitmap.
+ * @param[in] a_page_num    Number of pages.
+ */
+static void bench_fsbm_fill(uint8_t * a_bitmap, size_t a_page_num)
+{
+    size_t  page_idx = 0;
+    size_t  run_length;
+    size_t  i;
+    uint8_t bits;
+    int     r;
+
+    memset(a_bitmap, 0, (a_page_num * PIFS_FSBM_BITS_PER_PAGE + PIFS_BYTE_BITS - 1) / PIFS_BYTE_BITS);
+    while (page_idx < a_page_num)
+    {
+        r = rand() % 10;
+        /* 70% used, 10% to be released, 20% free */
+        bits = (r < 7) ? 2u : ((r < 8) ? 0u : 3u);
+        run_length = 1u + rand() % (2u * BENCH_FSBM_RUN_PAGES);
+        for (i = 0; i < run_length && page_idx < a_page_num; i++)
+        {
+            a_bitmap[page_idx / 4u] |= bits << ((page_idx % 4u) * PIFS_FSBM_BITS_PER_PAGE);
+            page_idx++;
+        }
+    }
+}
+
+/**
+ * @brief bench_fsbm_count_bytewise Count free pages like the byte by byte
+ * loop of pifs_get_pages().
+ *
+ * @param[in] a_bitmap      Free space bitmap.
+ * @param[in] a_page_num    Number of pages.
+ * @return Number of free pages.
+ */
+static size_t bench_fsbm_count_bytewise(const uint8_t * a_bitmap, size_t a_page_num)
+{
+    size_t  cntr = 0;
+    size_t  page_idx = 0;
+    size_t  i;
+    uint8_t byte;
+
+    while (page_idx < a_page_num)
+    {
+        byte = a_bitmap[page_idx / 4u];
+        for (i = 0; i < PIFS_BYTE_BITS / PIFS_FSBM_BITS_PER_PAGE && page_idx < a_page_num; i++)
+        {
+            if ((byte & 1u) == 1u)
+            {
+                cntr++;
+            }
+            byte >>= PIFS_FSBM_BITS_PER_PAGE;
+            page_idx++;
+        }
+    }
+
+    return cntr;
+}
+
+/**
+ * @brief bench_fsbm_runs_bytewise Count runs of free pages like the byte by
+ * byte loop of pifs_find_page_adv().
+ *
+ * @param[in] a_bitmap      Free space bitmap.
+ * @param[in] a_page_num    Number of pages.
+ * @return Number of runs with BENCH_FSBM_RUN_PAGES free pages.
+ */
+static size_t bench_fsbm_runs_bytewise(const uint8_t * a_bitmap, size_t a_page_num)
+{
+    size_t  cntr = 0;
+    size_t  page_count_found = 0;
+    size_t  page_idx = 0;
+    size_t  i;
+    uint8_t byte;
+
+    while (page_idx < a_page_num)
+    {
+        byte = a_bitmap[page_idx / 4u];
+        for (i = 0; i < PIFS_BYTE_BITS / PIFS_FSBM_BITS_PER_PAGE && page_idx < a_page_num; i++)
+        {
+            if ((byte & 1u) == 1u)
+            {
+                page_count_found++;
+                if (page_count_found == BENCH_FSBM_RUN_PAGES)
+                {
+                    cntr++;
+                    page_count_found = 0;
+                }
+            }
+            else
+            {
+                page_count_found = 0;
+            }
+            byte >>= PIFS_FSBM_BITS_PER_PAGE;
+            page_idx++;
+        }
+    }
+
+    return cntr;
+}
+
+/**
+ * @brief bench_fsbm_runs_wordwise Count runs of free pages by word kernels.
+ *
+ * @param[in] a_bitmap      Free space bitmap.
+ * @param[in] a_page_num    Number of pages.
+ * @return Number of runs with BENCH_FSBM_RUN_PAGES free pages.
+ */
+static size_t bench_fsbm_runs_wordwise(const uint8_t * a_bitmap, size_t a_page_num)
+{
+    size_t cntr = 0;
+    size_t page_idx = 0;
+    size_t run_end_idx;
+
+    while (page_idx < a_page_num)
+    {
+        page_idx = pifs_fsbm_find_next(a_bitmap, page_idx, a_page_num, TRUE, FALSE, TRUE);
+        run_end_idx = pifs_fsbm_find_next(a_bitmap, page_idx, a_page_num, TRUE, FALSE, FALSE);
+        cntr += (run_end_idx - page_idx) / BENCH_FSBM_RUN_PAGES;
+        page_idx = run_end_idx;
+    }
+
+    return cntr;
+}
+
+/**
+ * @brief pifs_bench_fsbm_scan Compare byte by byte and word at a time scans
+ * of free space bitmap: counting free pages and finding runs of free pages.
+ * Synthetic bitmaps of different flash memories are used, file system is
+ * not accessed.
+ *
+ * @return PIFS_SUCCESS if results of the two methods are equal.
+ */
+pifs_status_t pifs_bench_fsbm_scan(void)
+{
+    pifs_status_t ret = PIFS_SUCCESS;
+    uint8_t     * bitmap;
+    size_t        g;
+    size_t        i;
+    size_t        page_num;
+    size_t        result[2];
+    uint64_t      elapsed_us[2];
+    uint64_t      start_us;
+    const char  * op_name[2] = { "count", "runs" };
+    size_t        op;
+
+    printf("Word size: %lu bits, scans per measurement: %u\r\n",
+           (unsigned long) (sizeof(pifs_fsbm_word_t) * PIFS_BYTE_BITS), BENCH_FSBM_REPEAT);
+    printf("Flash      | Pages      | Operation  | Byte [us]  | Word [us]  | Speed-up\r\n");
+    for (g = 0; g < sizeof(bench_geometries) / sizeof(bench_geometries[0]) && ret == PIFS_SUCCESS; g++)
+    {
+        page_num = bench_geometries[g].page_num;
+        bitmap = malloc(page_num / 4u + 1u);
+        if (bitmap)
+        {
+            bench_fsbm_fill(bitmap, page_num);
+            for (op = 0; op < 2 && ret == PIFS_SUCCESS; op++)
+            {
+                start_us = bench_get_time_us();
+                for (i = 0; i < BENCH_FSBM_REPEAT; i++)
+                {
+                    result[0] = op ? bench_fsbm_runs_bytewise(bitmap, page_num)
+                                   : bench_fsbm_count_bytewise(bitmap, page_num);
+                }
+                elapsed_us[0] = bench_get_time_us() - start_us;
+                start_us = bench_get_time_us();
+                for (i = 0; i < BENCH_FSBM_REPEAT; i++)
+                {
+                    result[1] = op ? bench_fsbm_runs_wordwise(bitmap, page_num)
+                                   : pifs_fsbm_count(bitmap, 0, page_num, TRUE, FALSE);
+                }
+                elapsed_us[1] = bench_get_time_us() - start_us;
+                printf("%-10s | %-10lu | %-10s | %-10llu | %-10llu | %.1f\r\n",
+                       bench_geometries[g].name, (unsigned long) page_num, op_name[op],
+                       (unsigned long long) elapsed_us[0], (unsigned long long) elapsed_us[1],
+                       elapsed_us[1] ? (double) elapsed_us[0] / elapsed_us[1] : 0.0);
+                if (result[0] != result[1])
+                {
+                    printf("ERROR: results differ: %lu != %lu\r\n",
+                           (unsigned long) result[0], (unsigned long) result[1]);
+                    ret = PIFS_ERROR_GENERAL;
+                }
+            }
+            free(bitmap);
+        }
+        else
+        {
+            ret = PIFS_ERROR_NO_MORE_RESOURCE;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief bench_extent_walker Callback of pifs_walk_file_pages(): count
+ * contiguous runs of data pages and map pages of file.
+ */
+static pifs_status_t bench_extent_walker(pifs_file_t * a_file,
+                                         pifs_block_address_t a_block_address,
+                                         pifs_page_address_t a_page_address,
+                                         pifs_block_address_t a_delta_block_address,
+                                         pifs_page_address_t a_delta_page_address,
+                                         bool_t a_map_page,
+                                         void * a_func_data)
+{
+    bench_extent_t  * extent = (bench_extent_t*) a_func_data;
+    bool_t            is_next_page;
+
+    (void) a_file;
+    (void) a_delta_block_address;
+    (void) a_delta_page_address;
+
+    if (a_map_page)
+    {
+        extent->map_page_cntr++;
+    }
+    else
+    {
+        is_next_page = (a_block_address == extent->block_address
+                        && a_page_address == extent->page_address + 1u)
+                || (a_block_address == extent->block_address + 1u && a_page_address == 0
+                    && extent->page_address == PIFS_LOGICAL_PAGE_PER_BLOCK - 1u);
+        if (!is_next_page)
+        {
+            extent->extent_cntr++;
+        }
+        extent->block_address = a_block_address;
+        extent->page_address = a_page_address;
+    }
+
+    return PIFS_SUCCESS;
+}
+
+/**
+ * @brief bench_count_extents Count extents (contiguous runs of data pages),
+ * map entries and map pages of a file.
+ *
+ * @param[in] a_filename    Name of file.
+ * @param[out] a_extent     Result.
+ * @return PIFS_SUCCESS if file was processed.
+ */
+static pifs_status_t bench_count_extents(const char * a_filename, bench_extent_t * a_extent)
+{
+    pifs_status_t ret = PIFS_ERROR_FILE_NOT_FOUND;
+    pifs_file_t * file;
+
+    a_extent->block_address = PIFS_BLOCK_ADDRESS_INVALID;
+    a_extent->page_address = PIFS_PAGE_ADDRESS_INVALID;
+    a_extent->extent_cntr = 0;
+    a_extent->map_entry_cntr = 0;
+    a_extent->map_page_cntr = 0;
+    file = (pifs_file_t*) pifs_fopen(a_filename, "r");
+    if (file)
+    {
+        ret = pifs_walk_file_pages(file, bench_extent_walker, a_extent);
+        if (ret == PIFS_SUCCESS)
+        {
+            ret = pifs_read_first_map_entry(file);
+        }
+        while (ret == PIFS_SUCCESS && !pifs_is_buffer_erased(&file->map_entry, PIFS_MAP_ENTRY_SIZE_BYTE))
+        {
+            a_extent->map_entry_cntr++;
+            ret = pifs_read_next_map_entry(file);
+        }
+        if (ret == PIFS_ERROR_END_OF_FILE)
+        {
+            /* Last map page is full */
+            ret = PIFS_SUCCESS;
+        }
+        (void) pifs_fclose(file);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief bench_fragment_free_space Fragment free space of data blocks:
+ * random free pages are marked used and to be released, about one in
+ * every BENCH_FRAGMENT_HOLE_PERIOD pages. These pages are reclaimed by
+ * merge like pages of deleted files.
+ *
+ * @return PIFS_SUCCESS if pages were marked.
+ */
+static pifs_status_t bench_fragment_free_space(void)
+{
+    pifs_status_t        ret = PIFS_SUCCESS;
+    pifs_block_address_t ba;
+    pifs_page_address_t  pa;
+
+    srand(BENCH_FRAGMENT_SEED);
+    for (ba = PIFS_FLASH_BLOCK_RESERVED_NUM; ba < PIFS_FLASH_BLOCK_NUM_ALL && ret == PIFS_SUCCESS; ba++)
+    {
+        if (pifs_is_block_type(ba, PIFS_BLOCK_TYPE_DATA, &pifs.header))
+        {
+            for (pa = 0; pa < PIFS_LOGICAL_PAGE_PER_BLOCK && ret == PIFS_SUCCESS; pa++)
+            {
+                if ((rand() % BENCH_FRAGMENT_HOLE_PERIOD) == 0 && pifs_is_page_free(ba, pa))
+                {
+                    ret = pifs_mark_page(ba, pa, 1, TRUE, TRUE);
+                }
+            }
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_bench_fragment Measure allocation on fragmented free space
+ * with and without free extent index. Free space is fragmented first, then
+ * time of finding BENCH_FRAGMENT_FIND_PAGE_NUM free pages is measured and
+ * a file is written in a_chunk_size chunks. Number of extents, map entries
+ * and map pages of the written file is printed.
+ * Note: fragmented pages stay to be released until they are merged.
+ *
+ * @param[in] a_file_size   Size of test file in bytes.
+ * @param[in] a_chunk_size  Number of bytes written by one pifs_fwrite() call.
+ * @return PIFS_SUCCESS if benchmark was run successfully.
+ */
+pifs_status_t pifs_bench_fragment(size_t a_file_size, size_t a_chunk_size)
+{
+    pifs_status_t        ret;
+    P_FILE             * file;
+    pifs_block_address_t ba;
+    pifs_page_address_t  pa;
+    pifs_page_count_t    page_count_found;
+    bench_extent_t       extent;
+    size_t               written_size;
+    size_t               chunk_size;
+    size_t               i;
+    size_t               mode;
+    uint64_t             find_us;
+    uint64_t             write_us;
+    uint64_t             start_us;
+    char                 filename[16];
+
+    a_chunk_size = PIFS_MIN(a_chunk_size, sizeof(bench_buf));
+    for (i = 0; i < sizeof(bench_buf); i++)
+    {
+        bench_buf[i] = rand();
+    }
+    ret = bench_fragment_free_space();
+    printf("Find %u pages %u times, write %lu bytes in %lu byte chunks\r\n",
+           BENCH_FRAGMENT_FIND_PAGE_NUM, BENCH_FRAGMENT_FIND_REPEAT,
+           (unsigned long) a_file_size, (unsigned long) a_chunk_size);
+    printf("Index      | Find [us]  | Write [us] | Extents    | Map entries | Map pages\r\n");
+    for (mode = 0; mode < 2 && ret == PIFS_SUCCESS; mode++)
+    {
+#if PIFS_ENABLE_FREE_EXTENT_INDEX
+        if (mode)
+        {
+            pifs_free_extent_build();
+        }
+        else
+        {
+            pifs_free_extent_invalidate();
+        }
+#else
+        printf("Free extent index is disabled in pifs_config.h!\r\n");
+        mode++;
+#endif
+        start_us = bench_get_time_us();
+        for (i = 0; i < BENCH_FRAGMENT_FIND_REPEAT && ret == PIFS_SUCCESS; i++)
+        {
+            ret = pifs_find_page(1, BENCH_FRAGMENT_FIND_PAGE_NUM, PIFS_BLOCK_TYPE_DATA, TRUE, FALSE,
+                                 PIFS_FLASH_BLOCK_RESERVED_NUM, &ba, &pa, &page_count_found);
+        }
+        find_us = bench_get_time_us() - start_us;
+        snprintf(filename, sizeof(filename), "bfrag%lu.dat", (unsigned long) mode);
+        start_us = bench_get_time_us();
+        file = pifs_fopen(filename, "w");
+        if (file)
+        {
+            for (written_size = 0; written_size < a_file_size && ret == PIFS_SUCCESS; written_size += chunk_size)
+            {
+                chunk_size = PIFS_MIN(a_file_size - written_size, a_chunk_size);
+                if (pifs_fwrite(bench_buf, 1, chunk_size, file) != chunk_size)
+                {
+                    printf("Cannot write file: %i!\r\n", pifs_errno);
+                    ret = PIFS_ERROR_GENERAL;
+                }
+            }
+            if (pifs_fclose(file))
+            {
+                ret = PIFS_ERROR_GENERAL;
+            }
+        }
+        else
+        {
+            printf("Cannot open file '%s': %i!\r\n", filename, pifs_errno);
+            ret = PIFS_ERROR_GENERAL;
+        }
+        write_us = bench_get_time_us() - start_us;
+        if (ret == PIFS_SUCCESS)
+        {
+            ret = bench_count_extents(filename, &extent);
+        }
+        if (ret == PIFS_SUCCESS)
+        {
+            printf("%-10s | %-10llu | %-10llu | %-10lu | %-11lu | %lu\r\n",
+                   mode ? "enabled" : "disabled",
+                   (unsigned long long) find_us, (unsigned long long) write_us,
+                   (unsigned long) extent.extent_cntr, (unsigned long) extent.map_entry_cntr,
+                   (unsigned long) extent.map_page_cntr);
+        }
+        (void) pifs_remove(filename);
+    }
+#if PIFS_ENABLE_FREE_EXTENT_INDEX
+    pifs_free_extent_build();
+#endif
+
+    return ret;
+}
+
+/**
+ * @brief pifs_bench_interleave Measure appending files at the same time.
+ * BENCH_INTERLEAVE_FILE_NUM files are opened and written chunk by chunk,
+ * in turn. Number of extents, map entries and map pages of every file is
+ * printed, then read throughput of the files is measured.
+ *
+ * @param[in] a_file_size   Size of every test file in bytes.
+ * @param[in] a_chunk_size  Number of bytes written by one pifs_fwrite() call.
+ * @return PIFS_SUCCESS if benchmark was run successfully.
+ */
+pifs_status_t pifs_bench_interleave(size_t a_file_size, size_t a_chunk_size)
+{
+    pifs_status_t        ret = PIFS_SUCCESS;
+    P_FILE             * file[BENCH_INTERLEAVE_FILE_NUM];
+    bench_extent_t       extent;
+    size_t               written_size;
+    size_t               chunk_size = 0;
+    size_t               i;
+    uint64_t             start_us;
+    char                 filename[BENCH_INTERLEAVE_FILE_NUM][16];
+
+    a_chunk_size = PIFS_MIN(a_chunk_size, sizeof(bench_buf));
+    for (i = 0; i < sizeof(bench_buf); i++)
+    {
+        bench_buf[i] = rand();
+    }
+    for (i = 0; i < BENCH_INTERLEAVE_FILE_NUM; i++)
+    {
+        snprintf(filename[i], sizeof(filename[i]), "bint%lu.dat", (unsigned long) i);
+        file[i] = pifs_fopen(filename[i], "w");
+        if (!file[i])
+        {
+            printf("Cannot open file '%s': %i!\r\n", filename[i], pifs_errno);
+            ret = PIFS_ERROR_GENERAL;
+        }
+    }
+    start_us = bench_get_time_us();
+    for (written_size = 0; written_size < a_file_size && ret == PIFS_SUCCESS; written_size += chunk_size)
+    {
+        chunk_size = PIFS_MIN(a_file_size - written_size, a_chunk_size);
+        for (i = 0; i < BENCH_INTERLEAVE_FILE_NUM && ret == PIFS_SUCCESS; i++)
+        {
+            if (pifs_fwrite(bench_buf, 1, chunk_size, file[i]) != chunk_size)
+            {
+                printf("Cannot write file: %i!\r\n", pifs_errno);
+                ret = PIFS_ERROR_GENERAL;
+            }
+        }
+    }
+    for (i = 0; i < BENCH_INTERLEAVE_FILE_NUM; i++)
+    {
+        if (file[i] && pifs_fclose(file[i]))
+        {
+            ret = PIFS_ERROR_GENERAL;
+        }
+    }
+    if (ret == PIFS_SUCCESS)
+    {
+        printf("Write %lu files of %lu bytes in %lu byte chunks: %llu us\r\n",
+               (unsigned long) BENCH_INTERLEAVE_FILE_NUM, (unsigned long) a_file_size,
+               (unsigned long) a_chunk_size, (unsigned long long) (bench_get_time_us() - start_us));
+        printf("File       | Extents    | Map entries | Map pages\r\n");
+    }
+    for (i = 0; i < BENCH_INTERLEAVE_FILE_NUM && ret == PIFS_SUCCESS; i++)
+    {
+        ret = bench_count_extents(filename[i], &extent);
+        if (ret == PIFS_SUCCESS)
+        {
+            printf("%-10s | %-10lu | %-11lu | %lu\r\n", filename[i],
+                   (unsigned long) extent.extent_cntr, (unsigned long) extent.map_entry_cntr,
+                   (unsigned long) extent.map_page_cntr);
+        }
+    }
+    if (ret == PIFS_SUCCESS)
+    {
+        printf("Chunk      | Bytes      | Time [us]  | KiB/s      | Data hit   | Data miss\r\n");
+    }
+    for (i = 0; i < BENCH_INTERLEAVE_FILE_NUM && ret == PIFS_SUCCESS; i++)
+    {
+        ret = bench_read_file(filename[i], sizeof(bench_buf));
+    }
+    for (i = 0; i < BENCH_INTERLEAVE_FILE_NUM; i++)
+    {
+        (void) pifs_remove(filename[i]);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_bench_delta Measure sequential read throughput of a file
+ * which has overwritten pages. Every overwritten page is redirected to a
+ * delta page, which are looked up at every page read.
+ *
+ * @param[in] a_file_size   Size of test file in bytes.
+ * @param[in] a_page_num    Number of pages to overwrite, evenly spread in
+ *                          the file.
+ * @return PIFS_SUCCESS if benchmark was run successfully.
+ */
+pifs_status_t pifs_bench_delta(size_t a_file_size, size_t a_page_num)
+{
+    pifs_status_t ret;
+    P_FILE      * file;
+    size_t        file_page_num = a_file_size / PIFS_LOGICAL_PAGE_SIZE_BYTE;
+    size_t        i;
+
+    a_page_num = PIFS_MIN(a_page_num, file_page_num);
+    ret = bench_create_file(BENCH_FILENAME, a_file_size);
+    if (ret == PIFS_SUCCESS)
+    {
+        file = pifs_fopen(BENCH_FILENAME, "r+");
+        if (file)
+        {
+            for (i = 0; i < PIFS_LOGICAL_PAGE_SIZE_BYTE; i++)
+            {
+                bench_buf[i] = ~bench_buf[i];
+            }
+            for (i = 0; i < a_page_num && ret == PIFS_SUCCESS; i++)
+            {
+                if (pifs_fseek(file, (long int) ((i * file_page_num / a_page_num) * PIFS_LOGICAL_PAGE_SIZE_BYTE),
+                               PIFS_SEEK_SET)
+                        || pifs_fwrite(bench_buf, 1, PIFS_LOGICAL_PAGE_SIZE_BYTE, file) != PIFS_LOGICAL_PAGE_SIZE_BYTE)
+                {
+                    printf("Cannot overwrite file: %i!\r\n", pifs_errno);
+                    ret = PIFS_ERROR_GENERAL;
+                }
+            }
+            if (pifs_fclose(file))
+            {
+                ret = PIFS_ERROR_GENERAL;
+            }
+        }
+        else
+        {
+            printf("Cannot open file '%s': %i!\r\n", BENCH_FILENAME, pifs_errno);
+            ret = PIFS_ERROR_GENERAL;
+        }
+    }
+    if (ret == PIFS_SUCCESS)
+    {
+        printf("%lu of %lu pages overwritten\r\n", (unsigned long) a_page_num, (unsigned long) file_page_num);
+        printf("Chunk      | Bytes      | Time [us]  | KiB/s      | Data hit   | Data miss\r\n");
+        ret = bench_read_file(BENCH_FILENAME, PIFS_LOGICAL_PAGE_SIZE_BYTE);
+    }
+    if (ret == PIFS_SUCCESS)
+    {
+        ret = bench_read_file(BENCH_FILENAME, sizeof(bench_buf));
+    }
+    (void) pifs_remove(BENCH_FILENAME);
+
+    return ret;
+}
+
+/**
+ * @brief pifs_bench_counter Measure updating a counter at the beginning of
+ * a file. The file is opened, the counter is overwritten and the file is
+ * closed at every update. Content of the file is checked at the end.
+ *
+ * @param[in] a_update_num  Number of counter updates.
+ * @return PIFS_SUCCESS if benchmark was run successfully.
+ */
+pifs_status_t pifs_bench_counter(size_t a_update_num)
+{
+    pifs_status_t ret;
+    P_FILE      * file;
+    uint8_t       expected[BENCH_COUNTER_FILE_SIZE_BYTE];
+    uint32_t      counter;
+    size_t        i;
+    pifs_size_t   free_management_page_count;
+    pifs_size_t   free_data_page_count_start = 0;
+    pifs_size_t   free_data_page_count = 0;
+    uint64_t      start_us;
+    uint64_t      elapsed_us;
+
+    ret = bench_create_file(BENCH_FILENAME, sizeof(expected));
+    if (ret == PIFS_SUCCESS)
+    {
+        memcpy(expected, bench_buf, sizeof(expected));
+        ret = pifs_get_free_pages(&free_management_page_count, &free_data_page_count_start);
+    }
+    start_us = bench_get_time_us();
+    for (i = 0; i < a_update_num && ret == PIFS_SUCCESS; i++)
+    {
+        file = pifs_fopen(BENCH_FILENAME, "r+");
+        if (file)
+        {
+            counter = i;
+            memcpy(expected, &counter, sizeof(counter));
+            if (pifs_fwrite(&counter, 1, sizeof(counter), file) != sizeof(counter))
+            {
+                printf("Cannot overwrite file: %i!\r\n", pifs_errno);
+                ret = PIFS_ERROR_GENERAL;
+            }
+            if (pifs_fclose(file))
+            {
+                ret = PIFS_ERROR_GENERAL;
+            }
+        }
+        else
+        {
+            printf("Cannot open file '%s': %i!\r\n", BENCH_FILENAME, pifs_errno);
+            ret = PIFS_ERROR_GENERAL;
+        }
+    }
+    elapsed_us = bench_get_time_us() - start_us;
+    if (ret == PIFS_SUCCESS)
+    {
+        ret = pifs_get_free_pages(&free_management_page_count, &free_data_page_count);
+    }
+    if (ret == PIFS_SUCCESS)
+    {
+        file = pifs_fopen(BENCH_FILENAME, "r");
+        if (file)
+        {
+            if (pifs_fread(bench_buf, 1, sizeof(expected), file) != sizeof(expected)
+                    || memcmp(bench_buf, expected, sizeof(expected)))
+            {
+                printf("Content of file is wrong!\r\n");
+                ret = PIFS_ERROR_GENERAL;
+            }
+            (void) pifs_fclose(file);
+        }
+        else
+        {
+            printf("Cannot open file '%s': %i!\r\n", BENCH_FILENAME, pifs_errno);
+            ret = PIFS_ERROR_GENERAL;
+        }
+    }
+    if (ret == PIFS_SUCCESS)
+    {
+        printf("Updates    | Time [us]  | us/update  | Data pages used\r\n");
+        printf("%-10lu | %-10llu | %-10.1f | %li\r\n",
+               (unsigned long) a_update_num,
+               (unsigned long long) elapsed_us,
+               a_update_num ? (double) elapsed_us / a_update_num : 0.0,
+               (long) free_data_page_count_start - (long) free_data_page_count);
+    }
+    (void) pifs_remove(BENCH_FILENAME);
+
+    return ret;
+}
+
+/**
+ * @brief bench_seek_file Seek in file and read a few bytes at every position.
+ * Data read is checked.
+ *
+ * @param[in] a_file_size   Size of test file in bytes.
+ * @param[in] a_seek_num    Number of seeks.
+ * @param[in] a_seek        Order of positions.
+ * @return PIFS_SUCCESS if file was read successfully.
+ */
+static pifs_status_t bench_seek_file(size_t a_file_size, size_t a_seek_num, bench_seek_t a_seek)
+{
+    pifs_status_t ret = PIFS_SUCCESS;
+    P_FILE      * file;
+    uint8_t       buf[BENCH_SEEK_READ_SIZE_BYTE];
+    size_t        pos = a_file_size;
+    size_t        read_size;
+    size_t        i;
+    uint32_t      map_read_cntr;
+    uint32_t      map_miss_cntr;
+    uint64_t      start_us;
+    uint64_t      elapsed_us = 0;
+
+    map_read_cntr = pifs.cache_hit_cntr[PIFS_CACHE_CLASS_MAP] + pifs.cache_miss_cntr[PIFS_CACHE_CLASS_MAP];
+    map_miss_cntr = pifs.cache_miss_cntr[PIFS_CACHE_CLASS_MAP];
+    file = pifs_fopen(BENCH_FILENAME, "r");
+    if (file)
+    {
+        srand(BENCH_SEEK_SEED);
+        start_us = bench_get_time_us();
+        for (i = 0; i < a_seek_num && ret == PIFS_SUCCESS; i++)
+        {
+            if (a_seek != BENCH_SEEK_BACKWARD)
+            {
+                pos = ((size_t) rand() * RAND_MAX + rand()) % a_file_size;
+            }
+            else if (pos >= BENCH_SEEK_BACK_STEP_BYTE)
+            {
+                pos -= BENCH_SEEK_BACK_STEP_BYTE;
+            }
+            else
+            {
+                pos = a_file_size - BENCH_SEEK_READ_SIZE_BYTE;
+            }
+            if (a_seek == BENCH_SEEK_REOPEN)
+            {
+                (void) pifs_fclose(file);
+                file = pifs_fopen(BENCH_FILENAME, "r");
+            }
+            read_size = PIFS_MIN(sizeof(buf), a_file_size - pos);
+            if (!file)
+            {
+                printf("Cannot open file '%s': %i!\r\n", BENCH_FILENAME, pifs_errno);
+                ret = PIFS_ERROR_GENERAL;
+            }
+            else if (pifs_fseek(file, (long int) pos, PIFS_SEEK_SET)
+                    || pifs_fread(buf, 1, read_size, file) != read_size)
+            {
+                printf("Cannot read file at %lu: %i!\r\n", (unsigned long) pos, pifs_errno);
+                ret = PIFS_ERROR_GENERAL;
+            }
+            else if ((pos % sizeof(bench_buf)) + read_size <= sizeof(bench_buf)
+                     && memcmp(buf, &bench_buf[pos % sizeof(bench_buf)], read_size))
+            {
+                printf("Content of file is wrong at %lu!\r\n", (unsigned long) pos);
+                ret = PIFS_ERROR_GENERAL;
+            }
+        }
+        elapsed_us = bench_get_time_us() - start_us;
+        if (file)
+        {
+            (void) pifs_fclose(file);
+        }
+    }
+    else
+    {
+        printf("Cannot open file '%s': %i!\r\n", BENCH_FILENAME, pifs_errno);
+        ret = PIFS_ERROR_GENERAL;
+    }
+    if (ret == PIFS_SUCCESS)
+    {
+        map_read_cntr = pifs.cache_hit_cntr[PIFS_CACHE_CLASS_MAP] + pifs.cache_miss_cntr[PIFS_CACHE_CLASS_MAP]
+                - map_read_cntr;
+        map_miss_cntr = pifs.cache_miss_cntr[PIFS_CACHE_CLASS_MAP] - map_miss_cntr;
+        printf("%-10s | %-10lu | %-10llu | %-10.1f | %-14.1f | %.2f\r\n",
+               bench_seek_names[a_seek],
+               (unsigned long) a_seek_num,
+               (unsigned long long) elapsed_us,
+               a_seek_num ? (double) elapsed_us / a_seek_num : 0.0,
+               a_seek_num ? (double) map_read_cntr / a_seek_num : 0.0,
+               a_seek_num ? (double) map_miss_cntr / a_seek_num : 0.0);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_bench_seek Measure seeking to random positions of a file,
+ * going backward in a file and seeking right after opening the file.
+ * A few bytes are read after every seek.
+ * Free space is fragmented before the file is written, so the file's map
+ * has many entries.
+ * Note: fragmented pages stay to be released until they are merged.
+ *
+ * @param[in] a_file_size   Size of test file in bytes.
+ * @param[in] a_seek_num    Number of seeks.
+ * @return PIFS_SUCCESS if benchmark was run successfully.
+ */
+pifs_status_t pifs_bench_seek(size_t a_file_size, size_t a_seek_num)
+{
+    pifs_status_t  ret;
+    bench_extent_t extent;
+
+    a_file_size = PIFS_MAX(a_file_size, BENCH_SEEK_READ_SIZE_BYTE);
+    ret = bench_fragment_free_space();
+    if (ret == PIFS_SUCCESS)
+    {
+        ret = bench_create_file(BENCH_FILENAME, a_file_size);
+    }
+    if (ret == PIFS_SUCCESS)
+    {
+        ret = bench_count_extents(BENCH_FILENAME, &extent);
+    }
+    if (ret == PIFS_SUCCESS)
+    {
+        printf("%lu bytes, %lu extents, %lu map entries, %lu map pages\r\n", (unsigned long) a_file_size,
+               (unsigned long) extent.extent_cntr, (unsigned long) extent.map_entry_cntr,
+               (unsigned long) extent.map_page_cntr);
+        printf("Seek       | Seeks      | Time [us]  | us/seek    | Map reads/seek | Map misses/seek\r\n");
+        ret = bench_seek_file(a_file_size, a_seek_num, BENCH_SEEK_RANDOM);
+    }
+    if (ret == PIFS_SUCCESS)
+    {
+        ret = bench_seek_file(a_file_size, a_seek_num, BENCH_SEEK_BACKWARD);
+    }
+    if (ret == PIFS_SUCCESS)
+    {
+        ret = bench_seek_file(a_file_size, a_seek_num, BENCH_SEEK_REOPEN);
+    }
+    (void) pifs_remove(BENCH_FILENAME);
+
+    return ret;
+}
@@ -0,0 +1,39 @@
+/**
+ * @file        bench.h
+ * @brief       Function prototypes of benchmarks of Pi file system
+ * @author      Copyright (C) Peter Ivanov, 2017
+ *
+ * Created:     2026-10-16 10:12:40
+ * Last modify: 2026-10-16 10:12:40 ivanovp {Time-stamp}
+ * Licence:     GPL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _INCLUDE_BENCH_H_
+#define _INCLUDE_BENCH_H_
+
+#include <stdint.h>
+
+#include "common.h"
+#include "pifs_config.h"
+
+pifs_status_t pifs_bench_read_ahead(size_t a_file_size, size_t a_chunk_size);
+pifs_status_t pifs_bench_fsbm_scan(void);
+pifs_status_t pifs_bench_fragment(size_t a_file_size, size_t a_chunk_size);
+pifs_status_t pifs_bench_interleave(size_t a_file_size, size_t a_chunk_size);
+pifs_status_t pifs_bench_delta(size_t a_file_size, size_t a_page_num);
+pifs_status_t pifs_bench_counter(size_t a_update_num);
+pifs_status_t pifs_bench_seek(size_t a_file_size, size_t a_seek_num);
+
+#endif /* _INCLUDE_BENCH_H_ */
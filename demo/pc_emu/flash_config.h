@@ -128,6 +128,14 @@
 #define PIFS_FLASH_4BYTE_ADDRESS            1
 #endif
 
+#define PIFS_FLASH_MULTI_PAGE_ENABLED       1       /**< 1: driver implements pifs_flash_read_multi() and pifs_flash_write_multi() */
+#define PIFS_FLASH_ASYNC_ENABLED            1       /**< 1: driver implements pifs_flash_async_submit() and related functions */
+#define FLASH_EMU_ASYNC_QUEUE_SIZE          32u     /**< Maximum number of queued asynchronous requests */
+/* Latencies are overridden by environment variables of the same name, */
+/* benchmarks can set them to emulate busy time of flash memory */
+#define FLASH_EMU_READ_LATENCY_US           0u      /**< Emulated busy time of a read command */
+#define FLASH_EMU_WRITE_LATENCY_US          0u      /**< Emulated busy time of a page program command */
+#define FLASH_EMU_ERASE_LATENCY_US          0u      /**< Emulated busy time of a block erase command */
 #define PIFS_FLASH_ERASED_BYTE_VALUE        0xFFu
 #define PIFS_FLASH_PROGRAMMED_BYTE_VALUE    (PIFS_FLASH_ERASED_BYTE_VALUE ^ 0xFFu)
 
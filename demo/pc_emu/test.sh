@@ -6,6 +6,31 @@ rm $LOG
 make clean
 #make DEBUG=1
 make
+# Test flash driver, including reading while other block is erased.
+# Time limit stops the test if a read waits for a held request.
+timeout 60 ./pifs tstflash>>$LOG
+RC=$?
+if [[ $RC != 0 ]]; then
+    tail -50 $LOG
+    echo "Error $RC occured during flash test, exiting..."
+    exit $RC;
+fi
+rm flash.bin
+rm flash.stt
+# Run test twice on the same flash without any other file, so that files
+# are re-created when merge is started
+for i in 1 2; do
+    echo "### PERSISTED FLASH TEST $i"|tee -a $LOG
+    ./pifs tp>>$LOG
+    RC=$?
+    if [[ $RC != 0 ]]; then
+        tail -50 $LOG
+        echo "Error $RC occured during persisted flash test $i, exiting..."
+        exit $RC;
+    fi
+done
+rm flash.bin
+rm flash.stt
 # Create a file
 ./pifs tb staticwear.tst >>$LOG
 for i in `seq --format="%02.0f" 100`; do
@@ -64,6 +64,7 @@ typedef enum
     PIFS_ERROR_INTEGRITY = 25,
     PIFS_ERROR_CHECKSUM = 26,
     PIFS_ERROR_TASK = 27,
+    PIFS_ERROR_VERSION = 28,            /**< Flash memory contains other version or configuration of file system */
 } pifs_status_t;
 
 #define PIFS_EACCES     PIFS_ERROR_FILE_NOT_FOUND
@@ -171,6 +172,10 @@ extern int pifs_errno;
 void pifs_print_fs_info(void);
 void pifs_print_header_info(void);
 void pifs_print_free_space_info(void);
+void pifs_print_cache_info(void);
+#if PIFS_READ_AHEAD_PAGE_NUM_MAX
+void pifs_set_read_ahead_page_num(size_t a_page_num_max);
+#endif
 pifs_status_t pifs_init(void);
 pifs_status_t pifs_delete(void);
 pifs_status_t pifs_check(void);
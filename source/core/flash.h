@@ -93,6 +93,34 @@ typedef uint32_t pifs_page_offset_t;
 /** Number of flash pages used by the file system */
 #define PIFS_FLASH_PAGE_NUM_FS      (PIFS_FLASH_BLOCK_NUM_FS * PIFS_FLASH_PAGE_PER_BLOCK)
 
+#if PIFS_FLASH_ASYNC_ENABLED
+/**
+ * Operation of an asynchronous request.
+ */
+typedef enum
+{
+    PIFS_FLASH_OP_READ = 0,
+    PIFS_FLASH_OP_WRITE,
+    PIFS_FLASH_OP_ERASE
+} pifs_flash_op_t;
+
+/**
+ * Asynchronous request of flash memory.
+ * Caller fills the parameters, driver fills status and is_done.
+ */
+typedef struct
+{
+    pifs_flash_op_t      op;
+    pifs_block_address_t block_address;
+    pifs_page_address_t  page_address;  /**< Not used by erase */
+    pifs_page_offset_t   page_offset;   /**< Not used by erase */
+    void               * buf;           /**< Not used by erase */
+    size_t               buf_size;      /**< Not used by erase */
+    pifs_status_t        status;        /**< Result of request */
+    bool_t               is_done;       /**< TRUE: request is completed */
+} pifs_flash_request_t;
+#endif
+
 /**
  * @brief pifs_flash_init Initialize flash driver.
  *
@@ -131,6 +159,33 @@ pifs_status_t pifs_flash_read(pifs_block_address_t a_block_address, pifs_page_ad
  */
 pifs_status_t pifs_flash_write(pifs_block_address_t a_block_address, pifs_page_address_t a_page_address, pifs_page_address_t a_page_offset, const void * const a_buf, size_t a_buf_size);
 
+#if PIFS_FLASH_MULTI_PAGE_ENABLED
+/**
+ * @brief pifs_flash_read_multi Read consecutive pages from flash memory
+ * with one command.
+ *
+ * @param[in] a_block_address Address of block.
+ * @param[in] a_page_address  Address of the first page in block.
+ * @param[out] a_buf          Buffer to fill.
+ * @param[in] a_page_count    Number of pages to read. Pages shall be in
+ *                            the same block.
+ * @return PIFS_SUCCESS if read successfully finished.
+ */
+pifs_status_t pifs_flash_read_multi(pifs_block_address_t a_block_address, pifs_page_address_t a_page_address, void * const a_buf, size_t a_page_count);
+
+/**
+ * @brief pifs_flash_write_multi Write consecutive pages to flash memory.
+ *
+ * @param[in] a_block_address Address of block.
+ * @param[in] a_page_address  Address of the first page in block.
+ * @param[in] a_buf           Buffer to write.
+ * @param[in] a_page_count    Number of pages to write. Pages shall be in
+ *                            the same block.
+ * @return PIFS_SUCCESS if write successfully finished.
+ */
+pifs_status_t pifs_flash_write_multi(pifs_block_address_t a_block_address, pifs_page_address_t a_page_address, const void * const a_buf, size_t a_page_count);
+#endif
+
 /**
  * @brief pifs_flash_erase Erase a block.
  *
@@ -140,6 +195,57 @@ pifs_status_t pifs_flash_write(pifs_block_address_t a_block_address, pifs_page_a
  */
 pifs_status_t pifs_flash_erase(pifs_block_address_t a_block_address);
 
+#if PIFS_FLASH_ASYNC_ENABLED
+/**
+ * @brief pifs_flash_async_submit Queue a request without waiting for its
+ * completion. Requests are executed in submission order. Synchronous
+ * program and erase (pifs_flash_write(), pifs_flash_erase(), etc.) are
+ * executed after every request submitted before them. Synchronous read
+ * (pifs_flash_read(), pifs_flash_read_multi()) is executed after the program
+ * and erase requests of the same block submitted before it, so other blocks
+ * can be read while a block is busy.
+ * The request and its buffer shall not be changed until the request is
+ * completed.
+ *
+ * @param[in] a_request Pointer to request to execute.
+ * @return PIFS_SUCCESS if request was queued.
+ */
+pifs_status_t pifs_flash_async_submit(pifs_flash_request_t * a_request);
+
+/**
+ * @brief pifs_flash_async_is_done Poll a request.
+ *
+ * @param[in] a_request Pointer to submitted request.
+ * @return TRUE: request is completed.
+ */
+bool_t pifs_flash_async_is_done(pifs_flash_request_t * a_request);
+
+/**
+ * @brief pifs_flash_async_wait Wait for completion of a request.
+ *
+ * @param[in] a_request Pointer to submitted request.
+ * @return Result of the request.
+ */
+pifs_status_t pifs_flash_async_wait(pifs_flash_request_t * a_request);
+
+/**
+ * @brief pifs_flash_async_barrier Wait for completion of every submitted
+ * request.
+ *
+ * @return PIFS_SUCCESS if every request is completed.
+ */
+pifs_status_t pifs_flash_async_barrier(void);
+
+/**
+ * @brief pifs_flash_async_hold Hold or release execution of submitted
+ * requests. Requests are queued while they are held. It is used by the flash
+ * test to check which commands wait for submitted requests.
+ *
+ * @param[in] a_is_held TRUE: hold requests, FALSE: release requests.
+ */
+void pifs_flash_async_hold(bool_t a_is_held);
+#endif
+
 /**
  * @brief pifs_flash_print_stat Called by the terminal to print information
  * about flash memory.
@@ -51,7 +51,17 @@ PIFS_OS_DEFINE_MUTEX(pifs_mutex);
 PIFS_OS_MUTEX_TYPE pifs_mutex;
 #endif
 
-
+/** Number of reserved cache slots per access class, @see pifs_cache_class_t */
+static const pifs_size_t pifs_cache_rsv_page_num[PIFS_CACHE_CLASS_NUM] =
+{
+    PIFS_CACHE_RSV_DATA_PAGE_NUM,
+    PIFS_CACHE_RSV_FSBM_PAGE_NUM,
+    PIFS_CACHE_RSV_MAP_PAGE_NUM,
+    PIFS_CACHE_RSV_ENTRY_PAGE_NUM,
+    PIFS_CACHE_RSV_DELTA_PAGE_NUM,
+    PIFS_CACHE_RSV_WEAR_PAGE_NUM,
+    0   /* Header */
+};
 
 /**
  * @brief pifs_calc_header_checksum Calculate checksum of the file system header.
@@ -69,43 +79,539 @@ static pifs_checksum_t pifs_calc_header_checksum(pifs_header_t * a_pifs_header)
 }
 
 /**
- * @brief pifs_flush  Flush cache.
+ * @brief pifs_cache_find Find page in the page cache.
  *
- * @return PIFS_SUCCESS if data written successfully.
+ * @param[in] a_block_address   Block address of page.
+ * @param[in] a_page_address    Page address of page.
+ * @return Index of cache slot or PIFS_CACHE_PAGE_NUM if page is not cached.
  */
-pifs_status_t pifs_flush(void)
+static pifs_size_t pifs_cache_find(pifs_block_address_t a_block_address,
+                                   pifs_page_address_t a_page_address)
 {
-    pifs_status_t ret = PIFS_SUCCESS;
-#if PIFS_LOGICAL_PAGE_ENABLED
-    pifs_size_t   i;
+    pifs_size_t i;
+    pifs_size_t idx = PIFS_CACHE_PAGE_NUM;
+
+    for (i = 0; i < PIFS_CACHE_PAGE_NUM && idx == PIFS_CACHE_PAGE_NUM; i++)
+    {
+        if (a_block_address == pifs.cache[i].address.block_address
+                && a_page_address == pifs.cache[i].address.page_address)
+        {
+            idx = i;
+        }
+    }
+
+    return idx;
+}
+
+/**
+ * @brief pifs_cache_touch Mark cache slot as most recently used.
+ * pifs.cache_page_buf will point to the slot's buffer.
+ *
+ * @param[in] a_idx     Index of cache slot.
+ * @param[in] a_class   Access class of page.
+ */
+static void pifs_cache_touch(pifs_size_t a_idx, pifs_cache_class_t a_class)
+{
+    pifs.cache_lru_cntr++;
+    pifs.cache[a_idx].lru_cntr = pifs.cache_lru_cntr;
+    pifs.cache[a_idx].cache_class = a_class;
+    pifs.cache_page_buf = pifs.cache[a_idx].buf;
+}
+
+/**
+ * @brief pifs_cache_age Calculate age of cache slot. The older slot has
+ * greater age. Overflow of LRU counter is handled.
+ *
+ * @param[in] a_idx Index of cache slot.
+ * @return Number of cache accesses since last use of slot.
+ */
+static uint32_t pifs_cache_age(pifs_size_t a_idx)
+{
+    return pifs.cache_lru_cntr - pifs.cache[a_idx].lru_cntr;
+}
+
+/**
+ * @brief pifs_cache_clear_dirty Clear dirty flag and dirty ranges of
+ * cache slot.
+ *
+ * @param[in] a_idx Index of cache slot.
+ */
+static void pifs_cache_clear_dirty(pifs_size_t a_idx)
+{
+    pifs_size_t i;
+
+    pifs.cache[a_idx].is_dirty = FALSE;
+    for (i = 0; i < PIFS_FLASH_PAGE_PER_LOGICAL_PAGE; i++)
+    {
+        pifs.cache[a_idx].dirty_start[i] = PIFS_FLASH_PAGE_SIZE_BYTE;
+        pifs.cache[a_idx].dirty_end[i] = 0;
+    }
+}
+
+/**
+ * @brief pifs_cache_set_dirty Extend dirty ranges of cache slot.
+ * Dirty range is stored for every flash page of the logical page.
+ *
+ * @param[in] a_idx         Index of cache slot.
+ * @param[in] a_page_offset Offset of changed bytes in logical page.
+ * @param[in] a_size        Number of changed bytes.
+ */
+static void pifs_cache_set_dirty(pifs_size_t a_idx,
+                                 pifs_size_t a_page_offset,
+                                 pifs_size_t a_size)
+{
+    pifs_cache_entry_t * cache = &pifs.cache[a_idx];
+    pifs_size_t          start;
+    pifs_size_t          end;
+    pifs_size_t          i;
+
+    for (i = a_page_offset / PIFS_FLASH_PAGE_SIZE_BYTE;
+         i < PIFS_FLASH_PAGE_PER_LOGICAL_PAGE && i * PIFS_FLASH_PAGE_SIZE_BYTE < a_page_offset + a_size;
+         i++)
+    {
+        start = PIFS_MAX(a_page_offset, i * PIFS_FLASH_PAGE_SIZE_BYTE) - i * PIFS_FLASH_PAGE_SIZE_BYTE;
+        end = PIFS_MIN(a_page_offset + a_size, (i + 1) * PIFS_FLASH_PAGE_SIZE_BYTE) - i * PIFS_FLASH_PAGE_SIZE_BYTE;
+        if (start < cache->dirty_start[i])
+        {
+            cache->dirty_start[i] = start;
+        }
+        if (end > cache->dirty_end[i])
+        {
+            cache->dirty_end[i] = end;
+        }
+        cache->is_dirty = TRUE;
+    }
+}
+
+/**
+ * @brief pifs_cache_wait_slot Wait until the write of cache slot's buffer
+ * is completed. Buffer shall not be changed while it is being written.
+ *
+ * @param[in] a_idx Index of cache slot.
+ * @return PIFS_SUCCESS if data was written successfully.
+ */
+static pifs_status_t pifs_cache_wait_slot(pifs_size_t a_idx)
+{
+    pifs_status_t        ret = PIFS_SUCCESS;
+#if PIFS_FLASH_ASYNC_ENABLED
+    pifs_status_t        status;
+    pifs_cache_entry_t * cache = &pifs.cache[a_idx];
+    pifs_size_t          i;
+
+    if (cache->is_in_flight)
+    {
+        for (i = 0; i < PIFS_FLASH_PAGE_PER_LOGICAL_PAGE; i++)
+        {
+            if (cache->request[i].buf_size)
+            {
+                status = pifs_flash_async_wait(&cache->request[i]);
+                if (status != PIFS_SUCCESS)
+                {
+                    ret = status;
+                }
+            }
+        }
+        cache->is_in_flight = FALSE;
+        if (ret != PIFS_SUCCESS)
+        {
+            PIFS_ERROR_MSG("Cannot flush buffer %s\r\n",
+                           pifs_address2str(&cache->address));
+        }
+    }
+#else
+    (void) a_idx;
 #endif
 
-    if (pifs.cache_page_buf_is_dirty)
+    return ret;
+}
+
+/**
+ * @brief pifs_cache_flush_slot Write one cache slot to the flash memory if
+ * it is dirty. If asynchronous flash interface is enabled the writes are only
+ * submitted, pifs_cache_wait_slot() waits for their completion.
+ *
+ * @param[in] a_idx Index of cache slot.
+ * @return PIFS_SUCCESS if data written successfully.
+ */
+static pifs_status_t pifs_cache_flush_slot(pifs_size_t a_idx)
+{
+    pifs_status_t        ret = PIFS_SUCCESS;
+    pifs_cache_entry_t * cache = &pifs.cache[a_idx];
+    pifs_size_t          i;
+
+    if (cache->is_dirty)
     {
-#if PIFS_LOGICAL_PAGE_ENABLED
+#if PIFS_FLASH_ASYNC_ENABLED
+        /* Buffer shall not be changed until the requests are completed */
+        cache->is_in_flight = TRUE;
+        for (i = 0; i < PIFS_FLASH_PAGE_PER_LOGICAL_PAGE; i++)
+        {
+            cache->request[i].buf_size = 0;
+        }
+#endif
         for (i = 0; i < PIFS_FLASH_PAGE_PER_LOGICAL_PAGE && ret == PIFS_SUCCESS; i++)
+        {
+            if (cache->dirty_start[i] < cache->dirty_end[i])
+            {
+                /* Only program the changed bytes of the flash page */
+#if PIFS_FLASH_ASYNC_ENABLED
+                cache->request[i].op = PIFS_FLASH_OP_WRITE;
+                cache->request[i].block_address = cache->address.block_address;
+                cache->request[i].page_address = PIFS_LP2FP(cache->address.page_address) + PIFS_LOGICAL_PAGE_IDX(i);
+                cache->request[i].page_offset = cache->dirty_start[i];
+                cache->request[i].buf = cache->buf + i * PIFS_FLASH_PAGE_SIZE_BYTE + cache->dirty_start[i];
+                cache->request[i].buf_size = cache->dirty_end[i] - cache->dirty_start[i];
+                ret = pifs_flash_async_submit(&cache->request[i]);
+                if (ret != PIFS_SUCCESS)
+                {
+                    cache->request[i].buf_size = 0;
+                }
+#else
+                ret = pifs_flash_write(cache->address.block_address,
+                                       PIFS_LP2FP(cache->address.page_address) + PIFS_LOGICAL_PAGE_IDX(i),
+                                       cache->dirty_start[i],
+                                       cache->buf + i * PIFS_FLASH_PAGE_SIZE_BYTE + cache->dirty_start[i],
+                                       cache->dirty_end[i] - cache->dirty_start[i]);
 #endif
+            }
+        }
+        if (ret == PIFS_SUCCESS)
         {
-            ret = pifs_flash_write(pifs.cache_page_buf_address.block_address,
-                                   PIFS_LP2FP(pifs.cache_page_buf_address.page_address) + PIFS_LOGICAL_PAGE_IDX(i),
-                                   0,
-                                   pifs.cache_page_buf + PIFS_LOGICAL_PAGE_IDX(i * PIFS_FLASH_PAGE_SIZE_BYTE),
-                                   PIFS_FLASH_PAGE_SIZE_BYTE);
-            if (ret == PIFS_SUCCESS)
+            pifs_cache_clear_dirty(a_idx);
+        }
+        else
+        {
+            PIFS_ERROR_MSG("Cannot flush buffer %s\r\n",
+                           pifs_address2str(&cache->address));
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_cache_flush_dirty Flush dirty slots of free space bitmap or
+ * all the other dirty slots. Dirty pages are written in the order they were
+ * used, the least recently used first.
+ *
+ * @param[in] a_is_fsbm TRUE: flush free space bitmap's slots.
+ *                      FALSE: flush every other slot.
+ * @return PIFS_SUCCESS if data written successfully.
+ */
+static pifs_status_t pifs_cache_flush_dirty(bool_t a_is_fsbm)
+{
+    pifs_status_t ret = PIFS_SUCCESS;
+    pifs_size_t   i;
+    pifs_size_t   idx;
+    bool_t        found;
+    bool_t        is_fsbm;
+
+    do
+    {
+        found = FALSE;
+        idx = 0;
+        for (i = 0; i < PIFS_CACHE_PAGE_NUM; i++)
+        {
+            is_fsbm = (pifs.cache[i].cache_class == PIFS_CACHE_CLASS_FSBM) ? TRUE : FALSE;
+            if (pifs.cache[i].is_dirty && is_fsbm == a_is_fsbm
+                    && (!found || pifs_cache_age(i) > pifs_cache_age(idx)))
             {
-                pifs.cache_page_buf_is_dirty = FALSE;
+                idx = i;
+                found = TRUE;
             }
-            else
+        }
+        if (found)
+        {
+            ret = pifs_cache_flush_slot(idx);
+        }
+    } while (found && ret == PIFS_SUCCESS);
+
+    return ret;
+}
+
+/**
+ * @brief pifs_cache_get_slot Find a cache slot for a new page.
+ * Unused slot is preferred, otherwise the least recently used slot is
+ * flushed and reused. A slot is only taken from an other access class if
+ * that class has more slots than its reserved number.
+ *
+ * @param[in] a_class   Access class of the new page.
+ * @param[out] a_idx    Index of cache slot.
+ * @return PIFS_SUCCESS if slot is available.
+ */
+static pifs_status_t pifs_cache_get_slot(pifs_cache_class_t a_class, pifs_size_t * a_idx)
+{
+    pifs_status_t      ret = PIFS_SUCCESS;
+    pifs_size_t        i;
+    pifs_size_t        idx = 0;
+    pifs_size_t        lru_idx = 0;
+    bool_t             found = FALSE;
+    bool_t             is_unused = FALSE;
+    pifs_size_t        class_page_num[PIFS_CACHE_CLASS_NUM] = { 0 };
+    pifs_cache_class_t cache_class;
+
+    for (i = 0; i < PIFS_CACHE_PAGE_NUM; i++)
+    {
+        if (pifs.cache[i].address.block_address < PIFS_BLOCK_ADDRESS_INVALID)
+        {
+            class_page_num[pifs.cache[i].cache_class]++;
+        }
+    }
+    for (i = 0; i < PIFS_CACHE_PAGE_NUM && !is_unused; i++)
+    {
+        cache_class = pifs.cache[i].cache_class;
+        if (pifs.cache[i].address.block_address == PIFS_BLOCK_ADDRESS_INVALID)
+        {
+            idx = i;
+            found = TRUE;
+            is_unused = TRUE;
+        }
+        else
+        {
+            if ((cache_class == a_class
+                 || class_page_num[cache_class] > pifs_cache_rsv_page_num[cache_class])
+                    && (!found || pifs_cache_age(i) > pifs_cache_age(idx)))
             {
-                PIFS_ERROR_MSG("Cannot flush buffer %s\r\n",
-                               pifs_address2str(&pifs.cache_page_buf_address));
+                idx = i;
+                found = TRUE;
             }
+            if (pifs_cache_age(i) > pifs_cache_age(lru_idx))
+            {
+                lru_idx = i;
+            }
+        }
+    }
+    if (!found)
+    {
+        /* Every class is at its reserved number, use the least recently used */
+        idx = lru_idx;
+    }
+    if (!is_unused && pifs.cache[idx].is_dirty
+            && pifs.cache[idx].cache_class == PIFS_CACHE_CLASS_FSBM)
+    {
+        /* Pages referring to marked pages shall be written before */
+        /* free space bitmap */
+        ret = pifs_cache_flush_dirty(FALSE);
+    }
+    if (!is_unused && ret == PIFS_SUCCESS)
+    {
+        /* Cache is full, write back the page to be replaced */
+        ret = pifs_cache_flush_slot(idx);
+        if (ret == PIFS_SUCCESS)
+        {
+            ret = pifs_cache_wait_slot(idx);
+        }
+    }
+    *a_idx = idx;
+
+    return ret;
+}
+
+/**
+ * @brief pifs_cache_invalidate Drop cache slot without writing it to
+ * flash memory. Pending write of the slot is waited for.
+ *
+ * @param[in] a_idx Index of cache slot.
+ */
+static void pifs_cache_invalidate(pifs_size_t a_idx)
+{
+    (void) pifs_cache_wait_slot(a_idx);
+    pifs.cache[a_idx].address.block_address = PIFS_BLOCK_ADDRESS_INVALID;
+    pifs.cache[a_idx].address.page_address = PIFS_PAGE_ADDRESS_INVALID;
+    pifs.cache[a_idx].lru_cntr = pifs.cache_lru_cntr;
+    pifs_cache_clear_dirty(a_idx);
+}
+
+/**
+ * @brief pifs_cache_init Initialize page cache, all slots become unused.
+ */
+static void pifs_cache_init(void)
+{
+    pifs_size_t i;
+
+    memset(pifs.cache, 0, sizeof(pifs.cache));
+    memset(pifs.cache_hit_cntr, 0, sizeof(pifs.cache_hit_cntr));
+    memset(pifs.cache_miss_cntr, 0, sizeof(pifs.cache_miss_cntr));
+    pifs.cache_lru_cntr = 0;
+    for (i = 0; i < PIFS_CACHE_PAGE_NUM; i++)
+    {
+        pifs_cache_invalidate(i);
+    }
+    pifs.cache_page_buf = pifs.cache[0].buf;
+}
+
+/**
+ * @brief pifs_flush  Flush cache. Data and management pages (map, entry
+ * list, delta map, etc.) are written first, free space bitmap is written
+ * last. Therefore a page is never marked used or to be released before the
+ * pages referring to it are programmed.
+ * If asynchronous flash interface is enabled the writes are only submitted,
+ * pages are waited for when they are changed or replaced.
+ *
+ * @return PIFS_SUCCESS if data written successfully.
+ */
+pifs_status_t pifs_flush(void)
+{
+    pifs_status_t ret;
+
+    ret = pifs_cache_flush_dirty(FALSE);
+    if (ret == PIFS_SUCCESS)
+    {
+        ret = pifs_cache_flush_dirty(TRUE);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_transaction_begin Begin a metadata transaction. Until the
+ * outermost transaction is committed pifs_mark_page() does not flush the
+ * cache, so every dirty page is written only once.
+ * Transactions can be nested.
+ */
+void pifs_transaction_begin(void)
+{
+    pifs.transaction_depth++;
+}
+
+/**
+ * @brief pifs_transaction_commit Commit a metadata transaction.
+ * The cache is flushed when the outermost transaction is committed.
+ * Pending map entries of opened files are written before, so pages are not
+ * marked used in flash memory without a map entry referring to them.
+ *
+ * @return PIFS_SUCCESS if cache flushed successfully.
+ */
+pifs_status_t pifs_transaction_commit(void)
+{
+    pifs_status_t ret = PIFS_SUCCESS;
+
+    PIFS_ASSERT(pifs.transaction_depth);
+    pifs.transaction_depth--;
+    if (!pifs.transaction_depth)
+    {
+#if PIFS_ENABLE_MAP_COALESCE
+        ret = pifs_flush_map_entries();
+        if (ret == PIFS_SUCCESS)
+#endif
+        {
+            ret = pifs_flush();
         }
     }
 
     return ret;
 }
 
+/**
+ * @brief pifs_is_in_transaction Check if a metadata transaction is open.
+ *
+ * @return TRUE: flushing of cache is deferred to pifs_transaction_commit().
+ */
+bool_t pifs_is_in_transaction(void)
+{
+    return pifs.transaction_depth ? TRUE : FALSE;
+}
+
+/**
+ * @brief pifs_flash_read_range Read bytes of a logical page directly from
+ * flash memory. Range can cross flash page boundaries.
+ *
+ * @param[in] a_block_address   Block address of logical page.
+ * @param[in] a_page_address    Logical page address.
+ * @param[in] a_page_offset     Offset in logical page.
+ * @param[out] a_buf            Pointer to buffer to fill.
+ * @param[in] a_buf_size        Number of bytes to read.
+ * @return PIFS_SUCCESS if data read successfully.
+ */
+static pifs_status_t pifs_flash_read_range(pifs_block_address_t a_block_address,
+                                           pifs_page_address_t a_page_address,
+                                           pifs_size_t a_page_offset,
+                                           uint8_t * a_buf,
+                                           pifs_size_t a_buf_size)
+{
+    pifs_status_t ret = PIFS_SUCCESS;
+    pifs_size_t   fpo;
+    pifs_size_t   chunk_size;
+
+    while (a_buf_size && ret == PIFS_SUCCESS)
+    {
+        fpo = a_page_offset % PIFS_FLASH_PAGE_SIZE_BYTE;
+        chunk_size = PIFS_MIN(a_buf_size, PIFS_FLASH_PAGE_SIZE_BYTE - fpo);
+        ret = pifs_flash_read(a_block_address,
+                              PIFS_LP2FP(a_page_address) + a_page_offset / PIFS_FLASH_PAGE_SIZE_BYTE,
+                              fpo, a_buf, chunk_size);
+        a_page_offset += chunk_size;
+        a_buf += chunk_size;
+        a_buf_size -= chunk_size;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_flash_write_range Program bytes of a logical page directly to
+ * flash memory. Range can cross flash page boundaries.
+ *
+ * @param[in] a_block_address   Block address of logical page.
+ * @param[in] a_page_address    Logical page address.
+ * @param[in] a_page_offset     Offset in logical page.
+ * @param[in] a_buf             Pointer to buffer to write.
+ * @param[in] a_buf_size        Number of bytes to write.
+ * @return PIFS_SUCCESS if data written successfully.
+ */
+static pifs_status_t pifs_flash_write_range(pifs_block_address_t a_block_address,
+                                            pifs_page_address_t a_page_address,
+                                            pifs_size_t a_page_offset,
+                                            const uint8_t * a_buf,
+                                            pifs_size_t a_buf_size)
+{
+    pifs_status_t ret = PIFS_SUCCESS;
+    pifs_size_t   fpo;
+    pifs_size_t   chunk_size;
+
+    while (a_buf_size && ret == PIFS_SUCCESS)
+    {
+        fpo = a_page_offset % PIFS_FLASH_PAGE_SIZE_BYTE;
+        chunk_size = PIFS_MIN(a_buf_size, PIFS_FLASH_PAGE_SIZE_BYTE - fpo);
+        ret = pifs_flash_write(a_block_address,
+                               PIFS_LP2FP(a_page_address) + a_page_offset / PIFS_FLASH_PAGE_SIZE_BYTE,
+                               fpo, a_buf, chunk_size);
+        a_page_offset += chunk_size;
+        a_buf += chunk_size;
+        a_buf_size -= chunk_size;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_is_direct_io Check if cache shall be bypassed on cache miss.
+ * Full data pages are transferred directly between flash memory and the
+ * caller's buffer to avoid evicting cached pages and an extra copy.
+ *
+ * @param[in] a_page_offset     Offset in page.
+ * @param[in] a_buf             Pointer to caller's buffer.
+ * @param[in] a_buf_size        Size of buffer.
+ * @param[in] a_class           Access class of page.
+ * @return TRUE: cache shall be bypassed.
+ */
+static bool_t pifs_is_direct_io(pifs_page_offset_t a_page_offset,
+                                const void * const a_buf,
+                                pifs_size_t a_buf_size,
+                                pifs_cache_class_t a_class)
+{
+#if PIFS_ENABLE_DIRECT_IO
+    return (a_class == PIFS_CACHE_CLASS_DATA && a_buf && a_page_offset == 0
+            && a_buf_size == PIFS_LOGICAL_PAGE_SIZE_BYTE) ? TRUE : FALSE;
+#else
+    (void) a_page_offset;
+    (void) a_buf;
+    (void) a_buf_size;
+    (void) a_class;
+    return FALSE;
+#endif
+}
+
 /**
  * @brief pifs_read  Cached read.
  *
@@ -115,64 +621,217 @@ pifs_status_t pifs_flush(void)
  * @param[out] a_buf            Pointer to buffer to fill or NULL if
  *                              pifs.cache_page_buf is used.
  * @param[in] a_buf_size        Size of buffer. Ignored if a_buf is NULL.
+ * @param[in] a_class           Access class of page. @see pifs_cache_class_t
  * @return PIFS_SUCCESS if data read successfully.
  */
 pifs_status_t pifs_read(pifs_block_address_t a_block_address,
                         pifs_page_address_t a_page_address,
                         pifs_page_offset_t a_page_offset,
                         void * const a_buf,
-                        pifs_size_t a_buf_size)
+                        pifs_size_t a_buf_size,
+                        pifs_cache_class_t a_class)
 {
     pifs_status_t ret = PIFS_ERROR_GENERAL;
-#if PIFS_LOGICAL_PAGE_ENABLED
-    pifs_size_t   i;
-#endif
+    pifs_size_t   idx;
 
-    if (a_block_address == pifs.cache_page_buf_address.block_address
-            && a_page_address == pifs.cache_page_buf_address.page_address)
+    idx = pifs_cache_find(a_block_address, a_page_address);
+    if (idx < PIFS_CACHE_PAGE_NUM)
     {
         /* Cache hit */
+        pifs.cache_hit_cntr[a_class]++;
+        ret = PIFS_SUCCESS;
+    }
+    else if (pifs_is_direct_io(a_page_offset, a_buf, a_buf_size, a_class))
+    {
+        /* Cache miss, full page is read directly to caller's buffer, */
+        /* idx remains invalid as no cache slot is used */
+        pifs.cache_miss_cntr[a_class]++;
+        ret = pifs_flash_read_range(a_block_address, a_page_address, 0,
+                                    a_buf, PIFS_LOGICAL_PAGE_SIZE_BYTE);
+    }
+    else
+    {
+        /* Cache miss, get a free slot or flush the least recently used */
+        pifs.cache_miss_cntr[a_class]++;
+        ret = pifs_cache_get_slot(a_class, &idx);
+
+        if (ret == PIFS_SUCCESS)
+        {
+            ret = pifs_flash_read_range(a_block_address, a_page_address, 0,
+                                        pifs.cache[idx].buf, PIFS_LOGICAL_PAGE_SIZE_BYTE);
+        }
+
+        if (ret == PIFS_SUCCESS)
+        {
+            pifs.cache[idx].address.block_address = a_block_address;
+            pifs.cache[idx].address.page_address = a_page_address;
+        }
+        else
+        {
+            pifs_cache_invalidate(idx);
+        }
+    }
+
+    if (ret == PIFS_SUCCESS && idx < PIFS_CACHE_PAGE_NUM)
+    {
+        pifs_cache_touch(idx, a_class);
         if (a_buf)
         {
             memcpy(a_buf, &pifs.cache_page_buf[a_page_offset], a_buf_size);
         }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_read_uncached Read from page cache if page is cached,
+ * otherwise read directly from flash memory without using a cache slot.
+ *
+ * @param[in] a_block_address   Block address of page to read.
+ * @param[in] a_page_address    Page address of page to read.
+ * @param[in] a_page_offset     Offset in page.
+ * @param[out] a_buf            Pointer to buffer to fill.
+ * @param[in] a_buf_size        Size of buffer.
+ * @return PIFS_SUCCESS if data read successfully.
+ */
+pifs_status_t pifs_read_uncached(pifs_block_address_t a_block_address,
+                                 pifs_page_address_t a_page_address,
+                                 pifs_page_offset_t a_page_offset,
+                                 void * const a_buf,
+                                 pifs_size_t a_buf_size)
+{
+    pifs_status_t ret;
+    pifs_size_t   idx;
+
+    idx = pifs_cache_find(a_block_address, a_page_address);
+    if (idx < PIFS_CACHE_PAGE_NUM)
+    {
+        memcpy(a_buf, &pifs.cache[idx].buf[a_page_offset], a_buf_size);
         ret = PIFS_SUCCESS;
     }
     else
     {
-        /* Cache miss, first flush cache */
-        ret = pifs_flush();
+        ret = pifs_flash_read_range(a_block_address, a_page_address, a_page_offset,
+                                    a_buf, a_buf_size);
+    }
 
-        if (ret == PIFS_SUCCESS)
+    return ret;
+}
+
+#if PIFS_FLASH_MULTI_PAGE_ENABLED
+/**
+ * @brief pifs_read_multi Read consecutive data pages of a block.
+ * Pages which are not cached are read with one flash command, cached pages
+ * are copied from the cache.
+ *
+ * @param[in] a_block_address   Block address of first page to read.
+ * @param[in] a_page_address    Page address of first page to read.
+ * @param[out] a_buf            Pointer to buffer to fill.
+ * @param[in] a_page_count      Number of logical pages to read.
+ * @return PIFS_SUCCESS if data read successfully.
+ */
+pifs_status_t pifs_read_multi(pifs_block_address_t a_block_address,
+                              pifs_page_address_t a_page_address,
+                              void * const a_buf,
+                              pifs_size_t a_page_count)
+{
+    pifs_status_t ret = PIFS_SUCCESS;
+    uint8_t     * buf = (uint8_t*) a_buf;
+    pifs_size_t   run_page_count;
+
+    PIFS_ASSERT(a_page_address + a_page_count <= PIFS_LOGICAL_PAGE_PER_BLOCK);
+    while (a_page_count && ret == PIFS_SUCCESS)
+    {
+        if (pifs_cache_find(a_block_address, a_page_address) < PIFS_CACHE_PAGE_NUM)
         {
-#if PIFS_LOGICAL_PAGE_ENABLED
-            for (i = 0; i < PIFS_FLASH_PAGE_PER_LOGICAL_PAGE && ret == PIFS_SUCCESS; i++)
-#endif
+            run_page_count = 1;
+            ret = pifs_read(a_block_address, a_page_address, 0, buf,
+                            PIFS_LOGICAL_PAGE_SIZE_BYTE, PIFS_CACHE_CLASS_DATA);
+        }
+        else
+        {
+            /* Collect pages which are not cached */
+            run_page_count = 1;
+            while (run_page_count < a_page_count
+                   && pifs_cache_find(a_block_address, a_page_address + run_page_count) >= PIFS_CACHE_PAGE_NUM)
             {
-                ret = pifs_flash_read(a_block_address,
-                                      PIFS_LP2FP(a_page_address) + PIFS_LOGICAL_PAGE_IDX(i),
-                                      0,
-                                      pifs.cache_page_buf + PIFS_LOGICAL_PAGE_IDX(i * PIFS_FLASH_PAGE_SIZE_BYTE),
-                                      PIFS_FLASH_PAGE_SIZE_BYTE);
+                run_page_count++;
             }
+            pifs.cache_miss_cntr[PIFS_CACHE_CLASS_DATA] += run_page_count;
+            ret = pifs_flash_read_multi(a_block_address, PIFS_LP2FP(a_page_address),
+                                        buf, PIFS_LP2FP(run_page_count));
         }
+        a_page_address += run_page_count;
+        buf += run_page_count * PIFS_LOGICAL_PAGE_SIZE_BYTE;
+        a_page_count -= run_page_count;
+    }
 
-        if (ret == PIFS_SUCCESS)
+    return ret;
+}
+
+/**
+ * @brief pifs_write_multi Write consecutive data pages of a block.
+ * Pages which are not cached are programmed with one flash command, cached
+ * pages are written to the cache.
+ *
+ * @param[in] a_block_address   Block address of first page to write.
+ * @param[in] a_page_address    Page address of first page to write.
+ * @param[in] a_buf             Pointer to buffer to write.
+ * @param[in] a_page_count      Number of logical pages to write.
+ * @return PIFS_SUCCESS if data written successfully.
+ */
+pifs_status_t pifs_write_multi(pifs_block_address_t a_block_address,
+                               pifs_page_address_t a_page_address,
+                               const void * const a_buf,
+                               pifs_size_t a_page_count)
+{
+    pifs_status_t   ret = PIFS_SUCCESS;
+    const uint8_t * buf = (const uint8_t*) a_buf;
+    pifs_size_t     run_page_count;
+#if PIFS_CHECK_IF_PAGE_IS_ERASED && PIFS_ENABLE_ERASED_PAGE_BITMAP
+    pifs_size_t     i;
+#endif
+
+    PIFS_ASSERT(a_page_address + a_page_count <= PIFS_LOGICAL_PAGE_PER_BLOCK);
+    while (a_page_count && ret == PIFS_SUCCESS)
+    {
+        if (pifs_cache_find(a_block_address, a_page_address) < PIFS_CACHE_PAGE_NUM)
         {
-            if (a_buf)
+            run_page_count = 1;
+            ret = pifs_write(a_block_address, a_page_address, 0, buf,
+                             PIFS_LOGICAL_PAGE_SIZE_BYTE, PIFS_CACHE_CLASS_DATA);
+        }
+        else
+        {
+            /* Collect pages which are not cached */
+            run_page_count = 1;
+            while (run_page_count < a_page_count
+                   && pifs_cache_find(a_block_address, a_page_address + run_page_count) >= PIFS_CACHE_PAGE_NUM)
             {
-                memcpy(a_buf, &pifs.cache_page_buf[a_page_offset], a_buf_size);
+                run_page_count++;
             }
-            pifs.cache_page_buf_address.block_address = a_block_address;
-            pifs.cache_page_buf_address.page_address = a_page_address;
+#if PIFS_CHECK_IF_PAGE_IS_ERASED && PIFS_ENABLE_ERASED_PAGE_BITMAP
+            for (i = 0; i < run_page_count; i++)
+            {
+                pifs_mark_page_programmed(a_block_address, a_page_address + i);
+            }
+#endif
+            pifs.cache_miss_cntr[PIFS_CACHE_CLASS_DATA] += run_page_count;
+            ret = pifs_flash_write_multi(a_block_address, PIFS_LP2FP(a_page_address),
+                                         buf, PIFS_LP2FP(run_page_count));
         }
+        a_page_address += run_page_count;
+        buf += run_page_count * PIFS_LOGICAL_PAGE_SIZE_BYTE;
+        a_page_count -= run_page_count;
     }
 
     return ret;
 }
+#endif
 
 /**
- * @brief pifs_write  Cached write.
+ * @brief pifs_write_internal  Cached write.
  *
  * @param[in] a_block_address   Block address of page to write.
  * @param[in] a_page_address    Page address of page to write.
@@ -180,61 +839,169 @@ pifs_status_t pifs_read(pifs_block_address_t a_block_address,
  * @param[in] a_buf             Pointer to buffer to write or NULL if
  *                              pifs.cache_page_buf is directly written.
  * @param[in] a_buf_size        Size of buffer. Ignored if a_buf is NULL.
+ * @param[in] a_class           Access class of page. @see pifs_cache_class_t
+ * @param[in] a_is_erased       TRUE: target bytes are known to be erased,
+ *                              so page is not read on cache miss.
  * @return PIFS_SUCCESS if data write successfully.
  */
-pifs_status_t pifs_write(pifs_block_address_t a_block_address,
-                         pifs_page_address_t a_page_address,
-                         pifs_page_offset_t a_page_offset,
-                         const void * const a_buf,
-                         pifs_size_t a_buf_size)
+static pifs_status_t pifs_write_internal(pifs_block_address_t a_block_address,
+                                         pifs_page_address_t a_page_address,
+                                         pifs_page_offset_t a_page_offset,
+                                         const void * const a_buf,
+                                         pifs_size_t a_buf_size,
+                                         pifs_cache_class_t a_class,
+                                         bool_t a_is_erased)
 {
     pifs_status_t ret = PIFS_ERROR_GENERAL;
-#if PIFS_LOGICAL_PAGE_ENABLED
-    pifs_size_t   i;
-#endif
+    pifs_size_t   idx;
 
-    if (a_block_address == pifs.cache_page_buf_address.block_address
-            && a_page_address == pifs.cache_page_buf_address.page_address)
+#if PIFS_CHECK_IF_PAGE_IS_ERASED && PIFS_ENABLE_ERASED_PAGE_BITMAP
+    /* Page is not erased anymore: data is programmed or cached */
+    pifs_mark_page_programmed(a_block_address, a_page_address);
+#endif
+    idx = pifs_cache_find(a_block_address, a_page_address);
+    if (idx < PIFS_CACHE_PAGE_NUM)
     {
         /* Cache hit */
-        if (a_buf)
-        {
-            memcpy(&pifs.cache_page_buf[a_page_offset], a_buf, a_buf_size);
-        }
-        pifs.cache_page_buf_is_dirty = TRUE;
+        pifs.cache_hit_cntr[a_class]++;
         ret = PIFS_SUCCESS;
     }
+    else if (pifs_is_direct_io(a_page_offset, a_buf, a_buf_size, a_class))
+    {
+        /* Cache miss, full page is programmed directly from caller's buffer, */
+        /* idx remains invalid as no cache slot is used */
+        pifs.cache_miss_cntr[a_class]++;
+        ret = pifs_flash_write_range(a_block_address, a_page_address, 0,
+                                     a_buf, PIFS_LOGICAL_PAGE_SIZE_BYTE);
+    }
+#if PIFS_ENABLE_PARTIAL_PROGRAM
+    else if (a_is_erased && a_buf)
+    {
+        /* Cache miss, target bytes are erased: only the touched range is */
+        /* programmed, page is not read and no cache slot is used */
+        pifs.cache_miss_cntr[a_class]++;
+        ret = pifs_flash_write_range(a_block_address, a_page_address, a_page_offset,
+                                     a_buf, a_buf_size);
+    }
+#endif
     else
     {
-        /* Cache miss, first flush cache */
-        ret = pifs_flush();
+        /* Cache miss, get a free slot or flush the least recently used */
+        pifs.cache_miss_cntr[a_class]++;
+        ret = pifs_cache_get_slot(a_class, &idx);
+
+        if (ret == PIFS_SUCCESS && (a_page_offset != 0 || a_buf_size != PIFS_LOGICAL_PAGE_SIZE_BYTE))
+        {
+            /* Only part of page is written */
+            ret = pifs_flash_read_range(a_block_address, a_page_address, 0,
+                                        pifs.cache[idx].buf, PIFS_LOGICAL_PAGE_SIZE_BYTE);
+        }
 
         if (ret == PIFS_SUCCESS)
         {
-            if (a_page_offset != 0 || a_buf_size != PIFS_LOGICAL_PAGE_SIZE_BYTE)
-            {
-#if PIFS_LOGICAL_PAGE_ENABLED
-                for (i = 0; i < PIFS_FLASH_PAGE_PER_LOGICAL_PAGE && ret == PIFS_SUCCESS; i++)
-#endif
-                {
-                    /* Only part of page is written */
-                    ret = pifs_flash_read(a_block_address,
-                                          PIFS_LP2FP(a_page_address) + PIFS_LOGICAL_PAGE_IDX(i),
-                                          0,
-                                          pifs.cache_page_buf + PIFS_LOGICAL_PAGE_IDX(i * PIFS_FLASH_PAGE_SIZE_BYTE),
-                                          PIFS_FLASH_PAGE_SIZE_BYTE);
-                }
-            }
+            pifs.cache[idx].address.block_address = a_block_address;
+            pifs.cache[idx].address.page_address = a_page_address;
+        }
+        else
+        {
+            pifs_cache_invalidate(idx);
+        }
+    }
 
-            if (a_buf)
-            {
-                memcpy(&pifs.cache_page_buf[a_page_offset], a_buf, a_buf_size);
-            }
-            pifs.cache_page_buf_address.block_address = a_block_address;
-            pifs.cache_page_buf_address.page_address = a_page_address;
-            pifs.cache_page_buf_is_dirty = TRUE;
+    if (ret == PIFS_SUCCESS && idx < PIFS_CACHE_PAGE_NUM)
+    {
+        /* Buffer cannot be changed while it is being written */
+        ret = pifs_cache_wait_slot(idx);
+    }
+
+    if (ret == PIFS_SUCCESS && idx < PIFS_CACHE_PAGE_NUM)
+    {
+        pifs_cache_touch(idx, a_class);
+        if (a_buf)
+        {
+            memcpy(&pifs.cache_page_buf[a_page_offset], a_buf, a_buf_size);
+            pifs_cache_set_dirty(idx, a_page_offset, a_buf_size);
+        }
+        else
+        {
+            /* Changed bytes are not known, whole page will be written */
+            pifs_cache_set_dirty(idx, 0, PIFS_LOGICAL_PAGE_SIZE_BYTE);
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_write  Cached write.
+ *
+ * @param[in] a_block_address   Block address of page to write.
+ * @param[in] a_page_address    Page address of page to write.
+ * @param[in] a_page_offset     Offset in page.
+ * @param[in] a_buf             Pointer to buffer to write or NULL if
+ *                              pifs.cache_page_buf is directly written.
+ *                              If NULL, the whole page will be programmed
+ *                              at flush.
+ * @param[in] a_buf_size        Size of buffer. Ignored if a_buf is NULL.
+ * @param[in] a_class           Access class of page. @see pifs_cache_class_t
+ * @return PIFS_SUCCESS if data write successfully.
+ */
+pifs_status_t pifs_write(pifs_block_address_t a_block_address,
+                         pifs_page_address_t a_page_address,
+                         pifs_page_offset_t a_page_offset,
+                         const void * const a_buf,
+                         pifs_size_t a_buf_size,
+                         pifs_cache_class_t a_class)
+{
+    return pifs_write_internal(a_block_address, a_page_address, a_page_offset,
+                               a_buf, a_buf_size, a_class, FALSE);
+}
+
+/**
+ * @brief pifs_write_erased  Write bytes which are known to be erased
+ * (or already checked to be programmable). On cache miss only the touched
+ * range is programmed, the page is not read into the cache. If the page is
+ * cached, it behaves like pifs_write().
+ *
+ * @param[in] a_block_address   Block address of page to write.
+ * @param[in] a_page_address    Page address of page to write.
+ * @param[in] a_page_offset     Offset in page.
+ * @param[in] a_buf             Pointer to buffer to write.
+ * @param[in] a_buf_size        Size of buffer.
+ * @param[in] a_class           Access class of page. @see pifs_cache_class_t
+ * @return PIFS_SUCCESS if data write successfully.
+ */
+pifs_status_t pifs_write_erased(pifs_block_address_t a_block_address,
+                                pifs_page_address_t a_page_address,
+                                pifs_page_offset_t a_page_offset,
+                                const void * const a_buf,
+                                pifs_size_t a_buf_size,
+                                pifs_cache_class_t a_class)
+{
+    return pifs_write_internal(a_block_address, a_page_address, a_page_offset,
+                               a_buf, a_buf_size, a_class, TRUE);
+}
+
+/**
+ * @brief pifs_erase_wait Wait for completion of last block erase.
+ *
+ * @return PIFS_SUCCESS if block was erased successfully.
+ */
+static pifs_status_t pifs_erase_wait(void)
+{
+    pifs_status_t ret = PIFS_SUCCESS;
+
+#if PIFS_FLASH_ASYNC_ENABLED
+    if (pifs.is_erasing)
+    {
+        ret = pifs_flash_async_wait(&pifs.erase_request);
+        pifs.is_erasing = FALSE;
+        if (ret != PIFS_SUCCESS)
+        {
+            PIFS_ERROR_MSG("Cannot erase block %i\r\n", pifs.erase_request.block_address);
         }
     }
+#endif
 
     return ret;
 }
@@ -250,19 +1017,41 @@ pifs_status_t pifs_write(pifs_block_address_t a_block_address,
 pifs_status_t pifs_erase(pifs_block_address_t a_block_address, pifs_header_t * a_old_header, pifs_header_t * a_new_header)
 {
     pifs_status_t           ret = PIFS_ERROR_GENERAL;
+    pifs_size_t             i;
 
     (void) a_old_header;
 
     PIFS_DEBUG_MSG("Erasing block %i\r\n", a_block_address)
-    ret = pifs_flash_erase(a_block_address);
+    for (i = 0; i < PIFS_CACHE_PAGE_NUM; i++)
+    {
+        if (a_block_address == pifs.cache[i].address.block_address)
+        {
+            /* If the block was erased which contains the cached page, simply forget it */
+            pifs_cache_invalidate(i);
+        }
+    }
 
-    if (a_block_address == pifs.cache_page_buf_address.block_address)
+#if PIFS_FLASH_ASYNC_ENABLED
+    /* Erase is only submitted, busy time of flash memory overlaps with */
+    /* the following operations. Later flash accesses are executed after */
+    /* the erase by the driver. */
+    ret = pifs_erase_wait();
+    if (ret == PIFS_SUCCESS)
+    {
+        pifs.erase_request.op = PIFS_FLASH_OP_ERASE;
+        pifs.erase_request.block_address = a_block_address;
+        ret = pifs_flash_async_submit(&pifs.erase_request);
+        pifs.is_erasing = (ret == PIFS_SUCCESS);
+    }
+#else
+    ret = pifs_flash_erase(a_block_address);
+#endif
+#if PIFS_CHECK_IF_PAGE_IS_ERASED && PIFS_ENABLE_ERASED_PAGE_BITMAP
+    if (ret == PIFS_SUCCESS)
     {
-        /* If the block was erased which contains the cached page, simply forget it */
-        pifs.cache_page_buf_address.block_address = PIFS_BLOCK_ADDRESS_INVALID;
-        pifs.cache_page_buf_address.page_address = PIFS_PAGE_ADDRESS_INVALID;
-        pifs.cache_page_buf_is_dirty = FALSE;
+        pifs_mark_page_erased(a_block_address, 0, PIFS_LOGICAL_PAGE_PER_BLOCK);
     }
+#endif
 
     if (ret == PIFS_SUCCESS && a_new_header)
     {
@@ -327,10 +1116,14 @@ pifs_status_t pifs_header_init(pifs_block_address_t a_block_address,
     a_header->least_weared_block_num = PIFS_LEAST_WEARED_BLOCK_NUM;
     a_header->most_weared_block_num = PIFS_MOST_WEARED_BLOCK_NUM;
     a_header->delta_map_page_num = PIFS_DELTA_MAP_PAGE_NUM;
+    a_header->delta_map_page_num_max = PIFS_DELTA_MAP_PAGE_NUM_MAX;
+    a_header->patch_log_page_num = PIFS_PATCH_LOG_PAGE_NUM;
+    a_header->patch_data_size_byte = PIFS_PATCH_DATA_SIZE_BYTE;
     a_header->map_page_count_size = PIFS_MAP_PAGE_COUNT_SIZE;
     a_header->use_delta_for_entries = PIFS_USE_DELTA_FOR_ENTRIES;
     a_header->enable_directories = PIFS_ENABLE_DIRECTORIES;
     a_header->enable_crc = PIFS_ENABLE_CRC;
+    a_header->enable_map_index = PIFS_ENABLE_MAP_INDEX;
 #endif
     address.block_address = a_block_address;
     address.page_address = a_page_address;
@@ -341,6 +1134,8 @@ pifs_status_t pifs_header_init(pifs_block_address_t a_block_address,
     pifs_add_address(&address, PIFS_FREE_SPACE_BITMAP_SIZE_PAGE);
     a_header->delta_map_address = address;
     pifs_add_address(&address, PIFS_DELTA_MAP_PAGE_NUM);
+    a_header->patch_log_address = address;
+    pifs_add_address(&address, PIFS_PATCH_LOG_PAGE_NUM);
     a_header->wear_level_list_address = address;
     if ((address.block_address - a_block_address) > (pifs_block_address_t)PIFS_MANAGEMENT_BLOCK_NUM)
     {
@@ -384,7 +1179,7 @@ pifs_status_t pifs_header_write(pifs_block_address_t a_block_address,
     pifs_size_t   free_entries = 0;
     pifs_size_t   to_be_released_entries = 0;
 
-    ret = pifs_write(a_block_address, a_page_address, 0, a_header, sizeof(pifs_header_t));
+    ret = pifs_write(a_block_address, a_page_address, 0, a_header, sizeof(pifs_header_t), PIFS_CACHE_CLASS_HEADER);
     if (ret == PIFS_SUCCESS)
     {
         pifs.is_header_found = TRUE;
@@ -429,6 +1224,15 @@ pifs_status_t pifs_header_write(pifs_block_address_t a_block_address,
                                  a_header->delta_map_address.page_address,
                                  PIFS_DELTA_MAP_PAGE_NUM, TRUE, FALSE);
         }
+#if PIFS_PATCH_LOG_PAGE_NUM
+        if (ret == PIFS_SUCCESS)
+        {
+            /* Mark patch log as used */
+            ret = pifs_mark_page(a_header->patch_log_address.block_address,
+                                 a_header->patch_log_address.page_address,
+                                 PIFS_PATCH_LOG_PAGE_NUM, TRUE, FALSE);
+        }
+#endif
         if (ret == PIFS_SUCCESS)
         {
             /* Mark wear level list as used */
@@ -445,6 +1249,8 @@ pifs_status_t pifs_header_write(pifs_block_address_t a_block_address,
                   pifs_address2str(&a_header->free_space_bitmap_address));
     PIFS_INFO_MSG("Delta page map at %s\r\n",
                   pifs_address2str(&a_header->delta_map_address));
+    PIFS_INFO_MSG("Patch log at %s\r\n",
+                  pifs_address2str(&a_header->patch_log_address));
     PIFS_INFO_MSG("Wear level list at %s\r\n",
                   pifs_address2str(&a_header->wear_level_list_address));
     if (ret == PIFS_SUCCESS)
@@ -505,6 +1311,8 @@ void pifs_print_fs_info(void)
     PIFS_PRINT_MSG("Number of delta entries/page:       %lu\r\n", PIFS_DELTA_ENTRY_PER_PAGE);
     PIFS_PRINT_MSG("Number of delta entries:            %lu\r\n", PIFS_DELTA_ENTRY_PER_PAGE * PIFS_DELTA_MAP_PAGE_NUM);
     PIFS_PRINT_MSG("Delta map size:                     %u bytes, %u logical pages\r\n", PIFS_DELTA_MAP_PAGE_NUM * PIFS_LOGICAL_PAGE_SIZE_BYTE, PIFS_DELTA_MAP_PAGE_NUM);
+    PIFS_PRINT_MSG("Maximum delta map size:             %u bytes, %u logical pages\r\n", PIFS_DELTA_MAP_PAGE_NUM_MAX * PIFS_LOGICAL_PAGE_SIZE_BYTE, PIFS_DELTA_MAP_PAGE_NUM_MAX);
+    PIFS_PRINT_MSG("Number of patch records:            %lu\r\n", PIFS_PATCH_ENTRY_NUM);
     PIFS_PRINT_MSG("Wear level entry size:              %lu bytes\r\n", PIFS_WEAR_LEVEL_ENTRY_SIZE_BYTE);
     PIFS_PRINT_MSG("Number of wear level entries/page:  %lu\r\n", PIFS_WEAR_LEVEL_ENTRY_PER_PAGE);
     PIFS_PRINT_MSG("Number of wear level entries:       %lu\r\n", PIFS_FLASH_BLOCK_NUM_FS);
@@ -536,10 +1344,34 @@ void pifs_print_header_info(void)
            pifs_address2str(&pifs.header.free_space_bitmap_address));
     PIFS_PRINT_MSG("Delta page map at %s\r\n",
            pifs_address2str(&pifs.header.delta_map_address));
+    PIFS_PRINT_MSG("Patch log at %s\r\n",
+           pifs_address2str(&pifs.header.patch_log_address));
     PIFS_PRINT_MSG("Wear level list at %s\r\n",
            pifs_address2str(&pifs.header.wear_level_list_address));
 }
 
+/**
+ * @brief pifs_print_cache_info Print hit/miss statistics of page cache.
+ */
+void pifs_print_cache_info(void)
+{
+    const char *        class_str[PIFS_CACHE_CLASS_NUM] =
+    {
+        "Data", "Free space bitmap", "Map", "Entry list",
+        "Delta map", "Wear level list", "Header"
+    };
+    pifs_size_t         i;
+
+    PIFS_PRINT_MSG("Cache pages:                        %u\r\n", PIFS_CACHE_PAGE_NUM);
+    PIFS_PRINT_MSG("Class              Reserved       Hit      Miss\r\n");
+    for (i = 0; i < PIFS_CACHE_CLASS_NUM; i++)
+    {
+        PIFS_PRINT_MSG("%-17s  %8lu  %8u  %8u\r\n", class_str[i],
+                       pifs_cache_rsv_page_num[i],
+                       pifs.cache_hit_cntr[i], pifs.cache_miss_cntr[i]);
+    }
+}
+
 /**
  * @brief pifs_print_free_space_info Print information about free space.
  */
@@ -604,6 +1436,7 @@ pifs_status_t pifs_init(void)
     pifs_checksum_t      checksum;
     pifs_size_t          i;
     uint8_t              retry_cntr = 5;
+    bool_t               is_incompatible_found = FALSE;
 
 #if PIFS_ENABLE_OS
     pifs_mutex = PIFS_OS_CREATE_MUTEX(pifs_mutex);
@@ -617,22 +1450,43 @@ pifs_status_t pifs_init(void)
     pifs.is_header_found = FALSE;
     pifs.is_merging = FALSE;
     pifs.is_wear_leveling = FALSE;
+    pifs.transaction_depth = 0;
+#if PIFS_ENABLE_FSBM_SHADOW
+    pifs.is_fsbm_shadow_valid = FALSE;
+#endif
+#if PIFS_ENABLE_BLOCK_PAGE_CNTR
+    pifs.is_page_cntr_valid = FALSE;
+#endif
+#if PIFS_ENABLE_FREE_EXTENT_INDEX
+    pifs.is_free_extent_valid = FALSE;
+#endif
+#if PIFS_CHECK_IF_PAGE_IS_ERASED && PIFS_ENABLE_ERASED_PAGE_BITMAP
+    /* State of pages is unknown until they are checked or erased */
+    memset(pifs.erased_page_bitmap, 0, sizeof(pifs.erased_page_bitmap));
+#endif
+#if PIFS_FLASH_ASYNC_ENABLED
+    pifs.is_erasing = FALSE;
+#endif
     memset(&pifs.header, 0, PIFS_HEADER_SIZE_BYTE);
-    memset(pifs.cache_page_buf, 0, PIFS_LOGICAL_PAGE_SIZE_BYTE);
-    pifs.cache_page_buf_address.block_address = PIFS_BLOCK_ADDRESS_INVALID;
-    pifs.cache_page_buf_address.page_address = PIFS_PAGE_ADDRESS_INVALID;
-    pifs.cache_page_buf_is_dirty = FALSE;
+    pifs_cache_init();
+#if PIFS_READ_AHEAD_PAGE_NUM_MAX
+    pifs.read_ahead_page_num_max = PIFS_READ_AHEAD_PAGE_NUM_MAX;
+#endif
     memset(pifs.file, 0, sizeof(pifs.file));
     memset(&pifs.internal_file, 0, sizeof(pifs.internal_file));
     memset(pifs.dir, 0, sizeof(pifs.dir));
-    memset(pifs.delta_map_page_buf, 0, sizeof(pifs.delta_map_page_buf));
     pifs.delta_map_page_is_read = FALSE;
-    pifs.delta_map_page_is_dirty = FALSE;
+#if PIFS_PATCH_LOG_PAGE_NUM
+    pifs.patch_log_is_read = FALSE;
+#endif
     memset(pifs.dmw_page_buf, 0, sizeof(pifs.dmw_page_buf));
     memset(pifs.sc_page_buf, 0, sizeof(pifs.sc_page_buf));
     pifs.error_cntr = 0;
     pifs.last_static_wear_block_idx = 0;
     pifs.auto_static_wear_cntr = 0;
+#if PIFS_FILE_RESERVE_PAGE_NUM
+    pifs.last_appended_file = NULL;
+#endif
 #if PIFS_ENABLE_DIRECTORIES
     for (i = 0; i < PIFS_TASK_COUNT_MAX; i++)
     {
@@ -705,7 +1559,7 @@ pifs_status_t pifs_init(void)
         for (ba = PIFS_FLASH_BLOCK_RESERVED_NUM; ba < PIFS_FLASH_BLOCK_NUM_ALL && ret == PIFS_SUCCESS; ba++)
         {
             pa = 0;
-            ret = pifs_read(ba, pa, 0, &header, sizeof(header));
+            ret = pifs_read(ba, pa, 0, &header, sizeof(header), PIFS_CACHE_CLASS_HEADER);
             if (ret == PIFS_SUCCESS && header.magic == PIFS_MAGIC
 #if PIFS_ENABLE_VERSION
                     && header.majorVersion == PIFS_MAJOR_VERSION
@@ -748,10 +1602,14 @@ pifs_status_t pifs_init(void)
                                 && header.least_weared_block_num == PIFS_LEAST_WEARED_BLOCK_NUM
                                 && header.most_weared_block_num == PIFS_MOST_WEARED_BLOCK_NUM
                                 && header.delta_map_page_num == PIFS_DELTA_MAP_PAGE_NUM
+                                && header.delta_map_page_num_max == PIFS_DELTA_MAP_PAGE_NUM_MAX
+                                && header.patch_log_page_num == PIFS_PATCH_LOG_PAGE_NUM
+                                && header.patch_data_size_byte == PIFS_PATCH_DATA_SIZE_BYTE
                                 && header.map_page_count_size == PIFS_MAP_PAGE_COUNT_SIZE
                                 && header.use_delta_for_entries == PIFS_USE_DELTA_FOR_ENTRIES
                                 && header.enable_directories == PIFS_ENABLE_DIRECTORIES
-                                && header.enable_crc == PIFS_ENABLE_CRC)
+                                && header.enable_crc == PIFS_ENABLE_CRC
+                                && header.enable_map_index == PIFS_ENABLE_MAP_INDEX)
 #endif
                         {
                             pifs.is_header_found = TRUE;
@@ -763,6 +1621,7 @@ pifs_status_t pifs_init(void)
                         else
                         {
                             PIFS_WARNING_MSG("Invalid flash/file system configuration!\r\n");
+                            is_incompatible_found = TRUE;
                         }
 #endif
                     }
@@ -773,12 +1632,28 @@ pifs_status_t pifs_init(void)
                             checksum, pifs.header.checksum);
                 }
             }
+#if PIFS_ENABLE_VERSION
+            else if (ret == PIFS_SUCCESS && header.magic == PIFS_MAGIC)
+            {
+                /* Layout of other versions is not known, checksum cannot be checked */
+                PIFS_WARNING_MSG("File system version %i.%i found at %s, supported version is %i.%i!\r\n",
+                                 header.majorVersion, header.minorVersion, pifs_ba_pa2str(ba, pa),
+                                 PIFS_MAJOR_VERSION, PIFS_MINOR_VERSION);
+                is_incompatible_found = TRUE;
+            }
+#endif
         }
 
         if (pifs.is_header_found)
         {
             memcpy(&pifs.header, &prev_header, sizeof(pifs.header));
         }
+        else if (is_incompatible_found)
+        {
+            /* Flash memory is not formatted to keep data of other version or configuration */
+            PIFS_ERROR_MSG("Incompatible file system found, flash memory shall be erased to use it!\r\n");
+            ret = PIFS_ERROR_VERSION;
+        }
         else
         {
             /* No file system header found, so create brand new one */
@@ -792,7 +1667,7 @@ pifs_status_t pifs_init(void)
                 PIFS_WARNING_MSG("Erasing all blocks...\r\n");
                 for (i = PIFS_FLASH_BLOCK_RESERVED_NUM; i < PIFS_FLASH_BLOCK_NUM_ALL; i++)
                 {
-                    ret = pifs_flash_erase(i);
+                    ret = pifs_erase(i, NULL, NULL);
                     /* TODO mark bad blocks */
                 }
                 PIFS_WARNING_MSG("Done.\r\n");
@@ -812,7 +1687,19 @@ pifs_status_t pifs_init(void)
                 pifs.current_entry_list_address[i] = pifs.header.root_entry_list_address;
             }
 #endif
-            ret = pifs_get_free_pages(&i, &pifs.free_data_page_num);
+#if PIFS_ENABLE_FSBM_SHADOW
+            ret = pifs_fsbm_shadow_load();
+            if (ret == PIFS_SUCCESS)
+#endif
+            {
+#if PIFS_ENABLE_BLOCK_PAGE_CNTR
+                pifs_page_cntr_build();
+#endif
+#if PIFS_ENABLE_FREE_EXTENT_INDEX
+                pifs_free_extent_build();
+#endif
+                ret = pifs_get_free_pages(&i, &pifs.free_data_page_num);
+            }
             pifs_initialized = TRUE;
 #if PIFS_DEBUG_LEVEL >= 6
             print_buffer(&pifs.header, sizeof(pifs.header), 0);
@@ -837,11 +1724,17 @@ pifs_status_t pifs_init(void)
 pifs_status_t pifs_delete(void)
 {
     pifs_status_t ret = PIFS_ERROR_GENERAL;
+    pifs_size_t   i;
 
     if (pifs_initialized)
     {
         /* Flush cache */
         ret = pifs_flush();
+        for (i = 0; i < PIFS_CACHE_PAGE_NUM; i++)
+        {
+            (void) pifs_cache_wait_slot(i);
+        }
+        (void) pifs_erase_wait();
 
         ret = pifs_flash_delete();
 
@@ -1105,6 +1998,43 @@ pifs_status_t pifs_dir_walker_check(pifs_dirent_t * a_dirent, void * a_func_data
     return ret;
 }
 
+#if PIFS_DELTA_MAP_CHAIN_ENABLED
+/**
+ * @brief pifs_delta_walker_check Mark chained delta map page as used.
+ * Callback function for pifs_walk_delta_map() used during file system check.
+ *
+ * @param[in] a_block_address   Block address of delta map page.
+ * @param[in] a_page_address    Page address of delta map page.
+ * @param[in] a_page_offset     Offset of entry in delta map page.
+ * @param[in] a_delta_entry     Pointer to delta entry.
+ * @param[in] a_func_data       Pointer to free page buffer.
+ *
+ * @return PIFS_SUCCESS if entry processed successfully.
+ */
+static pifs_status_t pifs_delta_walker_check(pifs_block_address_t a_block_address,
+                                             pifs_page_address_t a_page_address,
+                                             pifs_page_offset_t a_page_offset,
+                                             pifs_delta_entry_t * a_delta_entry,
+                                             void * a_func_data)
+{
+    pifs_status_t ret = PIFS_SUCCESS;
+
+    (void) a_block_address;
+    (void) a_page_address;
+    (void) a_page_offset;
+
+    if (PIFS_IS_DELTA_LINK_ENTRY(*a_delta_entry))
+    {
+        ret = pifs_mark_page_check((uint8_t*) a_func_data,
+                                   a_delta_entry->delta_address.block_address,
+                                   a_delta_entry->delta_address.page_address,
+                                   1);
+    }
+
+    return ret;
+}
+#endif
+
 /**
  * @brief pifs_check_free_page_buf Used during file system check.
  * Checks allocated space of files and free space bitmap is consistent.
@@ -1131,6 +2061,13 @@ pifs_status_t pifs_check_free_page_buf(uint8_t * a_free_page_buf)
                                           address.page_address);
         is_free_fsbm = pifs_is_page_free(address.block_address, address.page_address);
         is_tbr_fsbm = pifs_is_page_to_be_released(address.block_address, address.page_address);
+#if PIFS_FILE_RESERVE_PAGE_NUM
+        if (is_free && pifs_is_page_reserved(address.block_address, address.page_address))
+        {
+            /* Page is in reservation window of an opened file */
+            is_free = FALSE;
+        }
+#endif
         if (is_free && !is_free_fsbm && !is_tbr_fsbm)
         {
             PIFS_DEBUG_MSG("Found lost page %s\r\n",
@@ -1149,7 +2086,7 @@ pifs_status_t pifs_check_free_page_buf(uint8_t * a_free_page_buf)
 #if 0
             /* Read to page cache */
             pifs_read(address.block_address, address.page_address, 0,
-                      NULL, 0);
+                      NULL, 0, PIFS_CACHE_CLASS_DATA);
             print_buffer(pifs.cache_page_buf, PIFS_LOGICAL_PAGE_SIZE_BYTE,
                          address.block_address * PIFS_FLASH_BLOCK_SIZE_BYTE
                          + address.page_address * PIFS_LOGICAL_PAGE_SIZE_BYTE);
@@ -1232,6 +2169,23 @@ pifs_status_t pifs_check(void)
                                        pifs.header.delta_map_address.page_address,
                                        PIFS_DELTA_MAP_PAGE_NUM);
         }
+#if PIFS_PATCH_LOG_PAGE_NUM
+        if (ret == PIFS_SUCCESS)
+        {
+            /* Mark patch log as used */
+            ret = pifs_mark_page_check(free_page_buf,
+                                       pifs.header.patch_log_address.block_address,
+                                       pifs.header.patch_log_address.page_address,
+                                       PIFS_PATCH_LOG_PAGE_NUM);
+        }
+#endif
+#if PIFS_DELTA_MAP_CHAIN_ENABLED
+        if (ret == PIFS_SUCCESS)
+        {
+            /* Mark chained delta map pages as used */
+            ret = pifs_walk_delta_map(&pifs.header, pifs_delta_walker_check, free_page_buf);
+        }
+#endif
         if (ret == PIFS_SUCCESS)
         {
             /* Mark wear level list as used */
@@ -47,7 +47,7 @@ extern "C" {
 #endif
 
 #define PIFS_ENABLE_VERSION                 1
-#define PIFS_MAJOR_VERSION                  1u
+#define PIFS_MAJOR_VERSION                  4u
 #define PIFS_MINOR_VERSION                  0u
 
 #define PIFS_ENABLE_ATTRIBUTES              1u   /**< 1: Use attribute field of files, 0: don't use attribute field */
@@ -95,6 +95,12 @@ extern "C" {
 
 #define PIFS_MAP_ENTRY_PER_PAGE             ((PIFS_LOGICAL_PAGE_SIZE_BYTE - PIFS_MAP_HEADER_SIZE_BYTE) / PIFS_MAP_ENTRY_SIZE_BYTE)
 
+#if PIFS_ENABLE_MAP_INDEX
+#define PIFS_MAP_INDEX_ENTRY_SIZE_BYTE      (sizeof(pifs_map_index_entry_t))
+/** Index pages have the same header as map pages */
+#define PIFS_MAP_INDEX_ENTRY_PER_PAGE       ((PIFS_LOGICAL_PAGE_SIZE_BYTE - PIFS_MAP_HEADER_SIZE_BYTE) / PIFS_MAP_INDEX_ENTRY_SIZE_BYTE)
+#endif
+
 
 /******************************************************************************/
 /*** FREE SPACE BITMAP                                                      ***/
@@ -104,12 +110,38 @@ extern "C" {
 #define PIFS_FREE_SPACE_BITMAP_SIZE_BYTE    (PIFS_FSBM_BITS_PER_PAGE * ((PIFS_LOGICAL_PAGE_NUM_FS + PIFS_BYTE_BITS - 1) / PIFS_BYTE_BITS))
 /** Size of free space bitmap in pages */
 #define PIFS_FREE_SPACE_BITMAP_SIZE_PAGE    ((PIFS_FREE_SPACE_BITMAP_SIZE_BYTE + PIFS_LOGICAL_PAGE_SIZE_BYTE - 1) / PIFS_LOGICAL_PAGE_SIZE_BYTE)
+/** Number of leaves in free extent index: number of blocks rounded up to
+ * power of two */
+#define PIFS_FREE_EXTENT_LEAF_NUM           (PIFS_FLASH_BLOCK_NUM_FS <= 16u ? 16u \
+                                             : PIFS_FLASH_BLOCK_NUM_FS <= 64u ? 64u \
+                                             : PIFS_FLASH_BLOCK_NUM_FS <= 256u ? 256u \
+                                             : PIFS_FLASH_BLOCK_NUM_FS <= 1024u ? 1024u : 4096u)
 
 /******************************************************************************/
 /*** DELTA PAGES                                                            ***/
 /******************************************************************************/
 #define PIFS_DELTA_ENTRY_SIZE_BYTE          (sizeof(pifs_delta_entry_t))
 #define PIFS_DELTA_ENTRY_PER_PAGE           (PIFS_LOGICAL_PAGE_SIZE_BYTE / PIFS_DELTA_ENTRY_SIZE_BYTE)
+#define PIFS_DELTA_ENTRY_NUM                (PIFS_DELTA_ENTRY_PER_PAGE * PIFS_DELTA_MAP_PAGE_NUM_MAX)
+/** Number of slots in hash table of delta pages, at least twice of delta entries */
+#define PIFS_DELTA_HASH_SIZE                (PIFS_DELTA_ENTRY_NUM <= 32u ? 64u \
+                                             : PIFS_DELTA_ENTRY_NUM <= 128u ? 256u \
+                                             : PIFS_DELTA_ENTRY_NUM <= 512u ? 1024u \
+                                             : PIFS_DELTA_ENTRY_NUM <= 2048u ? 4096u : 16384u)
+#define PIFS_DELTA_HASH_SLOT_EMPTY          UINT16_MAX
+/** Link entry contains address of next delta map page */
+#define PIFS_IS_DELTA_LINK_ENTRY(delta_entry) ((delta_entry).orig_address.block_address == PIFS_BLOCK_ADDRESS_INVALID \
+                                               && (delta_entry).orig_address.page_address == PIFS_PAGE_ADDRESS_INVALID)
+/** Delta map pages are chained after PIFS_DELTA_MAP_PAGE_NUM pages */
+#define PIFS_DELTA_MAP_CHAIN_ENABLED        (PIFS_DELTA_MAP_PAGE_NUM_MAX > PIFS_DELTA_MAP_PAGE_NUM \
+                                             || PIFS_DELTA_FOLD_WATERMARK)
+
+/******************************************************************************/
+/*** PATCH LOG                                                              ***/
+/******************************************************************************/
+#define PIFS_PATCH_ENTRY_SIZE_BYTE          (sizeof(pifs_patch_entry_t))
+#define PIFS_PATCH_ENTRY_PER_PAGE           (PIFS_LOGICAL_PAGE_SIZE_BYTE / PIFS_PATCH_ENTRY_SIZE_BYTE)
+#define PIFS_PATCH_ENTRY_NUM                (PIFS_PATCH_ENTRY_PER_PAGE * PIFS_PATCH_LOG_PAGE_NUM)
 
 /******************************************************************************/
 /*** WEAR LEVEL LIST                                                        ***/
@@ -120,10 +152,15 @@ extern "C" {
 #define PIFS_WEAR_LEVEL_LIST_SIZE_PAGE      ((PIFS_FLASH_BLOCK_NUM_FS + PIFS_WEAR_LEVEL_ENTRY_PER_PAGE - 1)/ PIFS_WEAR_LEVEL_ENTRY_PER_PAGE)
 
 #define PIFS_MAP_PAGE_NUM_RECOMM            (((PIFS_LOGICAL_PAGE_NUM_FS - PIFS_MANAGEMENT_BLOCK_NUM * PIFS_LOGICAL_PAGE_PER_BLOCK) * PIFS_MAP_ENTRY_SIZE_BYTE + PIFS_LOGICAL_PAGE_SIZE_BYTE - 1) / PIFS_LOGICAL_PAGE_SIZE_BYTE)
+#if PIFS_ENABLE_MAP_INDEX
+#define PIFS_MAP_INDEX_PAGE_NUM_RECOMM      ((PIFS_MAP_PAGE_NUM_RECOMM + PIFS_MAP_INDEX_ENTRY_PER_PAGE - 1) / PIFS_MAP_INDEX_ENTRY_PER_PAGE)
+#else
+#define PIFS_MAP_INDEX_PAGE_NUM_RECOMM      0
+#endif
 
-#define PIFS_MANAGEMENT_PAGE_NUM_MIN        (PIFS_HEADER_SIZE_PAGE + PIFS_ENTRY_LIST_SIZE_PAGE + PIFS_FREE_SPACE_BITMAP_SIZE_PAGE + PIFS_DELTA_MAP_PAGE_NUM + PIFS_WEAR_LEVEL_LIST_SIZE_PAGE)
+#define PIFS_MANAGEMENT_PAGE_NUM_MIN        (PIFS_HEADER_SIZE_PAGE + PIFS_ENTRY_LIST_SIZE_PAGE + PIFS_FREE_SPACE_BITMAP_SIZE_PAGE + PIFS_DELTA_MAP_PAGE_NUM + PIFS_PATCH_LOG_PAGE_NUM + PIFS_WEAR_LEVEL_LIST_SIZE_PAGE)
 #define PIFS_MANAGEMENT_BLOCK_NUM_MIN       ((PIFS_MANAGEMENT_PAGE_NUM_MIN + PIFS_LOGICAL_PAGE_PER_BLOCK - 1) / PIFS_LOGICAL_PAGE_PER_BLOCK)
-#define PIFS_MANAGEMENT_PAGE_NUM_RECOMM     (PIFS_MANAGEMENT_PAGE_NUM_MIN + PIFS_MAP_PAGE_NUM_RECOMM)
+#define PIFS_MANAGEMENT_PAGE_NUM_RECOMM     (PIFS_MANAGEMENT_PAGE_NUM_MIN + PIFS_MAP_PAGE_NUM_RECOMM + PIFS_MAP_INDEX_PAGE_NUM_RECOMM)
 #define PIFS_MANAGEMENT_BLOCK_NUM_RECOMM    ((PIFS_MANAGEMENT_PAGE_NUM_RECOMM + PIFS_LOGICAL_PAGE_PER_BLOCK - 1) / PIFS_LOGICAL_PAGE_PER_BLOCK)
 /******************************************************************************/
 
@@ -263,6 +300,46 @@ typedef uint8_t pifs_wear_level_bits_t;
 #if PIFS_MOST_WEARED_BLOCK_NUM > PIFS_FLASH_BLOCK_NUM_FS - PIFS_MANAGEMENT_BLOCK_NUM * 2
 #error PIFS_MOST_WEARED_BLOCK_NUM shall not be greater than PIFS_FLASH_BLOCK_NUM_FS - PIFS_MANAGEMENT_BLOCK_NUM * 2!
 #endif
+#if PIFS_CACHE_PAGE_NUM < 1
+#error PIFS_CACHE_PAGE_NUM shall be 1 at minimum!
+#endif
+#if PIFS_ENABLE_BLOCK_PAGE_CNTR && PIFS_LOGICAL_PAGE_PER_BLOCK > 0xFFFFu
+#error PIFS_ENABLE_BLOCK_PAGE_CNTR: page counters of blocks are 16 bit wide!
+#endif
+#if PIFS_ENABLE_FREE_EXTENT_INDEX && !PIFS_ENABLE_FSBM_SHADOW
+#error PIFS_ENABLE_FREE_EXTENT_INDEX needs PIFS_ENABLE_FSBM_SHADOW!
+#endif
+#if PIFS_ENABLE_FREE_EXTENT_INDEX && PIFS_LOGICAL_PAGE_PER_BLOCK > 0xFFFFu
+#error PIFS_ENABLE_FREE_EXTENT_INDEX: length of free page runs is 16 bit wide!
+#endif
+#if PIFS_ENABLE_FREE_EXTENT_INDEX && PIFS_FLASH_BLOCK_NUM_FS > 4096u
+#error PIFS_ENABLE_FREE_EXTENT_INDEX: too many blocks, increase PIFS_FREE_EXTENT_LEAF_NUM!
+#endif
+#if PIFS_DELTA_MAP_PAGE_NUM_MAX < PIFS_DELTA_MAP_PAGE_NUM
+#error PIFS_DELTA_MAP_PAGE_NUM_MAX shall not be less than PIFS_DELTA_MAP_PAGE_NUM!
+#endif
+#if PIFS_ENABLE_DELTA_HASH_INDEX && PIFS_DELTA_MAP_PAGE_NUM_MAX * PIFS_LOGICAL_PAGE_SIZE_BYTE > 8192u * 4u
+#error PIFS_ENABLE_DELTA_HASH_INDEX: too many delta entries, increase PIFS_DELTA_HASH_SIZE!
+#endif
+#if PIFS_DELTA_FOLD_WATERMARK > 100u
+#error PIFS_DELTA_FOLD_WATERMARK shall not be greater than 100!
+#endif
+#if PIFS_PATCH_LOG_PAGE_NUM && (PIFS_PATCH_DATA_SIZE_BYTE < 1u || PIFS_PATCH_DATA_SIZE_BYTE > 255u)
+#error PIFS_PATCH_DATA_SIZE_BYTE shall be between 1 and 255!
+#endif
+#if PIFS_PATCH_LOG_PAGE_NUM && PIFS_PATCH_PER_PAGE_MAX < 1u
+#error PIFS_PATCH_PER_PAGE_MAX shall be at least 1!
+#endif
+#if PIFS_FILE_RESERVE_PAGE_NUM >= PIFS_MAP_PAGE_COUNT_INVALID
+#error PIFS_FILE_RESERVE_PAGE_NUM shall be less than PIFS_MAP_PAGE_COUNT_INVALID!
+#endif
+#if PIFS_READ_AHEAD_PAGE_NUM_MAX >= PIFS_CACHE_PAGE_NUM
+#error PIFS_READ_AHEAD_PAGE_NUM_MAX shall be less than PIFS_CACHE_PAGE_NUM!
+#endif
+#if PIFS_CACHE_RSV_DATA_PAGE_NUM + PIFS_CACHE_RSV_FSBM_PAGE_NUM + PIFS_CACHE_RSV_MAP_PAGE_NUM \
+    + PIFS_CACHE_RSV_ENTRY_PAGE_NUM + PIFS_CACHE_RSV_DELTA_PAGE_NUM + PIFS_CACHE_RSV_WEAR_PAGE_NUM > PIFS_CACHE_PAGE_NUM
+#error Sum of PIFS_CACHE_RSV_*_PAGE_NUM shall not be greater than PIFS_CACHE_PAGE_NUM!
+#endif
 #if PIFS_ENABLE_DIRECTORIES && !PIFS_ENABLE_ATTRIBUTES
 #error PIFS_ENABLE_ATTRIBUTES shall be 1 if PIFS_ENABLE_DIRECTORIES is 1!
 #endif
@@ -369,10 +446,14 @@ typedef struct PIFS_PACKED_ATTRIBUTE
     uint16_t                least_weared_block_num;     /**< Number of least weared blocks in the list */
     uint16_t                most_weared_block_num;      /**< Number of most weared blocks in the list */
     uint16_t                delta_map_page_num;         /**< Number of delta map pages */
+    uint16_t                delta_map_page_num_max;     /**< Maximum number of delta map pages including chained ones */
+    uint16_t                patch_log_page_num;         /**< Number of patch log pages */
+    uint16_t                patch_data_size_byte;       /**< Maximum number of bytes in a patch record */
     uint8_t                 map_page_count_size;        /**< Size of map page count's type in bytes */
     bool_t                  use_delta_for_entries : 1;  /**< TRUE: delta pages used for entries */
     bool_t                  enable_directories : 1;     /**< TRUE: directories can be create, read */
     bool_t                  enable_crc : 1;             /**< TRUE: CRC is calculate, FALSE: checksum is calculated */
+    bool_t                  enable_map_index : 1;       /**< TRUE: maps of files have index pages */
 #endif
     /* file system status */
     pifs_block_address_t    management_block_address;       /**< Address of primary (active) management block */
@@ -380,6 +461,7 @@ typedef struct PIFS_PACKED_ATTRIBUTE
     pifs_address_t          free_space_bitmap_address;      /**< Address of free space bitmap (FSBM) */
     pifs_address_t          root_entry_list_address;        /**< Root directory */
     pifs_address_t          delta_map_address;              /**< Address of delta map */
+    pifs_address_t          patch_log_address;              /**< Address of patch log */
     pifs_address_t          wear_level_list_address;        /**< Address of wear level list */
     /** Data blocks with lowest erase counter value */
     pifs_wear_level_t       least_weared_blocks[PIFS_LEAST_WEARED_BLOCK_NUM];   /**< List of least weared blocks */
@@ -418,6 +500,10 @@ typedef struct PIFS_PACKED_ATTRIBUTE
     pifs_checksum_t         prev_map_checksum;
     pifs_address_t          next_map_address;   /**< Address of next map */
     pifs_checksum_t         next_map_checksum;
+#if PIFS_ENABLE_MAP_INDEX
+    pifs_address_t          index_address;      /**< Address of map index, only used in first map */
+    pifs_checksum_t         index_checksum;
+#endif
 } pifs_map_header_t;
 
 /**
@@ -432,6 +518,21 @@ typedef struct PIFS_PACKED_ATTRIBUTE
     pifs_checksum_t         checksum;
 } pifs_map_entry_t;
 
+#if PIFS_ENABLE_MAP_INDEX
+/**
+ * Entry of map index. Index pages list the map pages of a file with the
+ * index of file's page where the map page starts.
+ * This structure is used in RAM and flash memory as well.
+ */
+typedef struct PIFS_PACKED_ATTRIBUTE
+{
+    pifs_address_t          map_address;        /**< Address of map page */
+    pifs_file_size_t        page_idx;           /**< Index of file's page where map page starts */
+    /** Checksum shall be the last element! */
+    pifs_checksum_t         checksum;
+} pifs_map_index_entry_t;
+#endif
+
 /**
  * Wear level (erase count) of a block.
  * This structure is used in RAM and flash memory as well.
@@ -459,6 +560,43 @@ typedef struct PIFS_PACKED_ATTRIBUTE
     pifs_checksum_t         checksum;
 } pifs_delta_entry_t;
 
+/**
+ * Patch record: a few bytes of a data page are replaced when the page is read.
+ * This structure is used in RAM and flash memory as well.
+ */
+typedef struct PIFS_PACKED_ATTRIBUTE
+{
+    pifs_address_t          address;        /**< Address of patched page */
+    pifs_page_offset_t      offset;         /**< Offset of first patched byte in the page */
+    uint8_t                 size;           /**< Number of patched bytes */
+    uint8_t                 data[PIFS_PATCH_DATA_SIZE_BYTE];
+    /** Checksum shall be the last element! */
+    pifs_checksum_t         checksum;
+} pifs_patch_entry_t;
+
+/**
+ * Valid entry of delta map.
+ * This structure is used only in RAM.
+ */
+typedef struct
+{
+    pifs_address_t          delta_address;
+    pifs_address_t          orig_address;
+} pifs_delta_index_t;
+
+#if PIFS_FILE_EXTENT_NUM_MAX
+/**
+ * Position of a map entry of an opened file.
+ * This structure is used only in RAM.
+ */
+typedef struct
+{
+    size_t                  page_idx;           /**< Index of file's page where map entry starts */
+    pifs_address_t          map_address;        /**< Address of map page which contains the entry */
+    size_t                  map_entry_idx;      /**< Index of entry in the map page */
+} pifs_file_extent_t;
+#endif
+
 /**
  * Actual status and parameters of an opened file.
  * This structure is used only in RAM.
@@ -481,9 +619,31 @@ typedef struct
     pifs_map_header_t       map_header;         /**< Actual map's header */
     size_t                  map_entry_idx;      /**< Actual entry's index in the map */
     pifs_map_entry_t        map_entry;          /**< Actual entry in the map */
+#if PIFS_ENABLE_MAP_COALESCE
+    bool_t                  is_map_entry_pending PIFS_BOOL_SIZE; /**< TRUE: map_entry is last entry of map, not written yet */
+#endif
+#if PIFS_DELTA_FOLD_WATERMARK
+    pifs_size_t             delta_entry_cnt;    /**< Number of delta entries added by writes since file was opened or folded */
+#endif
     size_t                  rw_pos;             /**< Position in file after last read/write */
     pifs_address_t          rw_address;         /**< Last read/write page's address */
     pifs_page_count_t       rw_page_count;      /**< Page count to be read/write from 'rw_address' */
+#if PIFS_READ_AHEAD_PAGE_NUM_MAX
+    size_t                  ra_pos;             /**< Position in file where next sequential read starts */
+    pifs_size_t             ra_page_count;      /**< Number of pages to read ahead */
+    size_t                  ra_page_end;        /**< Index of first page in file which is not prefetched */
+#endif
+#if PIFS_FILE_RESERVE_PAGE_NUM
+    pifs_address_t          reserved_address;   /**< First page of reservation window, pages are marked used */
+    pifs_page_count_t       reserved_page_count; /**< Number of reserved pages not yet written */
+    bool_t                  is_appended PIFS_BOOL_SIZE; /**< TRUE: pages were appended since file was opened */
+#endif
+#if PIFS_FILE_EXTENT_NUM_MAX
+    bool_t                  extent_is_read PIFS_BOOL_SIZE; /**< TRUE: extent[] is read from map */
+    size_t                  extent_cnt;         /**< Number of used elements of extent[] */
+    size_t                  extent_stride;      /**< Every n-th map entry is stored in extent[] */
+    pifs_file_extent_t      extent[PIFS_FILE_EXTENT_NUM_MAX]; /**< Map entries in order of file's pages */
+#endif
 } pifs_file_t;
 
 /**
@@ -500,6 +660,44 @@ typedef struct
     pifs_entry_t   entry; /**< Can be large, to avoid storing on stack */
 } pifs_dir_t;
 
+/**
+ * Access class of a cached page. Every class has reserved slots in the page
+ * cache, see PIFS_CACHE_RSV_*_PAGE_NUM.
+ */
+typedef enum
+{
+    PIFS_CACHE_CLASS_DATA = 0,      /**< File's data and delta pages */
+    PIFS_CACHE_CLASS_FSBM,          /**< Free space bitmap */
+    PIFS_CACHE_CLASS_MAP,           /**< Map pages of files */
+    PIFS_CACHE_CLASS_ENTRY_LIST,    /**< Entry list of directories */
+    PIFS_CACHE_CLASS_DELTA_MAP,     /**< Delta map pages */
+    PIFS_CACHE_CLASS_WEAR_LIST,     /**< Wear level list */
+    PIFS_CACHE_CLASS_HEADER,        /**< File system's header */
+    PIFS_CACHE_CLASS_NUM
+} pifs_cache_class_t;
+
+/**
+ * One slot of the page cache.
+ * This structure is used only in RAM.
+ */
+typedef struct
+{
+    pifs_address_t          address;                                      /**< Address of cached page, invalid if slot is unused */
+    uint32_t                lru_cntr;                                     /**< Value of pifs.cache_lru_cntr at last use */
+    pifs_cache_class_t      cache_class;                                  /**< Access class of last use */
+    bool_t                  is_dirty PIFS_BOOL_SIZE;                      /**< TRUE: cache page was changed and needs to be written to flash memory */
+    /** Start offset of changed bytes in every flash page of the logical page */
+    pifs_page_offset_t      dirty_start[PIFS_FLASH_PAGE_PER_LOGICAL_PAGE];
+    /** End offset (exclusive) of changed bytes in every flash page of the logical page */
+    pifs_page_offset_t      dirty_end[PIFS_FLASH_PAGE_PER_LOGICAL_PAGE];
+#if PIFS_FLASH_ASYNC_ENABLED
+    bool_t                  is_in_flight PIFS_BOOL_SIZE;                  /**< TRUE: buffer is being written to flash memory */
+    /** Write requests of flash pages, buf_size is zero if flash page was not written */
+    pifs_flash_request_t    request[PIFS_FLASH_PAGE_PER_LOGICAL_PAGE];
+#endif
+    uint8_t                 buf[PIFS_LOGICAL_PAGE_SIZE_BYTE];             /**< Flash page buffer for cache */
+} pifs_cache_entry_t;
+
 /**
  * Actual status of file system.
  * This structure is used only in RAM.
@@ -514,19 +712,49 @@ typedef struct
     pifs_header_t           header;                                       /**< Actual header. */
     pifs_entry_t            entry;                                        /**< For merging */
     /* Page cache */
-    pifs_address_t          cache_page_buf_address;                       /**< Address of cache_page_buf */
-    uint8_t                 cache_page_buf[PIFS_LOGICAL_PAGE_SIZE_BYTE];  /**< Flash page buffer for cache */
-    bool_t                  cache_page_buf_is_dirty;                      /**< TRUE: cache page was changed and needs to be written to flash memory */
+    pifs_cache_entry_t      cache[PIFS_CACHE_PAGE_NUM];                   /**< Slots of page cache */
+    uint32_t                cache_lru_cntr;                               /**< Incremented at every cache access */
+    uint8_t               * cache_page_buf;                               /**< Buffer of last accessed cache slot */
+    uint32_t                cache_hit_cntr[PIFS_CACHE_CLASS_NUM];         /**< Number of cache hits per access class */
+    uint32_t                cache_miss_cntr[PIFS_CACHE_CLASS_NUM];        /**< Number of cache misses per access class */
+    pifs_size_t             transaction_depth;                            /**< Nesting level of metadata transactions */
+#if PIFS_FLASH_ASYNC_ENABLED
+    pifs_flash_request_t    erase_request;                                /**< Request of last block erase */
+    bool_t                  is_erasing PIFS_BOOL_SIZE;                    /**< TRUE: erase_request is submitted */
+#endif
+#if PIFS_READ_AHEAD_PAGE_NUM_MAX
+    pifs_size_t             read_ahead_page_num_max;                      /**< Maximum number of pages to read ahead */
+#endif
     /* Opened files and directories */
     pifs_file_t             file[PIFS_OPEN_FILE_NUM_MAX];                 /**< Opened files */
     pifs_file_t             internal_file;                                /**< Internally opened files */
     pifs_dir_t              dir[PIFS_OPEN_DIR_NUM_MAX];                   /**< Opened directories */
-    /** Page buffer of delta map */
-    uint8_t                 delta_map_page_buf[PIFS_DELTA_MAP_PAGE_NUM][PIFS_LOGICAL_PAGE_SIZE_BYTE];
-    /** TRUE: delta_map_page_buf's content is valid */
+    /** Valid entries of delta map in the order of writing */
+    pifs_delta_index_t      delta_index[PIFS_DELTA_ENTRY_NUM];
+    pifs_size_t             delta_index_cnt;        /**< Number of entries in delta_index */
+    pifs_size_t             delta_map_page_cnt;     /**< Number of delta map pages */
+    pifs_size_t             delta_map_tail_page_idx;    /**< Delta map page of next free entry */
+    /** Address of delta map page of next free entry. Pages after PIFS_DELTA_MAP_PAGE_NUM are chained. */
+    pifs_address_t          delta_map_tail_address;
+    /** Index of next free entry in delta map page. PIFS_DELTA_ENTRY_PER_PAGE: delta map is full */
+    pifs_size_t             delta_map_tail_entry_idx;
+    /** TRUE: delta map is read to delta_index */
     bool_t                  delta_map_page_is_read PIFS_BOOL_SIZE;
-    /** TRUE: delta_map_page_buf is inconsistent, it shall be written to the flash memory */
-    bool_t                  delta_map_page_is_dirty PIFS_BOOL_SIZE;
+#if PIFS_ENABLE_DELTA_HASH_INDEX
+    /** Index of latest delta entry of original pages in delta_index, open addressing */
+    uint16_t                delta_hash[PIFS_DELTA_HASH_SIZE];
+#endif
+#if PIFS_DELTA_FILTER_SIZE_BYTE
+    /** 1: page may have delta page, 0: page has no delta page */
+    uint8_t                 delta_filter[PIFS_DELTA_FILTER_SIZE_BYTE];
+#endif
+#if PIFS_PATCH_LOG_PAGE_NUM
+    /** Address of patched page of patch records. Invalid address: record is not valid. */
+    pifs_address_t          patch_address[PIFS_PATCH_ENTRY_NUM];
+    pifs_size_t             patch_entry_cnt;        /**< Number of used patch records */
+    /** TRUE: patch log is read to patch_address */
+    bool_t                  patch_log_is_read PIFS_BOOL_SIZE;
+#endif
     /** General page buffer used by pifs_write_delta(),
      * pifs_copy_fsbm(), pifs_wear_level_list_init(), dmw=delta, merge, wear */
     uint8_t                 dmw_page_buf[PIFS_LOGICAL_PAGE_SIZE_BYTE];
@@ -536,6 +764,9 @@ typedef struct
     pifs_size_t             free_data_page_num;
     pifs_size_t             last_static_wear_block_idx; /**< Block index used for last static wear leveling. */
     uint32_t                auto_static_wear_cntr;      /**< Counter to call less often static wear leveling */
+#if PIFS_FILE_RESERVE_PAGE_NUM
+    pifs_file_t           * last_appended_file;         /**< File which got new data pages last time */
+#endif
 #if PIFS_ENABLE_DIRECTORIES
 #if PIFS_OS_TASK_ID_IS_SEQUENTIAL == 0 && PIFS_SEPARATE_WORKDIR_FOR_TASKS
     PIFS_OS_TASK_ID_TYPE    task_ids[PIFS_TASK_COUNT_MAX];
@@ -544,6 +775,28 @@ typedef struct
     /* TODO current_entry_list_address shall be removed and cwd shall be used instead! */
     pifs_address_t          current_entry_list_address[PIFS_TASK_COUNT_MAX]; /**< Entry list of current working directory */
 #endif
+#if PIFS_ENABLE_FSBM_SHADOW
+    bool_t                  is_fsbm_shadow_valid PIFS_BOOL_SIZE;          /**< TRUE: fsbm_shadow is equal to free space bitmap of actual header */
+    uint8_t                 fsbm_shadow[PIFS_FREE_SPACE_BITMAP_SIZE_BYTE]; /**< Copy of free space bitmap */
+#endif
+#if PIFS_ENABLE_BLOCK_PAGE_CNTR
+    bool_t                  is_page_cntr_valid PIFS_BOOL_SIZE;            /**< TRUE: page counters are equal to free space bitmap */
+    uint16_t                free_page_cntr[PIFS_FLASH_BLOCK_NUM_FS];      /**< Number of free pages in every block */
+    uint16_t                to_be_released_page_cntr[PIFS_FLASH_BLOCK_NUM_FS]; /**< Number of to be released pages in every block */
+    pifs_size_t             free_management_page_cntr;                    /**< Number of free pages in primary management blocks */
+    pifs_size_t             free_data_page_cntr;                          /**< Number of free pages in data blocks */
+    pifs_size_t             to_be_released_management_page_cntr;          /**< Number of to be released pages in primary management blocks */
+    pifs_size_t             to_be_released_data_page_cntr;                /**< Number of to be released pages in data blocks */
+#endif
+#if PIFS_ENABLE_FREE_EXTENT_INDEX
+    bool_t                  is_free_extent_valid PIFS_BOOL_SIZE;          /**< TRUE: free extent index is built */
+    bool_t                  is_free_extent_dirty PIFS_BOOL_SIZE;          /**< TRUE: at least one block shall be updated in index */
+    uint8_t                 free_extent_dirty[(PIFS_FLASH_BLOCK_NUM_FS + PIFS_BYTE_BITS - 1) / PIFS_BYTE_BITS]; /**< Blocks changed since last update */
+    uint16_t                free_extent_tree[2 * PIFS_FREE_EXTENT_LEAF_NUM]; /**< Longest free page run of data blocks, maximum of children in other nodes */
+#endif
+#if PIFS_CHECK_IF_PAGE_IS_ERASED && PIFS_ENABLE_ERASED_PAGE_BITMAP
+    uint8_t                 erased_page_bitmap[(PIFS_LOGICAL_PAGE_NUM_FS + PIFS_BYTE_BITS - 1) / PIFS_BYTE_BITS]; /**< 1: page is known to be erased, 0: unknown */
+#endif
 #if PIFS_FSCHECK_USE_STATIC_MEMORY
     uint8_t                 free_pages_buf[PIFS_FLASH_PAGE_NUM_FS / PIFS_BYTE_BITS];
 #endif
@@ -552,16 +805,42 @@ typedef struct
 extern pifs_t pifs;
 
 pifs_status_t pifs_flush(void);
+void pifs_transaction_begin(void);
+pifs_status_t pifs_transaction_commit(void);
+bool_t pifs_is_in_transaction(void);
 pifs_status_t pifs_read(pifs_block_address_t a_block_address,
                         pifs_page_address_t a_page_address,
                         pifs_page_offset_t a_page_offset,
                         void * const a_buf,
-                        pifs_size_t a_buf_size);
+                        pifs_size_t a_buf_size,
+                        pifs_cache_class_t a_class);
+pifs_status_t pifs_read_uncached(pifs_block_address_t a_block_address,
+                                 pifs_page_address_t a_page_address,
+                                 pifs_page_offset_t a_page_offset,
+                                 void * const a_buf,
+                                 pifs_size_t a_buf_size);
+#if PIFS_FLASH_MULTI_PAGE_ENABLED
+pifs_status_t pifs_read_multi(pifs_block_address_t a_block_address,
+                              pifs_page_address_t a_page_address,
+                              void * const a_buf,
+                              pifs_size_t a_page_count);
+pifs_status_t pifs_write_multi(pifs_block_address_t a_block_address,
+                               pifs_page_address_t a_page_address,
+                               const void * const a_buf,
+                               pifs_size_t a_page_count);
+#endif
 pifs_status_t pifs_write(pifs_block_address_t a_block_address,
                          pifs_page_address_t a_page_address,
                          pifs_page_offset_t a_page_offset,
                          const void * const a_buf,
-                         pifs_size_t a_buf_size);
+                         pifs_size_t a_buf_size,
+                         pifs_cache_class_t a_class);
+pifs_status_t pifs_write_erased(pifs_block_address_t a_block_address,
+                                pifs_page_address_t a_page_address,
+                                pifs_page_offset_t a_page_offset,
+                                const void * const a_buf,
+                                pifs_size_t a_buf_size,
+                                pifs_cache_class_t a_class);
 pifs_status_t pifs_erase(pifs_block_address_t a_block_address, pifs_header_t *a_old_header, pifs_header_t *a_new_header);
 pifs_status_t pifs_merge(void);
 pifs_status_t pifs_header_init(pifs_block_address_t a_block_address,
@@ -35,29 +35,285 @@
 #include "pifs_helper.h"
 #include "pifs_delta.h"
 
+#if PIFS_ENABLE_DELTA_HASH_INDEX
 /**
- * @brief pifs_read_delta_map_page Read delta map pages to memory buffer.
+ * @brief pifs_find_delta_hash_slot Find slot of an original page in hash
+ * table of delta pages. Table is never full, so an empty slot ends the
+ * search.
  *
- * @param[in] a_header          File system's header to use.
+ * @param[in] a_block_address Block address of original page.
+ * @param[in] a_page_address  Page address of original page.
+ * @return Pointer to slot which contains index of the latest delta entry
+ * or PIFS_DELTA_HASH_SLOT_EMPTY if page has no delta page.
+ */
+static uint16_t * pifs_find_delta_hash_slot(pifs_block_address_t a_block_address,
+                                            pifs_page_address_t a_page_address)
+{
+    uint32_t             key = (uint32_t) a_block_address * PIFS_LOGICAL_PAGE_PER_BLOCK + a_page_address;
+    pifs_size_t          slot = ((key * 2654435761u) >> 16) & (PIFS_DELTA_HASH_SIZE - 1u);
+    uint16_t           * found = NULL;
+    pifs_delta_index_t * delta_index;
+
+    while (!found)
+    {
+        if (pifs.delta_hash[slot] == PIFS_DELTA_HASH_SLOT_EMPTY)
+        {
+            found = &pifs.delta_hash[slot];
+        }
+        else
+        {
+            delta_index = &pifs.delta_index[pifs.delta_hash[slot]];
+            if (delta_index->orig_address.block_address == a_block_address
+                    && delta_index->orig_address.page_address == a_page_address)
+            {
+                found = &pifs.delta_hash[slot];
+            }
+            else
+            {
+                slot = (slot + 1u) & (PIFS_DELTA_HASH_SIZE - 1u);
+            }
+        }
+    }
+
+    return found;
+}
+#endif
+
+#if PIFS_DELTA_FILTER_SIZE_BYTE
+/**
+ * @brief pifs_get_delta_filter_bit Get bit index of a page in filter of
+ * delta pages. If filter is smaller than number of pages, pages share bits.
  *
- * @return PIFS_SUCCESS if read successfully.
+ * @param[in] a_block_address Block address of original page.
+ * @param[in] a_page_address  Page address of original page.
+ * @return Bit index in pifs.delta_filter.
+ */
+static inline pifs_size_t pifs_get_delta_filter_bit(pifs_block_address_t a_block_address,
+                                                    pifs_page_address_t a_page_address)
+{
+    return ((pifs_size_t) a_block_address * PIFS_LOGICAL_PAGE_PER_BLOCK + a_page_address)
+            % (PIFS_DELTA_FILTER_SIZE_BYTE * PIFS_BYTE_BITS);
+}
+#endif
+
+/**
+ * @brief pifs_add_delta_index Add a valid delta entry to RAM index of delta
+ * map. Entry replaces the previous delta entry of the same original page
+ * in hash table and marks the original page in filter.
+ *
+ * @param[in] a_delta_entry Pointer to delta entry.
+ */
+static void pifs_add_delta_index(const pifs_delta_entry_t * a_delta_entry)
+{
+#if PIFS_DELTA_FILTER_SIZE_BYTE
+    pifs_size_t bit = pifs_get_delta_filter_bit(a_delta_entry->orig_address.block_address,
+                                                a_delta_entry->orig_address.page_address);
+#endif
+
+    PIFS_ASSERT(pifs.delta_index_cnt < PIFS_DELTA_ENTRY_NUM);
+    pifs.delta_index[pifs.delta_index_cnt].delta_address = a_delta_entry->delta_address;
+    pifs.delta_index[pifs.delta_index_cnt].orig_address = a_delta_entry->orig_address;
+#if PIFS_ENABLE_DELTA_HASH_INDEX
+    *pifs_find_delta_hash_slot(a_delta_entry->orig_address.block_address,
+                               a_delta_entry->orig_address.page_address) = pifs.delta_index_cnt;
+#endif
+#if PIFS_DELTA_FILTER_SIZE_BYTE
+    pifs.delta_filter[bit / PIFS_BYTE_BITS] |= 1u << (bit % PIFS_BYTE_BITS);
+#endif
+    pifs.delta_index_cnt++;
+}
+
+/**
+ * @brief pifs_find_delta_page_to_read Look for a delta page of a page to be
+ * read. Works like pifs_find_delta_page(), but delta map is not searched
+ * if the page has no delta page according to filter.
+ *
+ * @param[in] a_block_address        Block address to search.
+ * @param[in] a_page_address         Page address to search.
+ * @param[out] a_delta_block_address Pointer to block address to fill.
+ * @param[out] a_delta_page_address  Pointer to page address to fill.
+ * @return PIFS_SUCCESS: if delta map read successfully.
+ */
+static pifs_status_t pifs_find_delta_page_to_read(pifs_block_address_t a_block_address,
+                                                  pifs_page_address_t a_page_address,
+                                                  pifs_block_address_t * a_delta_block_address,
+                                                  pifs_page_address_t * a_delta_page_address)
+{
+    pifs_status_t ret = PIFS_SUCCESS;
+#if PIFS_DELTA_FILTER_SIZE_BYTE
+    pifs_size_t   bit = pifs_get_delta_filter_bit(a_block_address, a_page_address);
+
+    if (pifs.delta_map_page_is_read
+            && !(pifs.delta_filter[bit / PIFS_BYTE_BITS] & (1u << (bit % PIFS_BYTE_BITS))))
+    {
+        /* Page was not overwritten */
+        *a_delta_block_address = a_block_address;
+        *a_delta_page_address = a_page_address;
+    }
+    else
+#endif
+    {
+        ret = pifs_find_delta_page(a_block_address, a_page_address,
+                                   a_delta_block_address, a_delta_page_address,
+                                   NULL, &pifs.header);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_walk_delta_map Go through entries of delta map in the order of
+ * writing. Pages after PIFS_DELTA_MAP_PAGE_NUM are reached via link entries.
+ * Walking stops at the first erased entry, which is the next entry to write,
+ * so position of next free entry is updated.
+ * Erased, released entries and entries with invalid checksum are skipped.
+ *
+ * @param[in] a_header           File system's header to use.
+ * @param[in] a_delta_walker_func Function to call for every valid entry,
+ *                               including link entries.
+ * @param[in] a_func_data        User-data to pass to a_delta_walker_func.
+ * @return PIFS_SUCCESS if walked successfully.
  */
-static pifs_status_t pifs_read_delta_map_page(pifs_header_t * a_header)
+pifs_status_t pifs_walk_delta_map(pifs_header_t * a_header,
+                                  pifs_delta_walker_func_t a_delta_walker_func,
+                                  void * a_func_data)
 {
     pifs_block_address_t ba = a_header->delta_map_address.block_address;
     pifs_page_address_t  pa = a_header->delta_map_address.page_address;
-    pifs_size_t          i;
+    pifs_address_t       next_address;
+    pifs_size_t          i = 0;
+    pifs_size_t          j;
+    pifs_delta_entry_t   delta_entry;
+    pifs_checksum_t      checksum;
+    bool_t               tail_found = FALSE;
+    bool_t               end = FALSE;
     pifs_status_t        ret = PIFS_SUCCESS;
 
-    for (i = 0; i < PIFS_DELTA_MAP_PAGE_NUM && ret == PIFS_SUCCESS; i++)
+    PIFS_ASSERT(a_delta_walker_func);
+    pifs.delta_map_page_cnt = PIFS_DELTA_MAP_PAGE_NUM;
+    while (!tail_found && !end && ret == PIFS_SUCCESS)
     {
-        ret = pifs_read(ba, pa, 0, &pifs.delta_map_page_buf[i], PIFS_LOGICAL_PAGE_SIZE_BYTE);
-        if (ret == PIFS_SUCCESS && i < PIFS_DELTA_MAP_PAGE_NUM - 1)
+        next_address.block_address = PIFS_BLOCK_ADDRESS_INVALID;
+        next_address.page_address = PIFS_PAGE_ADDRESS_INVALID;
+        for (j = 0; j < PIFS_DELTA_ENTRY_PER_PAGE && !tail_found && ret == PIFS_SUCCESS; j++)
         {
-            ret = pifs_inc_ba_pa(&ba, &pa);
+            ret = pifs_read(ba, pa, j * PIFS_DELTA_ENTRY_SIZE_BYTE, &delta_entry,
+                            PIFS_DELTA_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_DELTA_MAP);
+            if (ret == PIFS_SUCCESS)
+            {
+                if (pifs_is_buffer_erased(&delta_entry, PIFS_DELTA_ENTRY_SIZE_BYTE))
+                {
+                    pifs.delta_map_tail_page_idx = i;
+                    pifs.delta_map_tail_entry_idx = j;
+                    tail_found = TRUE;
+                }
+                else if (pifs_is_buffer_programmed(&delta_entry, PIFS_DELTA_ENTRY_SIZE_BYTE))
+                {
+                    /* Entry was released */
+                }
+                else
+                {
+                    checksum = pifs_calc_checksum(&delta_entry, PIFS_DELTA_ENTRY_SIZE_BYTE - PIFS_CHECKSUM_SIZE_BYTE);
+                    if (checksum != delta_entry.checksum)
+                    {
+                        /* Entry is skipped */
+                    }
+                    else
+                    {
+                        if (PIFS_IS_DELTA_LINK_ENTRY(delta_entry))
+                        {
+                            /* Link entry, it contains address of next delta map page */
+                            next_address = delta_entry.delta_address;
+                        }
+                        ret = (*a_delta_walker_func)(ba, pa, j * PIFS_DELTA_ENTRY_SIZE_BYTE,
+                                                     &delta_entry, a_func_data);
+                    }
+                }
+            }
+        }
+        if (ret == PIFS_SUCCESS && !tail_found)
+        {
+            if (i < PIFS_DELTA_MAP_PAGE_NUM - 1)
+            {
+                ret = pifs_inc_ba_pa(&ba, &pa);
+                i++;
+            }
+            else if (pifs_is_address_valid(&next_address))
+            {
+                ba = next_address.block_address;
+                pa = next_address.page_address;
+                pifs.delta_map_page_cnt++;
+                i++;
+            }
+            else
+            {
+                /* Delta map is full */
+                pifs.delta_map_tail_page_idx = i;
+                pifs.delta_map_tail_entry_idx = PIFS_DELTA_ENTRY_PER_PAGE;
+                end = TRUE;
+            }
         }
     }
     if (ret == PIFS_SUCCESS)
+    {
+        pifs.delta_map_tail_address.block_address = ba;
+        pifs.delta_map_tail_address.page_address = pa;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_delta_walker_read Add entry to RAM index of delta map.
+ * Callback function for pifs_walk_delta_map().
+ *
+ * @param[in] a_block_address   Block address of delta map page.
+ * @param[in] a_page_address    Page address of delta map page.
+ * @param[in] a_page_offset     Offset of entry in delta map page.
+ * @param[in] a_delta_entry     Pointer to valid delta entry.
+ * @param[in] a_func_data       Not used.
+ * @return PIFS_SUCCESS.
+ */
+static pifs_status_t pifs_delta_walker_read(pifs_block_address_t a_block_address,
+                                            pifs_page_address_t a_page_address,
+                                            pifs_page_offset_t a_page_offset,
+                                            pifs_delta_entry_t * a_delta_entry,
+                                            void * a_func_data)
+{
+    (void) a_block_address;
+    (void) a_page_address;
+    (void) a_page_offset;
+    (void) a_func_data;
+
+    if (!PIFS_IS_DELTA_LINK_ENTRY(*a_delta_entry))
+    {
+        /* Later entries are the latest delta pages */
+        pifs_add_delta_index(a_delta_entry);
+    }
+
+    return PIFS_SUCCESS;
+}
+
+/**
+ * @brief pifs_read_delta_map_page Read delta map pages to RAM index.
+ *
+ * @param[in] a_header          File system's header to use.
+ *
+ * @return PIFS_SUCCESS if read successfully.
+ */
+pifs_status_t pifs_read_delta_map_page(pifs_header_t * a_header)
+{
+    pifs_status_t ret;
+
+    pifs.delta_index_cnt = 0;
+#if PIFS_ENABLE_DELTA_HASH_INDEX
+    memset(pifs.delta_hash, 0xFF, sizeof(pifs.delta_hash));
+#endif
+#if PIFS_DELTA_FILTER_SIZE_BYTE
+    memset(pifs.delta_filter, 0, sizeof(pifs.delta_filter));
+#endif
+    ret = pifs_walk_delta_map(a_header, pifs_delta_walker_read, NULL);
+    if (ret == PIFS_SUCCESS)
     {
         pifs.delta_map_page_is_read = TRUE;
     }
@@ -66,32 +322,88 @@ static pifs_status_t pifs_read_delta_map_page(pifs_header_t * a_header)
 }
 
 /**
- * @brief pifs_write_delta_map_page Write delta map pages to flash memory.
+ * @brief pifs_write_delta_map_entry Write an entry to the next free entry of
+ * delta map and step to the next free entry.
  *
+ * @param[in] a_delta_entry Pointer to the entry to write.
  * @return PIFS_SUCCESS if written successfully.
  */
-static pifs_status_t pifs_write_delta_map_page(pifs_size_t a_delta_map_page_idx,
-                                               pifs_header_t * a_header)
+static pifs_status_t pifs_write_delta_map_entry(const pifs_delta_entry_t * a_delta_entry)
 {
-    pifs_block_address_t ba = a_header->delta_map_address.block_address;
-    pifs_page_address_t  pa = a_header->delta_map_address.page_address;
-    pifs_status_t        ret = PIFS_SUCCESS;
+    pifs_address_t * address = &pifs.delta_map_tail_address;
+    pifs_status_t    ret;
 
     PIFS_ASSERT(pifs.delta_map_page_is_read);
-    if (a_delta_map_page_idx < PIFS_DELTA_MAP_PAGE_NUM)
+    PIFS_ASSERT(pifs.delta_map_tail_entry_idx < PIFS_DELTA_ENTRY_PER_PAGE);
+    /* Entry is erased, it does not need to be read */
+    ret = pifs_write_erased(address->block_address, address->page_address,
+                            pifs.delta_map_tail_entry_idx * PIFS_DELTA_ENTRY_SIZE_BYTE,
+                            a_delta_entry, PIFS_DELTA_ENTRY_SIZE_BYTE,
+                            PIFS_CACHE_CLASS_DELTA_MAP);
+    PIFS_DEBUG_MSG("%s ret: %i\r\n", pifs_address2str(address), ret);
+    if (ret == PIFS_SUCCESS)
     {
-        ret = pifs_add_ba_pa(&ba, &pa, a_delta_map_page_idx);
-        if (ret == PIFS_SUCCESS)
+        pifs.delta_map_tail_entry_idx++;
+        if (pifs.delta_map_tail_entry_idx == PIFS_DELTA_ENTRY_PER_PAGE
+                && pifs.delta_map_tail_page_idx < pifs.delta_map_page_cnt - 1)
         {
-            ret = pifs_write(ba, pa, 0, &pifs.delta_map_page_buf[a_delta_map_page_idx],
-                             PIFS_LOGICAL_PAGE_SIZE_BYTE);
-            PIFS_WARNING_MSG("%s ret: %i\r\n", pifs_ba_pa2str(ba, pa), ret);
+            /* Pages of PIFS_DELTA_MAP_PAGE_NUM are consecutive */
+            ret = pifs_inc_address(address);
+            pifs.delta_map_tail_page_idx++;
+            pifs.delta_map_tail_entry_idx = 0;
         }
     }
 
     return ret;
 }
 
+#if PIFS_DELTA_MAP_CHAIN_ENABLED
+/**
+ * @brief pifs_chain_delta_map_page Allocate a new delta map page in the
+ * management area and write its address to the last entry of delta map as
+ * a link entry.
+ *
+ * @return PIFS_SUCCESS if page was chained. PIFS_ERROR_NO_MORE_SPACE if
+ * there is no free page in the management area.
+ */
+static pifs_status_t pifs_chain_delta_map_page(void)
+{
+    pifs_status_t        ret;
+    pifs_delta_entry_t   link_entry;
+    pifs_block_address_t ba;
+    pifs_page_address_t  pa;
+    pifs_page_count_t    page_count_found;
+
+    ret = pifs_find_free_page_wl(1, 1, PIFS_BLOCK_TYPE_PRIMARY_MANAGEMENT,
+                                 &ba, &pa, &page_count_found);
+    if (ret == PIFS_SUCCESS)
+    {
+        /* Mark new page as used before linking it */
+        ret = pifs_mark_page(ba, pa, 1, TRUE, FALSE);
+    }
+    if (ret == PIFS_SUCCESS)
+    {
+        link_entry.orig_address.block_address = PIFS_BLOCK_ADDRESS_INVALID;
+        link_entry.orig_address.page_address = PIFS_PAGE_ADDRESS_INVALID;
+        link_entry.delta_address.block_address = ba;
+        link_entry.delta_address.page_address = pa;
+        link_entry.checksum = pifs_calc_checksum(&link_entry, PIFS_DELTA_ENTRY_SIZE_BYTE - PIFS_CHECKSUM_SIZE_BYTE);
+        ret = pifs_write_delta_map_entry(&link_entry);
+    }
+    if (ret == PIFS_SUCCESS)
+    {
+        pifs.delta_map_tail_address.block_address = ba;
+        pifs.delta_map_tail_address.page_address = pa;
+        pifs.delta_map_tail_page_idx++;
+        pifs.delta_map_tail_entry_idx = 0;
+        pifs.delta_map_page_cnt++;
+        PIFS_NOTICE_MSG("New delta map page %s\r\n", pifs_ba_pa2str(ba, pa));
+    }
+
+    return ret;
+}
+#endif
+
 /**
  * @brief pifs_find_delta_page Look for a delta page of a specified page.
  * a_delta_block_address and a_delta_page_address will contain the
@@ -119,12 +431,14 @@ pifs_status_t pifs_find_delta_page(pifs_block_address_t a_block_address,
                                    pifs_header_t * a_header)
 {
     pifs_status_t        ret = PIFS_SUCCESS;
-    pifs_size_t          i;
-    pifs_size_t          j;
-    pifs_delta_entry_t * delta_entry;
+    pifs_delta_index_t * delta_index;
     pifs_block_address_t ba = a_block_address;
     pifs_page_address_t  pa = a_page_address;
-    pifs_checksum_t      checksum;
+#if PIFS_ENABLE_DELTA_HASH_INDEX
+    uint16_t             entry_idx;
+#else
+    pifs_size_t          i;
+#endif
 
     PIFS_ASSERT(a_block_address < PIFS_BLOCK_ADDRESS_INVALID);
     PIFS_ASSERT(a_page_address < PIFS_PAGE_ADDRESS_INVALID);
@@ -137,33 +451,36 @@ pifs_status_t pifs_find_delta_page(pifs_block_address_t a_block_address,
     {
         if (a_is_map_full)
         {
-            *a_is_map_full = TRUE;
+            *a_is_map_full = (pifs.delta_map_tail_entry_idx == PIFS_DELTA_ENTRY_PER_PAGE);
+        }
+#if PIFS_ENABLE_DELTA_HASH_INDEX
+        entry_idx = *pifs_find_delta_hash_slot(a_block_address, a_page_address);
+        delta_index = NULL;
+        if (entry_idx != PIFS_DELTA_HASH_SLOT_EMPTY)
+        {
+            delta_index = &pifs.delta_index[entry_idx];
         }
-        /* All delta pages shall be checked to find latest delta page! */
-        for (i = 0; i < PIFS_DELTA_MAP_PAGE_NUM; i++)
+#else
+        /* Latest delta page is searched */
+        delta_index = NULL;
+        for (i = pifs.delta_index_cnt; i > 0 && !delta_index; i--)
         {
-            delta_entry = (pifs_delta_entry_t*) &pifs.delta_map_page_buf[i];
-            for (j = 0; j < PIFS_DELTA_ENTRY_PER_PAGE; j++)
+            if (pifs.delta_index[i - 1].orig_address.block_address == a_block_address
+                    && pifs.delta_index[i - 1].orig_address.page_address == a_page_address)
             {
-                checksum = pifs_calc_checksum(&delta_entry[j], PIFS_DELTA_ENTRY_SIZE_BYTE - PIFS_CHECKSUM_SIZE_BYTE);
-                if (checksum == delta_entry[j].checksum
-                        && delta_entry[j].orig_address.block_address == a_block_address
-                        && delta_entry[j].orig_address.page_address == a_page_address)
-                {
-                    ba = delta_entry[j].delta_address.block_address;
-                    pa = delta_entry[j].delta_address.page_address;
-                    PIFS_DEBUG_MSG("delta found %s -> ",
-                                   pifs_ba_pa2str(a_block_address, a_page_address));
-                    PIFS_DEBUG_MSG("%s\r\n",
-                                   pifs_ba_pa2str(ba, pa));
-                }
-                if (a_is_map_full && *a_is_map_full
-                        && pifs_is_buffer_erased(&delta_entry[j], sizeof(PIFS_DELTA_ENTRY_SIZE_BYTE)))
-                {
-                    *a_is_map_full = FALSE;
-                }
+                delta_index = &pifs.delta_index[i - 1];
             }
         }
+#endif
+        if (delta_index)
+        {
+            ba = delta_index->delta_address.block_address;
+            pa = delta_index->delta_address.page_address;
+            PIFS_DEBUG_MSG("delta found %s -> ",
+                           pifs_ba_pa2str(a_block_address, a_page_address));
+            PIFS_DEBUG_MSG("%s\r\n",
+                           pifs_ba_pa2str(ba, pa));
+        }
         *a_delta_block_address = ba;
         *a_delta_page_address = pa;
     }
@@ -171,8 +488,205 @@ pifs_status_t pifs_find_delta_page(pifs_block_address_t a_block_address,
     return ret;
 }
 
+#if PIFS_DELTA_FOLD_WATERMARK
+/**
+ * @brief pifs_is_delta_index_superseded Check if a later entry of the same
+ * original page exists in RAM index of delta map.
+ *
+ * @param[in] a_entry_idx Index of entry in pifs.delta_index.
+ * @return TRUE: entry is superseded.
+ */
+static bool_t pifs_is_delta_index_superseded(pifs_size_t a_entry_idx)
+{
+    pifs_delta_index_t * delta_index = &pifs.delta_index[a_entry_idx];
+#if PIFS_ENABLE_DELTA_HASH_INDEX
+
+    return *pifs_find_delta_hash_slot(delta_index->orig_address.block_address,
+                                      delta_index->orig_address.page_address) != a_entry_idx;
+#else
+    bool_t               is_superseded = FALSE;
+    pifs_size_t          i;
+
+    for (i = a_entry_idx + 1; i < pifs.delta_index_cnt && !is_superseded; i++)
+    {
+        is_superseded = (pifs.delta_index[i].orig_address.block_address == delta_index->orig_address.block_address
+                         && pifs.delta_index[i].orig_address.page_address == delta_index->orig_address.page_address);
+    }
+
+    return is_superseded;
+#endif
+}
+
+/**
+ * @brief pifs_is_delta_fold_needed Check if delta pages shall be folded into
+ * the map of files. Used entries of delta map are compared to
+ * PIFS_DELTA_FOLD_WATERMARK.
+ *
+ * @return TRUE: delta pages shall be folded.
+ */
+bool_t pifs_is_delta_fold_needed(void)
+{
+    return pifs.delta_map_page_is_read
+            && pifs.delta_index_cnt * 100u >= PIFS_DELTA_ENTRY_NUM * PIFS_DELTA_FOLD_WATERMARK;
+}
+
+/**
+ * @brief pifs_count_superseded_delta_entries Count entries of delta map
+ * which are superseded by a later entry of the same original page.
+ *
+ * @return Number of superseded entries.
+ */
+pifs_size_t pifs_count_superseded_delta_entries(void)
+{
+    pifs_size_t superseded_cnt = 0;
+    pifs_size_t i;
+
+    for (i = 0; i < pifs.delta_index_cnt; i++)
+    {
+        if (pifs_is_delta_index_superseded(i))
+        {
+            superseded_cnt++;
+        }
+    }
+
+    return superseded_cnt;
+}
+
+/**
+ * @brief pifs_release_delta_page Release delta entries of an original page.
+ * Map of file shall contain the actual page instead of original page.
+ * Entries are removed by pifs_compact_delta_map(), until that the page
+ * shall not be searched.
+ *
+ * @param[in] a_block_address Block address of original page.
+ * @param[in] a_page_address  Page address of original page.
+ */
+void pifs_release_delta_page(pifs_block_address_t a_block_address,
+                             pifs_page_address_t a_page_address)
+{
+    pifs_size_t i;
+    bool_t      found = FALSE;
+
+    /* Previous entries of the page are superseded by the latest one */
+    for (i = pifs.delta_index_cnt; i > 0 && !found; i--)
+    {
+        if (pifs.delta_index[i - 1].orig_address.block_address == a_block_address
+                && pifs.delta_index[i - 1].orig_address.page_address == a_page_address)
+        {
+            pifs.delta_index[i - 1].delta_address.block_address = PIFS_BLOCK_ADDRESS_INVALID;
+            pifs.delta_index[i - 1].delta_address.page_address = PIFS_PAGE_ADDRESS_INVALID;
+            found = TRUE;
+        }
+    }
+}
+
+/**
+ * @brief pifs_delta_walker_compact Program released entry of delta map to
+ * zero. Callback function for pifs_walk_delta_map().
+ *
+ * @param[in] a_block_address   Block address of delta map page.
+ * @param[in] a_page_address    Page address of delta map page.
+ * @param[in] a_page_offset     Offset of entry in delta map page.
+ * @param[in] a_delta_entry     Pointer to valid delta entry.
+ * @param[in] a_func_data       Pointer to index of entry in pifs.delta_index.
+ * @return PIFS_SUCCESS if entry was processed successfully.
+ */
+static pifs_status_t pifs_delta_walker_compact(pifs_block_address_t a_block_address,
+                                               pifs_page_address_t a_page_address,
+                                               pifs_page_offset_t a_page_offset,
+                                               pifs_delta_entry_t * a_delta_entry,
+                                               void * a_func_data)
+{
+    pifs_status_t ret = PIFS_SUCCESS;
+    pifs_size_t * entry_idx = (pifs_size_t*) a_func_data;
+
+    if (!PIFS_IS_DELTA_LINK_ENTRY(*a_delta_entry))
+    {
+        /* Entries of RAM index are in the same order */
+        PIFS_ASSERT(*entry_idx < pifs.delta_index_cnt);
+        if (pifs.delta_index[*entry_idx].delta_address.block_address == PIFS_BLOCK_ADDRESS_INVALID)
+        {
+            memset(a_delta_entry, PIFS_FLASH_PROGRAMMED_BYTE_VALUE, PIFS_DELTA_ENTRY_SIZE_BYTE);
+            ret = pifs_write(a_block_address, a_page_address, a_page_offset,
+                             a_delta_entry, PIFS_DELTA_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_DELTA_MAP);
+        }
+        (*entry_idx)++;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_compact_delta_map Release superseded entries and entries of
+ * folded pages. Released entries are programmed to zero in delta map and
+ * removed from RAM index, so more delta map pages can be chained.
+ * Entries of other pages are not changed.
+ *
+ * @param[in] a_header          File system's header to use.
+ * @return PIFS_SUCCESS if delta map was compacted successfully.
+ */
+pifs_status_t pifs_compact_delta_map(pifs_header_t * a_header)
+{
+    pifs_status_t      ret = PIFS_SUCCESS;
+    pifs_size_t        entry_idx = 0;
+    pifs_size_t        entry_cnt;
+    pifs_size_t        i;
+    pifs_delta_entry_t delta_entry;
+
+    if (!pifs.delta_map_page_is_read)
+    {
+        ret = pifs_read_delta_map_page(a_header);
+    }
+    if (ret == PIFS_SUCCESS)
+    {
+        for (i = 0; i < pifs.delta_index_cnt; i++)
+        {
+            if (pifs_is_delta_index_superseded(i))
+            {
+                pifs.delta_index[i].delta_address.block_address = PIFS_BLOCK_ADDRESS_INVALID;
+                pifs.delta_index[i].delta_address.page_address = PIFS_PAGE_ADDRESS_INVALID;
+            }
+        }
+        ret = pifs_walk_delta_map(a_header, pifs_delta_walker_compact, &entry_idx);
+    }
+    if (ret == PIFS_SUCCESS)
+    {
+        /* Rebuild RAM index from the remaining entries */
+        entry_cnt = pifs.delta_index_cnt;
+        pifs.delta_index_cnt = 0;
+#if PIFS_ENABLE_DELTA_HASH_INDEX
+        memset(pifs.delta_hash, 0xFF, sizeof(pifs.delta_hash));
+#endif
+#if PIFS_DELTA_FILTER_SIZE_BYTE
+        memset(pifs.delta_filter, 0, sizeof(pifs.delta_filter));
+#endif
+        for (i = 0; i < entry_cnt; i++)
+        {
+            if (pifs.delta_index[i].delta_address.block_address != PIFS_BLOCK_ADDRESS_INVALID)
+            {
+                delta_entry.orig_address = pifs.delta_index[i].orig_address;
+                delta_entry.delta_address = pifs.delta_index[i].delta_address;
+                pifs_add_delta_index(&delta_entry);
+            }
+        }
+        PIFS_NOTICE_MSG("%i of %i delta entries released\r\n",
+                        entry_cnt - pifs.delta_index_cnt, entry_cnt);
+    }
+    else
+    {
+        /* RAM index is read again from flash */
+        pifs.delta_map_page_is_read = FALSE;
+    }
+
+    return ret;
+}
+#endif
+
 /**
  * @brief pifs_append_delta_map_entry Add an entry to the delta map.
+ * If the last entry of the delta map is reached, a new delta map page is
+ * chained while entries of PIFS_DELTA_MAP_PAGE_NUM_MAX pages fit in RAM index.
+ * Superseded entries are released before if it is needed.
  *
  * @param[in] a_new_delta_entry Pointer to the new entry.
  * @return PIFS_SUCCESS if entry was added. PIFS_ERROR_NO_MORE_SPACE if map
@@ -182,41 +696,431 @@ static pifs_status_t pifs_append_delta_map_entry(pifs_delta_entry_t * a_new_delt
                                                  pifs_header_t * a_header)
 {
     pifs_status_t        ret = PIFS_SUCCESS;
-    pifs_size_t          i;
-    pifs_size_t          j;
-    pifs_delta_entry_t * delta_entry;
-    bool_t               delta_written = FALSE;
 
     if (!pifs.delta_map_page_is_read)
     {
         ret = pifs_read_delta_map_page(a_header);
     }
+#if PIFS_DELTA_MAP_CHAIN_ENABLED
+    if (ret == PIFS_SUCCESS
+            && pifs.delta_map_tail_entry_idx == PIFS_DELTA_ENTRY_PER_PAGE - 1
+            && pifs.delta_map_tail_page_idx == pifs.delta_map_page_cnt - 1)
+    {
+#if PIFS_DELTA_FOLD_WATERMARK
+        if (pifs.delta_index_cnt + PIFS_DELTA_ENTRY_PER_PAGE > PIFS_DELTA_ENTRY_NUM)
+        {
+            ret = pifs_compact_delta_map(a_header);
+        }
+#endif
+        if (ret == PIFS_SUCCESS
+                && pifs.delta_index_cnt + PIFS_DELTA_ENTRY_PER_PAGE <= PIFS_DELTA_ENTRY_NUM)
+        {
+            ret = pifs_chain_delta_map_page();
+            if (ret == PIFS_ERROR_NO_MORE_SPACE)
+            {
+                /* Management area is full, last entry is used for delta */
+                ret = PIFS_SUCCESS;
+            }
+        }
+    }
+#endif
+    if (ret == PIFS_SUCCESS)
+    {
+        if (pifs.delta_map_tail_entry_idx == PIFS_DELTA_ENTRY_PER_PAGE)
+        {
+            ret = PIFS_ERROR_NO_MORE_SPACE;
+        }
+        else
+        {
+            ret = pifs_write_delta_map_entry(a_new_delta_entry);
+        }
+    }
+    if (ret == PIFS_SUCCESS)
+    {
+        pifs_add_delta_index(a_new_delta_entry);
+    }
+
+    return ret;
+}
+
+#if PIFS_PATCH_LOG_PAGE_NUM
+/**
+ * @brief pifs_get_patch_entry_address Calculate address of a patch record.
+ *
+ * @param[in] a_entry_idx       Index of patch record in patch log.
+ * @param[out] a_block_address  Pointer to block address to fill.
+ * @param[out] a_page_address   Pointer to page address to fill.
+ * @param[out] a_page_offset    Pointer to page offset to fill.
+ * @param[in] a_header          File system's header to use.
+ * @return PIFS_SUCCESS if address was calculated successfully.
+ */
+static pifs_status_t pifs_get_patch_entry_address(pifs_size_t a_entry_idx,
+                                                  pifs_block_address_t * a_block_address,
+                                                  pifs_page_address_t * a_page_address,
+                                                  pifs_page_offset_t * a_page_offset,
+                                                  pifs_header_t * a_header)
+{
+    *a_block_address = a_header->patch_log_address.block_address;
+    *a_page_address = a_header->patch_log_address.page_address;
+    *a_page_offset = (a_entry_idx % PIFS_PATCH_ENTRY_PER_PAGE) * PIFS_PATCH_ENTRY_SIZE_BYTE;
+
+    return pifs_add_ba_pa(a_block_address, a_page_address, a_entry_idx / PIFS_PATCH_ENTRY_PER_PAGE);
+}
+
+/**
+ * @brief pifs_read_patch_entry Read a patch record from patch log.
+ *
+ * @param[in] a_entry_idx       Index of patch record in patch log.
+ * @param[out] a_patch_entry    Pointer to patch record to fill.
+ * @param[in] a_header          File system's header to use.
+ * @return PIFS_SUCCESS if record was read successfully.
+ */
+static pifs_status_t pifs_read_patch_entry(pifs_size_t a_entry_idx,
+                                           pifs_patch_entry_t * a_patch_entry,
+                                           pifs_header_t * a_header)
+{
+    pifs_status_t        ret;
+    pifs_block_address_t ba;
+    pifs_page_address_t  pa;
+    pifs_page_offset_t   po;
+
+    ret = pifs_get_patch_entry_address(a_entry_idx, &ba, &pa, &po, a_header);
     if (ret == PIFS_SUCCESS)
     {
-        for (i = 0; i < PIFS_DELTA_MAP_PAGE_NUM && !delta_written && ret == PIFS_SUCCESS; i++)
+        ret = pifs_read(ba, pa, po, a_patch_entry, PIFS_PATCH_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_DELTA_MAP);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_read_patch_log Read addresses of patched pages from patch log
+ * to RAM. Reading stops at the first erased record, which is the next record
+ * to write.
+ *
+ * @param[in] a_header          File system's header to use.
+ * @return PIFS_SUCCESS if patch log was read successfully.
+ */
+static pifs_status_t pifs_read_patch_log(pifs_header_t * a_header)
+{
+    pifs_status_t      ret = PIFS_SUCCESS;
+    pifs_patch_entry_t patch_entry;
+    pifs_checksum_t    checksum;
+    bool_t             is_erased = FALSE;
+
+    pifs.patch_entry_cnt = 0;
+    while (pifs.patch_entry_cnt < PIFS_PATCH_ENTRY_NUM && !is_erased && ret == PIFS_SUCCESS)
+    {
+        ret = pifs_read_patch_entry(pifs.patch_entry_cnt, &patch_entry, a_header);
+        if (ret == PIFS_SUCCESS)
+        {
+            is_erased = pifs_is_buffer_erased(&patch_entry, PIFS_PATCH_ENTRY_SIZE_BYTE);
+        }
+        if (ret == PIFS_SUCCESS && !is_erased)
         {
-            delta_entry = (pifs_delta_entry_t*) &pifs.delta_map_page_buf[i];
-            for (j = 0; j < PIFS_DELTA_ENTRY_PER_PAGE && !delta_written && ret == PIFS_SUCCESS; j++)
+            checksum = pifs_calc_checksum(&patch_entry, PIFS_PATCH_ENTRY_SIZE_BYTE - PIFS_CHECKSUM_SIZE_BYTE);
+            if (checksum == patch_entry.checksum)
             {
-                if (pifs_is_buffer_erased(&delta_entry[j], PIFS_DELTA_ENTRY_SIZE_BYTE))
+                pifs.patch_address[pifs.patch_entry_cnt] = patch_entry.address;
+            }
+            else
+            {
+                pifs.patch_address[pifs.patch_entry_cnt].block_address = PIFS_BLOCK_ADDRESS_INVALID;
+                pifs.patch_address[pifs.patch_entry_cnt].page_address = PIFS_PAGE_ADDRESS_INVALID;
+            }
+            pifs.patch_entry_cnt++;
+        }
+    }
+    if (ret == PIFS_SUCCESS)
+    {
+        pifs.patch_log_is_read = TRUE;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_get_patch_count Count patch records of a page.
+ *
+ * @param[in] a_block_address   Block address of page.
+ * @param[in] a_page_address    Page address of page.
+ * @param[out] a_patch_count    Pointer to number of patch records to fill.
+ * @param[in] a_header          File system's header to use.
+ * @return PIFS_SUCCESS if patch log was read successfully.
+ */
+static pifs_status_t pifs_get_patch_count(pifs_block_address_t a_block_address,
+                                          pifs_page_address_t a_page_address,
+                                          pifs_size_t * a_patch_count,
+                                          pifs_header_t * a_header)
+{
+    pifs_status_t ret = PIFS_SUCCESS;
+    pifs_size_t   i;
+
+    *a_patch_count = 0;
+    if (!pifs.patch_log_is_read)
+    {
+        ret = pifs_read_patch_log(a_header);
+    }
+    for (i = 0; i < pifs.patch_entry_cnt && ret == PIFS_SUCCESS; i++)
+    {
+        if (pifs.patch_address[i].block_address == a_block_address
+                && pifs.patch_address[i].page_address == a_page_address)
+        {
+            (*a_patch_count)++;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_apply_patch Apply patch records of a page to data read from
+ * the page. Records are applied in the order of writing.
+ *
+ * @param[in] a_block_address   Block address of page.
+ * @param[in] a_page_address    Page address of page.
+ * @param[in] a_page_offset     Offset of data in page.
+ * @param[in,out] a_buf         Pointer to data read from the page.
+ * @param[in] a_buf_size        Size of data.
+ * @param[in] a_header          File system's header to use.
+ * @return PIFS_SUCCESS if patch records were applied successfully.
+ */
+static pifs_status_t pifs_apply_patch(pifs_block_address_t a_block_address,
+                                      pifs_page_address_t a_page_address,
+                                      pifs_page_offset_t a_page_offset,
+                                      uint8_t * a_buf,
+                                      pifs_size_t a_buf_size,
+                                      pifs_header_t * a_header)
+{
+    pifs_status_t      ret = PIFS_SUCCESS;
+    pifs_patch_entry_t patch_entry;
+    pifs_size_t        i;
+    pifs_size_t        start;
+    pifs_size_t        end;
+
+    if (!pifs.patch_log_is_read)
+    {
+        ret = pifs_read_patch_log(a_header);
+    }
+    for (i = 0; i < pifs.patch_entry_cnt && ret == PIFS_SUCCESS; i++)
+    {
+        if (pifs.patch_address[i].block_address == a_block_address
+                && pifs.patch_address[i].page_address == a_page_address)
+        {
+            ret = pifs_read_patch_entry(i, &patch_entry, a_header);
+            if (ret == PIFS_SUCCESS)
+            {
+                /* Copy overlapping bytes */
+                start = PIFS_MAX(patch_entry.offset, a_page_offset);
+                end = PIFS_MIN(patch_entry.offset + patch_entry.size, a_page_offset + a_buf_size);
+                if (start < end)
                 {
-                    delta_entry[j] = *a_new_delta_entry;
-                    ret = pifs_write_delta_map_page(i, a_header);
-                    delta_written = TRUE;
+                    memcpy(&a_buf[start - a_page_offset], &patch_entry.data[start - patch_entry.offset],
+                           end - start);
                 }
             }
         }
-        if (!delta_written)
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_write_patch Write changed bytes of a page as a patch record.
+ * pifs.dmw_page_buf shall contain the actual content of the page.
+ * If the changed bytes do not fit in a record, the page has too many records
+ * or patch log is full, nothing is written.
+ *
+ * @param[in] a_block_address   Block address of page.
+ * @param[in] a_page_address    Page address of page.
+ * @param[in] a_page_offset     Offset in page.
+ * @param[in] a_buf             Pointer to buffer to write.
+ * @param[in] a_buf_size        Size of buffer.
+ * @param[in] a_patch_count     Number of patch records of the page.
+ * @param[out] a_is_patched     TRUE: page is up to date. FALSE: page shall be copied.
+ * @param[in] a_header          File system's header to use.
+ * @return PIFS_SUCCESS if no error occurred.
+ */
+static pifs_status_t pifs_write_patch(pifs_block_address_t a_block_address,
+                                      pifs_page_address_t a_page_address,
+                                      pifs_page_offset_t a_page_offset,
+                                      const uint8_t * a_buf,
+                                      pifs_size_t a_buf_size,
+                                      pifs_size_t a_patch_count,
+                                      bool_t * a_is_patched,
+                                      pifs_header_t * a_header)
+{
+    pifs_status_t        ret = PIFS_SUCCESS;
+    pifs_patch_entry_t   patch_entry;
+    const uint8_t      * page_buf = &pifs.dmw_page_buf[a_page_offset];
+    pifs_size_t          first = 0;
+    pifs_size_t          last = a_buf_size;
+    pifs_block_address_t ba;
+    pifs_page_address_t  pa;
+    pifs_page_offset_t   po;
+
+    *a_is_patched = FALSE;
+    /* Find range of changed bytes */
+    while (first < a_buf_size && page_buf[first] == a_buf[first])
+    {
+        first++;
+    }
+    while (last > first && page_buf[last - 1] == a_buf[last - 1])
+    {
+        last--;
+    }
+    if (first == last)
+    {
+        /* Content is not changed */
+        *a_is_patched = TRUE;
+    }
+    else if (last - first <= PIFS_PATCH_DATA_SIZE_BYTE
+             && a_patch_count < PIFS_PATCH_PER_PAGE_MAX
+             && pifs.patch_entry_cnt < PIFS_PATCH_ENTRY_NUM)
+    {
+        memset(&patch_entry, PIFS_FLASH_ERASED_BYTE_VALUE, PIFS_PATCH_ENTRY_SIZE_BYTE);
+        patch_entry.address.block_address = a_block_address;
+        patch_entry.address.page_address = a_page_address;
+        patch_entry.offset = a_page_offset + first;
+        patch_entry.size = last - first;
+        memcpy(patch_entry.data, &a_buf[first], last - first);
+        patch_entry.checksum = pifs_calc_checksum(&patch_entry, PIFS_PATCH_ENTRY_SIZE_BYTE - PIFS_CHECKSUM_SIZE_BYTE);
+        ret = pifs_get_patch_entry_address(pifs.patch_entry_cnt, &ba, &pa, &po, a_header);
+        if (ret == PIFS_SUCCESS)
         {
-            ret = PIFS_ERROR_NO_MORE_SPACE;
+            /* Record is erased, it does not need to be read */
+            ret = pifs_write_erased(ba, pa, po, &patch_entry, PIFS_PATCH_ENTRY_SIZE_BYTE,
+                                    PIFS_CACHE_CLASS_DELTA_MAP);
+        }
+        if (ret == PIFS_SUCCESS)
+        {
+            PIFS_DEBUG_MSG("patch %s offset: %i size: %i\r\n",
+                           pifs_ba_pa2str(a_block_address, a_page_address),
+                           patch_entry.offset, patch_entry.size);
+            pifs.patch_address[pifs.patch_entry_cnt] = patch_entry.address;
+            pifs.patch_entry_cnt++;
+            *a_is_patched = TRUE;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_drop_patch Forget patch records of a page which was copied.
+ * Records remain in the patch log until the next merge.
+ *
+ * @param[in] a_block_address   Block address of page.
+ * @param[in] a_page_address    Page address of page.
+ */
+static void pifs_drop_patch(pifs_block_address_t a_block_address,
+                            pifs_page_address_t a_page_address)
+{
+    pifs_size_t i;
+
+    for (i = 0; i < pifs.patch_entry_cnt; i++)
+    {
+        if (pifs.patch_address[i].block_address == a_block_address
+                && pifs.patch_address[i].page_address == a_page_address)
+        {
+            pifs.patch_address[i].block_address = PIFS_BLOCK_ADDRESS_INVALID;
+            pifs.patch_address[i].page_address = PIFS_PAGE_ADDRESS_INVALID;
         }
     }
+}
+
+/**
+ * @brief pifs_copy_patch_log Copy patch records of used pages from old
+ * management blocks to new ones. Records of released pages are dropped.
+ * Free space bitmap of new management blocks shall be ready.
+ *
+ * @param[in] a_old_header Pointer to old header.
+ * @param[in] a_new_header Pointer to new header.
+ * @return PIFS_SUCCESS if copy was successful.
+ */
+pifs_status_t pifs_copy_patch_log(pifs_header_t * a_old_header, pifs_header_t * a_new_header)
+{
+    pifs_status_t        ret = PIFS_SUCCESS;
+    pifs_patch_entry_t   patch_entry;
+    pifs_checksum_t      checksum;
+    pifs_size_t          i;
+    pifs_size_t          j = 0;
+    bool_t               is_erased = FALSE;
+    pifs_block_address_t ba;
+    pifs_page_address_t  pa;
+    pifs_page_offset_t   po;
+
+    for (i = 0; i < PIFS_PATCH_ENTRY_NUM && !is_erased && ret == PIFS_SUCCESS; i++)
+    {
+        ret = pifs_read_patch_entry(i, &patch_entry, a_old_header);
+        if (ret == PIFS_SUCCESS)
+        {
+            is_erased = pifs_is_buffer_erased(&patch_entry, PIFS_PATCH_ENTRY_SIZE_BYTE);
+        }
+        if (ret == PIFS_SUCCESS && !is_erased)
+        {
+            checksum = pifs_calc_checksum(&patch_entry, PIFS_PATCH_ENTRY_SIZE_BYTE - PIFS_CHECKSUM_SIZE_BYTE);
+            if (checksum == patch_entry.checksum
+                    && !pifs_is_page_free(patch_entry.address.block_address,
+                                          patch_entry.address.page_address)
+                    && !pifs_is_page_to_be_released(patch_entry.address.block_address,
+                                                    patch_entry.address.page_address))
+            {
+                ret = pifs_get_patch_entry_address(j, &ba, &pa, &po, a_new_header);
+                if (ret == PIFS_SUCCESS)
+                {
+                    ret = pifs_write_erased(ba, pa, po, &patch_entry, PIFS_PATCH_ENTRY_SIZE_BYTE,
+                                            PIFS_CACHE_CLASS_DELTA_MAP);
+                }
+                j++;
+            }
+        }
+    }
+    PIFS_NOTICE_MSG("%i of %i patch records copied\r\n", j, i);
+
+    return ret;
+}
+#endif
+
+/**
+ * @brief pifs_read_dmw_page Read actual content of a page to
+ * pifs.dmw_page_buf. Patch records of the page are applied.
+ *
+ * @param[in] a_block_address   Block address of page.
+ * @param[in] a_page_address    Page address of page.
+ * @param[out] a_patch_count    Pointer to number of patch records to fill.
+ * @param[in] a_header          File system's header to use.
+ * @return PIFS_SUCCESS if page was read successfully.
+ */
+static pifs_status_t pifs_read_dmw_page(pifs_block_address_t a_block_address,
+                                        pifs_page_address_t a_page_address,
+                                        pifs_size_t * a_patch_count,
+                                        pifs_header_t * a_header)
+{
+    pifs_status_t ret;
+
+    *a_patch_count = 0;
+    ret = pifs_read(a_block_address, a_page_address, 0, &pifs.dmw_page_buf,
+                    PIFS_LOGICAL_PAGE_SIZE_BYTE, PIFS_CACHE_CLASS_DATA);
+#if PIFS_PATCH_LOG_PAGE_NUM
+    if (ret == PIFS_SUCCESS)
+    {
+        ret = pifs_get_patch_count(a_block_address, a_page_address, a_patch_count, a_header);
+    }
+    if (ret == PIFS_SUCCESS && *a_patch_count)
+    {
+        ret = pifs_apply_patch(a_block_address, a_page_address, 0, pifs.dmw_page_buf,
+                               PIFS_LOGICAL_PAGE_SIZE_BYTE, a_header);
+    }
+#else
+    (void) a_header;
+#endif
 
     return ret;
 }
 
 /**
- * @brief pifs_read_delta  Cached read with delta page handling.
+ * @brief pifs_read_delta  Cached read with delta page and patch record handling.
  *
  * @param[in] a_block_address   Block address of page to read.
  * @param[in] a_page_address    Page address of page to read.
@@ -236,8 +1140,7 @@ pifs_status_t pifs_read_delta(pifs_block_address_t a_block_address,
     pifs_block_address_t ba;
     pifs_page_address_t  pa;
 
-    ret = pifs_find_delta_page(a_block_address, a_page_address, &ba, &pa, NULL,
-                               &pifs.header);
+    ret = pifs_find_delta_page_to_read(a_block_address, a_page_address, &ba, &pa);
     if (ret == PIFS_SUCCESS)
     {
         if (a_block_address != ba
@@ -245,12 +1148,97 @@ pifs_status_t pifs_read_delta(pifs_block_address_t a_block_address,
         {
             PIFS_NOTICE_MSG("%s\r\n", pifs_ba_pa2str(ba, pa));
         }
-        ret = pifs_read(ba, pa, a_page_offset, a_buf, a_buf_size);
+        ret = pifs_read(ba, pa, a_page_offset, a_buf, a_buf_size, PIFS_CACHE_CLASS_DATA);
+    }
+#if PIFS_PATCH_LOG_PAGE_NUM
+    if (ret == PIFS_SUCCESS && a_buf)
+    {
+        ret = pifs_apply_patch(ba, pa, a_page_offset, a_buf, a_buf_size, &pifs.header);
     }
+#endif
 
     return ret;
 }
 
+#if PIFS_FLASH_MULTI_PAGE_ENABLED
+/**
+ * @brief pifs_read_delta_multi Read consecutive full pages of a block with
+ * delta page handling. Pages without delta page are read together.
+ *
+ * @param[in] a_block_address   Block address of first page to read.
+ * @param[in] a_page_address    Page address of first page to read.
+ * @param[out] a_buf            Pointer to buffer to fill.
+ * @param[in] a_page_count      Number of logical pages to read.
+ * @return PIFS_SUCCESS if data read successfully.
+ */
+pifs_status_t pifs_read_delta_multi(pifs_block_address_t a_block_address,
+                                    pifs_page_address_t a_page_address,
+                                    void * const a_buf,
+                                    pifs_size_t a_page_count)
+{
+    pifs_status_t        ret = PIFS_SUCCESS;
+    uint8_t            * buf = (uint8_t*) a_buf;
+    pifs_block_address_t ba = a_block_address;
+    pifs_page_address_t  pa = a_page_address;
+    pifs_size_t          run_page_count;
+    bool_t               is_delta = FALSE;
+#if PIFS_PATCH_LOG_PAGE_NUM
+    pifs_size_t          i;
+#endif
+
+    while (a_page_count && ret == PIFS_SUCCESS)
+    {
+        /* Count pages which are not replaced by delta pages */
+        run_page_count = 0;
+        is_delta = FALSE;
+        while (run_page_count < a_page_count && !is_delta && ret == PIFS_SUCCESS)
+        {
+            ret = pifs_find_delta_page_to_read(a_block_address, a_page_address + run_page_count,
+                                               &ba, &pa);
+            if (ret == PIFS_SUCCESS)
+            {
+                is_delta = (a_block_address != ba || a_page_address + run_page_count != pa);
+                if (!is_delta)
+                {
+                    run_page_count++;
+                }
+            }
+        }
+        if (ret == PIFS_SUCCESS && run_page_count)
+        {
+            ret = pifs_read_multi(a_block_address, a_page_address, buf, run_page_count);
+        }
+#if PIFS_PATCH_LOG_PAGE_NUM
+        for (i = 0; i < run_page_count && ret == PIFS_SUCCESS; i++)
+        {
+            ret = pifs_apply_patch(a_block_address, a_page_address + i,
+                                   0, &buf[i * PIFS_LOGICAL_PAGE_SIZE_BYTE],
+                                   PIFS_LOGICAL_PAGE_SIZE_BYTE, &pifs.header);
+        }
+#endif
+        if (ret == PIFS_SUCCESS && is_delta)
+        {
+            PIFS_NOTICE_MSG("%s\r\n", pifs_ba_pa2str(ba, pa));
+            ret = pifs_read(ba, pa, 0, &buf[run_page_count * PIFS_LOGICAL_PAGE_SIZE_BYTE],
+                            PIFS_LOGICAL_PAGE_SIZE_BYTE, PIFS_CACHE_CLASS_DATA);
+#if PIFS_PATCH_LOG_PAGE_NUM
+            if (ret == PIFS_SUCCESS)
+            {
+                ret = pifs_apply_patch(ba, pa, 0, &buf[run_page_count * PIFS_LOGICAL_PAGE_SIZE_BYTE],
+                                       PIFS_LOGICAL_PAGE_SIZE_BYTE, &pifs.header);
+            }
+#endif
+            run_page_count++;
+        }
+        a_page_address += run_page_count;
+        buf += run_page_count * PIFS_LOGICAL_PAGE_SIZE_BYTE;
+        a_page_count -= run_page_count;
+    }
+
+    return ret;
+}
+#endif
+
 /**
  * @brief pifs_write  Cached write with delta page handling.
  * Note: marks written page as used!
@@ -282,18 +1270,30 @@ pifs_status_t pifs_write_delta(pifs_block_address_t a_block_address,
     pifs_page_address_t  fpa;
     pifs_page_count_t    page_count_found;
     bool_t               is_delta_map_full;
+    bool_t               is_free = FALSE;
+    pifs_size_t          patch_count = 0;
+#if PIFS_PATCH_LOG_PAGE_NUM
+    bool_t               is_patched = FALSE;
+#endif
 
     ret = pifs_find_delta_page(a_block_address, a_page_address, &ba, &pa, &is_delta_map_full, a_header);
     if (ret == PIFS_SUCCESS)
     {
-        /* Read to page buffer */
-        ret = pifs_read(ba, pa, 0, &pifs.dmw_page_buf, PIFS_LOGICAL_PAGE_SIZE_BYTE);
+        /* Free pages are erased, they do not need to be read and checked */
+        is_free = pifs_is_page_free(ba, pa);
+        if (!is_free)
+        {
+            /* Read to page buffer */
+            ret = pifs_read_dmw_page(ba, pa, &patch_count, a_header);
+        }
     }
     /* TODO more safe to write ALWAYS delta page! */
-    if (ret == PIFS_SUCCESS)
+    if (ret == PIFS_SUCCESS && !is_free)
     {
-        delta_needed = !pifs_is_buffer_programmable(&pifs.dmw_page_buf[a_page_offset],
-                                                    a_buf, a_buf_size);
+        /* Patched bytes cannot be programmed in place */
+        delta_needed = patch_count
+                || !pifs_is_buffer_programmable(&pifs.dmw_page_buf[a_page_offset],
+                                                a_buf, a_buf_size);
     }
     if (ret == PIFS_SUCCESS)
     {
@@ -304,46 +1304,74 @@ pifs_status_t pifs_write_delta(pifs_block_address_t a_block_address,
             {
                 *a_is_delta = TRUE;
             }
-            if (is_delta_map_full)
+#if PIFS_PATCH_LOG_PAGE_NUM
+            if (pifs_is_block_type(ba, PIFS_BLOCK_TYPE_DATA, a_header))
             {
-                PIFS_WARNING_MSG("Management blocks shall be merged!\r\n");
-                ret = pifs_merge();
+                /* Small changes are stored in patch log */
+                ret = pifs_write_patch(ba, pa, a_page_offset, a_buf, a_buf_size,
+                                       patch_count, &is_patched, a_header);
             }
-            if (ret == PIFS_SUCCESS)
+            if (ret == PIFS_SUCCESS && !is_patched)
+#endif
             {
-                ret = pifs_find_free_page_wl(1, 1, PIFS_BLOCK_TYPE_DATA,
-                                             &fba, &fpa, &page_count_found);
-            }
-            if (ret == PIFS_SUCCESS)
-            {
-                PIFS_DEBUG_MSG("free page %s\r\n", pifs_ba_pa2str(fba, fpa));
-
-                delta_entry.orig_address.block_address = a_block_address;
-                delta_entry.orig_address.page_address = a_page_address;
-                delta_entry.delta_address.block_address = fba;
-                delta_entry.delta_address.page_address = fpa;
-                delta_entry.checksum = pifs_calc_checksum(&delta_entry, PIFS_DELTA_ENTRY_SIZE_BYTE - PIFS_CHECKSUM_SIZE_BYTE);
-                PIFS_DEBUG_MSG("delta page %s -> ",
-                               pifs_ba_pa2str(a_block_address, a_page_address));
-                PIFS_DEBUG_MSG("%s\r\n",
-                               pifs_ba_pa2str(fba, fpa));
-                ret = pifs_write(fba, fpa, a_page_offset, a_buf, PIFS_LOGICAL_PAGE_SIZE_BYTE);
-                if (ret == PIFS_SUCCESS)
+                if (is_delta_map_full)
                 {
-                    ret = pifs_append_delta_map_entry(&delta_entry, a_header);
+                    PIFS_WARNING_MSG("Management blocks shall be merged!\r\n");
+                    ret = pifs_merge();
+                    if (ret == PIFS_SUCCESS)
+                    {
+                        /* Merge replaced the original page with the actual */
+                        /* page in the map of file and used the page buffer */
+                        a_block_address = ba;
+                        a_page_address = pa;
+                        ret = pifs_read_dmw_page(ba, pa, &patch_count, a_header);
+                    }
                 }
                 if (ret == PIFS_SUCCESS)
                 {
-                    /* Mark new page as used */
-                    ret = pifs_mark_page(fba, fpa, 1, TRUE, FALSE);
-                    PIFS_DEBUG_MSG("Mark page %s as used: %i\r\n", pifs_ba_pa2str(fba, fpa), ret);
+                    ret = pifs_find_free_page_wl(1, 1, PIFS_BLOCK_TYPE_DATA,
+                                                 &fba, &fpa, &page_count_found);
                 }
                 if (ret == PIFS_SUCCESS)
                 {
-                    /* Mark old page (original or previous delta)
-                     * as to be released */
-                    ret = pifs_mark_page(ba, pa, 1, FALSE, TRUE);
-                    PIFS_DEBUG_MSG("Mark page %s as to be released: %i\r\n", pifs_ba_pa2str(a_block_address, a_page_address), ret);
+                    PIFS_DEBUG_MSG("free page %s\r\n", pifs_ba_pa2str(fba, fpa));
+
+                    delta_entry.orig_address.block_address = a_block_address;
+                    delta_entry.orig_address.page_address = a_page_address;
+                    delta_entry.delta_address.block_address = fba;
+                    delta_entry.delta_address.page_address = fpa;
+                    delta_entry.checksum = pifs_calc_checksum(&delta_entry, PIFS_DELTA_ENTRY_SIZE_BYTE - PIFS_CHECKSUM_SIZE_BYTE);
+                    PIFS_DEBUG_MSG("delta page %s -> ",
+                                   pifs_ba_pa2str(a_block_address, a_page_address));
+                    PIFS_DEBUG_MSG("%s\r\n",
+                                   pifs_ba_pa2str(fba, fpa));
+                    /* New page contains the actual page with the new data */
+                    memcpy(&pifs.dmw_page_buf[a_page_offset], a_buf, a_buf_size);
+                    ret = pifs_write(fba, fpa, 0, &pifs.dmw_page_buf, PIFS_LOGICAL_PAGE_SIZE_BYTE, PIFS_CACHE_CLASS_DATA);
+                    if (ret == PIFS_SUCCESS)
+                    {
+                        ret = pifs_append_delta_map_entry(&delta_entry, a_header);
+                    }
+                    if (ret == PIFS_SUCCESS)
+                    {
+                        /* Mark new page as used */
+                        ret = pifs_mark_page(fba, fpa, 1, TRUE, FALSE);
+                        PIFS_DEBUG_MSG("Mark page %s as used: %i\r\n", pifs_ba_pa2str(fba, fpa), ret);
+                    }
+                    if (ret == PIFS_SUCCESS)
+                    {
+                        /* Mark old page (original or previous delta)
+                         * as to be released */
+                        ret = pifs_mark_page(ba, pa, 1, FALSE, TRUE);
+                        PIFS_DEBUG_MSG("Mark page %s as to be released: %i\r\n", pifs_ba_pa2str(a_block_address, a_page_address), ret);
+                    }
+#if PIFS_PATCH_LOG_PAGE_NUM
+                    if (ret == PIFS_SUCCESS && patch_count)
+                    {
+                        /* Patch records are copied to the new page */
+                        pifs_drop_patch(ba, pa);
+                    }
+#endif
                 }
             }
         }
@@ -354,8 +1382,9 @@ pifs_status_t pifs_write_delta(pifs_block_address_t a_block_address,
             {
                 *a_is_delta = FALSE;
             }
-            ret = pifs_write(ba, pa, a_page_offset, a_buf, a_buf_size);
-            if (ret == PIFS_SUCCESS && pifs_is_page_free(ba, pa))
+            /* Target bytes are erased or checked to be programmable */
+            ret = pifs_write_erased(ba, pa, a_page_offset, a_buf, a_buf_size, PIFS_CACHE_CLASS_DATA);
+            if (ret == PIFS_SUCCESS && is_free)
             {
                 /* Mark new page as used */
                 ret = pifs_mark_page(ba, pa, 1, TRUE, FALSE);
@@ -367,12 +1396,13 @@ pifs_status_t pifs_write_delta(pifs_block_address_t a_block_address,
 }
 
 /**
- * @brief pifs_reset_delta Reset buffer of delta map.
+ * @brief pifs_reset_delta Reset RAM index of delta map and patch log. They
+ * will be read again at next access.
  */
 void pifs_reset_delta(void)
 {
-    memset(pifs.delta_map_page_buf, PIFS_FLASH_ERASED_BYTE_VALUE,
-           PIFS_DELTA_MAP_PAGE_NUM * PIFS_LOGICAL_PAGE_SIZE_BYTE);
-    pifs.delta_map_page_is_dirty = FALSE;
     pifs.delta_map_page_is_read = FALSE;
+#if PIFS_PATCH_LOG_PAGE_NUM
+    pifs.patch_log_is_read = FALSE;
+#endif
 }
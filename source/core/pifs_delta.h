@@ -34,6 +34,29 @@
 extern "C" {
 #endif
 
+/**
+ * @brief pifs_delta_walker_func_t
+ * Callback function which is called for every valid entry of delta map,
+ * including link entries.
+ *
+ * @param[in] a_block_address   Block address of delta map page.
+ * @param[in] a_page_address    Page address of delta map page.
+ * @param[in] a_page_offset     Offset of entry in delta map page.
+ * @param[in] a_delta_entry     Pointer to delta entry.
+ * @param[in] a_func_data       User data.
+ *
+ * @return PIFS_SUCCESS if entry processed successfully.
+ */
+typedef pifs_status_t (*pifs_delta_walker_func_t)(pifs_block_address_t a_block_address,
+                                                  pifs_page_address_t a_page_address,
+                                                  pifs_page_offset_t a_page_offset,
+                                                  pifs_delta_entry_t * a_delta_entry,
+                                                  void * a_func_data);
+
+pifs_status_t pifs_walk_delta_map(pifs_header_t * a_header,
+                                  pifs_delta_walker_func_t a_delta_walker_func,
+                                  void * a_func_data);
+pifs_status_t pifs_read_delta_map_page(pifs_header_t * a_header);
 pifs_status_t pifs_find_delta_page(pifs_block_address_t a_block_address,
                                    pifs_page_address_t a_page_address,
                                    pifs_block_address_t * a_delta_block_address,
@@ -45,6 +68,12 @@ pifs_status_t pifs_read_delta(pifs_block_address_t a_block_address,
                               pifs_page_offset_t a_page_offset,
                               void * const a_buf,
                               pifs_size_t a_buf_size);
+#if PIFS_FLASH_MULTI_PAGE_ENABLED
+pifs_status_t pifs_read_delta_multi(pifs_block_address_t a_block_address,
+                                    pifs_page_address_t a_page_address,
+                                    void * const a_buf,
+                                    pifs_size_t a_page_count);
+#endif
 pifs_status_t pifs_write_delta(pifs_block_address_t a_block_address,
                                pifs_page_address_t a_page_address,
                                pifs_page_offset_t a_page_offset,
@@ -53,6 +82,16 @@ pifs_status_t pifs_write_delta(pifs_block_address_t a_block_address,
                                bool_t * a_is_delta,
                                pifs_header_t * a_header);
 void pifs_reset_delta(void);
+#if PIFS_DELTA_FOLD_WATERMARK
+bool_t pifs_is_delta_fold_needed(void);
+pifs_size_t pifs_count_superseded_delta_entries(void);
+void pifs_release_delta_page(pifs_block_address_t a_block_address,
+                             pifs_page_address_t a_page_address);
+pifs_status_t pifs_compact_delta_map(pifs_header_t * a_header);
+#endif
+#if PIFS_PATCH_LOG_PAGE_NUM
+pifs_status_t pifs_copy_patch_log(pifs_header_t * a_old_header, pifs_header_t * a_new_header);
+#endif
 
 #ifdef __cplusplus
 }
@@ -552,7 +552,7 @@ pifs_dirent_t * pifs_internal_readdir(pifs_dir_t * a_dirp)
         ret = pifs_read(dir->entry_list_address.block_address,
                         dir->entry_list_address.page_address,
                         dir->entry_list_index * PIFS_ENTRY_SIZE_BYTE, entry,
-                        PIFS_ENTRY_SIZE_BYTE);
+                        PIFS_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_ENTRY_LIST);
         if (ret == PIFS_SUCCESS)
         {
             if (!pifs_is_entry_deleted(entry))
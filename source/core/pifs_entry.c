@@ -65,7 +65,7 @@ pifs_status_t pifs_read_entry(pifs_block_address_t a_entry_list_block_address,
                           PIFS_ENTRY_SIZE_BYTE);
 #else
     ret = pifs_read(ba, pa, a_entry_idx * PIFS_ENTRY_SIZE_BYTE, a_entry,
-                    PIFS_ENTRY_SIZE_BYTE);
+                    PIFS_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_ENTRY_LIST);
 #endif
     if (ret == PIFS_SUCCESS)
     {
@@ -115,7 +115,7 @@ pifs_status_t pifs_write_entry(pifs_block_address_t a_entry_list_block_address,
                           PIFS_ENTRY_SIZE_BYTE);
 #else
     ret = pifs_write(ba, pa, a_entry_idx * PIFS_ENTRY_SIZE_BYTE, a_entry,
-                    PIFS_ENTRY_SIZE_BYTE);
+                    PIFS_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_ENTRY_LIST);
 #endif
 
     return ret;
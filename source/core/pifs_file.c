@@ -109,8 +109,26 @@ pifs_status_t pifs_internal_open(pifs_file_t * a_file,
     a_file->rw_address.block_address = PIFS_BLOCK_ADDRESS_INVALID;
     a_file->rw_address.page_address = PIFS_PAGE_ADDRESS_INVALID;
     a_file->rw_pos = 0;
+#if PIFS_READ_AHEAD_PAGE_NUM_MAX
+    a_file->ra_pos = 0;
+    a_file->ra_page_count = 0;
+    a_file->ra_page_end = 0;
+#endif
+#if PIFS_FILE_RESERVE_PAGE_NUM
+    a_file->reserved_page_count = 0;
+    a_file->is_appended = FALSE;
+#endif
+#if PIFS_FILE_EXTENT_NUM_MAX
+    a_file->extent_is_read = FALSE;
+#endif
     a_file->actual_map_address.block_address = PIFS_BLOCK_ADDRESS_INVALID;
     a_file->actual_map_address.page_address = PIFS_PAGE_ADDRESS_INVALID;
+#if PIFS_ENABLE_MAP_COALESCE
+    a_file->is_map_entry_pending = FALSE;
+#endif
+#if PIFS_DELTA_FOLD_WATERMARK
+    a_file->delta_entry_cnt = 0;
+#endif
     a_file->is_entry_changed = FALSE;
     if (a_modes)
     {
@@ -382,6 +400,182 @@ pifs_status_t pifs_inc_rw_address(pifs_file_t * a_file, bool_t a_is_read)
     return a_file->status;
 }
 
+/**
+ * @brief pifs_dec_rw_address Decrement read/write address for file.
+ * Reverse of pifs_inc_rw_address(), previous map entry is read when the
+ * first page of actual map entry is passed.
+ *
+ * @param[in] a_file    Pointer to the internal file structure.
+ */
+pifs_status_t pifs_dec_rw_address(pifs_file_t * a_file)
+{
+    if (a_file->rw_page_count < a_file->map_entry.page_count)
+    {
+        a_file->rw_page_count++;
+        a_file->status = pifs_dec_address(&a_file->rw_address);
+    }
+    else
+    {
+        a_file->status = pifs_read_prev_map_entry(a_file);
+        if (a_file->status == PIFS_SUCCESS)
+        {
+            /* Last page of previous map entry */
+            a_file->rw_address = a_file->map_entry.address;
+            a_file->rw_page_count = 1;
+            a_file->status = pifs_add_address(&a_file->rw_address, a_file->map_entry.page_count - 1);
+        }
+    }
+
+    return a_file->status;
+}
+
+#if PIFS_FILE_RESERVE_PAGE_NUM
+/**
+ * @brief pifs_is_append_interleaved Check if another file got new data
+ * pages since the last append of the file. In this case pages of the files
+ * would interleave. Files which are only opened for writing (e.g. source of
+ * pifs_copy()) or do not append in turn (e.g. copy of static wear leveling
+ * during an other file's write) do not interleave.
+ *
+ * @param[in] a_file Pointer to the internal file structure.
+ * @return TRUE: appended pages of files interleave.
+ */
+static bool_t pifs_is_append_interleaved(pifs_file_t * a_file)
+{
+    pifs_file_t * last_file = pifs.last_appended_file;
+
+    return (a_file->is_appended
+            && last_file
+            && last_file != a_file
+            && last_file->is_opened
+            && last_file->is_appended);
+}
+
+/**
+ * @brief pifs_get_reserved_pages Get pages from reservation window of file.
+ * Reservation window is allocated when files are appended in turn, so
+ * appended pages of the file remain contiguous.
+ *
+ * @param[in] a_file            Pointer to the internal file structure.
+ * @param[in] a_page_count_needed Number of pages to write.
+ * @param[out] a_block_address  Block address of first page.
+ * @param[out] a_page_address   Page address of first page.
+ * @param[out] a_page_count_found Number of pages got.
+ * @param[out] a_is_reserved    TRUE: pages got from reservation window,
+ *                              FALSE: pages shall be found by caller.
+ * @return PIFS_SUCCESS if pages got or reservation is not used.
+ */
+static pifs_status_t pifs_get_reserved_pages(pifs_file_t * a_file,
+                                             pifs_page_count_t a_page_count_needed,
+                                             pifs_block_address_t * a_block_address,
+                                             pifs_page_address_t * a_page_address,
+                                             pifs_page_count_t * a_page_count_found,
+                                             bool_t * a_is_reserved)
+{
+    pifs_status_t        ret = PIFS_SUCCESS;
+    pifs_block_address_t ba = PIFS_BLOCK_ADDRESS_INVALID;
+    pifs_page_address_t  pa = PIFS_PAGE_ADDRESS_INVALID;
+    pifs_page_count_t    page_count_found = 0;
+    pifs_page_count_t    page_count_desired = PIFS_MAX(a_page_count_needed, PIFS_FILE_RESERVE_PAGE_NUM);
+    pifs_page_count_t    i;
+
+    *a_is_reserved = FALSE;
+    if (!a_file->reserved_page_count && pifs_is_append_interleaved(a_file))
+    {
+        /* Find pages in the previous data block */
+        ret = pifs_find_page(1, page_count_desired, PIFS_BLOCK_TYPE_DATA,
+                             TRUE, FALSE, a_file->map_entry.address.block_address,
+                             &ba, &pa, &page_count_found);
+        if (ret == PIFS_ERROR_NO_MORE_SPACE
+                || ba != a_file->map_entry.address.block_address)
+        {
+            ret = pifs_find_free_page_wl(1, page_count_desired, PIFS_BLOCK_TYPE_DATA,
+                                         &ba, &pa, &page_count_found);
+        }
+        if (ret == PIFS_SUCCESS)
+        {
+            /* Pages are claimed, other files cannot allocate them */
+            ret = pifs_mark_page(ba, pa, page_count_found, TRUE, FALSE);
+        }
+        if (ret == PIFS_SUCCESS)
+        {
+            PIFS_DEBUG_MSG("%u pages reserved at %s\r\n", page_count_found, pifs_ba_pa2str(ba, pa));
+            a_file->reserved_address.block_address = ba;
+            a_file->reserved_address.page_address = pa;
+            a_file->reserved_page_count = page_count_found;
+        }
+    }
+    if (ret == PIFS_SUCCESS && a_file->reserved_page_count)
+    {
+        *a_block_address = a_file->reserved_address.block_address;
+        *a_page_address = a_file->reserved_address.page_address;
+        *a_page_count_found = PIFS_MIN(a_page_count_needed, a_file->reserved_page_count);
+        *a_is_reserved = TRUE;
+        a_file->reserved_page_count -= *a_page_count_found;
+        for (i = 0; i < *a_page_count_found && a_file->reserved_page_count && ret == PIFS_SUCCESS; i++)
+        {
+            ret = pifs_inc_address(&a_file->reserved_address);
+        }
+    }
+    a_file->is_appended = TRUE;
+    pifs.last_appended_file = a_file;
+
+    return ret;
+}
+
+/**
+ * @brief pifs_release_reserved_pages Release unused pages of reservation
+ * window. Pages are marked to be released, they will be free after merge.
+ *
+ * @param[in] a_file Pointer to the internal file structure.
+ * @return PIFS_SUCCESS if pages released successfully.
+ */
+static pifs_status_t pifs_release_reserved_pages(pifs_file_t * a_file)
+{
+    pifs_status_t ret = PIFS_SUCCESS;
+
+    if (a_file->reserved_page_count)
+    {
+        ret = pifs_mark_page(a_file->reserved_address.block_address,
+                             a_file->reserved_address.page_address,
+                             a_file->reserved_page_count, FALSE, TRUE);
+        a_file->reserved_page_count = 0;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_is_page_reserved Check if page is in reservation window of an
+ * opened file. Used during file system check.
+ *
+ * @param[in] a_block_address Block address of page.
+ * @param[in] a_page_address  Page address of page.
+ * @return TRUE: page is reserved.
+ */
+bool_t pifs_is_page_reserved(pifs_block_address_t a_block_address,
+                             pifs_page_address_t a_page_address)
+{
+    bool_t      is_reserved = FALSE;
+    pifs_size_t i;
+    pifs_size_t page_idx = a_block_address * PIFS_LOGICAL_PAGE_PER_BLOCK + a_page_address;
+    pifs_size_t reserved_page_idx;
+
+    for (i = 0; i < PIFS_OPEN_FILE_NUM_MAX && !is_reserved; i++)
+    {
+        if (pifs.file[i].is_opened && pifs.file[i].reserved_page_count)
+        {
+            reserved_page_idx = pifs.file[i].reserved_address.block_address * PIFS_LOGICAL_PAGE_PER_BLOCK
+                    + pifs.file[i].reserved_address.page_address;
+            is_reserved = (page_idx >= reserved_page_idx
+                           && page_idx < reserved_page_idx + pifs.file[i].reserved_page_count);
+        }
+    }
+
+    return is_reserved;
+}
+#endif
+
 /**
  * @brief pifs_fwrite Write to file. Works like fwrite().
  *
@@ -399,7 +593,12 @@ size_t pifs_fwrite(const void * a_data, size_t a_size, size_t a_count, P_FILE *
 
     PIFS_GET_MUTEX();
 
+    pifs_transaction_begin();
     ret = pifs_internal_fwrite(a_data, a_size, a_count, a_file);
+    if (pifs_transaction_commit() != PIFS_SUCCESS)
+    {
+        ret = 0;
+    }
 
     PIFS_PUT_MUTEX();
 
@@ -433,9 +632,16 @@ size_t pifs_internal_fwrite(const void * a_data, size_t a_size, size_t a_count,
     pifs_page_address_t  pa_start = PIFS_PAGE_ADDRESS_INVALID;
     pifs_page_offset_t   po = PIFS_PAGE_OFFSET_INVALID;
     bool_t               is_delta = FALSE;
+    bool_t               is_reserved = FALSE;
     bool_t               is_free_map_entry;
     pifs_size_t          free_management_page_count = 0;
     pifs_size_t          free_data_page_count = 0;
+#if PIFS_FLASH_MULTI_PAGE_ENABLED
+    pifs_size_t          run_page_count;
+#endif
+#if PIFS_DELTA_FOLD_WATERMARK
+    pifs_size_t          delta_index_cnt;
+#endif
 
     PIFS_NOTICE_MSG("filename: '%s', size: %i, count: %i\r\n", file->entry.name, a_size, a_count);
     if (pifs.is_header_found && file && file->is_opened && file->mode_write)
@@ -458,9 +664,10 @@ size_t pifs_internal_fwrite(const void * a_data, size_t a_size, size_t a_count,
                 chunk_size = PIFS_MIN(data_size, PIFS_LOGICAL_PAGE_SIZE_BYTE - po);
                 //PIFS_DEBUG_MSG("--------> pos: %i po: %i data_size: %i chunk_size: %i\r\n",
                 //               file->rw_pos, po, data_size, chunk_size);
-                file->status = pifs_write(file->rw_address.block_address,
-                                          file->rw_address.page_address,
-                                          po, data, chunk_size);
+                /* Bytes after end of file are erased, page is not read */
+                file->status = pifs_write_erased(file->rw_address.block_address,
+                                                 file->rw_address.page_address,
+                                                 po, data, chunk_size, PIFS_CACHE_CLASS_DATA);
                 //pifs_print_cache();
                 if (file->status == PIFS_SUCCESS)
                 {
@@ -484,6 +691,19 @@ size_t pifs_internal_fwrite(const void * a_data, size_t a_size, size_t a_count,
             {
                 /* Overwriting existing pages in the file */
                 PIFS_DEBUG_MSG("Overwriting pages, pos: %i, size: %i\r\n", file->rw_pos, file->entry.file_size);
+#if PIFS_DELTA_FOLD_WATERMARK
+                /* Every entry added by the file is a delta page of the file or */
+                /* supersedes an entry, so folding releases at least a delta */
+                /* map page's worth of entries. Walking the map is not */
+                /* repeated until the file adds that many entries again. */
+                if (file->delta_entry_cnt >= PIFS_DELTA_ENTRY_PER_PAGE
+                        && pifs_is_delta_fold_needed())
+                {
+                    /* Delta pages of the file are folded into its map */
+                    file->delta_entry_cnt = 0;
+                    file->status = pifs_fold_delta(file);
+                }
+#endif
                 //page_count_needed = (data_size + PIFS_LOGICAL_PAGE_SIZE_BYTE - 1) / PIFS_LOGICAL_PAGE_SIZE_BYTE;
                 while (page_count_needed && file->status == PIFS_SUCCESS)
                 {
@@ -495,10 +715,20 @@ size_t pifs_internal_fwrite(const void * a_data, size_t a_size, size_t a_count,
                     PIFS_DEBUG_MSG("write %s, page_count_needed: %i, chunk size: %i\r\n",
                                     pifs_address2str(&file->rw_address), page_count_needed, chunk_size);
                     PIFS_ASSERT(pifs_is_address_valid(&file->rw_address));
+#if PIFS_DELTA_FOLD_WATERMARK
+                    delta_index_cnt = pifs.delta_index_cnt;
+#endif
                     file->status = pifs_write_delta(file->rw_address.block_address,
                                                     file->rw_address.page_address,
                                                     0, data, chunk_size, &is_delta,
                                                     &pifs.header);
+#if PIFS_DELTA_FOLD_WATERMARK
+                    if (file->status == PIFS_SUCCESS && pifs.delta_index_cnt > delta_index_cnt)
+                    {
+                        /* Delta entry is added, patched pages are not counted */
+                        file->delta_entry_cnt++;
+                    }
+#endif
                     if (file->status == PIFS_SUCCESS && chunk_size == PIFS_LOGICAL_PAGE_SIZE_BYTE)
                     {
                         pifs_inc_rw_address(file, FALSE);
@@ -541,19 +771,27 @@ size_t pifs_internal_fwrite(const void * a_data, size_t a_size, size_t a_count,
                     {
                         page_count_needed_limited = PIFS_MAP_PAGE_COUNT_INVALID - 1;
                     }
-                    /* Find a block in the previous data block */
-                    file->status = pifs_find_page(1, page_count_needed_limited,
-                                                  PIFS_BLOCK_TYPE_DATA,
-                                                  TRUE, FALSE,
-                                                  file->map_entry.address.block_address,
-                                                  &ba, &pa, &page_count_found);
-                    if (file->status == PIFS_ERROR_NO_MORE_SPACE
-                            || ba != file->map_entry.address.block_address)
+#if PIFS_FILE_RESERVE_PAGE_NUM
+                    file->status = pifs_get_reserved_pages(file, page_count_needed_limited,
+                                                           &ba, &pa, &page_count_found,
+                                                           &is_reserved);
+#endif
+                    if (file->status == PIFS_SUCCESS && !is_reserved)
                     {
-                        /* If last used block is full, try to find a not so weared block */
-                        file->status = pifs_find_free_page_wl(1, page_count_needed_limited,
-                                                              PIFS_BLOCK_TYPE_DATA,
-                                                              &ba, &pa, &page_count_found);
+                        /* Find a block in the previous data block */
+                        file->status = pifs_find_page(1, page_count_needed_limited,
+                                                      PIFS_BLOCK_TYPE_DATA,
+                                                      TRUE, FALSE,
+                                                      file->map_entry.address.block_address,
+                                                      &ba, &pa, &page_count_found);
+                        if (file->status == PIFS_ERROR_NO_MORE_SPACE
+                                || ba != file->map_entry.address.block_address)
+                        {
+                            /* If last used block is full, try to find a not so weared block */
+                            file->status = pifs_find_free_page_wl(1, page_count_needed_limited,
+                                                                  PIFS_BLOCK_TYPE_DATA,
+                                                                  &ba, &pa, &page_count_found);
+                        }
                     }
                     PIFS_DEBUG_MSG("%u pages found. %s, status: %i\r\n",
                                    page_count_found, pifs_ba_pa2str(ba, pa), file->status);
@@ -562,7 +800,39 @@ size_t pifs_internal_fwrite(const void * a_data, size_t a_size, size_t a_count,
                         ba_start = ba;
                         pa_start = pa;
                         page_cound_found_start = page_count_found;
-                        do
+                        is_delta = FALSE;
+#if PIFS_FLASH_MULTI_PAGE_ENABLED
+                        /* Found pages are erased, full pages of the same */
+                        /* block are programmed with one flash command */
+                        run_page_count = PIFS_MIN(page_count_found, data_size / PIFS_LOGICAL_PAGE_SIZE_BYTE);
+                        run_page_count = PIFS_MIN(run_page_count, PIFS_LOGICAL_PAGE_PER_BLOCK - pa);
+                        if (run_page_count > 1)
+                        {
+                            file->status = pifs_write_multi(ba, pa, data, run_page_count);
+                            if (file->status == PIFS_SUCCESS && !is_reserved)
+                            {
+                                /* Reserved pages are already marked as used */
+                                file->status = pifs_mark_page(ba, pa, run_page_count, TRUE, FALSE);
+                            }
+                            if (file->status == PIFS_SUCCESS)
+                            {
+                                data += run_page_count * PIFS_LOGICAL_PAGE_SIZE_BYTE;
+                                data_size -= run_page_count * PIFS_LOGICAL_PAGE_SIZE_BYTE;
+                                written_size += run_page_count * PIFS_LOGICAL_PAGE_SIZE_BYTE;
+                                page_count_found -= run_page_count;
+                                page_count_needed -= run_page_count;
+                                /* Save last page's address for future use */
+                                pa += run_page_count - 1;
+                                file->rw_address.block_address = ba;
+                                file->rw_address.page_address = pa;
+                                if (page_count_found)
+                                {
+                                    file->status = pifs_inc_ba_pa(&ba, &pa);
+                                }
+                            }
+                        }
+#endif
+                        while (page_count_found && file->status == PIFS_SUCCESS)
                         {
                             if (data_size > PIFS_LOGICAL_PAGE_SIZE_BYTE)
                             {
@@ -572,8 +842,18 @@ size_t pifs_internal_fwrite(const void * a_data, size_t a_size, size_t a_count,
                             {
                                 chunk_size = data_size;
                             }
-                            file->status = pifs_write_delta(ba, pa, 0, data, chunk_size, &is_delta,
-                                                            &pifs.header);
+                            if (is_reserved)
+                            {
+                                /* Reserved pages are erased and already marked as used */
+                                is_delta = FALSE;
+                                file->status = pifs_write_erased(ba, pa, 0, data, chunk_size,
+                                                                 PIFS_CACHE_CLASS_DATA);
+                            }
+                            else
+                            {
+                                file->status = pifs_write_delta(ba, pa, 0, data, chunk_size, &is_delta,
+                                                                &pifs.header);
+                            }
                             PIFS_DEBUG_MSG("%s is_delta: %i status: %i\r\n", pifs_ba_pa2str(ba, pa),
                                            is_delta, file->status);
                             /* Save last page's address for future use */
@@ -588,7 +868,7 @@ size_t pifs_internal_fwrite(const void * a_data, size_t a_size, size_t a_count,
                             {
                                 file->status = pifs_inc_ba_pa(&ba, &pa);
                             }
-                        } while (page_count_found && file->status == PIFS_SUCCESS);
+                        }
 
                         if (file->status == PIFS_SUCCESS && !is_delta)
                         {
@@ -623,6 +903,141 @@ size_t pifs_internal_fwrite(const void * a_data, size_t a_size, size_t a_count,
     return written_size / a_size;
 }
 
+#if PIFS_READ_AHEAD_PAGE_NUM_MAX
+/**
+ * @brief pifs_set_read_ahead_page_num Set maximum number of pages read ahead
+ * when a file is read sequentially.
+ *
+ * @param[in] a_page_num_max Maximum number of pages. 0: read-ahead is disabled.
+ * Limited to PIFS_READ_AHEAD_PAGE_NUM_MAX.
+ */
+void pifs_set_read_ahead_page_num(size_t a_page_num_max)
+{
+    PIFS_GET_MUTEX();
+
+    pifs.read_ahead_page_num_max = PIFS_MIN(a_page_num_max, PIFS_READ_AHEAD_PAGE_NUM_MAX);
+
+    PIFS_PUT_MUTEX();
+}
+
+/**
+ * @brief pifs_adapt_read_ahead Adjust number of pages to read ahead to the
+ * observed access pattern.
+ * Read-ahead window is doubled at every sequential read, halved when
+ * prefetched pages were evicted before use and cleared at random access.
+ *
+ * @param[in] a_file            Pointer to file.
+ * @param[in] a_is_sequential   TRUE: read started where previous read ended.
+ * @param[in] a_is_missed       TRUE: data page was read from flash memory.
+ * @param[in] a_read_size       Number of bytes read.
+ */
+static void pifs_adapt_read_ahead(pifs_file_t * a_file, bool_t a_is_sequential,
+                                  bool_t a_is_missed, pifs_size_t a_read_size)
+{
+    pifs_size_t read_page_count = (a_read_size + PIFS_LOGICAL_PAGE_SIZE_BYTE - 1) / PIFS_LOGICAL_PAGE_SIZE_BYTE;
+
+    if (!a_is_sequential)
+    {
+        a_file->ra_page_count = 0;
+        a_file->ra_page_end = 0;
+    }
+    else if (a_is_missed && a_file->ra_page_count && read_page_count <= a_file->ra_page_count)
+    {
+        /* Prefetched pages were evicted, cache is too small for the window */
+        a_file->ra_page_count /= 2;
+    }
+    else if (a_file->ra_page_count)
+    {
+        a_file->ra_page_count *= 2;
+    }
+    else
+    {
+        a_file->ra_page_count = 1;
+    }
+    a_file->ra_page_count = PIFS_MIN(a_file->ra_page_count, pifs.read_ahead_page_num_max);
+}
+
+/**
+ * @brief pifs_read_ahead Prefetch pages following the actual read position
+ * into the page cache. Pages of actual map entry's run and the next map
+ * entries of actual map page are prefetched. Prefetching is done when the
+ * window moves forward. Pages of the window which are already cached are
+ * touched to keep them in the cache until they are read.
+ * File's map position is not changed.
+ *
+ * @param[in] a_file Pointer to file.
+ */
+static void pifs_read_ahead(pifs_file_t * a_file)
+{
+    pifs_status_t      status = PIFS_SUCCESS;
+    pifs_address_t     address = a_file->rw_address;
+    pifs_page_count_t  page_count = a_file->rw_page_count;
+    size_t             map_entry_idx = a_file->map_entry_idx;
+    pifs_map_entry_t   map_entry;
+    size_t             page_idx = a_file->rw_pos / PIFS_LOGICAL_PAGE_SIZE_BYTE;
+    size_t             first_page_idx;
+    size_t             end_page_idx;
+
+    /* First page not read yet and not prefetched yet */
+    first_page_idx = (a_file->rw_pos + PIFS_LOGICAL_PAGE_SIZE_BYTE - 1) / PIFS_LOGICAL_PAGE_SIZE_BYTE;
+    end_page_idx = PIFS_MIN(first_page_idx + a_file->ra_page_count,
+                            (a_file->entry.file_size + PIFS_LOGICAL_PAGE_SIZE_BYTE - 1) / PIFS_LOGICAL_PAGE_SIZE_BYTE);
+    if (end_page_idx <= a_file->ra_page_end)
+    {
+        /* Window has not moved, every page of it is already prefetched */
+        page_idx = end_page_idx;
+    }
+    for ( ; page_idx < end_page_idx && status == PIFS_SUCCESS; page_idx++)
+    {
+        if (!page_count)
+        {
+            /* Peek next map entry */
+            map_entry_idx++;
+            status = PIFS_ERROR_END_OF_FILE;
+            if (map_entry_idx < PIFS_MAP_ENTRY_PER_PAGE)
+            {
+                status = pifs_read(a_file->actual_map_address.block_address,
+                                   a_file->actual_map_address.page_address,
+                                   PIFS_MAP_HEADER_SIZE_BYTE + map_entry_idx * PIFS_MAP_ENTRY_SIZE_BYTE,
+                                   &map_entry, PIFS_MAP_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
+            }
+            if (status == PIFS_SUCCESS)
+            {
+                if (pifs_is_buffer_erased(&map_entry, PIFS_MAP_ENTRY_SIZE_BYTE)
+                        || pifs_calc_checksum(&map_entry, PIFS_MAP_ENTRY_SIZE_BYTE - PIFS_CHECKSUM_SIZE_BYTE)
+                        != map_entry.checksum)
+                {
+                    status = PIFS_ERROR_END_OF_FILE;
+                }
+                else
+                {
+                    address = map_entry.address;
+                    page_count = map_entry.page_count;
+                }
+            }
+        }
+        if (status == PIFS_SUCCESS && page_idx >= first_page_idx)
+        {
+            /* Page is loaded into the cache or touched if it is cached */
+            status = pifs_read_delta(address.block_address, address.page_address,
+                                     0, NULL, 0);
+        }
+        if (status == PIFS_SUCCESS)
+        {
+            page_count--;
+            if (page_count)
+            {
+                status = pifs_inc_address(&address);
+            }
+        }
+    }
+    if (status == PIFS_SUCCESS)
+    {
+        a_file->ra_page_end = PIFS_MAX(a_file->ra_page_end, end_page_idx);
+    }
+}
+#endif
+
 /**
  * @brief pifs_fread File read. Works like fread().
  *
@@ -641,12 +1056,24 @@ size_t pifs_fread(void * a_data, size_t a_size, size_t a_count, P_FILE * a_file)
     pifs_size_t          data_size = a_size * a_count;
     pifs_size_t          page_count = 0;
     pifs_page_offset_t   po;
+#if PIFS_FLASH_MULTI_PAGE_ENABLED
+    pifs_size_t          run_page_count;
+    pifs_size_t          i;
+#endif
+#if PIFS_READ_AHEAD_PAGE_NUM_MAX
+    uint32_t             miss_cntr;
+    bool_t               is_sequential;
+#endif
 
     PIFS_GET_MUTEX();
 
     PIFS_NOTICE_MSG("filename: '%s', size: %i, count: %i\r\n", file->entry.name, a_size, a_count);
     if (pifs.is_header_found && file && file->is_opened && file->mode_read)
     {
+#if PIFS_READ_AHEAD_PAGE_NUM_MAX
+        is_sequential = (file->rw_pos == file->ra_pos);
+        miss_cntr = pifs.cache_miss_cntr[PIFS_CACHE_CLASS_DATA];
+#endif
         if (file->rw_pos + data_size > file->entry.file_size)
         {
             PIFS_DEBUG_MSG("Trying to read more than file size: %i, file size: %i\r\n",
@@ -685,28 +1112,65 @@ size_t pifs_fread(void * a_data, size_t a_size, size_t a_count, P_FILE * a_file)
             page_count = (data_size + PIFS_LOGICAL_PAGE_SIZE_BYTE - 1) / PIFS_LOGICAL_PAGE_SIZE_BYTE;
             while (page_count && file->status == PIFS_SUCCESS)
             {
-                chunk_size = PIFS_MIN(data_size, PIFS_LOGICAL_PAGE_SIZE_BYTE);
-                if (file->rw_pos + chunk_size > file->entry.file_size)
+#if PIFS_FLASH_MULTI_PAGE_ENABLED
+                /* Full pages of actual map entry's run are read at once */
+                run_page_count = PIFS_MIN(file->rw_page_count, data_size / PIFS_LOGICAL_PAGE_SIZE_BYTE);
+                run_page_count = PIFS_MIN(run_page_count,
+                                          PIFS_LOGICAL_PAGE_PER_BLOCK - file->rw_address.page_address);
+                if (run_page_count > 1)
                 {
-                    chunk_size = file->entry.file_size - file->rw_pos;
+                    PIFS_NOTICE_MSG("read %s, run page count: %i\r\n",
+                                   pifs_address2str(&file->rw_address), run_page_count);
+                    PIFS_ASSERT(pifs_is_address_valid(&file->rw_address));
+                    chunk_size = run_page_count * PIFS_LOGICAL_PAGE_SIZE_BYTE;
+                    file->status = pifs_read_delta_multi(file->rw_address.block_address,
+                                                         file->rw_address.page_address,
+                                                         data, run_page_count);
+                    for (i = 0; i < run_page_count && file->status == PIFS_SUCCESS; i++)
+                    {
+                        pifs_inc_rw_address(file, TRUE);
+                    }
+                    data += chunk_size;
+                    data_size -= chunk_size;
+                    read_size += chunk_size;
+                    page_count -= run_page_count;
                 }
-                PIFS_NOTICE_MSG("read %s, page_count: %i, chunk size: %i\r\n",
-                               pifs_address2str(&file->rw_address), page_count, chunk_size);
-                PIFS_ASSERT(pifs_is_address_valid(&file->rw_address));
-                file->status = pifs_read_delta(file->rw_address.block_address,
-                                               file->rw_address.page_address,
-                                               0, data, chunk_size);
-                if (file->status == PIFS_SUCCESS && chunk_size == PIFS_LOGICAL_PAGE_SIZE_BYTE)
+                else
+#endif
                 {
-                    pifs_inc_rw_address(file, TRUE);
+                    chunk_size = PIFS_MIN(data_size, PIFS_LOGICAL_PAGE_SIZE_BYTE);
+                    if (file->rw_pos + chunk_size > file->entry.file_size)
+                    {
+                        chunk_size = file->entry.file_size - file->rw_pos;
+                    }
+                    PIFS_NOTICE_MSG("read %s, page_count: %i, chunk size: %i\r\n",
+                                   pifs_address2str(&file->rw_address), page_count, chunk_size);
+                    PIFS_ASSERT(pifs_is_address_valid(&file->rw_address));
+                    file->status = pifs_read_delta(file->rw_address.block_address,
+                                                   file->rw_address.page_address,
+                                                   0, data, chunk_size);
+                    if (file->status == PIFS_SUCCESS && chunk_size == PIFS_LOGICAL_PAGE_SIZE_BYTE)
+                    {
+                        pifs_inc_rw_address(file, TRUE);
+                    }
+                    data += chunk_size;
+                    data_size -= chunk_size;
+                    read_size += chunk_size;
+                    page_count--;
                 }
-                data += chunk_size;
-                data_size -= chunk_size;
-                read_size += chunk_size;
-                page_count--;
             }
         }
         file->rw_pos += read_size;
+#if PIFS_READ_AHEAD_PAGE_NUM_MAX
+        pifs_adapt_read_ahead(file, is_sequential,
+                              miss_cntr != pifs.cache_miss_cntr[PIFS_CACHE_CLASS_DATA],
+                              read_size);
+        if (file->status == PIFS_SUCCESS && file->ra_page_count)
+        {
+            pifs_read_ahead(file);
+        }
+        file->ra_pos = file->rw_pos;
+#endif
     }
 
     PIFS_SET_ERRNO(file->status);
@@ -755,6 +1219,14 @@ int pifs_internal_fflush(P_FILE * a_file, bool_t a_is_merge_allowed, bool_t a_is
         PIFS_DEBUG_MSG("mode_write: %i, is_entry_changed: %i, file_size: %i\r\n",
                        file->mode_write, file->is_entry_changed,
                        file->entry.file_size);
+#if PIFS_ENABLE_MAP_COALESCE
+        /* Map shall contain all pages of file size stored in the entry */
+        file->status = pifs_flush_map_entry(file);
+        if (file->status != PIFS_SUCCESS)
+        {
+            a_is_entry_update_allowed = FALSE;
+        }
+#endif
         if (a_is_entry_update_allowed
                 && (file->is_entry_changed || !file->entry.file_size))
         {
@@ -769,7 +1241,11 @@ int pifs_internal_fflush(P_FILE * a_file, bool_t a_is_merge_allowed, bool_t a_is
                                                  file->entry_list_address.page_address);
             }
         }
-        pifs_flush();
+        if (!pifs_is_in_transaction())
+        {
+            /* Otherwise cache is flushed when transaction is committed */
+            pifs_flush();
+        }
         ret = 0;
     }
 
@@ -791,7 +1267,12 @@ int pifs_fclose(P_FILE * a_file)
 
     PIFS_GET_MUTEX();
 
+    pifs_transaction_begin();
     ret = pifs_internal_fclose(file, TRUE, TRUE);
+    if (pifs_transaction_commit() != PIFS_SUCCESS)
+    {
+        ret = PIFS_EOF;
+    }
 
     PIFS_PUT_MUTEX();
 
@@ -833,6 +1314,17 @@ int pifs_internal_fclose(P_FILE * a_file, bool_t a_is_merge_allowed, bool_t a_is
     {
         ret = pifs_internal_fflush(a_file, a_is_merge_allowed, a_is_entry_update_allowed);
     }
+#if PIFS_FILE_RESERVE_PAGE_NUM
+    if (ret == 0)
+    {
+        /* Unused pages of reservation window are returned */
+        file->status = pifs_release_reserved_pages(file);
+        if (file->status != PIFS_SUCCESS)
+        {
+            ret = PIFS_EOF;
+        }
+    }
+#endif
     if (ret == 0)
     {
         file->is_opened = FALSE;
@@ -866,6 +1358,59 @@ int pifs_fseek(P_FILE * a_file, long int a_offset, int a_origin)
     return ret;
 }
 
+/**
+ * @brief pifs_seek_backward Go backward from actual position to the beginning
+ * of the page of target position, using previous map address of map headers.
+ * Position is only changed if the page is closer to the actual position than
+ * to the beginning of file.
+ *
+ * @param[in] a_file    Pointer to opened file.
+ * @param[in] a_pos     Target position in file, less than actual position.
+ * @return PIFS_SUCCESS if position is not changed or it was changed successfully.
+ */
+static pifs_status_t pifs_seek_backward(pifs_file_t * a_file, size_t a_pos)
+{
+    size_t page_idx = a_pos / PIFS_LOGICAL_PAGE_SIZE_BYTE;
+    size_t rw_page_idx = a_file->rw_pos / PIFS_LOGICAL_PAGE_SIZE_BYTE;
+    bool_t is_eof = (a_file->rw_pos == a_file->entry.file_size);
+
+    a_file->status = PIFS_SUCCESS;
+    if (is_eof)
+    {
+        /* At end of file read/write address is the last page of file */
+        rw_page_idx = (a_file->rw_pos - 1) / PIFS_LOGICAL_PAGE_SIZE_BYTE;
+    }
+    if (rw_page_idx - page_idx < page_idx)
+    {
+        PIFS_DEBUG_MSG("Go backward %i pages\r\n", rw_page_idx - page_idx);
+        if (is_eof)
+        {
+            /* Page count may not be updated after appending pages, */
+            /* map entry after the last page may be read */
+            a_file->rw_page_count = 1;
+            if (pifs_is_buffer_erased(&a_file->map_entry, PIFS_MAP_ENTRY_SIZE_BYTE))
+            {
+                a_file->status = pifs_read_prev_map_entry(a_file);
+            }
+        }
+        while (rw_page_idx > page_idx && a_file->status == PIFS_SUCCESS)
+        {
+            (void)pifs_dec_rw_address(a_file);
+            rw_page_idx--;
+        }
+        if (a_file->status == PIFS_SUCCESS)
+        {
+            a_file->rw_pos = page_idx * PIFS_LOGICAL_PAGE_SIZE_BYTE;
+#if PIFS_READ_AHEAD_PAGE_NUM_MAX
+            a_file->ra_page_count = 0;
+            a_file->ra_page_end = 0;
+#endif
+        }
+    }
+
+    return a_file->status;
+}
+
 /**
  * @brief pifs_internal_fseek Seek in opened file.
  * Note: the caller shall provide mutex protection!
@@ -888,39 +1433,26 @@ int pifs_internal_fseek(P_FILE * a_file, long int a_offset, int a_origin)
     pifs_page_offset_t  po;
     pifs_size_t         target_pos = 0;
     pifs_size_t         file_size = 0;
+#if PIFS_FILE_EXTENT_NUM_MAX || PIFS_ENABLE_MAP_INDEX
+    bool_t              is_map_indexed = FALSE;
+#endif
 
     PIFS_NOTICE_MSG("filename: '%s', filesize: %i, offset: %i, origin: %i, rw_pos: %i\r\n",
                      file->entry.name, file->entry.file_size, a_offset, a_origin, file->rw_pos);
     if (pifs.is_header_found && file && file->is_opened)
     {
+#if PIFS_ENABLE_MAP_COALESCE
+        /* Map is read from flash memory while seeking */
+        file->status = pifs_flush_map_entry(file);
+#else
+        file->status = PIFS_SUCCESS;
+#endif
         switch (a_origin)
         {
             case PIFS_SEEK_CUR:
                 target_pos = file->rw_pos + a_offset;
-                if (a_offset > 0)
-                {
-                    data_size = a_offset;
-                }
-                else
-                {
-                    /* TODO implement better method: */
-                    /* if rw_pos + a_offset > rw_pos / 2 */
-                    /* (if position is close to current position) */
-                    /* go backward using map header's previous address entry */
-                    data_size = file->rw_pos + a_offset;
-                    pifs_internal_rewind(file); /* Zeroing file->rw_pos! */
-                }
                 break;
             case PIFS_SEEK_SET:
-                if ((long int)file->rw_pos < a_offset)
-                {
-                    data_size = a_offset - file->rw_pos;
-                }
-                else
-                {
-                    data_size = a_offset;
-                    pifs_internal_rewind(file); /* Zeroing file->rw_pos! */
-                }
                 target_pos = a_offset;
                 break;
             case PIFS_SEEK_END:
@@ -930,24 +1462,43 @@ int pifs_internal_fseek(P_FILE * a_file, long int a_offset, int a_origin)
                 }
                 else
                 {
-                    data_size = file->entry.file_size + a_offset;
-                    if (data_size >= file->rw_pos)
-                    {
-                        data_size -= file->rw_pos;
-                    }
-                    else
-                    {
-                        pifs_internal_rewind(file); /* Zeroing file->rw_pos! */
-                    }
-                    target_pos = data_size;
+                    target_pos = file->entry.file_size + a_offset;
                 }
                 break;
             default:
+                target_pos = file->rw_pos;
                 break;
         }
 
+#if PIFS_ENABLE_MAP_INDEX
+        if (file->status == PIFS_SUCCESS)
+        {
+            /* Jump to the map page of target position */
+            (void)pifs_seek_map_index(file, target_pos, &is_map_indexed);
+        }
+#endif
+#if PIFS_FILE_EXTENT_NUM_MAX
+        if (file->status == PIFS_SUCCESS && !is_map_indexed)
+        {
+            /* Jump to the closest cached map entry before target position */
+            (void)pifs_seek_file_extent(file, target_pos);
+        }
+#endif
+        if (file->status == PIFS_SUCCESS)
+        {
+            if (target_pos < file->rw_pos)
+            {
+                /* Go backward if target position is close to current position */
+                (void)pifs_seek_backward(file, target_pos);
+            }
+            if (target_pos < file->rw_pos)
+            {
+                pifs_internal_rewind(file); /* Zeroing file->rw_pos! */
+            }
+        }
         if (file->status == PIFS_SUCCESS)
         {
+            data_size = target_pos - file->rw_pos;
             if (file->entry.file_size != PIFS_FILE_SIZE_ERASED)
             {
                 file_size = file->entry.file_size;
@@ -1072,16 +1623,28 @@ void pifs_internal_rewind(P_FILE * a_file)
     PIFS_NOTICE_MSG("filename: '%s'\r\n", file->entry.name);
     if (pifs.is_header_found && file && file->is_opened)
     {
-        file->rw_pos = 0;
-        file->rw_address.block_address = PIFS_BLOCK_ADDRESS_INVALID;
-        file->rw_address.page_address = PIFS_PAGE_ADDRESS_INVALID;
-        file->rw_pos = 0;
-        file->actual_map_address.block_address = PIFS_BLOCK_ADDRESS_INVALID;
-        file->actual_map_address.page_address = PIFS_PAGE_ADDRESS_INVALID;
-        file->status = pifs_read_first_map_entry(file);
-        PIFS_ASSERT(file->status == PIFS_SUCCESS);
-        file->rw_address = file->map_entry.address;
-        file->rw_page_count = file->map_entry.page_count;
+#if PIFS_ENABLE_MAP_COALESCE
+        /* Position is not changed if the last map entry cannot be written */
+        file->status = pifs_flush_map_entry(file);
+        if (file->status == PIFS_SUCCESS)
+#endif
+        {
+            file->rw_pos = 0;
+            file->rw_address.block_address = PIFS_BLOCK_ADDRESS_INVALID;
+            file->rw_address.page_address = PIFS_PAGE_ADDRESS_INVALID;
+            file->rw_pos = 0;
+#if PIFS_READ_AHEAD_PAGE_NUM_MAX
+            file->ra_pos = 0;
+            file->ra_page_count = 0;
+            file->ra_page_end = 0;
+#endif
+            file->actual_map_address.block_address = PIFS_BLOCK_ADDRESS_INVALID;
+            file->actual_map_address.page_address = PIFS_PAGE_ADDRESS_INVALID;
+            file->status = pifs_read_first_map_entry(file);
+            PIFS_ASSERT(file->status == PIFS_SUCCESS);
+            file->rw_address = file->map_entry.address;
+            file->rw_page_count = file->map_entry.page_count;
+        }
     }
     PIFS_SET_ERRNO(file->status);
 }
@@ -1230,10 +1793,17 @@ __weak int pifs_update_userdata_cb(bool_t a_is_mode_create_new_file, bool_t a_is
 int pifs_remove(const pifs_char_t * a_filename)
 {
     pifs_status_t       ret;
+    pifs_status_t       commit_ret;
 
     PIFS_GET_MUTEX();
 
+    pifs_transaction_begin();
     ret = pifs_internal_remove(a_filename, TRUE);
+    commit_ret = pifs_transaction_commit();
+    if (ret == PIFS_SUCCESS)
+    {
+        ret = commit_ret;
+    }
 
     PIFS_PUT_MUTEX();
 
@@ -1387,6 +1957,7 @@ int pifs_copy(const pifs_char_t * a_oldname, const pifs_char_t * a_newname)
     pifs_status_t    ret = PIFS_ERROR_NO_MORE_RESOURCE;
     pifs_file_t    * file = NULL;
     pifs_file_t    * file2 = NULL;
+    int              close_ret;
     pifs_size_t      read_bytes;
     pifs_size_t      written_bytes;
 #if PIFS_ENABLE_USER_DATA
@@ -1401,6 +1972,7 @@ int pifs_copy(const pifs_char_t * a_oldname, const pifs_char_t * a_newname)
         file2 = pifs_fopen(a_newname, "w");
         if (file2)
         {
+            ret = PIFS_SUCCESS;
 #if PIFS_ENABLE_USER_DATA
             ret = pifs_fgetuserdata(file, &user_data);
             if (ret == PIFS_SUCCESS)
@@ -1427,13 +1999,26 @@ int pifs_copy(const pifs_char_t * a_oldname, const pifs_char_t * a_newname)
                     }
                 } while (read_bytes > 0 && read_bytes == written_bytes && ret == PIFS_SUCCESS);
             }
-            ret = pifs_fclose(file2);
+            close_ret = pifs_fclose(file2);
+            if (ret == PIFS_SUCCESS)
+            {
+                ret = close_ret;
+            }
+            else
+            {
+                /* Incomplete copy shall not remain */
+                (void)pifs_remove(a_newname);
+            }
         }
         else
         {
             PIFS_ERROR_MSG("Cannot open file '%s'\r\n", a_newname);
         }
-        ret = pifs_fclose(file);
+        close_ret = pifs_fclose(file);
+        if (ret == PIFS_SUCCESS)
+        {
+            ret = close_ret;
+        }
     }
     else
     {
@@ -38,6 +38,7 @@ pifs_status_t pifs_internal_open(pifs_file_t * a_file,
                                  const pifs_char_t * a_filename,
                                  const pifs_char_t * a_modes, bool_t a_is_merge_allowed);
 pifs_status_t pifs_inc_rw_address(pifs_file_t * a_file, bool_t a_is_read);
+pifs_status_t pifs_dec_rw_address(pifs_file_t * a_file);
 size_t pifs_internal_fwrite(const void * a_data, size_t a_size, size_t a_count, P_FILE * a_file);
 int pifs_internal_fflush(P_FILE * a_file, bool_t a_is_merge_allowed, bool_t a_is_entry_update_allowed);
 int pifs_internal_fclose(P_FILE * a_file, bool_t a_is_merge_allowed, bool_t a_is_entry_update_allowed);
@@ -46,6 +47,10 @@ bool_t pifs_internal_is_file_exist(const pifs_char_t * a_filename);
 void pifs_internal_rewind(P_FILE * a_file);
 int pifs_internal_fsetuserdata(P_FILE * a_file, const pifs_user_data_t * a_user_data, bool_t a_is_merge_allowed);
 int pifs_internal_remove(const pifs_char_t * a_filename, bool_t a_is_merge_allowed);
+#if PIFS_FILE_RESERVE_PAGE_NUM
+bool_t pifs_is_page_reserved(pifs_block_address_t a_block_address,
+                             pifs_page_address_t a_page_address);
+#endif
 
 #ifdef __cplusplus
 }
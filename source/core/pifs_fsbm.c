@@ -134,6 +134,615 @@ static inline bool_t pifs_check_bits(bool_t a_is_free, bool_t a_is_to_be_release
     return ret;
 }
 
+/** Number of bits in a scan word */
+#define PIFS_FSBM_WORD_BITS         (sizeof(pifs_fsbm_word_t) * PIFS_BYTE_BITS)
+/** Number of pages in a scan word */
+#define PIFS_FSBM_WORD_PAGES        (PIFS_FSBM_WORD_BITS / PIFS_FSBM_BITS_PER_PAGE)
+/** Bit 0 of every page in a scan word: 0x5555... */
+#define PIFS_FSBM_WORD_PAGE_MASK    ((pifs_fsbm_word_t) (~(pifs_fsbm_word_t) 0u / 3u))
+/** Number of bytes of free space bitmap processed together when pages are marked */
+#define PIFS_FSBM_MARK_BUF_SIZE_BYTE    (8u * sizeof(pifs_fsbm_word_t))
+/** Number of bytes of free space bitmap processed together when pages are searched */
+#define PIFS_FSBM_SCAN_BUF_SIZE_BYTE    (8u * sizeof(pifs_fsbm_word_t))
+/** Number of pages in scan buffer */
+#define PIFS_FSBM_SCAN_BUF_PAGES        (PIFS_FSBM_SCAN_BUF_SIZE_BYTE * PIFS_BYTE_BITS / PIFS_FSBM_BITS_PER_PAGE)
+
+/**
+ * @brief pifs_fsbm_ctz Count trailing zero bits.
+ *
+ * @param[in] a_word Word to check. Shall not be zero.
+ * @return Number of zero bits below the lowest set bit.
+ */
+static inline pifs_size_t pifs_fsbm_ctz(pifs_fsbm_word_t a_word)
+{
+#if defined(__GNUC__)
+    return (pifs_size_t) __builtin_ctzll((unsigned long long) a_word);
+#else
+    pifs_size_t cntr = 0;
+
+    while (!(a_word & 1u))
+    {
+        a_word >>= 1;
+        cntr++;
+    }
+
+    return cntr;
+#endif
+}
+
+/**
+ * @brief pifs_fsbm_popcount Count set bits.
+ *
+ * @param[in] a_word Word to check.
+ * @return Number of set bits.
+ */
+static inline pifs_size_t pifs_fsbm_popcount(pifs_fsbm_word_t a_word)
+{
+#if defined(__GNUC__)
+    return (pifs_size_t) __builtin_popcountll((unsigned long long) a_word);
+#else
+    pifs_size_t cntr = 0;
+
+    while (a_word)
+    {
+        /* Clear lowest set bit */
+        a_word &= a_word - 1u;
+        cntr++;
+    }
+
+    return cntr;
+#endif
+}
+
+/**
+ * @brief pifs_fsbm_match_word Load one word of free space bitmap and
+ * calculate which pages are free or to be released.
+ *
+ * @param[in] a_bitmap          Pointer to free space bitmap.
+ * @param[in] a_word_idx        Index of word.
+ * @param[in] a_byte_num        Number of bytes can be read from bitmap.
+ * @param[in] a_is_free         TRUE: free pages match.
+ * @param[in] a_is_to_be_released TRUE: to be released pages match.
+ * @return Bit 0 of page's bit field is set if page matches.
+ */
+static inline pifs_fsbm_word_t pifs_fsbm_match_word(const uint8_t * a_bitmap,
+                                                    pifs_size_t a_word_idx,
+                                                    pifs_size_t a_byte_num,
+                                                    bool_t a_is_free,
+                                                    bool_t a_is_to_be_released)
+{
+    pifs_fsbm_word_t word = 0;
+    pifs_fsbm_word_t match = 0;
+    pifs_size_t      byte_idx = a_word_idx * sizeof(pifs_fsbm_word_t);
+    pifs_size_t      i;
+
+    /* Byte order independent load, first page is at bit 0 */
+    if (byte_idx + sizeof(pifs_fsbm_word_t) <= a_byte_num)
+    {
+        /* Whole word, compiler can merge it to one load */
+        for (i = 0; i < sizeof(pifs_fsbm_word_t); i++)
+        {
+            word |= (pifs_fsbm_word_t) a_bitmap[byte_idx + i] << (i * PIFS_BYTE_BITS);
+        }
+    }
+    else
+    {
+        for (i = 0; byte_idx + i < a_byte_num; i++)
+        {
+            word |= (pifs_fsbm_word_t) a_bitmap[byte_idx + i] << (i * PIFS_BYTE_BITS);
+        }
+    }
+    if (a_is_free)
+    {
+        /* Bit 0 is set: page is free */
+        match |= word & PIFS_FSBM_WORD_PAGE_MASK;
+    }
+    if (a_is_to_be_released)
+    {
+        /* Bit 1 is cleared: page is to be released */
+        match |= (~word >> 1) & PIFS_FSBM_WORD_PAGE_MASK;
+    }
+
+    return match;
+}
+
+/**
+ * @brief pifs_fsbm_find_next Find next page which is free or to be released
+ * (or next page which is neither) in a free space bitmap. The bitmap is
+ * processed one machine word at a time.
+ *
+ * @param[in] a_bitmap          Pointer to free space bitmap.
+ * @param[in] a_start_page_idx  Index of first page to check.
+ * @param[in] a_end_page_idx    Index after last page to check.
+ * @param[in] a_is_free         TRUE: free pages match.
+ * @param[in] a_is_to_be_released TRUE: to be released pages match.
+ * @param[in] a_is_match        TRUE: find matching page,
+ *                              FALSE: find not matching page.
+ * @return Index of page found or a_end_page_idx if not found.
+ */
+pifs_size_t pifs_fsbm_find_next(const uint8_t * a_bitmap,
+                                pifs_size_t a_start_page_idx,
+                                pifs_size_t a_end_page_idx,
+                                bool_t a_is_free,
+                                bool_t a_is_to_be_released,
+                                bool_t a_is_match)
+{
+    pifs_size_t      page_idx = a_start_page_idx;
+    pifs_size_t      byte_num = (a_end_page_idx * PIFS_FSBM_BITS_PER_PAGE + PIFS_BYTE_BITS - 1) / PIFS_BYTE_BITS;
+    pifs_size_t      word_idx;
+    pifs_fsbm_word_t match;
+    bool_t           found = FALSE;
+
+    while (page_idx < a_end_page_idx && !found)
+    {
+        word_idx = page_idx / PIFS_FSBM_WORD_PAGES;
+        match = pifs_fsbm_match_word(a_bitmap, word_idx, byte_num,
+                                     a_is_free, a_is_to_be_released);
+        if (!a_is_match)
+        {
+            match = ~match & PIFS_FSBM_WORD_PAGE_MASK;
+        }
+        /* Skip pages before start */
+        match &= ~(pifs_fsbm_word_t) 0u << ((page_idx % PIFS_FSBM_WORD_PAGES) * PIFS_FSBM_BITS_PER_PAGE);
+        if (match)
+        {
+            page_idx = word_idx * PIFS_FSBM_WORD_PAGES + pifs_fsbm_ctz(match) / PIFS_FSBM_BITS_PER_PAGE;
+            found = TRUE;
+        }
+        else
+        {
+            page_idx = (word_idx + 1) * PIFS_FSBM_WORD_PAGES;
+        }
+    }
+
+    return PIFS_MIN(page_idx, a_end_page_idx);
+}
+
+/**
+ * @brief pifs_fsbm_count Count pages which are free or to be released in a
+ * free space bitmap. The bitmap is processed one machine word at a time.
+ *
+ * @param[in] a_bitmap          Pointer to free space bitmap.
+ * @param[in] a_start_page_idx  Index of first page to count.
+ * @param[in] a_end_page_idx    Index after last page to count.
+ * @param[in] a_is_free         TRUE: count free pages.
+ * @param[in] a_is_to_be_released TRUE: count to be released pages.
+ * @return Number of pages.
+ */
+pifs_size_t pifs_fsbm_count(const uint8_t * a_bitmap,
+                            pifs_size_t a_start_page_idx,
+                            pifs_size_t a_end_page_idx,
+                            bool_t a_is_free,
+                            bool_t a_is_to_be_released)
+{
+    pifs_size_t      cntr = 0;
+    pifs_size_t      byte_num = (a_end_page_idx * PIFS_FSBM_BITS_PER_PAGE + PIFS_BYTE_BITS - 1) / PIFS_BYTE_BITS;
+    pifs_size_t      word_idx;
+    pifs_size_t      end_word_idx;
+    pifs_fsbm_word_t match;
+
+    if (a_start_page_idx < a_end_page_idx)
+    {
+        end_word_idx = (a_end_page_idx - 1) / PIFS_FSBM_WORD_PAGES;
+        for (word_idx = a_start_page_idx / PIFS_FSBM_WORD_PAGES; word_idx <= end_word_idx; word_idx++)
+        {
+            match = pifs_fsbm_match_word(a_bitmap, word_idx, byte_num,
+                                         a_is_free, a_is_to_be_released);
+            if (word_idx == a_start_page_idx / PIFS_FSBM_WORD_PAGES)
+            {
+                /* Skip pages before start */
+                match &= ~(pifs_fsbm_word_t) 0u << ((a_start_page_idx % PIFS_FSBM_WORD_PAGES) * PIFS_FSBM_BITS_PER_PAGE);
+            }
+            if (word_idx == end_word_idx && (a_end_page_idx % PIFS_FSBM_WORD_PAGES))
+            {
+                /* Skip pages after end */
+                match &= ~(~(pifs_fsbm_word_t) 0u << ((a_end_page_idx % PIFS_FSBM_WORD_PAGES) * PIFS_FSBM_BITS_PER_PAGE));
+            }
+            cntr += pifs_fsbm_popcount(match);
+        }
+    }
+
+    return cntr;
+}
+
+#if PIFS_ENABLE_FSBM_SHADOW
+/**
+ * @brief pifs_fsbm_shadow_load Copy free space bitmap of actual header to
+ * RAM. Shall be called when the file system header is changed.
+ *
+ * @return PIFS_SUCCESS if free space bitmap was read successfully.
+ */
+pifs_status_t pifs_fsbm_shadow_load(void)
+{
+    pifs_status_t        ret = PIFS_SUCCESS;
+    pifs_size_t          i;
+    pifs_size_t          chunk_size;
+    pifs_block_address_t ba;
+    pifs_page_address_t  pa;
+
+    pifs.is_fsbm_shadow_valid = FALSE;
+    for (i = 0; i < PIFS_FREE_SPACE_BITMAP_SIZE_BYTE && ret == PIFS_SUCCESS; i += chunk_size)
+    {
+        /* Same layout as in pifs_calc_free_space_pos() */
+        ba = pifs.header.free_space_bitmap_address.block_address + (i / PIFS_FLASH_BLOCK_SIZE_BYTE);
+        pa = pifs.header.free_space_bitmap_address.page_address
+                + ((i % PIFS_FLASH_BLOCK_SIZE_BYTE) / PIFS_LOGICAL_PAGE_SIZE_BYTE);
+        chunk_size = PIFS_MIN(PIFS_LOGICAL_PAGE_SIZE_BYTE, PIFS_FREE_SPACE_BITMAP_SIZE_BYTE - i);
+        ret = pifs_read(ba, pa, 0, &pifs.fsbm_shadow[i], chunk_size, PIFS_CACHE_CLASS_FSBM);
+    }
+    if (ret == PIFS_SUCCESS)
+    {
+        pifs.is_fsbm_shadow_valid = TRUE;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_fsbm_shadow_invalidate Stop using RAM copy of free space
+ * bitmap until pifs_fsbm_shadow_load() is called. Used when free space
+ * bitmap is written directly (merge).
+ */
+void pifs_fsbm_shadow_invalidate(void)
+{
+    pifs.is_fsbm_shadow_valid = FALSE;
+}
+
+/**
+ * @brief pifs_fsbm_shadow_idx Calculate index of free space bitmap's byte
+ * in RAM copy. Inverse of pifs_calc_free_space_pos().
+ *
+ * @param[in] a_header  Pointer to file system header.
+ * @param[in] a_fsbm_block_address Block address of free space bitmap's page.
+ * @param[in] a_fsbm_page_address  Page address of free space bitmap's page.
+ * @param[in] a_fsbm_page_offset   Offset in free space bitmap's page.
+ * @return Index in pifs.fsbm_shadow.
+ */
+static inline pifs_size_t pifs_fsbm_shadow_idx(const pifs_header_t * a_header,
+                                               pifs_block_address_t a_fsbm_block_address,
+                                               pifs_page_address_t a_fsbm_page_address,
+                                               pifs_page_offset_t a_fsbm_page_offset)
+{
+    return (a_fsbm_block_address - a_header->free_space_bitmap_address.block_address) * PIFS_FLASH_BLOCK_SIZE_BYTE
+            + (a_fsbm_page_address - a_header->free_space_bitmap_address.page_address) * PIFS_LOGICAL_PAGE_SIZE_BYTE
+            + a_fsbm_page_offset;
+}
+#endif
+
+/**
+ * @brief pifs_read_fsbm Read bytes of free space bitmap. RAM copy is used
+ * if it is enabled and valid for the header, otherwise the bytes are read
+ * through page cache.
+ *
+ * @param[in] a_header  Pointer to file system header.
+ * @param[in] a_fsbm_block_address Block address of free space bitmap's page.
+ * @param[in] a_fsbm_page_address  Page address of free space bitmap's page.
+ * @param[in] a_fsbm_page_offset   Offset in free space bitmap's page.
+ * @param[out] a_buf               Buffer to read to.
+ * @param[in] a_buf_size           Number of bytes to read. Shall not cross
+ *                                 page boundary.
+ * @return PIFS_SUCCESS if bytes read successfully.
+ */
+static pifs_status_t pifs_read_fsbm(const pifs_header_t * a_header,
+                                    pifs_block_address_t a_fsbm_block_address,
+                                    pifs_page_address_t a_fsbm_page_address,
+                                    pifs_page_offset_t a_fsbm_page_offset,
+                                    uint8_t * a_buf,
+                                    pifs_size_t a_buf_size)
+{
+    pifs_status_t ret = PIFS_SUCCESS;
+
+#if PIFS_ENABLE_FSBM_SHADOW
+    if (pifs.is_fsbm_shadow_valid && a_header == &pifs.header)
+    {
+        memcpy(a_buf, &pifs.fsbm_shadow[pifs_fsbm_shadow_idx(a_header, a_fsbm_block_address,
+                                                             a_fsbm_page_address, a_fsbm_page_offset)],
+               a_buf_size);
+    }
+    else
+#else
+    (void) a_header;
+#endif
+    {
+        ret = pifs_read(a_fsbm_block_address, a_fsbm_page_address, a_fsbm_page_offset,
+                        a_buf, a_buf_size, PIFS_CACHE_CLASS_FSBM);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_read_fsbm_pages Read bits of PIFS_FSBM_SCAN_BUF_PAGES pages
+ * from free space bitmap. Bytes after the end of bitmap are not changed.
+ *
+ * @param[in] a_header          Pointer to file system header.
+ * @param[in] a_page_idx        Index of first page. Shall be multiple of
+ *                              PIFS_FSBM_SCAN_BUF_PAGES.
+ * @param[out] a_buf            Buffer of PIFS_FSBM_SCAN_BUF_SIZE_BYTE bytes.
+ * @return PIFS_SUCCESS if bytes read successfully.
+ */
+static pifs_status_t pifs_read_fsbm_pages(const pifs_header_t * a_header,
+                                          pifs_size_t a_page_idx,
+                                          uint8_t * a_buf)
+{
+    pifs_status_t        ret = PIFS_SUCCESS;
+    pifs_size_t          i = a_page_idx * PIFS_FSBM_BITS_PER_PAGE / PIFS_BYTE_BITS;
+    pifs_size_t          end = PIFS_MIN(i + PIFS_FSBM_SCAN_BUF_SIZE_BYTE, PIFS_FREE_SPACE_BITMAP_SIZE_BYTE);
+    pifs_size_t          chunk_size;
+    pifs_block_address_t ba;
+    pifs_page_address_t  pa;
+    pifs_page_offset_t   po;
+
+    for ( ; i < end && ret == PIFS_SUCCESS; i += chunk_size)
+    {
+        /* Same layout as in pifs_calc_free_space_pos() */
+        ba = a_header->free_space_bitmap_address.block_address + (i / PIFS_FLASH_BLOCK_SIZE_BYTE);
+        pa = a_header->free_space_bitmap_address.page_address
+                + ((i % PIFS_FLASH_BLOCK_SIZE_BYTE) / PIFS_LOGICAL_PAGE_SIZE_BYTE);
+        po = i % PIFS_LOGICAL_PAGE_SIZE_BYTE;
+        chunk_size = PIFS_MIN(PIFS_LOGICAL_PAGE_SIZE_BYTE - po, end - i);
+        ret = pifs_read_fsbm(a_header, ba, pa, po, a_buf, chunk_size);
+        a_buf += chunk_size;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_write_fsbm Write bytes of actual free space bitmap through
+ * page cache and update RAM copy.
+ *
+ * @param[in] a_fsbm_block_address Block address of free space bitmap's page.
+ * @param[in] a_fsbm_page_address  Page address of free space bitmap's page.
+ * @param[in] a_fsbm_page_offset   Offset in free space bitmap's page.
+ * @param[in] a_buf                Buffer to write.
+ * @param[in] a_buf_size           Number of bytes to write. Shall not cross
+ *                                 page boundary.
+ * @return PIFS_SUCCESS if bytes written successfully.
+ */
+static pifs_status_t pifs_write_fsbm(pifs_block_address_t a_fsbm_block_address,
+                                     pifs_page_address_t a_fsbm_page_address,
+                                     pifs_page_offset_t a_fsbm_page_offset,
+                                     const uint8_t * a_buf,
+                                     pifs_size_t a_buf_size)
+{
+    pifs_status_t ret;
+#if PIFS_ENABLE_FSBM_SHADOW
+    pifs_size_t   idx;
+#endif
+#if PIFS_ENABLE_FREE_EXTENT_INDEX
+    pifs_size_t   block_idx;
+#endif
+
+    ret = pifs_write(a_fsbm_block_address, a_fsbm_page_address, a_fsbm_page_offset,
+                     a_buf, a_buf_size, PIFS_CACHE_CLASS_FSBM);
+#if PIFS_ENABLE_FSBM_SHADOW
+    if (ret == PIFS_SUCCESS && pifs.is_fsbm_shadow_valid)
+    {
+        idx = pifs_fsbm_shadow_idx(&pifs.header, a_fsbm_block_address,
+                                   a_fsbm_page_address, a_fsbm_page_offset);
+        memcpy(&pifs.fsbm_shadow[idx], a_buf, a_buf_size);
+#if PIFS_ENABLE_FREE_EXTENT_INDEX
+        /* Blocks of the changed pages shall be updated in index */
+        for (block_idx = idx * (PIFS_BYTE_BITS / PIFS_FSBM_BITS_PER_PAGE) / PIFS_LOGICAL_PAGE_PER_BLOCK;
+             block_idx <= (idx + a_buf_size - 1) * (PIFS_BYTE_BITS / PIFS_FSBM_BITS_PER_PAGE) / PIFS_LOGICAL_PAGE_PER_BLOCK;
+             block_idx++)
+        {
+            pifs.free_extent_dirty[block_idx / PIFS_BYTE_BITS] |= 1u << (block_idx % PIFS_BYTE_BITS);
+        }
+        pifs.is_free_extent_dirty = TRUE;
+#endif
+    }
+#endif
+
+    return ret;
+}
+
+#if PIFS_ENABLE_BLOCK_PAGE_CNTR
+/**
+ * @brief pifs_page_cntr_build Count free and to be released pages of every
+ * block. Shall be called when the file system header is changed.
+ */
+void pifs_page_cntr_build(void)
+{
+    pifs_block_address_t ba;
+    pifs_page_address_t  pa;
+    pifs_size_t          idx;
+
+    pifs.free_management_page_cntr = 0;
+    pifs.free_data_page_cntr = 0;
+    pifs.to_be_released_management_page_cntr = 0;
+    pifs.to_be_released_data_page_cntr = 0;
+    for (ba = PIFS_FLASH_BLOCK_RESERVED_NUM; ba < PIFS_FLASH_BLOCK_NUM_ALL; ba++)
+    {
+        idx = ba - PIFS_FLASH_BLOCK_RESERVED_NUM;
+#if PIFS_ENABLE_FSBM_SHADOW
+        if (pifs.is_fsbm_shadow_valid)
+        {
+            pifs.free_page_cntr[idx] = pifs_fsbm_count(pifs.fsbm_shadow, idx * PIFS_LOGICAL_PAGE_PER_BLOCK,
+                                                       (idx + 1) * PIFS_LOGICAL_PAGE_PER_BLOCK, TRUE, FALSE);
+            pifs.to_be_released_page_cntr[idx] = pifs_fsbm_count(pifs.fsbm_shadow, idx * PIFS_LOGICAL_PAGE_PER_BLOCK,
+                                                                 (idx + 1) * PIFS_LOGICAL_PAGE_PER_BLOCK, FALSE, TRUE);
+        }
+        else
+#endif
+        {
+            pifs.free_page_cntr[idx] = 0;
+            pifs.to_be_released_page_cntr[idx] = 0;
+            for (pa = 0; pa < PIFS_LOGICAL_PAGE_PER_BLOCK; pa++)
+            {
+                pifs.free_page_cntr[idx] += pifs_is_page_free(ba, pa);
+                pifs.to_be_released_page_cntr[idx] += pifs_is_page_to_be_released(ba, pa);
+            }
+        }
+        if (pifs_is_block_type(ba, PIFS_BLOCK_TYPE_DATA, &pifs.header))
+        {
+            pifs.free_data_page_cntr += pifs.free_page_cntr[idx];
+            pifs.to_be_released_data_page_cntr += pifs.to_be_released_page_cntr[idx];
+        }
+        else if (pifs_is_block_type(ba, PIFS_BLOCK_TYPE_PRIMARY_MANAGEMENT, &pifs.header))
+        {
+            pifs.free_management_page_cntr += pifs.free_page_cntr[idx];
+            pifs.to_be_released_management_page_cntr += pifs.to_be_released_page_cntr[idx];
+        }
+    }
+    pifs.is_page_cntr_valid = TRUE;
+}
+
+/**
+ * @brief pifs_page_cntr_invalidate Stop using page counters until
+ * pifs_page_cntr_build() is called. Used when free space bitmap is written
+ * directly (merge).
+ */
+void pifs_page_cntr_invalidate(void)
+{
+    pifs.is_page_cntr_valid = FALSE;
+}
+
+/**
+ * @brief pifs_page_cntr_update Update page counters after pages were marked.
+ *
+ * @param[in] a_page_idx            Index of first page, 0: first page of file system.
+ * @param[in] a_page_count          Number of pages marked.
+ * @param[in] a_is_marked_used      TRUE: free pages were marked used.
+ * @param[in] a_is_marked_to_be_released TRUE: pages were marked to be released.
+ */
+static void pifs_page_cntr_update(pifs_size_t a_page_idx,
+                                  pifs_size_t a_page_count,
+                                  bool_t a_is_marked_used,
+                                  bool_t a_is_marked_to_be_released)
+{
+    pifs_size_t idx;
+    pifs_size_t page_count;
+    bool_t      is_data;
+    bool_t      is_management;
+
+    while (a_page_count)
+    {
+        /* Pages of one block */
+        idx = a_page_idx / PIFS_LOGICAL_PAGE_PER_BLOCK;
+        page_count = PIFS_MIN(a_page_count, PIFS_LOGICAL_PAGE_PER_BLOCK - (a_page_idx % PIFS_LOGICAL_PAGE_PER_BLOCK));
+        is_data = pifs_is_block_type(idx + PIFS_FLASH_BLOCK_RESERVED_NUM, PIFS_BLOCK_TYPE_DATA, &pifs.header);
+        is_management = pifs_is_block_type(idx + PIFS_FLASH_BLOCK_RESERVED_NUM, PIFS_BLOCK_TYPE_PRIMARY_MANAGEMENT,
+                                           &pifs.header);
+        if (a_is_marked_used)
+        {
+            PIFS_ASSERT(pifs.free_page_cntr[idx] >= page_count);
+            pifs.free_page_cntr[idx] -= page_count;
+            pifs.free_data_page_cntr -= is_data ? page_count : 0u;
+            pifs.free_management_page_cntr -= is_management ? page_count : 0u;
+        }
+        if (a_is_marked_to_be_released)
+        {
+            pifs.to_be_released_page_cntr[idx] += page_count;
+            pifs.to_be_released_data_page_cntr += is_data ? page_count : 0u;
+            pifs.to_be_released_management_page_cntr += is_management ? page_count : 0u;
+        }
+        a_page_idx += page_count;
+        a_page_count -= page_count;
+    }
+}
+
+/**
+ * @brief pifs_get_pages_cntr Get number of free/to be released pages from
+ * page counters. Works like pifs_get_pages().
+ *
+ * @param[in] a_is_free                 TRUE: count free pages,
+ *                                      FALSE: count to be released pages.
+ * @param[in] a_start_block_address     Start block address.
+ * @param[in] a_block_count             Number of blocks.
+ * @param[out] a_management_page_count  Number of management pages found.
+ * @param[out] a_data_page_count        Number of data pages found.
+ */
+static void pifs_get_pages_cntr(bool_t a_is_free,
+                                pifs_block_address_t a_start_block_address,
+                                pifs_size_t a_block_count,
+                                pifs_size_t * a_management_page_count,
+                                pifs_size_t * a_data_page_count)
+{
+    pifs_block_address_t ba = a_start_block_address;
+    pifs_size_t          page_count;
+
+    if (a_start_block_address == PIFS_FLASH_BLOCK_RESERVED_NUM && a_block_count >= PIFS_FLASH_BLOCK_NUM_FS)
+    {
+        /* Whole file system */
+        *a_management_page_count = a_is_free ? pifs.free_management_page_cntr : pifs.to_be_released_management_page_cntr;
+        *a_data_page_count = a_is_free ? pifs.free_data_page_cntr : pifs.to_be_released_data_page_cntr;
+    }
+    else
+    {
+        while (ba < PIFS_FLASH_BLOCK_NUM_ALL && a_block_count)
+        {
+            page_count = a_is_free ? pifs.free_page_cntr[ba - PIFS_FLASH_BLOCK_RESERVED_NUM]
+                                   : pifs.to_be_released_page_cntr[ba - PIFS_FLASH_BLOCK_RESERVED_NUM];
+            if (pifs_is_block_type(ba, PIFS_BLOCK_TYPE_DATA, &pifs.header))
+            {
+                *a_data_page_count += page_count;
+            }
+            else if (pifs_is_block_type(ba, PIFS_BLOCK_TYPE_PRIMARY_MANAGEMENT, &pifs.header))
+            {
+                /* Only count primary management, see pifs_get_pages() */
+                *a_management_page_count += page_count;
+            }
+            ba++;
+            a_block_count--;
+        }
+    }
+}
+
+/**
+ * @brief pifs_find_to_be_released_block_cntr Find block(s) which have only
+ * free and to be released pages by page counters. Works like
+ * pifs_find_to_be_released_block().
+ *
+ * @param[in] a_block_count         Number of contiguous blocks.
+ * @param[in] a_block_type          Block type to find.
+ * @param[in] a_start_block_address Start block address.
+ * @param[in] a_end_block_address   End address of search.
+ * @param[out] a_block_address      Block address if found.
+ * @return PIFS_SUCCESS if block found.
+ */
+static pifs_status_t pifs_find_to_be_released_block_cntr(pifs_size_t a_block_count,
+                                                         pifs_block_type_t a_block_type,
+                                                         pifs_block_address_t a_start_block_address,
+                                                         pifs_block_address_t a_end_block_address,
+                                                         pifs_block_address_t * a_block_address)
+{
+    pifs_status_t        ret = PIFS_ERROR_NO_MORE_SPACE;
+    pifs_block_address_t ba = a_start_block_address;
+    pifs_size_t          idx;
+    pifs_size_t          block_count_found = 0;
+
+#if PIFS_FLASH_BLOCK_RESERVED_NUM
+    ba = PIFS_MAX(PIFS_FLASH_BLOCK_RESERVED_NUM, a_start_block_address);
+#endif
+    if (ba >= PIFS_FLASH_BLOCK_NUM_ALL)
+    {
+        ba = PIFS_FLASH_BLOCK_RESERVED_NUM;
+    }
+    for (; ba <= a_end_block_address && ba < PIFS_FLASH_BLOCK_NUM_ALL && ret != PIFS_SUCCESS; ba++)
+    {
+        idx = ba - PIFS_FLASH_BLOCK_RESERVED_NUM;
+        if (pifs_is_block_type(ba, a_block_type, &pifs.header)
+                && pifs.free_page_cntr[idx] + pifs.to_be_released_page_cntr[idx] == PIFS_LOGICAL_PAGE_PER_BLOCK)
+        {
+            block_count_found++;
+            if (block_count_found == a_block_count)
+            {
+                *a_block_address = ba + 1 - a_block_count;
+                ret = PIFS_SUCCESS;
+            }
+        }
+        else
+        {
+            block_count_found = 0;
+        }
+    }
+
+    return ret;
+}
+#endif
+
 /**
  * @brief pifs_is_page_free Check if page is used.
  *
@@ -149,6 +758,7 @@ bool_t pifs_is_page_free(pifs_block_address_t a_block_address,
     pifs_block_address_t ba = PIFS_BLOCK_ADDRESS_INVALID;
     pifs_page_address_t  pa = PIFS_PAGE_ADDRESS_INVALID;
     bool_t               is_free_space = FALSE;
+    uint8_t              fsbm_byte = 0;
 
     PIFS_ASSERT(pifs.is_header_found);
 
@@ -156,13 +766,14 @@ bool_t pifs_is_page_free(pifs_block_address_t a_block_address,
                                    a_block_address, a_page_address, &ba, &pa, &bit_pos);
     if (ret == PIFS_SUCCESS)
     {
+        PIFS_ASSERT((bit_pos / PIFS_BYTE_BITS) < PIFS_LOGICAL_PAGE_SIZE_BYTE);
         /* Read actual status of free space memory bitmap (or cache) */
-        ret = pifs_read(ba, pa, 0, NULL, 0);
+        ret = pifs_read_fsbm(&pifs.header, ba, pa, bit_pos / PIFS_BYTE_BITS,
+                             &fsbm_byte, sizeof(fsbm_byte));
     }
     if (ret == PIFS_SUCCESS)
     {
-        PIFS_ASSERT((bit_pos / PIFS_BYTE_BITS) < PIFS_LOGICAL_PAGE_SIZE_BYTE);
-        is_free_space = pifs.cache_page_buf[bit_pos / PIFS_BYTE_BITS] & (1u << (bit_pos % PIFS_BYTE_BITS));
+        is_free_space = fsbm_byte & (1u << (bit_pos % PIFS_BYTE_BITS));
     }
 
     return is_free_space ? TRUE : FALSE;
@@ -184,6 +795,7 @@ bool_t pifs_is_page_to_be_released(pifs_block_address_t a_block_address,
     pifs_block_address_t ba = PIFS_BLOCK_ADDRESS_INVALID;
     pifs_page_address_t  pa = PIFS_PAGE_ADDRESS_INVALID;
     bool_t               is_not_to_be_released = FALSE;
+    uint8_t              fsbm_byte = 0;
 
     PIFS_ASSERT(pifs.is_header_found);
 
@@ -191,21 +803,109 @@ bool_t pifs_is_page_to_be_released(pifs_block_address_t a_block_address,
                                    a_block_address, a_page_address, &ba, &pa, &bit_pos);
     if (ret == PIFS_SUCCESS)
     {
+        PIFS_ASSERT((bit_pos / PIFS_BYTE_BITS) < PIFS_LOGICAL_PAGE_SIZE_BYTE);
         /* Read actual status of free space memory bitmap (or cache) */
-        ret = pifs_read(ba, pa, 0, NULL, 0);
+        ret = pifs_read_fsbm(&pifs.header, ba, pa, bit_pos / PIFS_BYTE_BITS,
+                             &fsbm_byte, sizeof(fsbm_byte));
     }
     if (ret == PIFS_SUCCESS)
     {
-        PIFS_ASSERT((bit_pos / PIFS_BYTE_BITS) < PIFS_LOGICAL_PAGE_SIZE_BYTE);
-        is_not_to_be_released = pifs.cache_page_buf[bit_pos / PIFS_BYTE_BITS] & (1u << ((bit_pos % PIFS_BYTE_BITS) + 1));
+        is_not_to_be_released = fsbm_byte & (1u << ((bit_pos % PIFS_BYTE_BITS) + 1));
     }
 
     return !is_not_to_be_released;
 }
 
+/**
+ * @brief pifs_mark_bits Mark pages used and/or to be released in a part of
+ * free space bitmap.
+ *
+ * @param[in,out] a_bits        Bits of free space bitmap.
+ * @param[in] a_mask            Bit 0 of pages to mark.
+ * @param[in] a_mark_used       TRUE: Mark pages used.
+ * @param[in] a_mark_to_be_released TRUE: Mark pages to be released.
+ * @return TRUE: if pages were marked. FALSE: if at least one page has
+ * invalid state, a_bits is not changed.
+ */
+static inline bool_t pifs_mark_bits(pifs_fsbm_word_t * a_bits,
+                                    pifs_fsbm_word_t a_mask,
+                                    bool_t a_mark_used,
+                                    bool_t a_mark_to_be_released)
+{
+    bool_t           is_valid = TRUE;
+    pifs_fsbm_word_t bits = *a_bits;
+
+    if (a_mark_used)
+    {
+        /* Pages shall be free */
+        is_valid = ((bits & a_mask) == a_mask);
+        bits &= ~a_mask;
+    }
+    if (a_mark_to_be_released)
+    {
+        /* Pages shall be used and not yet to be released */
+        is_valid = is_valid && !(bits & a_mask) && ((bits & (a_mask << 1)) == (a_mask << 1));
+        bits &= ~(a_mask << 1);
+    }
+    if (is_valid)
+    {
+        *a_bits = bits;
+    }
+
+    return is_valid;
+}
+
+/**
+ * @brief pifs_mark_page_error Report the first page which cannot be marked.
+ *
+ * @param[in] a_page_idx        Index of first page in a_bits.
+ * @param[in] a_bits            Bits of free space bitmap.
+ * @param[in] a_mask            Bit 0 of pages to mark.
+ * @param[in] a_mark_used       TRUE: Mark pages used.
+ * @param[in] a_mark_to_be_released TRUE: Mark pages to be released.
+ */
+static void pifs_mark_page_error(pifs_size_t a_page_idx,
+                                 uint8_t a_bits,
+                                 uint8_t a_mask,
+                                 bool_t a_mark_used,
+                                 bool_t a_mark_to_be_released)
+{
+    pifs_fsbm_word_t     bits = a_bits;
+    pifs_block_address_t ba;
+    pifs_page_address_t  pa;
+
+    /* Find first page which cannot be marked */
+    while (!(a_mask & 1u) || pifs_mark_bits(&bits, 1u, a_mark_used, a_mark_to_be_released))
+    {
+        a_page_idx++;
+        a_mask >>= PIFS_FSBM_BITS_PER_PAGE;
+        a_bits >>= PIFS_FSBM_BITS_PER_PAGE;
+        bits = a_bits;
+    }
+    pifs_calc_address(a_page_idx << PIFS_FSBM_BITS_PER_PAGE_SHIFT, &ba, &pa);
+    pifs_print_cache();
+    if (a_mark_used && !(a_bits & 1u))
+    {
+        /* The space has already allocated */
+        PIFS_FATAL_ERROR_MSG("Page has already allocated! %s\r\n", pifs_ba_pa2str(ba, pa));
+    }
+    else if (!a_mark_used && (a_bits & 1u))
+    {
+        /* The space has not yet allocated */
+        PIFS_FATAL_ERROR_MSG("Page has not yet allocated! %s\r\n", pifs_ba_pa2str(ba, pa));
+    }
+    else
+    {
+        /* The space has already marked to be released */
+        PIFS_FATAL_ERROR_MSG("Page has already marked to be released %s\r\n", pifs_ba_pa2str(ba, pa));
+    }
+}
+
 /**
  * @brief pifs_mark_page Mark page(s) as used (or to be released) in free space
- * memory bitmap.
+ * memory bitmap. Bits of consecutive pages are processed together: one read
+ * and one write is done per free space bitmap page (or per
+ * PIFS_FSBM_MARK_BUF_SIZE_BYTE bytes).
  *
  * @param[in] a_block_address   Block address of page(s).
  * @param[in] a_page_address    Page address of page(s).
@@ -221,98 +921,115 @@ pifs_status_t pifs_mark_page(pifs_block_address_t a_block_address,
                              bool_t a_mark_to_be_released)
 {
     pifs_status_t        ret = PIFS_SUCCESS;
+    pifs_fsbm_word_t     buf[PIFS_FSBM_MARK_BUF_SIZE_BYTE / sizeof(pifs_fsbm_word_t)];
+    uint8_t            * buf8 = (uint8_t*) buf;
+    pifs_fsbm_word_t     bits;
     pifs_bit_pos_t       bit_pos;
     pifs_block_address_t ba = PIFS_BLOCK_ADDRESS_INVALID;
     pifs_page_address_t  pa = PIFS_PAGE_ADDRESS_INVALID;
-    bool_t               is_free_space;
-    bool_t               is_not_to_be_released;
+    pifs_size_t          page_idx;
+    pifs_size_t          end_page_idx;
+    pifs_size_t          buf_page_idx;
+    pifs_size_t          buf_page_num;
+    pifs_size_t          byte_num;
+    pifs_size_t          i;
+    uint8_t              mask;
 
     PIFS_ASSERT(pifs.is_header_found);
 
-    while (a_page_count > 0 && ret == PIFS_SUCCESS)
+    PIFS_DEBUG_MSG("Mark %i page(s) %s as%s%s\r\n", a_page_count,
+                    pifs_ba_pa2str(a_block_address, a_page_address),
+                    a_mark_used ? " used" : "",
+                    a_mark_to_be_released ? " to be released" : "");
+    page_idx = (a_block_address - PIFS_FLASH_BLOCK_RESERVED_NUM) * PIFS_LOGICAL_PAGE_PER_BLOCK + a_page_address;
+    end_page_idx = page_idx + a_page_count;
+    if (a_page_address >= PIFS_LOGICAL_PAGE_PER_BLOCK || end_page_idx > PIFS_LOGICAL_PAGE_NUM_FS)
+    {
+        PIFS_FATAL_ERROR_MSG("Invalid address %s, page count: %i\r\n",
+                             pifs_ba_pa2str(a_block_address, a_page_address), a_page_count);
+        ret = PIFS_ERROR_INTERNAL_RANGE;
+    }
+    while (page_idx < end_page_idx && ret == PIFS_SUCCESS)
     {
-        PIFS_DEBUG_MSG("Mark page %s as%s%s\r\n",
-                        pifs_ba_pa2str(a_block_address, a_page_address),
-                        a_mark_used ? " used" : "",
-                        a_mark_to_be_released ? " to be released" : "");
+        pifs_calc_address(page_idx << PIFS_FSBM_BITS_PER_PAGE_SHIFT, &a_block_address, &a_page_address);
         ret = pifs_calc_free_space_pos(&pifs.header.free_space_bitmap_address,
                                        a_block_address, a_page_address, &ba, &pa, &bit_pos);
-        //        PIFS_DEBUG_MSG("BA%i/PA%i/BITPOS%i\r\n", ba, pa, bit_pos);
         if (ret == PIFS_SUCCESS)
         {
+            /* Pages till end of range, end of free space bitmap's page or end of buffer */
+            buf_page_idx = (bit_pos % PIFS_BYTE_BITS) / PIFS_FSBM_BITS_PER_PAGE;
+            byte_num = PIFS_MIN(PIFS_LOGICAL_PAGE_SIZE_BYTE - bit_pos / PIFS_BYTE_BITS,
+                                PIFS_FSBM_MARK_BUF_SIZE_BYTE);
+            buf_page_num = PIFS_MIN(end_page_idx - page_idx,
+                                    byte_num * (PIFS_BYTE_BITS / PIFS_FSBM_BITS_PER_PAGE) - buf_page_idx);
+            byte_num = (buf_page_idx + buf_page_num + (PIFS_BYTE_BITS / PIFS_FSBM_BITS_PER_PAGE) - 1)
+                    / (PIFS_BYTE_BITS / PIFS_FSBM_BITS_PER_PAGE);
             /* Read actual status of free space memory bitmap (or cache) */
-            ret = pifs_read(ba, pa, 0, NULL, 0);
+            ret = pifs_read_fsbm(&pifs.header, ba, pa, bit_pos / PIFS_BYTE_BITS, buf8, byte_num);
         }
-        if (ret == PIFS_SUCCESS)
+        for (i = 0; i < byte_num && ret == PIFS_SUCCESS; i++)
         {
-            PIFS_ASSERT((bit_pos / PIFS_BYTE_BITS) < PIFS_LOGICAL_PAGE_SIZE_BYTE);
-            //print_buffer(pifs.cache_page_buf, sizeof(pifs.cache_page_buf), 0);
-            //PIFS_DEBUG_MSG("-Free space byte:    0x%02X\r\n", pifs.cache_page_buf[bit_pos / PIFS_BYTE_BITS]);
-            is_free_space = pifs.cache_page_buf[bit_pos / PIFS_BYTE_BITS] & (1u << (bit_pos % PIFS_BYTE_BITS));
-            is_not_to_be_released = pifs.cache_page_buf[bit_pos / PIFS_BYTE_BITS] & (1u << ((bit_pos % PIFS_BYTE_BITS) + 1));
-            //PIFS_DEBUG_MSG("-Free space bit:     %i\r\n", is_free_space);
-            //PIFS_DEBUG_MSG("-Release space bit:  %i\r\n", is_not_to_be_released);
-            //PIFS_DEBUG_MSG("-Free space bit:     %i\r\n", (pifs.cache_page_buf[bit_pos / PIFS_BYTE_BITS] >> (bit_pos % PIFS_BYTE_BITS)) & 1);
-            //PIFS_DEBUG_MSG("-Release space bit:  %i\r\n", (pifs.cache_page_buf[bit_pos / PIFS_BYTE_BITS] >> ((bit_pos % PIFS_BYTE_BITS) + 1)) & 1);
-            if (a_mark_used)
+            if ((i % sizeof(pifs_fsbm_word_t)) == 0 && i + sizeof(pifs_fsbm_word_t) < byte_num
+                    && (i > 0 || buf_page_idx == 0))
             {
-                /* Mark page used */
-                if (is_free_space)
+                /* All pages of the word shall be marked, mask is the same in every byte */
+                bits = buf[i / sizeof(pifs_fsbm_word_t)];
+                if (pifs_mark_bits(&bits, PIFS_FSBM_WORD_PAGE_MASK, a_mark_used, a_mark_to_be_released))
                 {
-                    //PIFS_NOTICE_MSG("MARK %s\r\n", pifs_ba_pa2str(a_block_address, a_page_address));
-                    /* Clear free bit */
-                    pifs.cache_page_buf[bit_pos / PIFS_BYTE_BITS] &= ~(1u << (bit_pos % PIFS_BYTE_BITS));
-                    is_free_space = FALSE;
+                    buf[i / sizeof(pifs_fsbm_word_t)] = bits;
+                    i += sizeof(pifs_fsbm_word_t) - 1;
+                    mask = 0;
                 }
                 else
                 {
-                    /* The space has already allocated */
-                    pifs_print_cache();
-                    PIFS_FATAL_ERROR_MSG("Page has already allocated! %s\r\n", pifs_ba_pa2str(a_block_address, a_page_address));
-                    ret = PIFS_ERROR_INTERNAL_ALLOCATION;
+                    mask = (uint8_t) PIFS_FSBM_WORD_PAGE_MASK;
                 }
             }
-            if (a_mark_to_be_released)
+            else
             {
-                /* Mark page to be released */
-                if (!is_free_space)
+                /* First and last byte can be partial */
+                mask = (uint8_t) PIFS_FSBM_WORD_PAGE_MASK;
+                if (i == 0)
                 {
-                    if (is_not_to_be_released)
-                    {
-                        /* Clear release bit */
-                        pifs.cache_page_buf[bit_pos / PIFS_BYTE_BITS] &= ~(1u << ((bit_pos % PIFS_BYTE_BITS) + 1));
-                    }
-                    else
-                    {
-                        /* The space has already marked to be released */
-                        pifs_print_cache();
-                        PIFS_FATAL_ERROR_MSG("Page has already marked to be released %s\r\n", pifs_ba_pa2str(a_block_address, a_page_address));
-                        ret = PIFS_ERROR_INTERNAL_ALLOCATION;
-                    }
+                    mask <<= buf_page_idx * PIFS_FSBM_BITS_PER_PAGE;
+                }
+                if (i == byte_num - 1 && (buf_page_idx + buf_page_num) % (PIFS_BYTE_BITS / PIFS_FSBM_BITS_PER_PAGE))
+                {
+                    mask &= (uint8_t) ((1u << (((buf_page_idx + buf_page_num) % (PIFS_BYTE_BITS / PIFS_FSBM_BITS_PER_PAGE))
+                                                * PIFS_FSBM_BITS_PER_PAGE)) - 1u);
+                }
+            }
+            if (mask)
+            {
+                bits = buf8[i];
+                if (pifs_mark_bits(&bits, mask, a_mark_used, a_mark_to_be_released))
+                {
+                    buf8[i] = (uint8_t) bits;
                 }
                 else
                 {
-                    /* The space has not yet allocated */
-                    pifs_print_cache();
-                    PIFS_FATAL_ERROR_MSG("Page has not yet allocated! %s\r\n", pifs_ba_pa2str(a_block_address, a_page_address));
+                    pifs_mark_page_error(page_idx - buf_page_idx + i * (PIFS_BYTE_BITS / PIFS_FSBM_BITS_PER_PAGE),
+                                         buf8[i], mask, a_mark_used, a_mark_to_be_released);
                     ret = PIFS_ERROR_INTERNAL_ALLOCATION;
                 }
             }
-            //PIFS_DEBUG_MSG("+Free space byte:    0x%02X\r\n", pifs.cache_page_buf[bit_pos / PIFS_BYTE_BITS]);
-            //PIFS_DEBUG_MSG("+Free space bit:     %i\r\n", (pifs.cache_page_buf[bit_pos / PIFS_BYTE_BITS] >> (bit_pos % PIFS_BYTE_BITS)) & 1);
-            //PIFS_DEBUG_MSG("+Release space bit:  %i\r\n", (pifs.cache_page_buf[bit_pos / PIFS_BYTE_BITS] >> ((bit_pos % PIFS_BYTE_BITS) + 1)) & 1);
-            /* Write new status to cache */
-            ret = pifs_write(ba, pa, 0, NULL, 0);
         }
-        a_page_count--;
-        if (a_page_count > 0)
+        if (ret == PIFS_SUCCESS)
         {
-            ret = pifs_inc_ba_pa(&a_block_address, &a_page_address);
+            /* Write new status to cache, only the changed bytes will be programmed */
+            ret = pifs_write_fsbm(ba, pa, bit_pos / PIFS_BYTE_BITS, buf8, byte_num);
         }
-        else
+#if PIFS_ENABLE_BLOCK_PAGE_CNTR
+        if (ret == PIFS_SUCCESS && pifs.is_page_cntr_valid)
         {
-            ret = pifs_flush();
+            pifs_page_cntr_update(page_idx, buf_page_num, a_mark_used, a_mark_to_be_released);
         }
+#endif
+        page_idx += buf_page_num;
+    }
+    if (ret == PIFS_SUCCESS && !pifs_is_in_transaction())
+    {
+        ret = pifs_flush();
     }
 
     return ret;
@@ -466,6 +1183,303 @@ pifs_status_t pifs_find_page(pifs_page_count_t a_page_count_minimum,
     return pifs_find_page_adv(&find, a_block_address, a_page_address, a_page_count_found);
 }
 
+#if PIFS_ENABLE_FREE_EXTENT_INDEX
+/**
+ * @brief pifs_free_extent_scan Find run of free pages in a block using RAM
+ * copy of free space bitmap.
+ *
+ * @param[in] a_block_idx   Index of block, 0: first block of file system.
+ * @param[in] a_run_min     Length of run to find.
+ * @param[out] a_run_start  Page index of first page of run.
+ * @return Length of first run which is at least a_run_min pages long.
+ * If there is no such run, length of longest run.
+ */
+static pifs_size_t pifs_free_extent_scan(pifs_size_t a_block_idx,
+                                         pifs_size_t a_run_min,
+                                         pifs_size_t * a_run_start)
+{
+    pifs_size_t page_idx = a_block_idx * PIFS_LOGICAL_PAGE_PER_BLOCK;
+    pifs_size_t end_page_idx = page_idx + PIFS_LOGICAL_PAGE_PER_BLOCK;
+    pifs_size_t run_end_page_idx;
+    pifs_size_t run_max = 0;
+
+    *a_run_start = end_page_idx;
+    while (page_idx < end_page_idx && run_max < a_run_min)
+    {
+        page_idx = pifs_fsbm_find_next(pifs.fsbm_shadow, page_idx, end_page_idx, TRUE, FALSE, TRUE);
+        run_end_page_idx = pifs_fsbm_find_next(pifs.fsbm_shadow, page_idx, end_page_idx, TRUE, FALSE, FALSE);
+        if (run_end_page_idx - page_idx > run_max)
+        {
+            run_max = run_end_page_idx - page_idx;
+            *a_run_start = page_idx;
+        }
+        page_idx = run_end_page_idx;
+    }
+
+    return run_max;
+}
+
+/**
+ * @brief pifs_free_extent_update Update longest free run of a block in
+ * free extent index. Blocks which are not data blocks have no free run.
+ *
+ * @param[in] a_block_idx   Index of block, 0: first block of file system.
+ */
+static void pifs_free_extent_update(pifs_size_t a_block_idx)
+{
+    pifs_size_t node = PIFS_FREE_EXTENT_LEAF_NUM + a_block_idx;
+    pifs_size_t run_start;
+
+    pifs.free_extent_tree[node] = 0;
+    if (pifs_is_block_type(a_block_idx + PIFS_FLASH_BLOCK_RESERVED_NUM, PIFS_BLOCK_TYPE_DATA, &pifs.header))
+    {
+        pifs.free_extent_tree[node] = pifs_free_extent_scan(a_block_idx, PIFS_LOGICAL_PAGE_PER_BLOCK + 1,
+                                                            &run_start);
+    }
+    while (node > 1)
+    {
+        node >>= 1;
+        pifs.free_extent_tree[node] = PIFS_MAX(pifs.free_extent_tree[node * 2],
+                                               pifs.free_extent_tree[node * 2 + 1]);
+    }
+}
+
+/**
+ * @brief pifs_free_extent_refresh Update blocks of free extent index which
+ * were changed since last update.
+ */
+static void pifs_free_extent_refresh(void)
+{
+    pifs_size_t i;
+    pifs_size_t j;
+
+    if (pifs.is_free_extent_dirty)
+    {
+        for (i = 0; i < sizeof(pifs.free_extent_dirty); i++)
+        {
+            for (j = 0; j < PIFS_BYTE_BITS && pifs.free_extent_dirty[i]; j++)
+            {
+                if (pifs.free_extent_dirty[i] & (1u << j))
+                {
+                    pifs_free_extent_update(i * PIFS_BYTE_BITS + j);
+                    pifs.free_extent_dirty[i] &= ~(1u << j);
+                }
+            }
+        }
+        pifs.is_free_extent_dirty = FALSE;
+    }
+}
+
+/**
+ * @brief pifs_free_extent_first Find first block which has a run of free
+ * pages with the given length. Time of search is logarithmic.
+ *
+ * @param[in] a_block_idx   Index of first block to check.
+ * @param[in] a_run_min     Length of run to find. Shall not be zero.
+ * @return Index of block found or PIFS_FREE_EXTENT_LEAF_NUM if not found.
+ */
+static pifs_size_t pifs_free_extent_first(pifs_size_t a_block_idx, pifs_size_t a_run_min)
+{
+    pifs_size_t block_idx = PIFS_FREE_EXTENT_LEAF_NUM;
+    pifs_size_t node = PIFS_FREE_EXTENT_LEAF_NUM + a_block_idx;
+    bool_t      found = FALSE;
+
+    if (a_block_idx < PIFS_FREE_EXTENT_LEAF_NUM)
+    {
+        found = (pifs.free_extent_tree[node] >= a_run_min);
+        while (!found && node > 1)
+        {
+            /* Go up until node has a right sibling */
+            while (node > 1 && (node & 1))
+            {
+                node >>= 1;
+            }
+            if (node > 1)
+            {
+                node++;
+                found = (pifs.free_extent_tree[node] >= a_run_min);
+            }
+        }
+        if (found)
+        {
+            /* Go down to the leftmost leaf with long enough run */
+            while (node < PIFS_FREE_EXTENT_LEAF_NUM)
+            {
+                node *= 2;
+                if (pifs.free_extent_tree[node] < a_run_min)
+                {
+                    node++;
+                }
+            }
+            block_idx = node - PIFS_FREE_EXTENT_LEAF_NUM;
+        }
+    }
+
+    return block_idx;
+}
+
+/**
+ * @brief pifs_free_extent_max Get length of longest run of free pages in
+ * a range of blocks. Time of search is logarithmic.
+ *
+ * @param[in] a_start_block_idx Index of first block.
+ * @param[in] a_end_block_idx   Index of last block.
+ * @return Length of longest run.
+ */
+static pifs_size_t pifs_free_extent_max(pifs_size_t a_start_block_idx, pifs_size_t a_end_block_idx)
+{
+    pifs_size_t left = PIFS_FREE_EXTENT_LEAF_NUM + a_start_block_idx;
+    pifs_size_t right = PIFS_FREE_EXTENT_LEAF_NUM + a_end_block_idx + 1;
+    pifs_size_t run_max = 0;
+
+    while (left < right)
+    {
+        if (left & 1)
+        {
+            run_max = PIFS_MAX(run_max, pifs.free_extent_tree[left]);
+            left++;
+        }
+        if (right & 1)
+        {
+            right--;
+            run_max = PIFS_MAX(run_max, pifs.free_extent_tree[right]);
+        }
+        left >>= 1;
+        right >>= 1;
+    }
+
+    return run_max;
+}
+
+/**
+ * @brief pifs_free_extent_build Build free extent index from RAM copy of
+ * free space bitmap. Shall be called when the file system header is changed.
+ */
+void pifs_free_extent_build(void)
+{
+    pifs_size_t i;
+
+    pifs.is_free_extent_valid = FALSE;
+    if (pifs.is_fsbm_shadow_valid)
+    {
+        memset(pifs.free_extent_tree, 0, sizeof(pifs.free_extent_tree));
+        for (i = 0; i < PIFS_FLASH_BLOCK_NUM_FS; i++)
+        {
+            pifs_free_extent_update(i);
+        }
+        memset(pifs.free_extent_dirty, 0, sizeof(pifs.free_extent_dirty));
+        pifs.is_free_extent_dirty = FALSE;
+        pifs.is_free_extent_valid = TRUE;
+    }
+}
+
+/**
+ * @brief pifs_free_extent_invalidate Stop using free extent index until
+ * pifs_free_extent_build() is called.
+ */
+void pifs_free_extent_invalidate(void)
+{
+    pifs.is_free_extent_valid = FALSE;
+}
+
+/**
+ * @brief pifs_find_page_extent Find free data pages using free extent index.
+ * Blocks are checked from the start block to the end block and the first
+ * run of 'page_count_desired' pages is used (first fit). If there is no such
+ * run, but there is one with at least 'page_count_minimum' pages, the rest of
+ * file system is checked like in pifs_find_page_adv() and if it fails the
+ * longest run is used (best fit). Runs do not cross block boundary.
+ *
+ * @param[in] a_find                Find parameters.
+ * @param[in] a_start_block_address Corrected start block address.
+ * @param[out] a_block_address      Block address of page(s).
+ * @param[out] a_page_address       Page address of page(s).
+ * @param[out] a_page_count_found   Number of free pages found.
+ * @return PIFS_SUCCESS: if free pages found. PIFS_ERROR_NO_MORE_SPACE: if no free pages found.
+ */
+static pifs_status_t pifs_find_page_extent(pifs_find_t * a_find,
+                                           pifs_block_address_t a_start_block_address,
+                                           pifs_block_address_t * a_block_address,
+                                           pifs_page_address_t * a_page_address,
+                                           pifs_page_count_t * a_page_count_found)
+{
+    pifs_status_t           ret = PIFS_SUCCESS;
+    pifs_size_t             start_block_idx = a_start_block_address - PIFS_FLASH_BLOCK_RESERVED_NUM;
+    pifs_size_t             end_block_idx;
+    pifs_size_t             block_idx;
+    pifs_size_t             page_idx = 0;
+    pifs_size_t             run = 0;
+    pifs_size_t             page_count_desired = PIFS_MIN(a_find->page_count_desired, PIFS_LOGICAL_PAGE_PER_BLOCK);
+    pifs_block_address_t    fba = PIFS_BLOCK_ADDRESS_INVALID;
+    pifs_page_address_t     fpa = PIFS_PAGE_ADDRESS_INVALID;
+    bool_t                  found = FALSE;
+#if PIFS_CHECK_IF_PAGE_IS_ERASED
+    pifs_size_t             i;
+#endif
+
+    /* Search stops after end block if no pages were found */
+    end_block_idx = PIFS_MIN(PIFS_MAX(a_find->end_block_address, a_start_block_address),
+                             PIFS_FLASH_BLOCK_NUM_ALL - 1) - PIFS_FLASH_BLOCK_RESERVED_NUM;
+    while (ret == PIFS_SUCCESS && !found)
+    {
+        pifs_free_extent_refresh();
+        block_idx = pifs_free_extent_first(start_block_idx, page_count_desired);
+        if (block_idx > end_block_idx)
+        {
+            run = pifs_free_extent_max(start_block_idx, end_block_idx);
+            if (run >= a_find->page_count_minimum)
+            {
+                block_idx = pifs_free_extent_first(end_block_idx + 1, page_count_desired);
+                if (block_idx >= PIFS_FLASH_BLOCK_NUM_FS)
+                {
+                    /* Best fit */
+                    run = pifs_free_extent_max(start_block_idx, PIFS_FLASH_BLOCK_NUM_FS - 1);
+                    block_idx = pifs_free_extent_first(start_block_idx, run);
+                }
+            }
+            else
+            {
+                ret = PIFS_ERROR_NO_MORE_SPACE;
+            }
+        }
+        if (ret == PIFS_SUCCESS)
+        {
+            run = pifs_free_extent_scan(block_idx, page_count_desired, &page_idx);
+            run = PIFS_MIN(run, page_count_desired);
+            pifs_calc_address(page_idx << PIFS_FSBM_BITS_PER_PAGE_SHIFT, &fba, &fpa);
+            found = TRUE;
+#if PIFS_CHECK_IF_PAGE_IS_ERASED
+            for (i = 0; i < run && found; i++)
+            {
+                if (!pifs_is_free_page_erased(fba, fpa + i))
+                {
+                    PIFS_WARNING_MSG("Flash page should be erased, but it is not! %s\r\n", pifs_ba_pa2str(fba, fpa + i));
+                    /* Mark page as used */
+                    /* Mark page as to be released as this page should erased */
+                    /* Index is updated and search is repeated */
+                    (void)pifs_mark_page(fba, fpa + i, 1, TRUE, TRUE);
+                    found = FALSE;
+                }
+            }
+#endif
+        }
+    }
+
+    if (ret == PIFS_SUCCESS && !run)
+    {
+        ret = PIFS_ERROR_NO_MORE_SPACE;
+    }
+    if (ret == PIFS_SUCCESS)
+    {
+        *a_block_address = fba;
+        *a_page_address = fpa;
+        *a_page_count_found = run;
+    }
+
+    return ret;
+}
+#endif
+
 /**
  * @brief pifs_find_page_adv Find free or to be released page(s) in free space
  * memory bitmap. Advanced version.
@@ -483,20 +1497,19 @@ pifs_status_t pifs_find_page_adv(pifs_find_t * a_find,
                                  pifs_page_address_t * a_page_address,
                                  pifs_page_count_t * a_page_count_found)
 {
-    pifs_status_t           ret = PIFS_ERROR_NO_MORE_SPACE;
+    pifs_status_t           ret = PIFS_SUCCESS;
     pifs_block_address_t    fba = a_find->start_block_address;
     pifs_page_address_t     fpa = 0;
     pifs_block_address_t    fba_start = PIFS_BLOCK_ADDRESS_INVALID;
     pifs_page_address_t     fpa_start = PIFS_PAGE_ADDRESS_INVALID;
-    pifs_block_address_t    fsbm_ba = a_find->header->free_space_bitmap_address.block_address;
-    pifs_page_address_t     fsbm_pa = a_find->header->free_space_bitmap_address.page_address;
-    pifs_page_offset_t      po = 0;
-    pifs_size_t             i;
+    pifs_size_t             page_idx;
+    pifs_size_t             limit_page_idx;
+    pifs_size_t             buf_page_idx = PIFS_LOGICAL_PAGE_NUM_FS;
+    pifs_size_t             buf_end_page_idx = PIFS_LOGICAL_PAGE_NUM_FS;
+    pifs_size_t             bit_idx;
     pifs_page_count_t       page_count_found = 0;
-    uint8_t                 free_space_bitmap = 0;
+    uint8_t                 free_space_bitmap[PIFS_FSBM_SCAN_BUF_SIZE_BYTE];
     bool_t                  found = FALSE;
-    pifs_size_t             byte_cntr = PIFS_FREE_SPACE_BITMAP_SIZE_BYTE;
-    pifs_bit_pos_t          bit_pos = 0;
 
     PIFS_ASSERT(pifs.is_header_found);
 
@@ -512,25 +1525,59 @@ pifs_status_t pifs_find_page_adv(pifs_find_t * a_find,
     }
 
     *a_page_count_found = 0;
-    ret = pifs_calc_free_space_pos(&a_find->header->free_space_bitmap_address,
-                                   fba, fpa, &fsbm_ba, &fsbm_pa, &bit_pos);
-    if (ret == PIFS_SUCCESS)
+#if PIFS_ENABLE_FREE_EXTENT_INDEX
+    if (pifs.is_free_extent_valid && pifs.is_fsbm_shadow_valid && a_find->header == &pifs.header
+            && a_find->is_free && !a_find->is_to_be_released
+            && a_find->block_type == PIFS_BLOCK_TYPE_DATA
+            && a_find->page_count_minimum <= PIFS_LOGICAL_PAGE_PER_BLOCK)
+    {
+        ret = pifs_find_page_extent(a_find, fba, a_block_address, a_page_address, a_page_count_found);
+    }
+    else
+#endif
     {
-        po = bit_pos / PIFS_BYTE_BITS;
+        page_idx = (fba - PIFS_FLASH_BLOCK_RESERVED_NUM) * PIFS_LOGICAL_PAGE_PER_BLOCK;
+        /* Search stops after end block if no pages were found */
+        limit_page_idx = (PIFS_MAX(a_find->end_block_address, fba) + 1 - PIFS_FLASH_BLOCK_RESERVED_NUM)
+                * PIFS_LOGICAL_PAGE_PER_BLOCK;
+        limit_page_idx = PIFS_MIN(limit_page_idx, PIFS_LOGICAL_PAGE_NUM_FS);
 
-        do
+        while (ret == PIFS_SUCCESS && !found && page_idx < PIFS_LOGICAL_PAGE_NUM_FS)
         {
-            ret = pifs_read(fsbm_ba, fsbm_pa, po, &free_space_bitmap, sizeof(free_space_bitmap));
-            if (ret == PIFS_SUCCESS)
+            if (page_idx < buf_page_idx || page_idx >= buf_end_page_idx)
             {
-                //PIFS_DEBUG_MSG("%s %i 0x%X\r\n", pifs_ba_pa2str(ba, pa), po, free_space_bitmap);
-                for (i = 0; i < (PIFS_BYTE_BITS / PIFS_FSBM_BITS_PER_PAGE) && !found; i++)
+                /* Bitmap is read in chunks and checked a word at a time */
+                buf_page_idx = page_idx - (page_idx % PIFS_FSBM_SCAN_BUF_PAGES);
+                buf_end_page_idx = PIFS_MIN(buf_page_idx + PIFS_FSBM_SCAN_BUF_PAGES, PIFS_LOGICAL_PAGE_NUM_FS);
+                ret = pifs_read_fsbm_pages(a_find->header, buf_page_idx, free_space_bitmap);
+            }
+            if (ret == PIFS_SUCCESS && !page_count_found)
+            {
+                /* Skip pages which cannot start a new run */
+                page_idx = buf_page_idx + pifs_fsbm_find_next(free_space_bitmap,
+                                                              page_idx - buf_page_idx,
+                                                              buf_end_page_idx - buf_page_idx,
+                                                              a_find->is_free,
+                                                              a_find->is_to_be_released,
+                                                              TRUE);
+            }
+            if (ret == PIFS_SUCCESS && page_idx < buf_end_page_idx)
+            {
+                pifs_calc_address(page_idx << PIFS_FSBM_BITS_PER_PAGE_SHIFT, &fba, &fpa);
+                bit_idx = (page_idx - buf_page_idx) << PIFS_FSBM_BITS_PER_PAGE_SHIFT;
+                if (!pifs_is_block_type(fba, a_find->block_type, a_find->header))
+                {
+                    /* Skip whole block */
+                    page_count_found = 0;
+                    page_idx += PIFS_LOGICAL_PAGE_PER_BLOCK - fpa;
+                }
+                else
                 {
-                    if (pifs_check_bits(a_find->is_free, a_find->is_to_be_released, free_space_bitmap)
-                            && pifs_is_block_type(fba, a_find->block_type, a_find->header))
+                    if (pifs_check_bits(a_find->is_free, a_find->is_to_be_released,
+                                        free_space_bitmap[bit_idx / PIFS_BYTE_BITS] >> (bit_idx % PIFS_BYTE_BITS)))
                     {
 #if PIFS_CHECK_IF_PAGE_IS_ERASED
-                        if (a_find->is_to_be_released || (a_find->is_free && pifs_is_page_erased(fba, fpa)))
+                        if (a_find->is_to_be_released || (a_find->is_free && pifs_is_free_page_erased(fba, fpa)))
 #endif
                         {
                             PIFS_DEBUG_MSG("Free page %s\r\n", pifs_ba_pa2str(fba, fpa));
@@ -557,22 +1604,6 @@ pifs_status_t pifs_find_page_adv(pifs_find_t * a_find,
                         else
                         {
                             PIFS_WARNING_MSG("Flash page should be erased, but it is not! %s\r\n", pifs_ba_pa2str(fba, fpa));
-#if 0
-                            /* FIXME debug code, remove! */
-                            {
-                                uint8_t buf_r[PIFS_LOGICAL_PAGE_SIZE_BYTE];
-                                ret = pifs_flash_read(fba, fpa, 0, buf_r, sizeof(buf_r));
-                                if (ret == PIFS_SUCCESS)
-                                {
-                                    print_buffer(buf_r, sizeof(buf_r), fba * PIFS_FLASH_BLOCK_SIZE_BYTE
-                                                 + fpa * PIFS_LOGICAL_PAGE_SIZE_BYTE);
-                                }
-                                else
-                                {
-                                    printf("ERROR: Cannot read from flash memory, error code: %i!\r\n", ret);
-                                }
-                            }
-#endif
                             /* Mark page as used */
                             /* Mark page as to be released as this page should erased */
                             (void)pifs_mark_page(fba, fpa, 1, TRUE, TRUE);
@@ -585,42 +1616,25 @@ pifs_status_t pifs_find_page_adv(pifs_find_t * a_find,
                     }
                     if (!found)
                     {
-                        free_space_bitmap >>= PIFS_FSBM_BITS_PER_PAGE;
-                        fpa++;
-                        if (fpa == PIFS_LOGICAL_PAGE_PER_BLOCK)
-                        {
-                            fpa = 0;
-                            fba++;
-                            if (a_find->is_same_block
-                                    && (a_find->page_count_minimum < PIFS_LOGICAL_PAGE_PER_BLOCK
-                                        || (fpa_start > 0 && a_find->page_count_desired >= PIFS_LOGICAL_PAGE_PER_BLOCK)))
-                            {
-                                page_count_found = 0;
-                            }
-                            if ((fba >= PIFS_FLASH_BLOCK_NUM_ALL || fba > a_find->end_block_address) && !(*a_page_count_found))
-                            {
-                                ret = PIFS_ERROR_NO_MORE_SPACE;
-                            }
-                        }
+                        page_idx++;
                     }
                 }
-                po++;
-                if (po == PIFS_LOGICAL_PAGE_SIZE_BYTE)
+                if (!found && (page_idx % PIFS_LOGICAL_PAGE_PER_BLOCK) == 0)
                 {
-                    po = 0;
-                    fsbm_pa++;
-                    if (fsbm_pa == PIFS_LOGICAL_PAGE_PER_BLOCK)
+                    /* Next block */
+                    if (a_find->is_same_block
+                            && (a_find->page_count_minimum < PIFS_LOGICAL_PAGE_PER_BLOCK
+                                || (fpa_start > 0 && a_find->page_count_desired >= PIFS_LOGICAL_PAGE_PER_BLOCK)))
                     {
-                        fsbm_pa = 0;
-                        fsbm_ba++;
-                        if (fsbm_ba >= PIFS_FLASH_BLOCK_NUM_ALL)
-                        {
-                            PIFS_FATAL_ERROR_MSG("End of flash! byte_cntr: %lu\r\n", byte_cntr);
-                        }
+                        page_count_found = 0;
                     }
                 }
             }
-        } while (byte_cntr-- > 0 && ret == PIFS_SUCCESS && !found && fba < PIFS_FLASH_BLOCK_NUM_ALL);
+            if (!found && page_idx >= limit_page_idx && !(*a_page_count_found))
+            {
+                ret = PIFS_ERROR_NO_MORE_SPACE;
+            }
+        }
     }
 
     if (ret == PIFS_SUCCESS && !(*a_page_count_found))
@@ -715,20 +1729,31 @@ pifs_status_t pifs_find_to_be_released_block(pifs_size_t a_block_count,
     pifs_page_count_t    page_count;
     pifs_find_t          find;
 
-    find.page_count_minimum = a_block_count * PIFS_LOGICAL_PAGE_PER_BLOCK;
-    find.page_count_desired = a_block_count * PIFS_LOGICAL_PAGE_PER_BLOCK;
-    find.block_type = a_block_type;
-    find.is_free = TRUE;
-    find.is_to_be_released = TRUE;
-    find.is_same_block = TRUE;
-    find.start_block_address = a_start_block_address;
-    find.end_block_address = a_end_block_address;
-    find.header = a_header;
+#if PIFS_ENABLE_BLOCK_PAGE_CNTR
+    if (pifs.is_page_cntr_valid && a_header == &pifs.header)
+    {
+        ret = pifs_find_to_be_released_block_cntr(a_block_count, a_block_type,
+                                                  a_start_block_address, a_end_block_address,
+                                                  &ba);
+    }
+    else
+#endif
+    {
+        find.page_count_minimum = a_block_count * PIFS_LOGICAL_PAGE_PER_BLOCK;
+        find.page_count_desired = a_block_count * PIFS_LOGICAL_PAGE_PER_BLOCK;
+        find.block_type = a_block_type;
+        find.is_free = TRUE;
+        find.is_to_be_released = TRUE;
+        find.is_same_block = TRUE;
+        find.start_block_address = a_start_block_address;
+        find.end_block_address = a_end_block_address;
+        find.header = a_header;
 
-    ret = pifs_find_page_adv(&find, &ba, &pa, &page_count);
-    PIFS_DEBUG_MSG("%i..%i ret: %i, page_count: %i\r\n",
-                     a_start_block_address, a_end_block_address,
-                     ret, page_count);
+        ret = pifs_find_page_adv(&find, &ba, &pa, &page_count);
+        PIFS_DEBUG_MSG("%i..%i ret: %i, page_count: %i\r\n",
+                         a_start_block_address, a_end_block_address,
+                         ret, page_count);
+    }
 
     *a_block_address = ba;
 
@@ -753,91 +1778,65 @@ pifs_status_t pifs_get_pages(bool_t a_is_free,
                              pifs_size_t * a_management_page_count,
                              pifs_size_t * a_data_page_count)
 {
-    pifs_status_t           ret = PIFS_ERROR_NO_MORE_SPACE;
+    pifs_status_t           ret = PIFS_SUCCESS;
     pifs_block_address_t    fba = a_start_block_address;
-    pifs_page_address_t     fpa = 0;
-    pifs_block_address_t    fsbm_ba = pifs.header.free_space_bitmap_address.block_address;
-    pifs_page_address_t     fsbm_pa = pifs.header.free_space_bitmap_address.page_address;
-    pifs_page_offset_t      po = 0;
-    pifs_size_t             i;
-    uint8_t                 free_space_bitmap = 0;
-    bool_t                  end = FALSE;
-    pifs_size_t             byte_cntr = PIFS_FREE_SPACE_BITMAP_SIZE_BYTE;
-    pifs_bit_pos_t          bit_pos = 0;
-    uint8_t                 mask = 1; /**< Mask for finding free page */
-    uint8_t                 value = 1; /**< Value for finding free page */
+    pifs_size_t             page_idx;
+    pifs_size_t             end_page_idx;
+    pifs_size_t             chunk_end_page_idx;
+    pifs_size_t             buf_page_idx = PIFS_LOGICAL_PAGE_NUM_FS;
+    pifs_size_t           * page_count;
+    uint8_t                 free_space_bitmap[PIFS_FSBM_SCAN_BUF_SIZE_BYTE];
 
     PIFS_ASSERT(pifs.is_header_found);
 
-    if (!a_is_free)
-    {
-        /* Find to be released page */
-        mask = 2;
-        value = 0;
-    }
-
     *a_management_page_count = 0;
     *a_data_page_count = 0;
 
-    ret = pifs_calc_free_space_pos(&pifs.header.free_space_bitmap_address,
-                                   fba, fpa, &fsbm_ba, &fsbm_pa, &bit_pos);
-    if (ret == PIFS_SUCCESS)
+#if PIFS_ENABLE_BLOCK_PAGE_CNTR
+    if (pifs.is_page_cntr_valid)
     {
-        po = bit_pos / PIFS_BYTE_BITS;
-
-        do
+        pifs_get_pages_cntr(a_is_free, a_start_block_address, a_block_count,
+                            a_management_page_count, a_data_page_count);
+    }
+    else
+#endif
+    {
+        while (ret == PIFS_SUCCESS && fba < PIFS_FLASH_BLOCK_NUM_ALL && a_block_count)
         {
-            ret = pifs_read(fsbm_ba, fsbm_pa, po, &free_space_bitmap, sizeof(free_space_bitmap));
-            if (ret == PIFS_SUCCESS)
+            page_count = NULL;
+            if (pifs_is_block_type(fba, PIFS_BLOCK_TYPE_DATA, &pifs.header))
             {
-#if PIFS_DEBUG_LEVEL >= 6
-                printf("%s ", pifs_byte2bin_str(free_space_bitmap));
-                if (((po + 1) % 8) == 0)
-                {
-                    printf("\r\n");
-                }
-#endif
-                for (i = 0; i < (PIFS_BYTE_BITS / PIFS_FSBM_BITS_PER_PAGE) && !end; i++)
+                page_count = a_data_page_count;
+            }
+            else if (pifs_is_block_type(fba, PIFS_BLOCK_TYPE_PRIMARY_MANAGEMENT, &pifs.header))
+            {
+                /* Only count primary management, because secondary */
+                /* management pages will be used when this management */
+                /* area is full. */
+                page_count = a_management_page_count;
+            }
+            page_idx = (fba - PIFS_FLASH_BLOCK_RESERVED_NUM) * PIFS_LOGICAL_PAGE_PER_BLOCK;
+            end_page_idx = page_idx + PIFS_LOGICAL_PAGE_PER_BLOCK;
+            while (page_count && ret == PIFS_SUCCESS && page_idx < end_page_idx)
+            {
+                if (page_idx < buf_page_idx || page_idx >= buf_page_idx + PIFS_FSBM_SCAN_BUF_PAGES)
                 {
-                    if ((free_space_bitmap & mask) == value)
-                    {
-                        if (pifs_is_block_type(fba, PIFS_BLOCK_TYPE_DATA, &pifs.header))
-                        {
-                            (*a_data_page_count)++;
-                        }
-                        else if (pifs_is_block_type(fba, PIFS_BLOCK_TYPE_PRIMARY_MANAGEMENT, &pifs.header))
-                        {
-                            /* Only count primary management, because secondary */
-                            /* management pages will be used when this management */
-                            /* area is full. */
-                            (*a_management_page_count)++;
-                        }
-                    }
-                    free_space_bitmap >>= PIFS_FSBM_BITS_PER_PAGE;
-                    bit_pos += PIFS_FSBM_BITS_PER_PAGE;
-                    fpa++;
-                    if (fpa == PIFS_LOGICAL_PAGE_PER_BLOCK)
-                    {
-                        fpa = 0;
-                        fba++;
-                        a_block_count--;
-                        if (fba >= PIFS_FLASH_BLOCK_NUM_ALL || !a_block_count)
-                        {
-                            end = TRUE;
-                        }
-                    }
+                    /* Bitmap is read in chunks and counted a word at a time */
+                    buf_page_idx = page_idx - (page_idx % PIFS_FSBM_SCAN_BUF_PAGES);
+                    ret = pifs_read_fsbm_pages(&pifs.header, buf_page_idx, free_space_bitmap);
                 }
-                if (!end)
+                chunk_end_page_idx = PIFS_MIN(buf_page_idx + PIFS_FSBM_SCAN_BUF_PAGES, end_page_idx);
+                if (ret == PIFS_SUCCESS)
                 {
-                    po++;
-                    if (po == PIFS_LOGICAL_PAGE_SIZE_BYTE)
-                    {
-                        po = 0;
-                        ret = pifs_inc_ba_pa(&fsbm_ba, &fsbm_pa);
-                    }
+                    *page_count += pifs_fsbm_count(free_space_bitmap, page_idx - buf_page_idx,
+                                                   chunk_end_page_idx - buf_page_idx,
+                                                   a_is_free, !a_is_free);
                 }
+                page_idx = chunk_end_page_idx;
             }
-        } while (byte_cntr-- > 0 && ret == PIFS_SUCCESS && !end);
+            fba++;
+            a_block_count--;
+        }
     }
 
     return ret;
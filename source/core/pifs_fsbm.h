@@ -34,6 +34,13 @@
 extern "C" {
 #endif
 
+/** Machine word used for scanning free space bitmap */
+#if UINTPTR_MAX > 0xFFFFFFFFu
+typedef uint64_t pifs_fsbm_word_t;
+#else
+typedef uint32_t pifs_fsbm_word_t;
+#endif
+
 typedef struct
 {
     pifs_page_count_t    page_count_minimum;  /**< Number of pages needed at least. */
@@ -57,6 +64,17 @@ pifs_status_t pifs_calc_free_space_pos(const pifs_address_t * a_free_space_bitma
 void pifs_calc_address(pifs_bit_pos_t a_bit_pos,
                        pifs_block_address_t * a_block_address,
                        pifs_page_address_t * a_page_address);
+pifs_size_t pifs_fsbm_find_next(const uint8_t * a_bitmap,
+                                pifs_size_t a_start_page_idx,
+                                pifs_size_t a_end_page_idx,
+                                bool_t a_is_free,
+                                bool_t a_is_to_be_released,
+                                bool_t a_is_match);
+pifs_size_t pifs_fsbm_count(const uint8_t * a_bitmap,
+                            pifs_size_t a_start_page_idx,
+                            pifs_size_t a_end_page_idx,
+                            bool_t a_is_free,
+                            bool_t a_is_to_be_released);
 bool_t pifs_is_page_free(pifs_block_address_t a_block_address,
                          pifs_page_address_t a_page_address);
 bool_t pifs_is_page_to_be_released(pifs_block_address_t a_block_address,
@@ -104,6 +122,18 @@ pifs_status_t pifs_get_to_be_released_pages(pifs_size_t * a_free_management_page
                                             pifs_size_t * a_free_data_page_count);
 pifs_status_t pifs_get_free_pages(pifs_size_t * a_free_management_page_count,
                                   pifs_size_t * a_free_data_page_count);
+#if PIFS_ENABLE_FSBM_SHADOW
+pifs_status_t pifs_fsbm_shadow_load(void);
+void pifs_fsbm_shadow_invalidate(void);
+#endif
+#if PIFS_ENABLE_BLOCK_PAGE_CNTR
+void pifs_page_cntr_build(void);
+void pifs_page_cntr_invalidate(void);
+#endif
+#if PIFS_ENABLE_FREE_EXTENT_INDEX
+void pifs_free_extent_build(void);
+void pifs_free_extent_invalidate(void);
+#endif
 
 #ifdef __cplusplus
 }
@@ -165,15 +165,26 @@ char * pifs_byte2bin_str(uint8_t byte)
 #endif
 
 /**
- * @brief pifs_print_cache Print content of page buffer.
+ * @brief pifs_print_cache Print content of used page cache slots.
  */
 void pifs_print_cache(void)
 {
 #if PIFS_DEBUG_LEVEL >= 3
-    PIFS_NOTICE_MSG("Cache page buffer:\r\n");
-    print_buffer(pifs.cache_page_buf, sizeof(pifs.cache_page_buf),
-                 pifs.cache_page_buf_address.block_address * PIFS_FLASH_BLOCK_SIZE_BYTE
-                 + pifs.cache_page_buf_address.page_address * PIFS_LOGICAL_PAGE_SIZE_BYTE);
+    pifs_size_t i;
+
+    for (i = 0; i < PIFS_CACHE_PAGE_NUM; i++)
+    {
+        if (pifs.cache[i].address.block_address < PIFS_BLOCK_ADDRESS_INVALID)
+        {
+            PIFS_NOTICE_MSG("Cache page buffer %lu %s%s%s:\r\n", i,
+                            pifs_address2str(&pifs.cache[i].address),
+                            pifs.cache[i].is_dirty ? " dirty" : "",
+                            pifs.cache[i].buf == pifs.cache_page_buf ? " last" : "");
+            print_buffer(pifs.cache[i].buf, sizeof(pifs.cache[i].buf),
+                         pifs.cache[i].address.block_address * PIFS_FLASH_BLOCK_SIZE_BYTE
+                         + pifs.cache[i].address.page_address * PIFS_LOGICAL_PAGE_SIZE_BYTE);
+        }
+    }
 #endif
 }
 
@@ -262,7 +273,7 @@ pifs_status_t pifs_print_map_page(pifs_block_address_t a_block_address,
             a_block_address = map_header.next_map_address.block_address;
             a_page_address = map_header.next_map_address.page_address;
         }
-        ret = pifs_read(a_block_address, a_page_address, 0, &map_header, PIFS_MAP_HEADER_SIZE_BYTE);
+        ret = pifs_read(a_block_address, a_page_address, 0, &map_header, PIFS_MAP_HEADER_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
         if (ret == PIFS_SUCCESS)
         {
             printf("Previous map: %s\r\n", pifs_address2str(&map_header.prev_map_address));
@@ -272,7 +283,7 @@ pifs_status_t pifs_print_map_page(pifs_block_address_t a_block_address,
             {
                 /* Go through all map entries in the page */
                 ret = pifs_read(a_block_address, a_page_address, PIFS_MAP_HEADER_SIZE_BYTE + i * PIFS_MAP_ENTRY_SIZE_BYTE,
-                                &map_entry, PIFS_MAP_ENTRY_SIZE_BYTE);
+                                &map_entry, PIFS_MAP_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
                 if (ret == PIFS_SUCCESS)
                 {
                     if (!pifs_is_buffer_erased(&map_entry, PIFS_MAP_ENTRY_SIZE_BYTE))
@@ -400,7 +411,8 @@ bool_t pifs_is_buffer_erased(const void * a_buf, pifs_size_t a_buf_size)
 }
 
 /**
- * @brief pifs_is_page_erased Checks if the given block address is block type.
+ * @brief pifs_is_page_erased Checks if the given page is erased.
+ * Page is read by flash pages and no cache slot is allocated for it.
  * @param[in] a_block_address Block address to check.
  * @param[in] a_page_address  Page address to check.
  * @return TRUE: If page is erased.
@@ -408,14 +420,102 @@ bool_t pifs_is_buffer_erased(const void * a_buf, pifs_size_t a_buf_size)
 bool_t pifs_is_page_erased(pifs_block_address_t a_block_address,
                            pifs_page_address_t a_page_address)
 {
-    pifs_status_t status;
-    bool_t is_erased = FALSE;
+    pifs_status_t      status = PIFS_SUCCESS;
+    bool_t             is_erased = TRUE;
+    uint8_t            buf[PIFS_FLASH_PAGE_SIZE_BYTE];
+    pifs_page_offset_t po;
+
+    /* Page is read by one flash command per flash page without using a */
+    /* cache slot, checking stops at first programmed flash page */
+    for (po = 0; po < PIFS_LOGICAL_PAGE_SIZE_BYTE && is_erased && status == PIFS_SUCCESS; po += sizeof(buf))
+    {
+        status = pifs_read_uncached(a_block_address, a_page_address, po, buf, sizeof(buf));
+        if (status == PIFS_SUCCESS)
+        {
+            is_erased = pifs_is_buffer_erased(buf, sizeof(buf));
+        }
+    }
 
-    status = pifs_read(a_block_address, a_page_address, 0, NULL, 0);
-    if (status == PIFS_SUCCESS)
+    return (status == PIFS_SUCCESS) ? is_erased : FALSE;
+}
+
+#if PIFS_CHECK_IF_PAGE_IS_ERASED && PIFS_ENABLE_ERASED_PAGE_BITMAP
+/**
+ * @brief pifs_mark_page_erased Remember that page(s) are erased.
+ *
+ * @param[in] a_block_address   Block address of page(s).
+ * @param[in] a_page_address    Page address of page(s).
+ * @param[in] a_page_count      Number of pages.
+ */
+void pifs_mark_page_erased(pifs_block_address_t a_block_address,
+                           pifs_page_address_t a_page_address,
+                           pifs_page_count_t a_page_count)
+{
+    pifs_size_t page_idx = (a_block_address - PIFS_FLASH_BLOCK_RESERVED_NUM) * PIFS_LOGICAL_PAGE_PER_BLOCK
+            + a_page_address;
+
+    while (a_page_count-- && page_idx < PIFS_LOGICAL_PAGE_NUM_FS)
     {
-        is_erased = pifs_is_buffer_erased(pifs.cache_page_buf, PIFS_LOGICAL_PAGE_SIZE_BYTE);
+        pifs.erased_page_bitmap[page_idx / PIFS_BYTE_BITS] |= 1u << (page_idx % PIFS_BYTE_BITS);
+        page_idx++;
     }
+}
+
+/**
+ * @brief pifs_mark_page_programmed Forget that page is erased. Shall be
+ * called when page is written.
+ *
+ * @param[in] a_block_address   Block address of page.
+ * @param[in] a_page_address    Page address of page.
+ */
+void pifs_mark_page_programmed(pifs_block_address_t a_block_address,
+                               pifs_page_address_t a_page_address)
+{
+    pifs_size_t page_idx = (a_block_address - PIFS_FLASH_BLOCK_RESERVED_NUM) * PIFS_LOGICAL_PAGE_PER_BLOCK
+            + a_page_address;
+
+    if (page_idx < PIFS_LOGICAL_PAGE_NUM_FS)
+    {
+        pifs.erased_page_bitmap[page_idx / PIFS_BYTE_BITS] &= ~(1u << (page_idx % PIFS_BYTE_BITS));
+    }
+}
+#endif
+
+/**
+ * @brief pifs_is_free_page_erased Checks if the given free page is erased
+ * before it is allocated. If page is known to be erased, flash memory is
+ * not read. Otherwise the page is checked by pifs_is_page_erased() and
+ * remembered if it is erased.
+ *
+ * @param[in] a_block_address Block address to check.
+ * @param[in] a_page_address  Page address to check.
+ * @return TRUE: If page is erased.
+ */
+bool_t pifs_is_free_page_erased(pifs_block_address_t a_block_address,
+                                pifs_page_address_t a_page_address)
+{
+    bool_t      is_erased = FALSE;
+#if PIFS_CHECK_IF_PAGE_IS_ERASED && PIFS_ENABLE_ERASED_PAGE_BITMAP
+    pifs_size_t page_idx = (a_block_address - PIFS_FLASH_BLOCK_RESERVED_NUM) * PIFS_LOGICAL_PAGE_PER_BLOCK
+            + a_page_address;
+
+    if (page_idx < PIFS_LOGICAL_PAGE_NUM_FS)
+    {
+        is_erased = pifs.erased_page_bitmap[page_idx / PIFS_BYTE_BITS] & (1u << (page_idx % PIFS_BYTE_BITS));
+    }
+    if (!is_erased)
+    {
+        /* State of page is unknown */
+        is_erased = pifs_is_page_erased(a_block_address, a_page_address);
+        if (is_erased)
+        {
+            pifs_mark_page_erased(a_block_address, a_page_address, 1);
+        }
+    }
+#else
+    is_erased = pifs_is_page_erased(a_block_address, a_page_address);
+#endif
+
     return is_erased;
 }
 
@@ -584,6 +684,37 @@ pifs_status_t pifs_inc_address(pifs_address_t * a_address)
     return ret;
 }
 
+/**
+ * @brief pifs_dec_address Decrement address.
+ *
+ * @param[out] a_address Pointer to address to decrement.
+ *
+ * @return PIFS_SUCCESS if successfully decremented.
+ * PIFS_ERROR_INTERNAL_RANGE if beginning of flash is reached.
+ */
+pifs_status_t pifs_dec_address(pifs_address_t * a_address)
+{
+    pifs_status_t ret = PIFS_SUCCESS;
+
+    if (a_address->page_address)
+    {
+        a_address->page_address--;
+    }
+    else if (a_address->block_address)
+    {
+        a_address->page_address = PIFS_LOGICAL_PAGE_PER_BLOCK - 1;
+        a_address->block_address--;
+    }
+    else
+    {
+        PIFS_ERROR_MSG("Beginning of flash: %s\r\n", pifs_address2str(a_address));
+        ret = PIFS_ERROR_INTERNAL_RANGE;
+    }
+    PIFS_DEBUG_MSG("%s\r\n", pifs_address2str(a_address));
+
+    return ret;
+}
+
 /**
  * @brief pifs_add_address Add page count to an address.
  * TODO think about return code handling when this function called!
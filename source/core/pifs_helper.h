@@ -53,10 +53,20 @@ bool_t pifs_is_block_type(pifs_block_address_t a_block_address,
 bool_t pifs_is_buffer_erased(const void * a_buf, pifs_size_t a_buf_size);
 bool_t pifs_is_page_erased(pifs_block_address_t a_block_address,
                            pifs_page_address_t a_page_address);
+#if PIFS_CHECK_IF_PAGE_IS_ERASED && PIFS_ENABLE_ERASED_PAGE_BITMAP
+void pifs_mark_page_erased(pifs_block_address_t a_block_address,
+                           pifs_page_address_t a_page_address,
+                           pifs_page_count_t a_page_count);
+void pifs_mark_page_programmed(pifs_block_address_t a_block_address,
+                               pifs_page_address_t a_page_address);
+#endif
+bool_t pifs_is_free_page_erased(pifs_block_address_t a_block_address,
+                                pifs_page_address_t a_page_address);
 bool_t pifs_is_buffer_programmable(const void * a_orig_buf, const void * a_new_buf, pifs_size_t a_buf_size);
 bool_t pifs_is_buffer_programmed(const void * a_buf, pifs_size_t a_buf_size);
 void pifs_parse_open_mode(pifs_file_t * a_file, const pifs_char_t *a_modes);
 pifs_status_t pifs_inc_address(pifs_address_t * a_address);
+pifs_status_t pifs_dec_address(pifs_address_t * a_address);
 pifs_status_t pifs_add_address(pifs_address_t * a_address, pifs_size_t a_page_count);
 pifs_status_t pifs_inc_ba_pa(pifs_block_address_t * a_block_address,
                              pifs_page_address_t * a_page_address);
@@ -53,13 +53,13 @@ pifs_status_t pifs_read_first_map_entry(pifs_file_t * a_file)
                    pifs_address2str(&a_file->actual_map_address));
     a_file->status = pifs_read(a_file->entry.first_map_address.block_address,
                              a_file->entry.first_map_address.page_address,
-                             0, &a_file->map_header, PIFS_MAP_HEADER_SIZE_BYTE);
+                             0, &a_file->map_header, PIFS_MAP_HEADER_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
     if (a_file->status == PIFS_SUCCESS)
     {
         a_file->status = pifs_read(a_file->entry.first_map_address.block_address,
                                  a_file->entry.first_map_address.page_address,
                                  PIFS_MAP_HEADER_SIZE_BYTE, &a_file->map_entry,
-                                 PIFS_MAP_ENTRY_SIZE_BYTE);
+                                 PIFS_MAP_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
     }
     if (a_file->status == PIFS_SUCCESS)
     {
@@ -97,6 +97,9 @@ pifs_status_t pifs_read_next_map_entry(pifs_file_t * a_file)
     pifs_checksum_t checksum;
     bool_t          is_erased;
 
+#if PIFS_ENABLE_MAP_COALESCE
+    PIFS_ASSERT(!a_file->is_map_entry_pending);
+#endif
     a_file->map_entry_idx++;
     if (a_file->map_entry_idx >= PIFS_MAP_ENTRY_PER_PAGE)
     {
@@ -113,7 +116,7 @@ pifs_status_t pifs_read_next_map_entry(pifs_file_t * a_file)
                 //                           pifs_address2str(&a_file->actual_map_address));
                 a_file->status = pifs_read(a_file->actual_map_address.block_address,
                                            a_file->actual_map_address.page_address,
-                                           0, &a_file->map_header, PIFS_MAP_HEADER_SIZE_BYTE);
+                                           0, &a_file->map_header, PIFS_MAP_HEADER_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
             }
             else
             {
@@ -122,6 +125,8 @@ pifs_status_t pifs_read_next_map_entry(pifs_file_t * a_file)
         }
         else
         {
+            /* Actual map entry remains the last one */
+            a_file->map_entry_idx = PIFS_MAP_ENTRY_PER_PAGE - 1;
             a_file->status = PIFS_ERROR_END_OF_FILE;
         }
     }
@@ -132,7 +137,7 @@ pifs_status_t pifs_read_next_map_entry(pifs_file_t * a_file)
                                    a_file->actual_map_address.page_address,
                                    PIFS_MAP_HEADER_SIZE_BYTE + a_file->map_entry_idx * PIFS_MAP_ENTRY_SIZE_BYTE,
                                    &a_file->map_entry,
-                                   PIFS_MAP_ENTRY_SIZE_BYTE);
+                                   PIFS_MAP_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
     }
     if (a_file->status == PIFS_SUCCESS)
     {
@@ -157,6 +162,80 @@ pifs_status_t pifs_read_next_map_entry(pifs_file_t * a_file)
     return a_file->status;
 }
 
+/**
+ * @brief pifs_read_prev_map_entry Read previous map entry.
+ * Map pages are followed backward by the previous map address of map header.
+ * pifs_read_first_map_entry() shall be called before calling this function!
+ *
+ * @param[in] a_file Pointer to opened file.
+ * @return PIFS_SUCCESS if entry is read and valid.
+ * PIFS_ERROR_END_OF_FILE if beginning of file reached.
+ */
+pifs_status_t pifs_read_prev_map_entry(pifs_file_t * a_file)
+{
+    pifs_checksum_t checksum;
+
+#if PIFS_ENABLE_MAP_COALESCE
+    PIFS_ASSERT(!a_file->is_map_entry_pending);
+#endif
+    if (a_file->map_entry_idx)
+    {
+        a_file->map_entry_idx--;
+    }
+    else
+    {
+        checksum = pifs_calc_checksum(&a_file->map_header.prev_map_address,
+                                      PIFS_ADDRESS_SIZE_BYTE);
+        if (a_file->map_header.prev_map_address.block_address < PIFS_BLOCK_ADDRESS_INVALID
+                && a_file->map_header.prev_map_address.page_address < PIFS_PAGE_ADDRESS_INVALID)
+        {
+            if (checksum == a_file->map_header.prev_map_checksum)
+            {
+                /* Previous map page is full */
+                a_file->map_entry_idx = PIFS_MAP_ENTRY_PER_PAGE - 1;
+                a_file->actual_map_address = a_file->map_header.prev_map_address;
+                a_file->status = pifs_read(a_file->actual_map_address.block_address,
+                                           a_file->actual_map_address.page_address,
+                                           0, &a_file->map_header, PIFS_MAP_HEADER_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
+            }
+            else
+            {
+                a_file->status = PIFS_ERROR_CHECKSUM;
+            }
+        }
+        else
+        {
+            a_file->status = PIFS_ERROR_END_OF_FILE;
+        }
+    }
+    if (a_file->status == PIFS_SUCCESS)
+    {
+        PIFS_ASSERT(pifs_is_address_valid(&a_file->actual_map_address));
+        a_file->status = pifs_read(a_file->actual_map_address.block_address,
+                                   a_file->actual_map_address.page_address,
+                                   PIFS_MAP_HEADER_SIZE_BYTE + a_file->map_entry_idx * PIFS_MAP_ENTRY_SIZE_BYTE,
+                                   &a_file->map_entry,
+                                   PIFS_MAP_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
+    }
+    if (a_file->status == PIFS_SUCCESS)
+    {
+        checksum = pifs_calc_checksum(&a_file->map_entry,
+                                      PIFS_MAP_ENTRY_SIZE_BYTE - PIFS_CHECKSUM_SIZE_BYTE);
+        if (checksum != a_file->map_entry.checksum)
+        {
+            a_file->status = PIFS_ERROR_CHECKSUM;
+        }
+    }
+    if (a_file->status == PIFS_SUCCESS)
+    {
+        PIFS_DEBUG_MSG("Map entry %s, page count: %i\r\n",
+                       pifs_address2str(&a_file->map_entry.address),
+                       a_file->map_entry.page_count);
+    }
+
+    return a_file->status;
+}
+
 /**
  * @brief pifs_is_free_map_entry Check if free map entry exists in the actual
  * map.
@@ -176,13 +255,23 @@ pifs_status_t pifs_is_free_map_entry(pifs_file_t * a_file,
 
     PIFS_DEBUG_MSG("Actual map address %s\r\n",
                    pifs_address2str(&a_file->actual_map_address));
-    for (i = 0; i < PIFS_MAP_ENTRY_PER_PAGE && !empty_entry_found && a_file->status == PIFS_SUCCESS; i++)
+#if PIFS_ENABLE_MAP_COALESCE
+    if (a_file->is_map_entry_pending)
+    {
+        /* Entry which is not written yet occupies its place */
+        empty_entry_found = (a_file->map_entry_idx + 1 < PIFS_MAP_ENTRY_PER_PAGE);
+    }
+    else
+#endif
     {
-        a_file->status = pifs_read(ba, pa, i * PIFS_MAP_ENTRY_SIZE_BYTE,
-                                   &map_entry, PIFS_MAP_ENTRY_SIZE_BYTE);
-        if (pifs_is_buffer_erased(&map_entry, PIFS_MAP_ENTRY_SIZE_BYTE))
+        for (i = 0; i < PIFS_MAP_ENTRY_PER_PAGE && !empty_entry_found && a_file->status == PIFS_SUCCESS; i++)
         {
-            empty_entry_found = TRUE;
+            a_file->status = pifs_read(ba, pa, i * PIFS_MAP_ENTRY_SIZE_BYTE,
+                                       &map_entry, PIFS_MAP_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
+            if (pifs_is_buffer_erased(&map_entry, PIFS_MAP_ENTRY_SIZE_BYTE))
+            {
+                empty_entry_found = TRUE;
+            }
         }
     }
     PIFS_DEBUG_MSG("Empty entry found: %i\r\n", empty_entry_found);
@@ -191,9 +280,435 @@ pifs_status_t pifs_is_free_map_entry(pifs_file_t * a_file,
     return a_file->status;
 }
 
+#if PIFS_ENABLE_MAP_INDEX
+/**
+ * @brief pifs_read_map_link Get address from a link of map or index header.
+ *
+ * @param[in] a_address     Pointer to address in header.
+ * @param[in] a_checksum    Checksum of address in header.
+ * @param[out] a_link       Pointer to address to fill.
+ * @return PIFS_SUCCESS if link is valid.
+ * PIFS_ERROR_END_OF_FILE if link is not written.
+ */
+static pifs_status_t pifs_read_map_link(pifs_address_t * a_address,
+                                        pifs_checksum_t a_checksum,
+                                        pifs_address_t * a_link)
+{
+    pifs_status_t ret = PIFS_ERROR_END_OF_FILE;
+
+    if (a_address->block_address < PIFS_BLOCK_ADDRESS_INVALID
+            && a_address->page_address < PIFS_PAGE_ADDRESS_INVALID)
+    {
+        if (pifs_calc_checksum(a_address, PIFS_ADDRESS_SIZE_BYTE) == a_checksum)
+        {
+            *a_link = *a_address;
+            ret = PIFS_SUCCESS;
+        }
+        else
+        {
+            ret = PIFS_ERROR_CHECKSUM;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_read_map_index_entry Read an entry of index page.
+ *
+ * @param[in] a_index_address   Pointer to address of index page.
+ * @param[in] a_idx             Index of entry in the index page.
+ * @param[out] a_index_entry    Pointer to entry to fill.
+ * @param[out] a_is_erased      TRUE: entry is not yet written.
+ * @return PIFS_SUCCESS if entry is valid or not yet written.
+ */
+static pifs_status_t pifs_read_map_index_entry(pifs_address_t * a_index_address,
+                                               size_t a_idx,
+                                               pifs_map_index_entry_t * a_index_entry,
+                                               bool_t * a_is_erased)
+{
+    pifs_status_t ret;
+
+    ret = pifs_read(a_index_address->block_address, a_index_address->page_address,
+                    PIFS_MAP_HEADER_SIZE_BYTE + a_idx * PIFS_MAP_INDEX_ENTRY_SIZE_BYTE,
+                    a_index_entry, PIFS_MAP_INDEX_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
+    if (ret == PIFS_SUCCESS)
+    {
+        *a_is_erased = pifs_is_buffer_erased(a_index_entry, PIFS_MAP_INDEX_ENTRY_SIZE_BYTE);
+        if (!*a_is_erased
+                && pifs_calc_checksum(a_index_entry, PIFS_MAP_INDEX_ENTRY_SIZE_BYTE - PIFS_CHECKSUM_SIZE_BYTE)
+                   != a_index_entry->checksum)
+        {
+            ret = PIFS_ERROR_CHECKSUM;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_write_map_index_entry Write an entry of index page.
+ *
+ * @param[in] a_index_address   Pointer to address of index page.
+ * @param[in] a_idx             Index of entry in the index page.
+ * @param[in] a_map_address     Pointer to address of map page.
+ * @param[in] a_page_idx        Index of file's page where map page starts.
+ * @return PIFS_SUCCESS if entry was written.
+ */
+static pifs_status_t pifs_write_map_index_entry(pifs_address_t * a_index_address,
+                                                size_t a_idx,
+                                                pifs_address_t * a_map_address,
+                                                pifs_file_size_t a_page_idx)
+{
+    pifs_map_index_entry_t index_entry;
+
+    PIFS_DEBUG_MSG("Index entry #%i: map %s starts at page %i\r\n", a_idx,
+                   pifs_address2str(a_map_address), a_page_idx);
+    index_entry.map_address = *a_map_address;
+    index_entry.page_idx = a_page_idx;
+    index_entry.checksum = pifs_calc_checksum(&index_entry,
+                                              PIFS_MAP_INDEX_ENTRY_SIZE_BYTE - PIFS_CHECKSUM_SIZE_BYTE);
+
+    return pifs_write(a_index_address->block_address, a_index_address->page_address,
+                      PIFS_MAP_HEADER_SIZE_BYTE + a_idx * PIFS_MAP_INDEX_ENTRY_SIZE_BYTE,
+                      &index_entry, PIFS_MAP_INDEX_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
+}
+
+/**
+ * @brief pifs_find_map_index Get address of first index page of a map.
+ *
+ * @param[in] a_map_address     Pointer to address of first map page.
+ * @param[out] a_index_address  Pointer to address to fill.
+ * @return PIFS_SUCCESS if map has index.
+ * PIFS_ERROR_END_OF_FILE if map has no index.
+ */
+static pifs_status_t pifs_find_map_index(pifs_address_t * a_map_address,
+                                         pifs_address_t * a_index_address)
+{
+    pifs_status_t     ret;
+    pifs_map_header_t map_header;
+
+    ret = pifs_read(a_map_address->block_address, a_map_address->page_address, 0,
+                    &map_header, PIFS_MAP_HEADER_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
+    if (ret == PIFS_SUCCESS)
+    {
+        ret = pifs_read_map_link(&map_header.index_address, map_header.index_checksum,
+                                 a_index_address);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_alloc_map_index_page Allocate an index page and write its
+ * header.
+ *
+ * @param[in] a_prev_index_address  Pointer to address of previous index page.
+ *                                  NULL: first index page of map.
+ * @param[out] a_index_address      Pointer to address of new index page.
+ * @return PIFS_SUCCESS if page was allocated.
+ */
+static pifs_status_t pifs_alloc_map_index_page(pifs_address_t * a_prev_index_address,
+                                               pifs_address_t * a_index_address)
+{
+    pifs_status_t        ret;
+    pifs_map_header_t    index_header;
+    pifs_block_address_t ba = PIFS_BLOCK_ADDRESS_INVALID;
+    pifs_page_address_t  pa = PIFS_PAGE_ADDRESS_INVALID;
+    pifs_page_count_t    page_count_found = 0;
+
+    ret = pifs_find_free_page_wl(PIFS_MAP_PAGE_NUM, PIFS_MAP_PAGE_NUM,
+                                 PIFS_BLOCK_TYPE_PRIMARY_MANAGEMENT,
+                                 &ba, &pa, &page_count_found);
+    if (ret == PIFS_SUCCESS)
+    {
+        a_index_address->block_address = ba;
+        a_index_address->page_address = pa;
+        ret = pifs_mark_page(ba, pa, PIFS_MAP_PAGE_NUM, TRUE, FALSE);
+    }
+    if (ret == PIFS_SUCCESS && a_prev_index_address)
+    {
+        /* Set jump address to previous index page */
+        memset(&index_header, PIFS_FLASH_ERASED_BYTE_VALUE, PIFS_MAP_HEADER_SIZE_BYTE);
+        index_header.prev_map_address = *a_prev_index_address;
+        index_header.prev_map_checksum = pifs_calc_checksum(&index_header.prev_map_address,
+                                                            PIFS_ADDRESS_SIZE_BYTE);
+        ret = pifs_write(a_index_address->block_address, a_index_address->page_address, 0,
+                         &index_header, PIFS_MAP_HEADER_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
+        if (ret == PIFS_SUCCESS)
+        {
+            /* Set jump address for previous index page */
+            ret = pifs_read(a_prev_index_address->block_address, a_prev_index_address->page_address, 0,
+                            &index_header, PIFS_MAP_HEADER_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
+        }
+        if (ret == PIFS_SUCCESS)
+        {
+            index_header.next_map_address = *a_index_address;
+            index_header.next_map_checksum = pifs_calc_checksum(&index_header.next_map_address,
+                                                                PIFS_ADDRESS_SIZE_BYTE);
+            ret = pifs_write(a_prev_index_address->block_address, a_prev_index_address->page_address, 0,
+                             &index_header, PIFS_MAP_HEADER_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
+        }
+    }
+    PIFS_DEBUG_MSG("### New index page %s ###\r\n", pifs_address2str(a_index_address));
+
+    return ret;
+}
+
+/**
+ * @brief pifs_append_map_index Add the actual map page to the index of
+ * file's map. It shall be called after a new map page is added.
+ * Index is created when the second map page is added, index address is
+ * stored in the header of first map page.
+ * Index is only a hint for seeking: if index page cannot be allocated or
+ * the index does not end with the previous map page, new map page is not
+ * added and seeking walks the map from the last indexed map page.
+ *
+ * @param[in] a_file Pointer to file to use.
+ * @return PIFS_SUCCESS if index was updated or it is not used.
+ */
+static pifs_status_t pifs_append_map_index(pifs_file_t * a_file)
+{
+    pifs_status_t          ret = PIFS_SUCCESS;
+    pifs_address_t         prev_map_address = a_file->map_header.prev_map_address;
+    pifs_address_t         index_address;
+    pifs_address_t         next_index_address;
+    pifs_map_header_t      header;
+    pifs_map_index_entry_t index_entry;
+    pifs_map_entry_t       map_entry;
+    pifs_file_size_t       page_idx = 0;
+    size_t                 idx = 0;
+    size_t                 i;
+    bool_t                 is_erased = FALSE;
+    bool_t                 is_found = FALSE;
+    bool_t                 end = FALSE;
+
+    if (prev_map_address.block_address == a_file->entry.first_map_address.block_address
+            && prev_map_address.page_address == a_file->entry.first_map_address.page_address)
+    {
+        /* Second map page is added: create index */
+        ret = pifs_read(prev_map_address.block_address, prev_map_address.page_address, 0,
+                        &header, PIFS_MAP_HEADER_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
+        if (ret == PIFS_SUCCESS && !pifs_is_buffer_erased(&header.index_address, PIFS_ADDRESS_SIZE_BYTE))
+        {
+            ret = PIFS_ERROR_END_OF_FILE;
+        }
+        if (ret == PIFS_SUCCESS)
+        {
+            ret = pifs_alloc_map_index_page(NULL, &index_address);
+        }
+        if (ret == PIFS_SUCCESS)
+        {
+            ret = pifs_write_map_index_entry(&index_address, idx, &prev_map_address, 0);
+            idx++;
+        }
+        if (ret == PIFS_SUCCESS)
+        {
+            /* Set index address of first map page */
+            header.index_address = index_address;
+            header.index_checksum = pifs_calc_checksum(&header.index_address, PIFS_ADDRESS_SIZE_BYTE);
+            ret = pifs_write(prev_map_address.block_address, prev_map_address.page_address, 0,
+                             &header, PIFS_MAP_HEADER_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
+        }
+    }
+    else
+    {
+        ret = pifs_find_map_index(&a_file->entry.first_map_address, &index_address);
+        /* Find last entry of index */
+        while (ret == PIFS_SUCCESS && !end)
+        {
+            is_erased = FALSE;
+            for (i = 0; i < PIFS_MAP_INDEX_ENTRY_PER_PAGE && !is_erased && ret == PIFS_SUCCESS; i++)
+            {
+                ret = pifs_read_map_index_entry(&index_address, i, &index_entry, &is_erased);
+                if (ret == PIFS_SUCCESS && !is_erased)
+                {
+                    page_idx = index_entry.page_idx;
+                    idx = i + 1;
+                    is_found = (index_entry.map_address.block_address == prev_map_address.block_address
+                                && index_entry.map_address.page_address == prev_map_address.page_address);
+                }
+            }
+            if (ret == PIFS_SUCCESS && !is_erased)
+            {
+                ret = pifs_read(index_address.block_address, index_address.page_address, 0,
+                                &header, PIFS_MAP_HEADER_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
+                if (ret == PIFS_SUCCESS)
+                {
+                    ret = pifs_read_map_link(&header.next_map_address, header.next_map_checksum,
+                                             &next_index_address);
+                }
+                if (ret == PIFS_SUCCESS)
+                {
+                    index_address = next_index_address;
+                    idx = 0;
+                }
+                else if (ret == PIFS_ERROR_END_OF_FILE)
+                {
+                    /* Last index page is full */
+                    ret = PIFS_SUCCESS;
+                    end = TRUE;
+                }
+            }
+            else
+            {
+                end = TRUE;
+            }
+        }
+        if (ret == PIFS_SUCCESS && !is_found)
+        {
+            PIFS_DEBUG_MSG("Index does not end with map %s\r\n",
+                           pifs_address2str(&prev_map_address));
+            ret = PIFS_ERROR_END_OF_FILE;
+        }
+    }
+    /* Count pages of previous map page, it is full */
+    for (i = 0; i < PIFS_MAP_ENTRY_PER_PAGE && ret == PIFS_SUCCESS; i++)
+    {
+        ret = pifs_read(prev_map_address.block_address, prev_map_address.page_address,
+                        PIFS_MAP_HEADER_SIZE_BYTE + i * PIFS_MAP_ENTRY_SIZE_BYTE,
+                        &map_entry, PIFS_MAP_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
+        if (ret == PIFS_SUCCESS
+                && pifs_calc_checksum(&map_entry, PIFS_MAP_ENTRY_SIZE_BYTE - PIFS_CHECKSUM_SIZE_BYTE)
+                   != map_entry.checksum)
+        {
+            ret = PIFS_ERROR_CHECKSUM;
+        }
+        if (ret == PIFS_SUCCESS)
+        {
+            page_idx += map_entry.page_count;
+        }
+    }
+    if (ret == PIFS_SUCCESS && idx == PIFS_MAP_INDEX_ENTRY_PER_PAGE)
+    {
+        next_index_address = index_address;
+        ret = pifs_alloc_map_index_page(&next_index_address, &index_address);
+        idx = 0;
+    }
+    if (ret == PIFS_SUCCESS)
+    {
+        ret = pifs_write_map_index_entry(&index_address, idx, &a_file->actual_map_address, page_idx);
+    }
+    if (ret == PIFS_ERROR_END_OF_FILE || ret == PIFS_ERROR_NO_MORE_SPACE)
+    {
+        /* Map is not indexed or index cannot be extended */
+        ret = PIFS_SUCCESS;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_walk_map_index Call walker function for index pages of a map.
+ *
+ * @param[in] a_file             Pointer of file structure.
+ * @param[in] a_map_address      Pointer to address of first map page.
+ * @param[in] a_file_walker_func Function to call when index page found.
+ * @param[in] a_func_data        User-data to pass to a_file_walker_func.
+ * @return PIFS_SUCCESS if all index pages were processed.
+ */
+static pifs_status_t pifs_walk_map_index(pifs_file_t * a_file,
+                                         pifs_address_t * a_map_address,
+                                         pifs_file_walker_func_t a_file_walker_func,
+                                         void * a_func_data)
+{
+    pifs_status_t     ret;
+    pifs_address_t    index_address;
+    pifs_map_header_t index_header;
+
+    ret = pifs_find_map_index(a_map_address, &index_address);
+    while (ret == PIFS_SUCCESS)
+    {
+        ret = pifs_read(index_address.block_address, index_address.page_address, 0,
+                        &index_header, PIFS_MAP_HEADER_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
+        if (ret == PIFS_SUCCESS)
+        {
+            /* Index pages are handled as map pages */
+            ret = (*a_file_walker_func)(a_file, index_address.block_address,
+                                        index_address.page_address,
+                                        PIFS_BLOCK_ADDRESS_INVALID,
+                                        PIFS_PAGE_ADDRESS_INVALID,
+                                        TRUE, a_func_data);
+        }
+        if (ret == PIFS_SUCCESS)
+        {
+            ret = pifs_read_map_link(&index_header.next_map_address,
+                                     index_header.next_map_checksum,
+                                     &index_address);
+        }
+    }
+    if (ret == PIFS_ERROR_END_OF_FILE)
+    {
+        ret = PIFS_SUCCESS;
+    }
+
+    return ret;
+}
+#endif
+
+#if PIFS_ENABLE_MAP_COALESCE
+/**
+ * @brief pifs_flush_map_entry Write last map entry of file if it is not
+ * written yet. It shall be called before the map is read from flash memory.
+ *
+ * @param[in] a_file Pointer to file to use.
+ * @return PIFS_SUCCESS if entry was written or it was already written.
+ */
+pifs_status_t pifs_flush_map_entry(pifs_file_t * a_file)
+{
+    pifs_status_t ret = PIFS_SUCCESS;
+
+    if (a_file->is_map_entry_pending)
+    {
+        a_file->map_entry.checksum = pifs_calc_checksum(&a_file->map_entry,
+                                                        PIFS_MAP_ENTRY_SIZE_BYTE - PIFS_CHECKSUM_SIZE_BYTE);
+        PIFS_DEBUG_MSG("Write map entry #%lu for %s, page count: %i\r\n", a_file->map_entry_idx,
+                       pifs_address2str(&a_file->map_entry.address),
+                       a_file->map_entry.page_count);
+        ret = pifs_write(a_file->actual_map_address.block_address,
+                         a_file->actual_map_address.page_address,
+                         PIFS_MAP_HEADER_SIZE_BYTE + a_file->map_entry_idx * PIFS_MAP_ENTRY_SIZE_BYTE,
+                         &a_file->map_entry,
+                         PIFS_MAP_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
+        if (ret == PIFS_SUCCESS)
+        {
+            a_file->is_map_entry_pending = FALSE;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_flush_map_entries Write last map entries of all opened files.
+ * It shall be called before the free space bitmap is written, because pages
+ * of pending entries are already marked as used.
+ *
+ * @return PIFS_SUCCESS if entries were written or they were already written.
+ */
+pifs_status_t pifs_flush_map_entries(void)
+{
+    pifs_status_t ret = PIFS_SUCCESS;
+    pifs_size_t   i;
+
+    for (i = 0; i < PIFS_OPEN_FILE_NUM_MAX && ret == PIFS_SUCCESS; i++)
+    {
+        if (pifs.file[i].is_opened)
+        {
+            ret = pifs_flush_map_entry(&pifs.file[i]);
+        }
+    }
+
+    return ret;
+}
+#endif
+
 /**
  * @brief pifs_append_map_entry Add an entry to the file's map.
  * This function is called when file is growing and new space is needed.
+ * If PIFS_ENABLE_MAP_COALESCE is enabled, the entry is only written when
+ * the next pages do not follow its pages or by pifs_flush_map_entry().
+ * Until then following pages are added to the entry.
  *
  * @param[in] a_file            Pointer to file to use.
  * @param[in] a_block_address   Block address of new file pages to added.
@@ -209,12 +724,31 @@ pifs_status_t pifs_append_map_entry(pifs_file_t * a_file,
     pifs_block_address_t    ba = a_file->actual_map_address.block_address;
     pifs_page_address_t     pa = a_file->actual_map_address.page_address;
     bool_t                  empty_entry_found = FALSE;
+    bool_t                  is_extended = FALSE;
     pifs_page_count_t       page_count_found = 0;
 
     PIFS_NOTICE_MSG("Actual map address %s\r\n",
                     pifs_address2str(&a_file->actual_map_address));
     PIFS_ASSERT(pifs_is_address_valid(&a_file->actual_map_address));
-    do
+#if PIFS_ENABLE_MAP_COALESCE
+    if (a_file->is_map_entry_pending
+            && a_file->map_entry.address.block_address == a_block_address
+            && a_file->map_entry.address.page_address + a_file->map_entry.page_count == a_page_address
+            && a_file->map_entry.page_count + a_page_count < PIFS_MAP_PAGE_COUNT_INVALID)
+    {
+        /* New pages follow the pages of last entry */
+        a_file->map_entry.page_count += a_page_count;
+        PIFS_DEBUG_MSG("Extend map entry #%lu for %s, page count: %i\r\n", a_file->map_entry_idx,
+                       pifs_address2str(&a_file->map_entry.address),
+                       a_file->map_entry.page_count);
+        is_extended = TRUE;
+    }
+    else
+    {
+        a_file->status = pifs_flush_map_entry(a_file);
+    }
+#endif
+    while (!is_extended && !empty_entry_found && a_file->status == PIFS_SUCCESS)
     {
         if (pifs_is_buffer_erased(&a_file->map_entry, PIFS_MAP_ENTRY_SIZE_BYTE))
         {
@@ -224,7 +758,7 @@ pifs_status_t pifs_append_map_entry(pifs_file_t * a_file,
         {
             a_file->status = pifs_read_next_map_entry(a_file);
         }
-    } while (!empty_entry_found && a_file->status == PIFS_SUCCESS);
+    }
     if (a_file->status == PIFS_ERROR_END_OF_FILE) // || a_file->status == PIFS_ERROR_CHECKSUM)
     {
         PIFS_DEBUG_MSG("End of map, new map will be created\r\n");
@@ -237,7 +771,7 @@ pifs_status_t pifs_append_map_entry(pifs_file_t * a_file,
                                        a_file->actual_map_address.page_address,
                                        0,
                                        &a_file->map_header,
-                                       PIFS_MAP_HEADER_SIZE_BYTE);
+                                       PIFS_MAP_HEADER_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
         }
         if (a_file->status == PIFS_SUCCESS)
         {
@@ -250,7 +784,7 @@ pifs_status_t pifs_append_map_entry(pifs_file_t * a_file,
                                         a_file->actual_map_address.page_address,
                                         0,
                                         &a_file->map_header,
-                                        PIFS_MAP_HEADER_SIZE_BYTE);
+                                        PIFS_MAP_HEADER_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
             PIFS_DEBUG_MSG("### Map full, set jump address %s ###\r\n",
                            pifs_address2str(&a_file->actual_map_address));
 //            pifs_print_cache();
@@ -267,7 +801,7 @@ pifs_status_t pifs_append_map_entry(pifs_file_t * a_file,
             a_file->actual_map_address.block_address = ba;
             a_file->actual_map_address.page_address = pa;
             a_file->status = pifs_write(ba, pa, 0, &a_file->map_header,
-                                        PIFS_MAP_HEADER_SIZE_BYTE);
+                                        PIFS_MAP_HEADER_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
             PIFS_DEBUG_MSG("### New map %s ###\r\n",
                            pifs_address2str(&a_file->actual_map_address));
 //            pifs_print_cache();
@@ -278,6 +812,12 @@ pifs_status_t pifs_append_map_entry(pifs_file_t * a_file,
             PIFS_DEBUG_MSG("### Mark page %s ###\r\n",
                            pifs_address2str(&a_file->actual_map_address));
             a_file->status = pifs_mark_page(ba, pa, PIFS_MAP_PAGE_NUM, TRUE, FALSE);
+#if PIFS_ENABLE_MAP_INDEX
+            if (a_file->status == PIFS_SUCCESS)
+            {
+                a_file->status = pifs_append_map_index(a_file);
+            }
+#endif
             empty_entry_found = TRUE;
         }
     }
@@ -287,6 +827,12 @@ pifs_status_t pifs_append_map_entry(pifs_file_t * a_file,
         a_file->map_entry.address.block_address = a_block_address;
         a_file->map_entry.address.page_address = a_page_address;
         a_file->map_entry.page_count = a_page_count;
+#if PIFS_ENABLE_MAP_COALESCE
+        /* Entry is written when its run of pages ends */
+        PIFS_DEBUG_MSG("Map entry #%lu for %s is not written yet\r\n", a_file->map_entry_idx,
+                       pifs_ba_pa2str(a_block_address, a_page_address));
+        a_file->is_map_entry_pending = TRUE;
+#else
         a_file->map_entry.checksum = pifs_calc_checksum(&a_file->map_entry,
                                                         PIFS_MAP_ENTRY_SIZE_BYTE - PIFS_CHECKSUM_SIZE_BYTE);
         PIFS_DEBUG_MSG("Create map entry #%lu for %s\r\n", a_file->map_entry_idx,
@@ -294,12 +840,13 @@ pifs_status_t pifs_append_map_entry(pifs_file_t * a_file,
         a_file->status = pifs_write(ba, pa, PIFS_MAP_HEADER_SIZE_BYTE
                                     + a_file->map_entry_idx * PIFS_MAP_ENTRY_SIZE_BYTE,
                                     &a_file->map_entry,
-                                    PIFS_MAP_ENTRY_SIZE_BYTE);
+                                    PIFS_MAP_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
         PIFS_DEBUG_MSG("### New map entry %s ###\r\n",
                        pifs_ba_pa2str(ba, pa));
 //        pifs_print_cache();
+#endif
     }
-    else
+    else if (!is_extended)
     {
         a_file->status = PIFS_ERROR_NO_MORE_SPACE;
         PIFS_ERROR_MSG("Cannot create new map!\r\n");
@@ -310,6 +857,7 @@ pifs_status_t pifs_append_map_entry(pifs_file_t * a_file,
 
 /**
  * @brief pifs_release_file_pages Mark file map and file's pages to be released.
+ * Index pages of the map are handled as map pages.
  *
  * @param[in] a_file             Pointer of file structure.
  * @param[in] a_file_walker_func Function to call when map or page found.
@@ -334,11 +882,14 @@ pifs_status_t pifs_walk_file_pages(pifs_file_t * a_file,
     bool_t                  end = FALSE;
 
     PIFS_ASSERT(a_file_walker_func);
+#if PIFS_ENABLE_MAP_COALESCE
+    PIFS_ASSERT(!a_file->is_map_entry_pending);
+#endif
     PIFS_DEBUG_MSG("Searching in map entry at %s\r\n", pifs_ba_pa2str(ba, pa));
 
     do
     {
-        a_file->status = pifs_read(ba, pa, 0, &a_file->map_header, PIFS_MAP_HEADER_SIZE_BYTE);
+        a_file->status = pifs_read(ba, pa, 0, &a_file->map_header, PIFS_MAP_HEADER_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
 
         if (a_file->status == PIFS_SUCCESS)
         {
@@ -348,7 +899,7 @@ pifs_status_t pifs_walk_file_pages(pifs_file_t * a_file,
             }
             for (i = 0; i < PIFS_MAP_ENTRY_PER_PAGE && !erased && a_file->status == PIFS_SUCCESS; i++)
             {
-                a_file->status = pifs_read(ba, pa, po, &a_file->map_entry, PIFS_MAP_ENTRY_SIZE_BYTE);
+                a_file->status = pifs_read(ba, pa, po, &a_file->map_entry, PIFS_MAP_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
                 if (pifs_is_buffer_erased(&a_file->map_entry, PIFS_MAP_ENTRY_SIZE_BYTE))
                 {
                     erased = TRUE;
@@ -428,15 +979,54 @@ pifs_status_t pifs_walk_file_pages(pifs_file_t * a_file,
             }
         }
     } while (!end && a_file->status == PIFS_SUCCESS);
+#if PIFS_ENABLE_MAP_INDEX
+    if (a_file->status == PIFS_SUCCESS)
+    {
+        a_file->status = pifs_walk_map_index(a_file, &a_file->entry.first_map_address,
+                                             a_file_walker_func, a_func_data);
+    }
+#endif
 
     return a_file->status;
 }
 
+/**
+ * Consecutive data pages which are not yet marked to be released.
+ */
+typedef struct
+{
+    pifs_block_address_t block_address;     /**< Address of first page */
+    pifs_page_address_t  page_address;
+    pifs_page_count_t    page_count;        /**< Number of pages */
+} pifs_release_run_t;
+
+/**
+ * @brief pifs_release_run_flush Mark pages of run to be released.
+ *
+ * @param[in] a_run     Pointer to run of pages.
+ * @return PIFS_SUCCESS if pages marked successfully.
+ */
+static pifs_status_t pifs_release_run_flush(pifs_release_run_t * a_run)
+{
+    pifs_status_t ret = PIFS_SUCCESS;
+
+    if (a_run->page_count)
+    {
+        PIFS_DEBUG_MSG("Release %i page(s) %s\r\n", a_run->page_count,
+                       pifs_ba_pa2str(a_run->block_address, a_run->page_address));
+        ret = pifs_mark_page(a_run->block_address, a_run->page_address, a_run->page_count, FALSE, TRUE);
+        a_run->page_count = 0;
+    }
+
+    return ret;
+}
+
 /**
  * @brief pifs_release_file_page Mark page as to be released.
  * Callback function for pifs_walk_file_pages().
  * If delta block and page are equal to original block address, no delta
  * page is used.
+ * Consecutive data pages are collected to a run and marked together.
  *
  * @param[in] a_file                 Pointer to file.
  * @param[in] a_block_address        Original block address.
@@ -445,22 +1035,24 @@ pifs_status_t pifs_walk_file_pages(pifs_file_t * a_file,
  * @param[in] a_delta_page_address   Delta page address.
  * @param[in] a_map_page             TRUE: the page is map page.
  *                                   FALSE: data page.
- * @param[in] a_func_data            User-data, which is unused.
+ * @param[in] a_func_data            Pointer to pifs_release_run_t.
  *
  * @return PIFS_SUCCESS if page marked successfully.
  */
-pifs_status_t pifs_release_file_page(pifs_file_t * a_file,
-                                     pifs_block_address_t a_block_address,
-                                     pifs_page_address_t a_page_address,
-                                     pifs_block_address_t a_delta_block_address,
-                                     pifs_page_address_t a_delta_page_address,
-                                     bool_t a_map_page,
-                                     void * a_func_data)
+static pifs_status_t pifs_release_file_page(pifs_file_t * a_file,
+                                            pifs_block_address_t a_block_address,
+                                            pifs_page_address_t a_page_address,
+                                            pifs_block_address_t a_delta_block_address,
+                                            pifs_page_address_t a_delta_page_address,
+                                            bool_t a_map_page,
+                                            void * a_func_data)
 {
-    pifs_status_t ret;
+    pifs_status_t        ret = PIFS_SUCCESS;
+    pifs_release_run_t * run = (pifs_release_run_t*) a_func_data;
+    pifs_size_t          page_idx;
+    pifs_size_t          run_end_page_idx;
 
     (void) a_file;
-    (void) a_func_data;
 
     if (a_map_page)
     {
@@ -474,7 +1066,17 @@ pifs_status_t pifs_release_file_page(pifs_file_t * a_file,
                        pifs_ba_pa2str(a_delta_block_address, a_delta_page_address));
         /* Only delta page shall be released as the original is released *
          * when delta page is added. */
-        ret = pifs_mark_page(a_delta_block_address, a_delta_page_address, 1, FALSE, TRUE);
+        page_idx = a_delta_block_address * PIFS_LOGICAL_PAGE_PER_BLOCK + a_delta_page_address;
+        run_end_page_idx = run->block_address * PIFS_LOGICAL_PAGE_PER_BLOCK + run->page_address
+                + run->page_count;
+        if (!run->page_count || page_idx != run_end_page_idx || run->page_count >= PIFS_PAGE_COUNT_INVALID - 1)
+        {
+            /* Page does not continue the run */
+            ret = pifs_release_run_flush(run);
+            run->block_address = a_delta_block_address;
+            run->page_address = a_delta_page_address;
+        }
+        run->page_count++;
     }
 
     return ret;
@@ -488,6 +1090,379 @@ pifs_status_t pifs_release_file_page(pifs_file_t * a_file,
  */
 pifs_status_t pifs_release_file_pages(pifs_file_t * a_file)
 {
-    return pifs_walk_file_pages(a_file, pifs_release_file_page, NULL);
+    pifs_status_t      ret;
+    pifs_release_run_t run;
+
+    run.block_address = PIFS_BLOCK_ADDRESS_INVALID;
+    run.page_address = PIFS_PAGE_ADDRESS_INVALID;
+    run.page_count = 0;
+    ret = pifs_walk_file_pages(a_file, pifs_release_file_page, &run);
+    if (ret == PIFS_SUCCESS)
+    {
+        ret = pifs_release_run_flush(&run);
+    }
+
+    return ret;
+}
+
+#if PIFS_ENABLE_MAP_INDEX
+/**
+ * @brief pifs_release_map_index Mark index pages of a map to be released.
+ *
+ * @param[in] a_file        Pointer of file structure.
+ * @param[in] a_map_address Pointer to address of first map page.
+ * @return PIFS_SUCCESS if all index pages were marked to be released.
+ */
+pifs_status_t pifs_release_map_index(pifs_file_t * a_file, pifs_address_t * a_map_address)
+{
+    pifs_release_run_t run;
+
+    run.page_count = 0;
+
+    return pifs_walk_map_index(a_file, a_map_address, pifs_release_file_page, &run);
+}
+#endif
+
+
+#if PIFS_FILE_EXTENT_NUM_MAX || PIFS_ENABLE_MAP_INDEX
+/**
+ * @brief pifs_jump_map_entry Set read/write position of file to the start of
+ * a map entry.
+ *
+ * @param[in] a_file            Pointer to opened file.
+ * @param[in] a_map_address     Pointer to address of map page.
+ * @param[in] a_map_entry_idx   Index of entry in the map page.
+ * @param[in] a_page_idx        Index of file's page where map entry starts.
+ * @return PIFS_SUCCESS if map entry is read and valid.
+ */
+static pifs_status_t pifs_jump_map_entry(pifs_file_t * a_file,
+                                         pifs_address_t * a_map_address,
+                                         size_t a_map_entry_idx,
+                                         size_t a_page_idx)
+{
+    pifs_checksum_t checksum;
+
+    PIFS_DEBUG_MSG("Jump to page %i, map entry #%i of %s\r\n", a_page_idx,
+                   a_map_entry_idx, pifs_address2str(a_map_address));
+    a_file->actual_map_address = *a_map_address;
+    a_file->map_entry_idx = a_map_entry_idx;
+    a_file->status = pifs_read(a_map_address->block_address,
+                               a_map_address->page_address,
+                               0, &a_file->map_header, PIFS_MAP_HEADER_SIZE_BYTE,
+                               PIFS_CACHE_CLASS_MAP);
+    if (a_file->status == PIFS_SUCCESS)
+    {
+        a_file->status = pifs_read(a_map_address->block_address,
+                                   a_map_address->page_address,
+                                   PIFS_MAP_HEADER_SIZE_BYTE + a_map_entry_idx * PIFS_MAP_ENTRY_SIZE_BYTE,
+                                   &a_file->map_entry, PIFS_MAP_ENTRY_SIZE_BYTE,
+                                   PIFS_CACHE_CLASS_MAP);
+    }
+    if (a_file->status == PIFS_SUCCESS)
+    {
+        checksum = pifs_calc_checksum(&a_file->map_entry,
+                                      PIFS_MAP_ENTRY_SIZE_BYTE - PIFS_CHECKSUM_SIZE_BYTE);
+        if (checksum != a_file->map_entry.checksum)
+        {
+            a_file->status = PIFS_ERROR_CHECKSUM;
+        }
+    }
+    if (a_file->status == PIFS_SUCCESS)
+    {
+        a_file->rw_address = a_file->map_entry.address;
+        a_file->rw_page_count = a_file->map_entry.page_count;
+        a_file->rw_pos = a_page_idx * PIFS_LOGICAL_PAGE_SIZE_BYTE;
+#if PIFS_READ_AHEAD_PAGE_NUM_MAX
+        a_file->ra_page_count = 0;
+        a_file->ra_page_end = 0;
+#endif
+    }
+
+    return a_file->status;
+}
+#endif
+
+#if PIFS_FILE_EXTENT_NUM_MAX
+/**
+ * @brief pifs_add_file_extent Add a map entry to the extent cache of file.
+ * Every extent_stride-th map entry is stored. If the cache is full, every
+ * second extent is dropped and the stride is doubled, so the cache covers
+ * the whole file.
+ *
+ * @param[in] a_file            Pointer to file.
+ * @param[in] a_entry_cnt       Index of map entry counted from the first map entry.
+ * @param[in] a_page_idx        Index of file's page where map entry starts.
+ * @param[in] a_map_address     Address of map page which contains the entry.
+ * @param[in] a_map_entry_idx   Index of entry in the map page.
+ */
+static void pifs_add_file_extent(pifs_file_t * a_file,
+                                 size_t a_entry_cnt,
+                                 size_t a_page_idx,
+                                 pifs_address_t * a_map_address,
+                                 size_t a_map_entry_idx)
+{
+    pifs_file_extent_t * extent;
+    size_t               i;
+
+    if (a_file->extent_cnt == PIFS_FILE_EXTENT_NUM_MAX && !(a_entry_cnt % a_file->extent_stride))
+    {
+        /* Cache is full, keep every second extent */
+        for (i = 0; i < (PIFS_FILE_EXTENT_NUM_MAX + 1) / 2; i++)
+        {
+            a_file->extent[i] = a_file->extent[i * 2];
+        }
+        a_file->extent_cnt = (PIFS_FILE_EXTENT_NUM_MAX + 1) / 2;
+        a_file->extent_stride *= 2;
+    }
+    if (!(a_entry_cnt % a_file->extent_stride))
+    {
+        extent = &a_file->extent[a_file->extent_cnt];
+        extent->page_idx = a_page_idx;
+        extent->map_address = *a_map_address;
+        extent->map_entry_idx = a_map_entry_idx;
+        a_file->extent_cnt++;
+    }
+}
+
+/**
+ * @brief pifs_read_file_extents Walk the map of file and fill the extent
+ * cache. File's actual map position is not changed.
+ *
+ * @param[in] a_file Pointer to opened file.
+ * @return PIFS_SUCCESS if map was read successfully.
+ */
+static pifs_status_t pifs_read_file_extents(pifs_file_t * a_file)
+{
+    pifs_status_t       ret = PIFS_SUCCESS;
+    pifs_address_t      map_address = a_file->entry.first_map_address;
+    pifs_map_header_t   map_header;
+    pifs_map_entry_t    map_entry;
+    pifs_checksum_t     checksum;
+    size_t              entry_cnt = 0;
+    size_t              page_idx = 0;
+    size_t              i;
+    bool_t              end = FALSE;
+
+    a_file->extent_cnt = 0;
+    a_file->extent_stride = 1;
+    do
+    {
+        ret = pifs_read(map_address.block_address, map_address.page_address, 0,
+                        &map_header, PIFS_MAP_HEADER_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
+        for (i = 0; i < PIFS_MAP_ENTRY_PER_PAGE && !end && ret == PIFS_SUCCESS; i++)
+        {
+            ret = pifs_read(map_address.block_address, map_address.page_address,
+                            PIFS_MAP_HEADER_SIZE_BYTE + i * PIFS_MAP_ENTRY_SIZE_BYTE,
+                            &map_entry, PIFS_MAP_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
+            if (ret == PIFS_SUCCESS)
+            {
+                if (pifs_is_buffer_erased(&map_entry, PIFS_MAP_ENTRY_SIZE_BYTE))
+                {
+                    end = TRUE;
+                }
+                else
+                {
+                    checksum = pifs_calc_checksum(&map_entry,
+                                                  PIFS_MAP_ENTRY_SIZE_BYTE - PIFS_CHECKSUM_SIZE_BYTE);
+                    if (checksum == map_entry.checksum)
+                    {
+                        pifs_add_file_extent(a_file, entry_cnt, page_idx, &map_address, i);
+                        entry_cnt++;
+                        page_idx += map_entry.page_count;
+                    }
+                    else
+                    {
+                        ret = PIFS_ERROR_CHECKSUM;
+                    }
+                }
+            }
+        }
+        if (ret == PIFS_SUCCESS && !end)
+        {
+            if (map_header.next_map_address.block_address < PIFS_BLOCK_ADDRESS_INVALID
+                    && map_header.next_map_address.page_address < PIFS_PAGE_ADDRESS_INVALID)
+            {
+                checksum = pifs_calc_checksum(&map_header.next_map_address, PIFS_ADDRESS_SIZE_BYTE);
+                if (checksum == map_header.next_map_checksum)
+                {
+                    map_address = map_header.next_map_address;
+                }
+                else
+                {
+                    ret = PIFS_ERROR_CHECKSUM;
+                }
+            }
+            else
+            {
+                end = TRUE;
+            }
+        }
+    } while (!end && ret == PIFS_SUCCESS);
+    a_file->extent_is_read = (ret == PIFS_SUCCESS);
+    PIFS_DEBUG_MSG("%i extents of %i map entries\r\n", a_file->extent_cnt, entry_cnt);
+
+    return ret;
+}
+
+/**
+ * @brief pifs_seek_file_extent Jump to the last cached map entry which starts
+ * before a position of file. Map entries between the actual position and
+ * the cached one are not read.
+ * Position is not changed if the target position is in the actual map
+ * entry, the cached map entry is before the actual position or going
+ * backward from the actual position is shorter.
+ * Extent cache is read at first use.
+ *
+ * @param[in] a_file    Pointer to opened file.
+ * @param[in] a_pos     Target position in file.
+ * @return PIFS_SUCCESS if position is not changed or jump was successful.
+ */
+pifs_status_t pifs_seek_file_extent(pifs_file_t * a_file, size_t a_pos)
+{
+    pifs_file_extent_t * extent;
+    size_t               page_idx = a_pos / PIFS_LOGICAL_PAGE_SIZE_BYTE;
+    size_t               rw_page_idx = a_file->rw_pos / PIFS_LOGICAL_PAGE_SIZE_BYTE;
+    size_t               lo = 0;
+    size_t               hi;
+    size_t               mid;
+
+    a_file->status = PIFS_SUCCESS;
+    if (a_pos < a_file->rw_pos || page_idx >= rw_page_idx + a_file->rw_page_count)
+    {
+        if (!a_file->extent_is_read)
+        {
+            a_file->status = pifs_read_file_extents(a_file);
+        }
+        /* Binary search of last extent starting at or before the page */
+        hi = a_file->extent_cnt;
+        while (lo < hi)
+        {
+            mid = (lo + hi) / 2;
+            if (a_file->extent[mid].page_idx <= page_idx)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        if (a_file->status == PIFS_SUCCESS && lo)
+        {
+            extent = &a_file->extent[lo - 1];
+            if (extent->page_idx * PIFS_LOGICAL_PAGE_SIZE_BYTE > a_file->rw_pos
+                    || (a_pos < a_file->rw_pos && page_idx - extent->page_idx < rw_page_idx - page_idx))
+            {
+                if (pifs_jump_map_entry(a_file, &extent->map_address,
+                                        extent->map_entry_idx, extent->page_idx) != PIFS_SUCCESS)
+                {
+                    /* Cache is read again at next seek */
+                    a_file->extent_is_read = FALSE;
+                }
+            }
+        }
+    }
+
+    return a_file->status;
 }
+#endif
 
+#if PIFS_ENABLE_MAP_INDEX
+/**
+ * @brief pifs_seek_map_index Jump to the map page which contains a position
+ * of file by the map index. Map pages between the actual position and the
+ * found one are not read.
+ * Position is not changed if the target position is in the actual map
+ * entry, the map page is before the actual position or going backward from
+ * the actual position is shorter.
+ * Corrupted index is not used, seeking walks the map in that case.
+ * Extent cache is not needed for files which have map index.
+ *
+ * @param[in] a_file        Pointer to opened file.
+ * @param[in] a_pos         Target position in file.
+ * @param[out] a_is_indexed TRUE: map of file has index.
+ * @return PIFS_SUCCESS if position is not changed or jump was successful.
+ */
+pifs_status_t pifs_seek_map_index(pifs_file_t * a_file, size_t a_pos, bool_t * a_is_indexed)
+{
+    pifs_status_t          ret;
+    pifs_address_t         index_address;
+    pifs_map_header_t      index_header;
+    pifs_map_index_entry_t index_entry;
+    pifs_address_t         map_address;
+    size_t                 map_page_idx = 0;
+    size_t                 page_idx = a_pos / PIFS_LOGICAL_PAGE_SIZE_BYTE;
+    size_t                 rw_page_idx = a_file->rw_pos / PIFS_LOGICAL_PAGE_SIZE_BYTE;
+    size_t                 lo;
+    size_t                 hi;
+    size_t                 mid;
+    bool_t                 is_erased = FALSE;
+    bool_t                 is_found = FALSE;
+    bool_t                 end = FALSE;
+
+    *a_is_indexed = FALSE;
+    a_file->status = PIFS_SUCCESS;
+    if (a_pos < a_file->rw_pos || page_idx >= rw_page_idx + a_file->rw_page_count)
+    {
+        ret = pifs_find_map_index(&a_file->entry.first_map_address, &index_address);
+        *a_is_indexed = (ret == PIFS_SUCCESS);
+        if (a_pos < a_file->rw_pos && rw_page_idx - page_idx < PIFS_MAP_ENTRY_PER_PAGE)
+        {
+            /* Going backward reads less map entries than walking a map page */
+            end = TRUE;
+        }
+        while (ret == PIFS_SUCCESS && !end)
+        {
+            /* Binary search of last map page starting at or before the page */
+            lo = 0;
+            hi = PIFS_MAP_INDEX_ENTRY_PER_PAGE;
+            while (lo < hi && ret == PIFS_SUCCESS)
+            {
+                mid = (lo + hi) / 2;
+                ret = pifs_read_map_index_entry(&index_address, mid, &index_entry, &is_erased);
+                if (ret == PIFS_SUCCESS && !is_erased && index_entry.page_idx <= page_idx)
+                {
+                    map_address = index_entry.map_address;
+                    map_page_idx = index_entry.page_idx;
+                    is_found = TRUE;
+                    lo = mid + 1;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+            if (ret == PIFS_SUCCESS && lo == PIFS_MAP_INDEX_ENTRY_PER_PAGE)
+            {
+                /* Map page may be listed in the next index page */
+                ret = pifs_read(index_address.block_address, index_address.page_address, 0,
+                                &index_header, PIFS_MAP_HEADER_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
+                if (ret == PIFS_SUCCESS)
+                {
+                    ret = pifs_read_map_link(&index_header.next_map_address,
+                                             index_header.next_map_checksum,
+                                             &index_address);
+                }
+            }
+            else
+            {
+                end = TRUE;
+            }
+        }
+        if (ret != PIFS_SUCCESS && ret != PIFS_ERROR_END_OF_FILE)
+        {
+            PIFS_WARNING_MSG("Map index of '%s' is not used: %i\r\n", a_file->entry.name, ret);
+            *a_is_indexed = FALSE;
+            is_found = FALSE;
+        }
+        if (is_found
+                && (map_page_idx * PIFS_LOGICAL_PAGE_SIZE_BYTE > a_file->rw_pos
+                    || (a_pos < a_file->rw_pos && page_idx - map_page_idx < rw_page_idx - page_idx)))
+        {
+            (void)pifs_jump_map_entry(a_file, &map_address, 0, map_page_idx);
+        }
+    }
+
+    return a_file->status;
+}
+#endif
@@ -66,8 +66,13 @@ typedef pifs_status_t (*pifs_file_walker_func_t)(pifs_file_t * a_file,
 
 pifs_status_t pifs_read_first_map_entry(pifs_file_t * a_file);
 pifs_status_t pifs_read_next_map_entry(pifs_file_t * a_file);
+pifs_status_t pifs_read_prev_map_entry(pifs_file_t * a_file);
 pifs_status_t pifs_is_free_map_entry(pifs_file_t * a_file,
                                      bool_t * a_is_free_map_entry);
+#if PIFS_ENABLE_MAP_COALESCE
+pifs_status_t pifs_flush_map_entry(pifs_file_t * a_file);
+pifs_status_t pifs_flush_map_entries(void);
+#endif
 pifs_status_t pifs_append_map_entry(pifs_file_t * a_file,
                                     pifs_block_address_t a_block_address,
                                     pifs_page_address_t a_page_address,
@@ -76,6 +81,13 @@ pifs_status_t pifs_walk_file_pages(pifs_file_t * a_file,
                                    pifs_file_walker_func_t a_file_walker_func,
                                    void * a_func_data);
 pifs_status_t pifs_release_file_pages(pifs_file_t * a_file);
+#if PIFS_ENABLE_MAP_INDEX
+pifs_status_t pifs_release_map_index(pifs_file_t * a_file, pifs_address_t * a_map_address);
+pifs_status_t pifs_seek_map_index(pifs_file_t * a_file, size_t a_pos, bool_t * a_is_indexed);
+#endif
+#if PIFS_FILE_EXTENT_NUM_MAX
+pifs_status_t pifs_seek_file_extent(pifs_file_t * a_file, size_t a_pos);
+#endif
 
 #ifdef __cplusplus
 }
@@ -113,7 +113,7 @@ static pifs_status_t pifs_copy_fsbm(pifs_header_t * a_old_header, pifs_header_t
     do
     {
         /* Read free space bitmap */
-        ret = pifs_read(old_fsbm_ba, old_fsbm_pa, 0, &pifs.dmw_page_buf, PIFS_LOGICAL_PAGE_SIZE_BYTE);
+        ret = pifs_read(old_fsbm_ba, old_fsbm_pa, 0, &pifs.dmw_page_buf, PIFS_LOGICAL_PAGE_SIZE_BYTE, PIFS_CACHE_CLASS_FSBM);
 
         PIFS_DEBUG_MSG("Old free space bitmap:\r\n");
 #if PIFS_DEBUG_LEVEL >= 5
@@ -182,7 +182,7 @@ static pifs_status_t pifs_copy_fsbm(pifs_header_t * a_old_header, pifs_header_t
 
         if (ret == PIFS_SUCCESS)
         {
-            ret = pifs_write(new_fsbm_ba, new_fsbm_pa, 0, &pifs.dmw_page_buf, PIFS_LOGICAL_PAGE_SIZE_BYTE);
+            ret = pifs_write(new_fsbm_ba, new_fsbm_pa, 0, &pifs.dmw_page_buf, PIFS_LOGICAL_PAGE_SIZE_BYTE, PIFS_CACHE_CLASS_FSBM);
             PIFS_DEBUG_MSG("New free space bitmap:\r\n");
 #if PIFS_DEBUG_LEVEL >= 5
             print_buffer(pifs.dmw_page_buf, PIFS_LOGICAL_PAGE_SIZE_BYTE,
@@ -259,13 +259,13 @@ static pifs_status_t pifs_copy_map(pifs_entry_t * a_old_entry,
         do
         {
             /* Read old map's header */
-            ret = pifs_read(old_map_ba, old_map_pa, 0, &old_map_header, PIFS_MAP_HEADER_SIZE_BYTE);
+            ret = pifs_read(old_map_ba, old_map_pa, 0, &old_map_header, PIFS_MAP_HEADER_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
             for (i = 0; i < PIFS_MAP_ENTRY_PER_PAGE && !end && ret == PIFS_SUCCESS; i++)
             {
                 /* Go through all map entries in the page */
                 ret = pifs_read(old_map_ba, old_map_pa,
                                 PIFS_MAP_HEADER_SIZE_BYTE + i * PIFS_MAP_ENTRY_SIZE_BYTE,
-                                &old_map_entry, PIFS_MAP_ENTRY_SIZE_BYTE);
+                                &old_map_entry, PIFS_MAP_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
                 if (ret == PIFS_SUCCESS)
                 {
                     is_erased = pifs_is_buffer_erased(&old_map_entry, PIFS_MAP_ENTRY_SIZE_BYTE);
@@ -443,7 +443,7 @@ static pifs_status_t pifs_copy_entry_list(pifs_header_t * a_old_header,
         for (i = 0; i < PIFS_ENTRY_PER_PAGE && ret == PIFS_SUCCESS && !end; i++)
         {
             ret = pifs_read(old_entry_list_ba, old_entry_list_pa, i * PIFS_ENTRY_SIZE_BYTE, &entry,
-                            PIFS_ENTRY_SIZE_BYTE);
+                            PIFS_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_ENTRY_LIST);
             /* Check if entry is valid */
             if (!pifs_is_buffer_erased(&entry, PIFS_ENTRY_SIZE_BYTE))
             {
@@ -496,7 +496,7 @@ static pifs_status_t pifs_copy_entry_list(pifs_header_t * a_old_header,
                         {
                             PIFS_NOTICE_MSG("%s\r\n", pifs_ba_pa2str(new_entry_list_ba, new_entry_list_pa));
 #if PIFS_DEBUG_LEVEL >= 5
-                            print_buffer(pifs.cache_page_buf, sizeof(pifs.cache_page_buf),
+                            print_buffer(pifs.cache_page_buf, PIFS_LOGICAL_PAGE_SIZE_BYTE,
                                          new_entry_list_ba * PIFS_FLASH_BLOCK_SIZE_BYTE + new_entry_list_pa * PIFS_LOGICAL_PAGE_SIZE_BYTE);
 #endif
                         }
@@ -543,13 +543,14 @@ static pifs_status_t pifs_copy_entry_list(pifs_header_t * a_old_header,
  * #6 Generate list of most and least weared blocks.
  * #7 Copy file entries from old to new management blocks. Maps are also copied,
  *    so map blocks are allocated from new management area (FSBM is needed).
+ *    Patch records of used pages are copied.
  * #8 Erase delta page mirror in RAM.
  * #9 Find free blocks for next management block in the new file system header.
  * #10 Add next management block's address to the new file system header and
  *    calculate checksum.
  * #11 Update page of new file system header. Checksum is written, so the new
  *    file system header is valid from this point.
- * #12 Erase old management blocks.
+ * #12 Flush cache, also in a transaction, and erase old management blocks.
  * #13 Re-open files and seek to the stored position.
  *     Therefore actual_map_address, map_header, etc. will be updated.
  *
@@ -567,10 +568,21 @@ pifs_status_t pifs_merge(void)
     pifs_file_t        * file;
     bool_t               file_is_opened[PIFS_OPEN_FILE_NUM_MAX] = { 0 };
     pifs_size_t          file_pos[PIFS_OPEN_FILE_NUM_MAX] = { 0 };
+    bool_t               file_is_created[PIFS_OPEN_FILE_NUM_MAX] = { 0 };
 
     PIFS_INFO_MSG("start\r\n");
     PIFS_ASSERT(!pifs.is_merging);
     pifs.is_merging = TRUE;
+#if PIFS_ENABLE_FSBM_SHADOW
+    /* Free space bitmap is copied and the header is changed */
+    pifs_fsbm_shadow_invalidate();
+#endif
+#if PIFS_ENABLE_BLOCK_PAGE_CNTR
+    pifs_page_cntr_invalidate();
+#endif
+#if PIFS_ENABLE_FREE_EXTENT_INDEX
+    pifs_free_extent_invalidate();
+#endif
     /* #0 */
     for (i = 0; i < PIFS_OPEN_FILE_NUM_MAX; i++)
     {
@@ -581,6 +593,9 @@ pifs_status_t pifs_merge(void)
             /* Store position in file */
             PIFS_NOTICE_MSG("rw_pos: %i\r\n", file->rw_pos);
             file_pos[i] = file->rw_pos;
+            /* Nothing is written to the file yet, its entry is not stored
+             * or not copied, therefore it shall be re-created */
+            file_is_created[i] = (file->entry.file_size == PIFS_FILE_SIZE_ERASED);
             /* This will never cause data loss. There shall be enough free
              * entries in the entry list. */
             (void)pifs_internal_fclose(file, FALSE, TRUE);
@@ -658,6 +673,14 @@ pifs_status_t pifs_merge(void)
                                    &old_header.root_entry_list_address,
                                    &new_header.root_entry_list_address);
     }
+#if PIFS_PATCH_LOG_PAGE_NUM
+    if (ret == PIFS_SUCCESS)
+    {
+        /* Pages of files are marked in the new free space bitmap, */
+        /* so patch records of released pages can be dropped */
+        ret = pifs_copy_patch_log(&old_header, &new_header);
+    }
+#endif
     /* #8 */
     if (ret == PIFS_SUCCESS)
     {
@@ -701,6 +724,12 @@ pifs_status_t pifs_merge(void)
     }
     /* #11 */
     if (ret == PIFS_SUCCESS)
+    {
+        /* New management area shall be programmed before the old one is
+         * erased, therefore cache is flushed even in a transaction */
+        ret = pifs_flush();
+    }
+    if (ret == PIFS_SUCCESS)
     {
         PIFS_ASSERT(old_header.management_block_address != new_header.management_block_address);
         /* Erase old management area */
@@ -711,6 +740,24 @@ pifs_status_t pifs_merge(void)
         }
     }
     /* #12 */
+#if PIFS_ENABLE_FSBM_SHADOW
+    if (ret == PIFS_SUCCESS)
+    {
+        ret = pifs_fsbm_shadow_load();
+    }
+#endif
+#if PIFS_ENABLE_BLOCK_PAGE_CNTR
+    if (ret == PIFS_SUCCESS)
+    {
+        pifs_page_cntr_build();
+    }
+#endif
+#if PIFS_ENABLE_FREE_EXTENT_INDEX
+    if (ret == PIFS_SUCCESS)
+    {
+        pifs_free_extent_build();
+    }
+#endif
     if (ret == PIFS_SUCCESS)
     {
         ret = pifs_get_free_pages(&i, &pifs.free_data_page_num);
@@ -723,11 +770,12 @@ pifs_status_t pifs_merge(void)
             file = &pifs.file[i];
             if (file_is_opened[i])
             {
-                /* Do not create new file, as it has already done */
+                /* Do not create new file, as it has already done, except
+                 * files which were being created when merge started */
                 /* TODO save and restore mode_create_new_file and mode_file_shall_exist?
                  * to their original value? */
-                file->mode_create_new_file = FALSE;
-                file->mode_file_shall_exist = TRUE;
+                file->mode_create_new_file = file_is_created[i];
+                file->mode_file_shall_exist = !file_is_created[i];
                 /* TODO file->entry.name is not enough, full path should be stored!? */
                 ret = pifs_internal_open(file, file->entry.name, NULL, FALSE);
                 if (ret == PIFS_SUCCESS && file_pos[i])
@@ -883,3 +931,313 @@ pifs_status_t pifs_merge_check(pifs_file_t * a_file, pifs_size_t a_data_page_cou
 
     return ret;
 }
+
+#if PIFS_DELTA_FOLD_WATERMARK
+/**
+ * Operation of pifs_fold_map().
+ */
+typedef enum
+{
+    PIFS_FOLD_COUNT,    /**< Count pages which have delta page */
+    PIFS_FOLD_WRITE,    /**< Write actual pages to map of pifs.internal_file */
+    PIFS_FOLD_RELEASE   /**< Release delta entries and map pages */
+} pifs_fold_cmd_t;
+
+/**
+ * @brief pifs_fold_map Go through map of a file and look for actual page of
+ * every original page.
+ * It can compact map entries when pages are in sequence.
+ *
+ * @param[in] a_map_address         Pointer to address of first map page.
+ * @param[in] a_fold_cmd            Operation to perform.
+ * @param[out] a_delta_page_count   Pointer to number of pages which have
+ *                                  delta page.
+ * @return PIFS_SUCCESS if map was processed successfully.
+ */
+static pifs_status_t pifs_fold_map(pifs_address_t * a_map_address,
+                                   pifs_fold_cmd_t a_fold_cmd,
+                                   pifs_size_t * a_delta_page_count)
+{
+    pifs_status_t        ret = PIFS_SUCCESS;
+    pifs_status_t        ret2;
+    pifs_size_t          i;
+    pifs_size_t          j;
+    pifs_block_address_t map_ba = a_map_address->block_address;
+    pifs_page_address_t  map_pa = a_map_address->page_address;
+    pifs_map_header_t    map_header;
+    pifs_map_entry_t     map_entry;
+    pifs_map_entry_t     new_map_entry;
+    bool_t               end = FALSE;
+    pifs_address_t       delta_address;
+    pifs_block_address_t delta_ba = PIFS_BLOCK_ADDRESS_INVALID;
+    pifs_page_address_t  delta_pa = PIFS_PAGE_ADDRESS_INVALID;
+    pifs_address_t       test_address;
+    pifs_checksum_t      checksum;
+
+    *a_delta_page_count = 0;
+    new_map_entry.page_count = 0;
+    do
+    {
+        ret = pifs_read(map_ba, map_pa, 0, &map_header, PIFS_MAP_HEADER_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
+        for (i = 0; i < PIFS_MAP_ENTRY_PER_PAGE && !end && ret == PIFS_SUCCESS; i++)
+        {
+            ret = pifs_read(map_ba, map_pa,
+                            PIFS_MAP_HEADER_SIZE_BYTE + i * PIFS_MAP_ENTRY_SIZE_BYTE,
+                            &map_entry, PIFS_MAP_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_MAP);
+            if (ret == PIFS_SUCCESS && pifs_is_buffer_erased(&map_entry, PIFS_MAP_ENTRY_SIZE_BYTE))
+            {
+                /* Map entry is unused */
+                end = TRUE;
+            }
+            else if (ret == PIFS_SUCCESS)
+            {
+                checksum = pifs_calc_checksum(&map_entry,
+                                              PIFS_MAP_ENTRY_SIZE_BYTE - PIFS_CHECKSUM_SIZE_BYTE);
+                if (checksum != map_entry.checksum)
+                {
+                    ret = PIFS_ERROR_CHECKSUM;
+                }
+            }
+            for (j = 0; !end && j < map_entry.page_count && ret == PIFS_SUCCESS; j++)
+            {
+                ret = pifs_find_delta_page(map_entry.address.block_address,
+                                           map_entry.address.page_address,
+                                           &delta_ba, &delta_pa, NULL,
+                                           &pifs.header);
+                delta_address.block_address = delta_ba;
+                delta_address.page_address = delta_pa;
+                if (ret == PIFS_SUCCESS
+                        && (map_entry.address.block_address != delta_address.block_address
+                            || map_entry.address.page_address != delta_address.page_address))
+                {
+                    (*a_delta_page_count)++;
+                    if (a_fold_cmd == PIFS_FOLD_RELEASE)
+                    {
+                        pifs_release_delta_page(map_entry.address.block_address,
+                                                map_entry.address.page_address);
+                    }
+                }
+                if (ret == PIFS_SUCCESS && a_fold_cmd == PIFS_FOLD_WRITE)
+                {
+                    if (new_map_entry.page_count)
+                    {
+                        ret2 = pifs_inc_address(&test_address);
+                        /* Check if map entry shall be written: */
+                        /* #1 End of flash reached */
+                        /* #2 Page is not in sequence */
+                        /* #3 Too much pages in map entry */
+                        if (ret2 != PIFS_SUCCESS
+                                || test_address.block_address != delta_address.block_address
+                                || test_address.page_address != delta_address.page_address
+                                || new_map_entry.page_count == PIFS_MAP_PAGE_COUNT_INVALID - 1)
+                        {
+                            ret = pifs_append_map_entry(&pifs.internal_file,
+                                                        new_map_entry.address.block_address,
+                                                        new_map_entry.address.page_address,
+                                                        new_map_entry.page_count);
+                            new_map_entry.page_count = 0;
+                        }
+                        else
+                        {
+                            new_map_entry.page_count++;
+                        }
+                    }
+                    if (!new_map_entry.page_count)
+                    {
+                        new_map_entry.address = delta_address;
+                        new_map_entry.page_count = 1;
+                        test_address = delta_address;
+                    }
+                }
+                /* Deliberately avoiding return code: */
+                /* it is not an error if we reach the end of */
+                /* flash memory */
+                (void)pifs_inc_address(&map_entry.address);
+            }
+        }
+        if (ret == PIFS_SUCCESS && a_fold_cmd == PIFS_FOLD_RELEASE)
+        {
+            /* Map page is not used anymore */
+            ret = pifs_mark_page(map_ba, map_pa, PIFS_MAP_PAGE_NUM, FALSE, TRUE);
+        }
+        if (ret == PIFS_SUCCESS && !end)
+        {
+            checksum = pifs_calc_checksum(&map_header.next_map_address, PIFS_ADDRESS_SIZE_BYTE);
+            if (!pifs_is_buffer_erased(&map_header.next_map_address, PIFS_ADDRESS_SIZE_BYTE)
+                    && checksum == map_header.next_map_checksum)
+            {
+                map_ba = map_header.next_map_address.block_address;
+                map_pa = map_header.next_map_address.page_address;
+            }
+            else
+            {
+                end = TRUE;
+            }
+        }
+    } while (!end && ret == PIFS_SUCCESS);
+    if (ret == PIFS_SUCCESS && new_map_entry.page_count)
+    {
+        /* Write last map entry */
+        ret = pifs_append_map_entry(&pifs.internal_file,
+                                    new_map_entry.address.block_address,
+                                    new_map_entry.address.page_address,
+                                    new_map_entry.page_count);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_fold_delta Fold delta pages of a file into its map without
+ * merging the management area. A new map is written which contains the
+ * actual pages, so delta entries of the file are released, other files are
+ * not changed. Superseded delta entries are also released.
+ * Nothing is done if less than a delta map page's worth of entries would be
+ * released.
+ * Note: the caller shall provide mutex protection!
+ *
+ * Steps of folding:
+ * #1 Count pages of the file which have delta page.
+ * #2 Write new map of the file to free management pages.
+ * #3 Update entry of the file, new map is valid from this point.
+ * #4 Release delta entries of the file and mark old map and index pages to be
+ *    released.
+ * #5 Release entries in the delta map.
+ * #6 Seek opened files of the entry to their position in the new map.
+ *
+ * @param[in] a_file Pointer to opened file.
+ * @return PIFS_SUCCESS if fold was not necessary or it was successful.
+ */
+pifs_status_t pifs_fold_delta(pifs_file_t * a_file)
+{
+    pifs_status_t        ret = PIFS_SUCCESS;
+    pifs_address_t       old_map_address = a_file->entry.first_map_address;
+    pifs_block_address_t ba = PIFS_BLOCK_ADDRESS_INVALID;
+    pifs_page_address_t  pa = PIFS_PAGE_ADDRESS_INVALID;
+    pifs_page_count_t    page_count_found = 0;
+    pifs_size_t          delta_page_count = 0;
+    pifs_size_t          i;
+    pifs_file_t        * file;
+    bool_t               is_folded = FALSE;
+    bool_t               file_is_folded[PIFS_OPEN_FILE_NUM_MAX] = { 0 };
+    pifs_size_t          file_pos;
+
+    PIFS_NOTICE_MSG("filename: '%s'\r\n", a_file->entry.name);
+#if PIFS_ENABLE_MAP_COALESCE
+    ret = pifs_flush_map_entry(a_file);
+#endif
+    /* #1 */
+    if (ret == PIFS_SUCCESS)
+    {
+        ret = pifs_fold_map(&old_map_address, PIFS_FOLD_COUNT, &delta_page_count);
+    }
+    if (ret == PIFS_SUCCESS
+            && delta_page_count + pifs_count_superseded_delta_entries() >= PIFS_DELTA_ENTRY_PER_PAGE)
+    {
+        /* #2 */
+        if (delta_page_count)
+        {
+            ret = pifs_find_free_page_wl(PIFS_MAP_PAGE_NUM, PIFS_MAP_PAGE_NUM,
+                                         PIFS_BLOCK_TYPE_PRIMARY_MANAGEMENT,
+                                         &ba, &pa, &page_count_found);
+            if (ret == PIFS_SUCCESS)
+            {
+                ret = pifs_mark_page(ba, pa, PIFS_MAP_PAGE_NUM, TRUE, FALSE);
+                is_folded = TRUE;
+            }
+            else if (ret == PIFS_ERROR_NO_MORE_SPACE)
+            {
+                /* Map is not changed, only superseded entries are released */
+                ret = PIFS_SUCCESS;
+            }
+        }
+        if (ret == PIFS_SUCCESS && is_folded)
+        {
+            PIFS_INFO_MSG("Fold %i delta pages of '%s' to new map %s\r\n", delta_page_count,
+                          a_file->entry.name, pifs_ba_pa2str(ba, pa));
+            pifs.internal_file.status = PIFS_SUCCESS;
+            pifs.internal_file.entry.first_map_address.block_address = ba;
+            pifs.internal_file.entry.first_map_address.page_address = pa;
+            pifs.internal_file.actual_map_address.block_address = ba;
+            pifs.internal_file.actual_map_address.page_address = pa;
+            pifs.internal_file.map_entry_idx = 0;
+            memset(&pifs.internal_file.map_header, PIFS_FLASH_ERASED_BYTE_VALUE, PIFS_MAP_HEADER_SIZE_BYTE);
+            memset(&pifs.internal_file.map_entry, PIFS_FLASH_ERASED_BYTE_VALUE, PIFS_MAP_ENTRY_SIZE_BYTE);
+#if PIFS_ENABLE_MAP_COALESCE
+            pifs.internal_file.is_map_entry_pending = FALSE;
+#endif
+            ret = pifs_fold_map(&old_map_address, PIFS_FOLD_WRITE, &delta_page_count);
+#if PIFS_ENABLE_MAP_COALESCE
+            if (ret == PIFS_SUCCESS)
+            {
+                ret = pifs_flush_map_entry(&pifs.internal_file);
+            }
+#endif
+        }
+        /* #3 */
+        if (ret == PIFS_SUCCESS && is_folded)
+        {
+            for (i = 0; i < PIFS_OPEN_FILE_NUM_MAX; i++)
+            {
+                file = &pifs.file[i];
+                if (file->is_opened
+                        && file->entry.first_map_address.block_address == old_map_address.block_address
+                        && file->entry.first_map_address.page_address == old_map_address.page_address)
+                {
+                    file->entry.first_map_address.block_address = ba;
+                    file->entry.first_map_address.page_address = pa;
+#if PIFS_FILE_EXTENT_NUM_MAX
+                    file->extent_is_read = FALSE;
+#endif
+                    file_is_folded[i] = TRUE;
+                }
+            }
+            a_file->is_entry_changed = TRUE;
+            (void)pifs_internal_fflush(a_file, FALSE, TRUE);
+            ret = a_file->status;
+        }
+        /* #4 */
+        if (ret == PIFS_SUCCESS && is_folded)
+        {
+            ret = pifs_fold_map(&old_map_address, PIFS_FOLD_RELEASE, &delta_page_count);
+        }
+#if PIFS_ENABLE_MAP_INDEX
+        if (ret == PIFS_SUCCESS && is_folded)
+        {
+            ret = pifs_release_map_index(a_file, &old_map_address);
+        }
+#endif
+        /* #5 */
+        if (ret == PIFS_SUCCESS)
+        {
+            ret = pifs_compact_delta_map(&pifs.header);
+        }
+        else
+        {
+            /* Read delta map again to drop released entries of RAM index */
+            pifs_reset_delta();
+        }
+        /* #6 */
+        for (i = 0; i < PIFS_OPEN_FILE_NUM_MAX; i++)
+        {
+            file = &pifs.file[i];
+            if (file_is_folded[i])
+            {
+                file_pos = file->rw_pos;
+                pifs_internal_rewind(file);
+                if (file->status == PIFS_SUCCESS && file_pos)
+                {
+                    /* Seek to the stored position */
+                    (void)pifs_internal_fseek(file, file_pos, PIFS_SEEK_SET);
+                }
+                if (ret == PIFS_SUCCESS)
+                {
+                    ret = file->status;
+                }
+            }
+        }
+    }
+
+    return ret;
+}
+#endif
@@ -36,6 +36,9 @@ extern "C" {
 
 pifs_status_t pifs_merge(void);
 pifs_status_t pifs_merge_check(pifs_file_t * a_file, pifs_size_t a_data_page_count_minimum);
+#if PIFS_DELTA_FOLD_WATERMARK
+pifs_status_t pifs_fold_delta(pifs_file_t * a_file);
+#endif
 
 #ifdef __cplusplus
 }
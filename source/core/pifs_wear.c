@@ -76,7 +76,7 @@ pifs_status_t pifs_wear_level_list_init(void)
     {
         //PIFS_WARNING_MSG("%s\r\n", pifs_address2str(&address));
         ret = pifs_write(address.block_address, address.page_address, 0,
-                         pifs.dmw_page_buf, PIFS_LOGICAL_PAGE_SIZE_BYTE);
+                         pifs.dmw_page_buf, PIFS_LOGICAL_PAGE_SIZE_BYTE, PIFS_CACHE_CLASS_WEAR_LIST);
         if (ret == PIFS_SUCCESS)
         {
             (void)pifs_inc_address(&address);
@@ -117,7 +117,7 @@ pifs_status_t pifs_get_wear_level(pifs_block_address_t a_block_address,
     if (ret == PIFS_SUCCESS)
     {
         ret = pifs_read(address.block_address, address.page_address, po,
-                        a_wear_level, PIFS_WEAR_LEVEL_ENTRY_SIZE_BYTE);
+                        a_wear_level, PIFS_WEAR_LEVEL_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_WEAR_LIST);
 #if 0
         PIFS_WARNING_MSG("BA%i wear level counter: %i, bits: 0x%02X\r\n",
                          a_block_address,
@@ -167,7 +167,7 @@ pifs_status_t pifs_inc_wear_level(pifs_block_address_t a_block_address,
     {
         po %= PIFS_LOGICAL_PAGE_SIZE_BYTE;
         ret = pifs_read(address.block_address, address.page_address, po,
-                        &wear_level, PIFS_WEAR_LEVEL_ENTRY_SIZE_BYTE);
+                        &wear_level, PIFS_WEAR_LEVEL_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_WEAR_LIST);
         if (ret == PIFS_SUCCESS)
         {
             ret = PIFS_ERROR_NO_MORE_SPACE;
@@ -187,7 +187,7 @@ pifs_status_t pifs_inc_wear_level(pifs_block_address_t a_block_address,
             if (ret == PIFS_SUCCESS)
             {
                 ret = pifs_write(address.block_address, address.page_address, po,
-                                 &wear_level, PIFS_WEAR_LEVEL_ENTRY_SIZE_BYTE);
+                                 &wear_level, PIFS_WEAR_LEVEL_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_WEAR_LIST);
             }
         }
     }
@@ -224,7 +224,7 @@ pifs_status_t pifs_write_wear_level(pifs_block_address_t a_block_address,
                          a_wear_level->wear_level_cntr,
                          a_wear_level->wear_level_bits);
         ret = pifs_write(address.block_address, address.page_address, po,
-                         a_wear_level, PIFS_WEAR_LEVEL_ENTRY_SIZE_BYTE);
+                         a_wear_level, PIFS_WEAR_LEVEL_ENTRY_SIZE_BYTE, PIFS_CACHE_CLASS_WEAR_LIST);
     }
 
     return ret;
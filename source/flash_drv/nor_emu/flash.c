@@ -21,8 +21,10 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <unistd.h>
 
 #include "api_pifs.h"
 #include "flash.h"
@@ -30,6 +32,10 @@
 #include "pifs_helper.h"
 #include "buffer.h"
 
+#if PIFS_FLASH_ASYNC_ENABLED
+#include <pthread.h>
+#endif
+
 #define FLASH_DEBUG     1
 
 #if FLASH_DEBUG
@@ -57,6 +63,204 @@ static FILE * stat_file = NULL;
 static uint8_t flash_page_buf[PIFS_FLASH_PAGE_SIZE_BYTE] = { 0 };
 static size_t flash_stat[FLASH_STAT_CNTR_NUM][PIFS_FLASH_BLOCK_NUM_ALL][PIFS_FLASH_PAGE_PER_BLOCK] = { { { 0  } } };
 static size_t flash_stat_temp[PIFS_FLASH_BLOCK_NUM_ALL * PIFS_FLASH_PAGE_PER_BLOCK] = { 0 };
+/** Emulated latencies in microseconds, environment variables can override them */
+static unsigned long flash_read_latency_us = FLASH_EMU_READ_LATENCY_US;
+static unsigned long flash_write_latency_us = FLASH_EMU_WRITE_LATENCY_US;
+static unsigned long flash_erase_latency_us = FLASH_EMU_ERASE_LATENCY_US;
+#if PIFS_FLASH_ASYNC_ENABLED
+static pthread_t flash_async_thread;
+static bool_t flash_async_is_running = FALSE;
+static bool_t flash_async_exit = FALSE;
+/** TRUE: submitted requests are not executed, see pifs_flash_async_hold() */
+static bool_t flash_async_is_held = FALSE;
+/** Protects the request queue */
+static pthread_mutex_t flash_async_mutex = PTHREAD_MUTEX_INITIALIZER;
+/** Protects the memory file, only one command is executed at a time */
+static pthread_mutex_t flash_device_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flash_async_submitted = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t flash_async_completed = PTHREAD_COND_INITIALIZER;
+/** Queue of submitted requests, executed in submission order */
+static pifs_flash_request_t * flash_async_queue[FLASH_EMU_ASYNC_QUEUE_SIZE];
+static size_t flash_async_head = 0;
+static size_t flash_async_count = 0;
+#endif
+
+static pifs_status_t flash_read(pifs_block_address_t a_block_address, pifs_page_address_t a_page_address, pifs_page_offset_t a_page_offset, void * const a_buf, size_t a_buf_size);
+static pifs_status_t flash_write(pifs_block_address_t a_block_address, pifs_page_address_t a_page_address, pifs_page_address_t a_page_offset, const void * const a_buf, size_t a_buf_size);
+static pifs_status_t flash_erase(pifs_block_address_t a_block_address);
+
+/**
+ * @brief flash_delay Emulate busy time of flash memory.
+ *
+ * @param[in] a_latency_us Busy time in microseconds.
+ */
+static void flash_delay(unsigned long a_latency_us)
+{
+    if (a_latency_us)
+    {
+        usleep(a_latency_us);
+    }
+}
+
+/**
+ * @brief flash_get_latency Get latency from environment variable.
+ *
+ * @param[in] a_name        Name of environment variable.
+ * @param[in] a_default_us  Default latency in microseconds.
+ * @return Latency in microseconds.
+ */
+static unsigned long flash_get_latency(const char * a_name, unsigned long a_default_us)
+{
+    const char * value = getenv(a_name);
+
+    return value ? strtoul(value, NULL, 0) : a_default_us;
+}
+
+#if PIFS_FLASH_ASYNC_ENABLED
+/**
+ * @brief flash_async_task Worker thread which executes the submitted
+ * requests in submission order.
+ *
+ * @param[in] a_arg Not used.
+ * @return NULL.
+ */
+static void * flash_async_task(void * a_arg)
+{
+    pifs_flash_request_t * request;
+    pifs_status_t          status;
+    unsigned long          latency_us;
+
+    (void) a_arg;
+
+    pthread_mutex_lock(&flash_async_mutex);
+    while (!flash_async_exit || flash_async_count)
+    {
+        if (flash_async_count && !flash_async_is_held)
+        {
+            /* Request stays in the queue until it is completed to keep */
+            /* barriers waiting */
+            request = flash_async_queue[flash_async_head];
+            pthread_mutex_unlock(&flash_async_mutex);
+            pthread_mutex_lock(&flash_device_mutex);
+            switch (request->op)
+            {
+                case PIFS_FLASH_OP_READ:
+                    status = flash_read(request->block_address, request->page_address,
+                                        request->page_offset, request->buf, request->buf_size);
+                    latency_us = flash_read_latency_us;
+                    break;
+                case PIFS_FLASH_OP_WRITE:
+                    status = flash_write(request->block_address, request->page_address,
+                                         request->page_offset, request->buf, request->buf_size);
+                    latency_us = flash_write_latency_us;
+                    break;
+                case PIFS_FLASH_OP_ERASE:
+                    status = flash_erase(request->block_address);
+                    latency_us = flash_erase_latency_us;
+                    break;
+                default:
+                    status = PIFS_ERROR_FLASH_GENERAL;
+                    latency_us = 0;
+                    break;
+            }
+            pthread_mutex_unlock(&flash_device_mutex);
+            /* Block is busy until request is completed, but other blocks */
+            /* can be read meanwhile */
+            flash_delay(latency_us);
+            pthread_mutex_lock(&flash_async_mutex);
+            request->status = status;
+            request->is_done = TRUE;
+            flash_async_head = (flash_async_head + 1) % FLASH_EMU_ASYNC_QUEUE_SIZE;
+            flash_async_count--;
+            pthread_cond_broadcast(&flash_async_completed);
+        }
+        else
+        {
+            pthread_cond_wait(&flash_async_submitted, &flash_async_mutex);
+        }
+    }
+    pthread_mutex_unlock(&flash_async_mutex);
+
+    return NULL;
+}
+
+/**
+ * @brief flash_is_async_task Check if caller is the worker thread.
+ *
+ * @return TRUE: caller is the worker thread.
+ */
+static bool_t flash_is_async_task(void)
+{
+    return flash_async_is_running && pthread_equal(pthread_self(), flash_async_thread);
+}
+
+/**
+ * @brief flash_async_is_block_busy Check if a submitted program or erase
+ * request of a block is not completed yet. Caller shall lock
+ * flash_async_mutex.
+ *
+ * @param[in] a_block_address Block address to check.
+ * @return TRUE: block is programmed or erased.
+ */
+static bool_t flash_async_is_block_busy(pifs_block_address_t a_block_address)
+{
+    bool_t                 is_busy = FALSE;
+    pifs_flash_request_t * request;
+    size_t                 i;
+
+    for (i = 0; i < flash_async_count && !is_busy; i++)
+    {
+        request = flash_async_queue[(flash_async_head + i) % FLASH_EMU_ASYNC_QUEUE_SIZE];
+        is_busy = (request->op != PIFS_FLASH_OP_READ
+                   && request->block_address == a_block_address);
+    }
+
+    return is_busy;
+}
+#endif
+
+
+/**
+ * @brief flash_sync_begin Start a synchronous command. Read waits only for
+ * the submitted program and erase requests of the same block, so blocks can
+ * be read while other blocks are busy. Program and erase wait for every
+ * submitted request.
+ *
+ * @param[in] a_block_address Block address of command.
+ * @param[in] a_is_read       TRUE: command is a read.
+ */
+static void flash_sync_begin(pifs_block_address_t a_block_address, bool_t a_is_read)
+{
+#if PIFS_FLASH_ASYNC_ENABLED
+    if (a_is_read)
+    {
+        pthread_mutex_lock(&flash_async_mutex);
+        while (flash_async_is_block_busy(a_block_address))
+        {
+            pthread_cond_wait(&flash_async_completed, &flash_async_mutex);
+        }
+        pthread_mutex_unlock(&flash_async_mutex);
+    }
+    else
+    {
+        (void) pifs_flash_async_barrier();
+    }
+    pthread_mutex_lock(&flash_device_mutex);
+#else
+    (void) a_block_address;
+    (void) a_is_read;
+#endif
+}
+
+/**
+ * @brief flash_sync_end Finish a synchronous command.
+ */
+static void flash_sync_end(void)
+{
+#if PIFS_FLASH_ASYNC_ENABLED
+    pthread_mutex_unlock(&flash_device_mutex);
+#endif
+}
 
 pifs_status_t pifs_flash_init(void)
 {
@@ -64,6 +268,9 @@ pifs_status_t pifs_flash_init(void)
     pifs_block_address_t ba;
 
     PIFS_ASSERT(flash_file == NULL);
+    flash_read_latency_us = flash_get_latency("FLASH_EMU_READ_LATENCY_US", FLASH_EMU_READ_LATENCY_US);
+    flash_write_latency_us = flash_get_latency("FLASH_EMU_WRITE_LATENCY_US", FLASH_EMU_WRITE_LATENCY_US);
+    flash_erase_latency_us = flash_get_latency("FLASH_EMU_ERASE_LATENCY_US", FLASH_EMU_ERASE_LATENCY_US);
     flash_file = fopen(FLASH_EMU_FILENAME, "rb+");
     if (flash_file)
     {
@@ -109,6 +316,21 @@ pifs_status_t pifs_flash_init(void)
             FLASH_ERROR_MSG("Cannot create flash file!\r\n");
         }
     }
+#if PIFS_FLASH_ASYNC_ENABLED
+    if (ret == PIFS_SUCCESS && !flash_async_is_running)
+    {
+        flash_async_exit = FALSE;
+        if (pthread_create(&flash_async_thread, NULL, flash_async_task, NULL) == 0)
+        {
+            flash_async_is_running = TRUE;
+        }
+        else
+        {
+            FLASH_ERROR_MSG("Cannot create worker thread!\r\n");
+            ret = PIFS_ERROR_FLASH_INIT;
+        }
+    }
+#endif
 
     return ret;
 }
@@ -118,6 +340,19 @@ pifs_status_t pifs_flash_delete(void)
     pifs_status_t ret = PIFS_ERROR_GENERAL;
 
     //pifs_flash_print_stat();
+#if PIFS_FLASH_ASYNC_ENABLED
+    if (flash_async_is_running && !flash_is_async_task())
+    {
+        /* Execute pending requests and stop the worker thread */
+        pthread_mutex_lock(&flash_async_mutex);
+        flash_async_exit = TRUE;
+        flash_async_is_held = FALSE;
+        pthread_cond_signal(&flash_async_submitted);
+        pthread_mutex_unlock(&flash_async_mutex);
+        pthread_join(flash_async_thread, NULL);
+        flash_async_is_running = FALSE;
+    }
+#endif
     if (flash_file)
     {
         if (!fclose(flash_file))
@@ -143,7 +378,7 @@ pifs_status_t pifs_flash_delete(void)
     return ret;
 }
 
-pifs_status_t pifs_flash_read(pifs_block_address_t a_block_address, pifs_page_address_t a_page_address, pifs_page_offset_t a_page_offset, void * const a_buf, size_t a_buf_size)
+static pifs_status_t flash_read(pifs_block_address_t a_block_address, pifs_page_address_t a_page_address, pifs_page_offset_t a_page_offset, void * const a_buf, size_t a_buf_size)
 {
     pifs_status_t ret = PIFS_ERROR_FLASH_READ;
     long unsigned int offset = a_block_address * PIFS_FLASH_BLOCK_SIZE_BYTE
@@ -175,7 +410,7 @@ pifs_status_t pifs_flash_read(pifs_block_address_t a_block_address, pifs_page_ad
     return ret;
 }
 
-pifs_status_t pifs_flash_write(pifs_block_address_t a_block_address, pifs_page_address_t a_page_address, pifs_page_address_t a_page_offset, const void * const a_buf, size_t a_buf_size)
+static pifs_status_t flash_write(pifs_block_address_t a_block_address, pifs_page_address_t a_page_address, pifs_page_address_t a_page_offset, const void * const a_buf, size_t a_buf_size)
 {
     pifs_status_t ret = PIFS_ERROR_FLASH_WRITE;
     long unsigned int offset = a_block_address * PIFS_FLASH_BLOCK_SIZE_BYTE
@@ -207,13 +442,9 @@ pifs_status_t pifs_flash_write(pifs_block_address_t a_block_address, pifs_page_a
                 {
                     /* Error: cannot write data */
                     printf("Original page:\r\n");
-                    print_buffer(flash_page_buf, PIFS_FLASH_PAGE_SIZE_BYTE,
-                                 a_block_address * PIFS_FLASH_BLOCK_SIZE_BYTE
-                                 + a_page_address * PIFS_FLASH_PAGE_SIZE_BYTE);
+                    print_buffer(flash_page_buf, a_buf_size, offset);
                     printf("New page:\r\n");
-                    print_buffer(buf8, PIFS_FLASH_PAGE_SIZE_BYTE,
-                                 a_block_address * PIFS_FLASH_BLOCK_SIZE_BYTE
-                                 + a_page_address * PIFS_FLASH_PAGE_SIZE_BYTE);
+                    print_buffer(buf8, a_buf_size, offset);
                     FLASH_ERROR_MSG("Cannot program 0x%02X to 0x%02X. %s offset: %i, 0x%02X\r\n",
                                     flash_page_buf[i], buf8[i],
                                     pifs_flash_ba_pa2str(a_block_address, a_page_address),
@@ -242,7 +473,75 @@ pifs_status_t pifs_flash_write(pifs_block_address_t a_block_address, pifs_page_a
     return ret;
 }
 
-pifs_status_t pifs_flash_erase(pifs_block_address_t a_block_address)
+#if PIFS_FLASH_MULTI_PAGE_ENABLED
+pifs_status_t pifs_flash_read_multi(pifs_block_address_t a_block_address, pifs_page_address_t a_page_address, void * const a_buf, size_t a_page_count)
+{
+    pifs_status_t ret = PIFS_ERROR_FLASH_READ;
+    long unsigned int offset = a_block_address * PIFS_FLASH_BLOCK_SIZE_BYTE
+            + a_page_address * PIFS_FLASH_PAGE_SIZE_BYTE;
+    size_t buf_size = a_page_count * PIFS_FLASH_PAGE_SIZE_BYTE;
+    size_t read_count = 0;
+    size_t i;
+
+    PIFS_ASSERT(flash_file);
+    flash_sync_begin(a_block_address, TRUE);
+    if ((a_page_address + a_page_count) <= PIFS_FLASH_PAGE_PER_BLOCK
+            && (offset + buf_size) <= PIFS_FLASH_SIZE_BYTE_ALL
+        #if PIFS_FLASH_BLOCK_RESERVED_NUM
+            && offset >= (PIFS_FLASH_BLOCK_RESERVED_NUM * PIFS_FLASH_BLOCK_SIZE_BYTE)
+        #endif
+            )
+    {
+        PIFS_ASSERT(fseek(flash_file, offset, SEEK_SET) == 0);
+        read_count = fread(a_buf, 1, buf_size, flash_file);
+        if (read_count == buf_size)
+        {
+            ret = PIFS_SUCCESS;
+        }
+        for (i = 0; i < a_page_count; i++)
+        {
+            flash_stat[FLASH_STAT_READ_CNTR][a_block_address][a_page_address + i]++;
+        }
+    }
+    else
+    {
+        FLASH_ERROR_MSG("Trying to read from invalid flash address! BA%i/PA%i, page count: %i\r\n",
+                        a_block_address, a_page_address, a_page_count);
+    }
+    flash_sync_end();
+    flash_delay(flash_read_latency_us);
+
+    return ret;
+}
+
+pifs_status_t pifs_flash_write_multi(pifs_block_address_t a_block_address, pifs_page_address_t a_page_address, const void * const a_buf, size_t a_page_count)
+{
+    pifs_status_t ret = PIFS_ERROR_FLASH_WRITE;
+    const uint8_t * buf8 = (const uint8_t*) a_buf;
+    size_t i;
+
+    if ((a_page_address + a_page_count) <= PIFS_FLASH_PAGE_PER_BLOCK)
+    {
+        ret = PIFS_SUCCESS;
+        /* Page program cannot cross page boundary */
+        for (i = 0; i < a_page_count && ret == PIFS_SUCCESS; i++)
+        {
+            ret = pifs_flash_write(a_block_address, a_page_address + i, 0,
+                                   &buf8[i * PIFS_FLASH_PAGE_SIZE_BYTE],
+                                   PIFS_FLASH_PAGE_SIZE_BYTE);
+        }
+    }
+    else
+    {
+        FLASH_ERROR_MSG("Trying to write to invalid flash address! %s, page count: %i\r\n",
+                        pifs_flash_ba_pa2str(a_block_address, a_page_address), a_page_count);
+    }
+
+    return ret;
+}
+#endif
+
+static pifs_status_t flash_erase(pifs_block_address_t a_block_address)
 {
     pifs_status_t ret = PIFS_ERROR_FLASH_ERASE;
     long unsigned int offset = a_block_address * PIFS_FLASH_BLOCK_SIZE_BYTE;
@@ -279,6 +578,114 @@ pifs_status_t pifs_flash_erase(pifs_block_address_t a_block_address)
     return ret;
 }
 
+pifs_status_t pifs_flash_read(pifs_block_address_t a_block_address, pifs_page_address_t a_page_address, pifs_page_offset_t a_page_offset, void * const a_buf, size_t a_buf_size)
+{
+    pifs_status_t ret;
+
+    flash_sync_begin(a_block_address, TRUE);
+    ret = flash_read(a_block_address, a_page_address, a_page_offset, a_buf, a_buf_size);
+    flash_sync_end();
+    flash_delay(flash_read_latency_us);
+
+    return ret;
+}
+
+pifs_status_t pifs_flash_write(pifs_block_address_t a_block_address, pifs_page_address_t a_page_address, pifs_page_address_t a_page_offset, const void * const a_buf, size_t a_buf_size)
+{
+    pifs_status_t ret;
+
+    flash_sync_begin(a_block_address, FALSE);
+    ret = flash_write(a_block_address, a_page_address, a_page_offset, a_buf, a_buf_size);
+    flash_sync_end();
+    flash_delay(flash_write_latency_us);
+
+    return ret;
+}
+
+pifs_status_t pifs_flash_erase(pifs_block_address_t a_block_address)
+{
+    pifs_status_t ret;
+
+    flash_sync_begin(a_block_address, FALSE);
+    ret = flash_erase(a_block_address);
+    flash_sync_end();
+    flash_delay(flash_erase_latency_us);
+
+    return ret;
+}
+
+#if PIFS_FLASH_ASYNC_ENABLED
+pifs_status_t pifs_flash_async_submit(pifs_flash_request_t * a_request)
+{
+    pifs_status_t ret = PIFS_ERROR_FLASH_INIT;
+
+    pthread_mutex_lock(&flash_async_mutex);
+    if (flash_async_is_running && !flash_async_exit)
+    {
+        while (flash_async_count == FLASH_EMU_ASYNC_QUEUE_SIZE)
+        {
+            /* Queue is full */
+            pthread_cond_wait(&flash_async_completed, &flash_async_mutex);
+        }
+        a_request->is_done = FALSE;
+        a_request->status = PIFS_ERROR_FLASH_GENERAL;
+        flash_async_queue[(flash_async_head + flash_async_count) % FLASH_EMU_ASYNC_QUEUE_SIZE] = a_request;
+        flash_async_count++;
+        pthread_cond_signal(&flash_async_submitted);
+        ret = PIFS_SUCCESS;
+    }
+    pthread_mutex_unlock(&flash_async_mutex);
+
+    return ret;
+}
+
+bool_t pifs_flash_async_is_done(pifs_flash_request_t * a_request)
+{
+    bool_t is_done;
+
+    pthread_mutex_lock(&flash_async_mutex);
+    is_done = a_request->is_done;
+    pthread_mutex_unlock(&flash_async_mutex);
+
+    return is_done;
+}
+
+pifs_status_t pifs_flash_async_wait(pifs_flash_request_t * a_request)
+{
+    pifs_status_t ret;
+
+    pthread_mutex_lock(&flash_async_mutex);
+    while (!a_request->is_done)
+    {
+        pthread_cond_wait(&flash_async_completed, &flash_async_mutex);
+    }
+    ret = a_request->status;
+    pthread_mutex_unlock(&flash_async_mutex);
+
+    return ret;
+}
+
+void pifs_flash_async_hold(bool_t a_is_held)
+{
+    pthread_mutex_lock(&flash_async_mutex);
+    flash_async_is_held = a_is_held;
+    pthread_cond_signal(&flash_async_submitted);
+    pthread_mutex_unlock(&flash_async_mutex);
+}
+
+pifs_status_t pifs_flash_async_barrier(void)
+{
+    pthread_mutex_lock(&flash_async_mutex);
+    while (flash_async_count)
+    {
+        pthread_cond_wait(&flash_async_completed, &flash_async_mutex);
+    }
+    pthread_mutex_unlock(&flash_async_mutex);
+
+    return PIFS_SUCCESS;
+}
+#endif
+
 void pifs_flash_sort(size_t * a_array, size_t a_array_size)
 {
     size_t i;
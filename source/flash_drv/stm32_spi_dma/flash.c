@@ -400,6 +400,72 @@ pifs_status_t pifs_flash_write(pifs_block_address_t a_block_address, pifs_page_a
     return ret;
 }
 
+#if PIFS_FLASH_MULTI_PAGE_ENABLED
+/**
+ * @brief pifs_flash_read_multi Read consecutive pages from flash memory.
+ * One read command is used for all pages.
+ *
+ * @param[in] a_block_address Address of block.
+ * @param[in] a_page_address  Address of the first page in block.
+ * @param[out] a_buf          Buffer to fill.
+ * @param[in] a_page_count    Number of pages to read.
+ * @return PIFS_SUCCESS if read successfully finished.
+ */
+pifs_status_t pifs_flash_read_multi(pifs_block_address_t a_block_address, pifs_page_address_t a_page_address, void * const a_buf, size_t a_page_count)
+{
+    pifs_status_t ret = PIFS_ERROR_FLASH_READ;
+
+    if ((a_page_address + a_page_count) <= PIFS_FLASH_PAGE_PER_BLOCK)
+    {
+        ret = pifs_flash_read(a_block_address, a_page_address, 0, a_buf,
+                              a_page_count * PIFS_FLASH_PAGE_SIZE_BYTE);
+    }
+    else
+    {
+        FLASH_ERROR_MSG("Trying to read from invalid flash address! BA%i/PA%i, page count: %i\r\n",
+                        a_block_address, a_page_address, a_page_count);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief pifs_flash_write_multi Write consecutive pages to flash memory.
+ * Page program command cannot cross page boundary, therefore pages are
+ * programmed one by one.
+ *
+ * @param[in] a_block_address Address of block.
+ * @param[in] a_page_address  Address of the first page in block.
+ * @param[in] a_buf           Buffer to write.
+ * @param[in] a_page_count    Number of pages to write.
+ * @return PIFS_SUCCESS if write successfully finished.
+ */
+pifs_status_t pifs_flash_write_multi(pifs_block_address_t a_block_address, pifs_page_address_t a_page_address, const void * const a_buf, size_t a_page_count)
+{
+    pifs_status_t   ret = PIFS_ERROR_FLASH_WRITE;
+    const uint8_t * buf8 = (const uint8_t*) a_buf;
+    size_t          i;
+
+    if ((a_page_address + a_page_count) <= PIFS_FLASH_PAGE_PER_BLOCK)
+    {
+        ret = PIFS_SUCCESS;
+        for (i = 0; i < a_page_count && ret == PIFS_SUCCESS; i++)
+        {
+            ret = pifs_flash_write(a_block_address, a_page_address + i, 0,
+                                   &buf8[i * PIFS_FLASH_PAGE_SIZE_BYTE],
+                                   PIFS_FLASH_PAGE_SIZE_BYTE);
+        }
+    }
+    else
+    {
+        FLASH_ERROR_MSG("Trying to write to invalid flash address! BA%i/PA%i, page count: %i\r\n",
+                        a_block_address, a_page_address, a_page_count);
+    }
+
+    return ret;
+}
+#endif
+
 /**
  * @brief pifs_flash_erase Erase a block.
  *
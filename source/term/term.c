@@ -48,6 +48,10 @@
 #include "stm32f4xx_hal.h"
 #endif
 
+#if ENABLE_BENCHMARK
+#include "bench.h"
+#endif
+
 #if STM32F4xx || STM32F1xx
 #include "uart.h"
 #endif
@@ -269,6 +273,142 @@ void cmdTestPifsSeek (char* command, char* params)
     pifs_test_wseek_r();
 }
 
+#if ENABLE_BENCHMARK
+void cmdBenchReadAhead (char* command, char* params)
+{
+    char * param;
+    size_t file_size = 64u * 1024u;
+    size_t chunk_size = 0;
+
+    (void) command;
+    (void) params;
+
+    param = PARSER_getNextParam();
+    if (param)
+    {
+        file_size = strtoul(param, NULL, 0);
+        param = PARSER_getNextParam();
+        if (param)
+        {
+            chunk_size = strtoul(param, NULL, 0);
+        }
+    }
+    pifs_bench_read_ahead(file_size, chunk_size);
+}
+
+void cmdBenchFsbmScan (char* command, char* params)
+{
+    (void) command;
+    (void) params;
+
+    pifs_bench_fsbm_scan();
+}
+
+void cmdBenchFragment (char* command, char* params)
+{
+    char * param;
+    size_t file_size = 64u * 1024u;
+    size_t chunk_size = PIFS_LOGICAL_PAGE_SIZE_BYTE;
+
+    (void) command;
+    (void) params;
+
+    param = PARSER_getNextParam();
+    if (param)
+    {
+        file_size = strtoul(param, NULL, 0);
+        param = PARSER_getNextParam();
+        if (param)
+        {
+            chunk_size = strtoul(param, NULL, 0);
+        }
+    }
+    pifs_bench_fragment(file_size, chunk_size);
+}
+
+void cmdBenchInterleave (char* command, char* params)
+{
+    char * param;
+    size_t file_size = 32u * 1024u;
+    size_t chunk_size = PIFS_LOGICAL_PAGE_SIZE_BYTE;
+
+    (void) command;
+    (void) params;
+
+    param = PARSER_getNextParam();
+    if (param)
+    {
+        file_size = strtoul(param, NULL, 0);
+        param = PARSER_getNextParam();
+        if (param)
+        {
+            chunk_size = strtoul(param, NULL, 0);
+        }
+    }
+    pifs_bench_interleave(file_size, chunk_size);
+}
+
+void cmdBenchDelta (char* command, char* params)
+{
+    char * param;
+    size_t file_size = 64u * 1024u;
+    size_t page_num = 32u;
+
+    (void) command;
+    (void) params;
+
+    param = PARSER_getNextParam();
+    if (param)
+    {
+        file_size = strtoul(param, NULL, 0);
+        param = PARSER_getNextParam();
+        if (param)
+        {
+            page_num = strtoul(param, NULL, 0);
+        }
+    }
+    pifs_bench_delta(file_size, page_num);
+}
+
+void cmdBenchCounter (char* command, char* params)
+{
+    char * param;
+    size_t update_num = 100u;
+
+    (void) command;
+    (void) params;
+
+    param = PARSER_getNextParam();
+    if (param)
+    {
+        update_num = strtoul(param, NULL, 0);
+    }
+    pifs_bench_counter(update_num);
+}
+
+void cmdBenchSeek (char* command, char* params)
+{
+    char * param;
+    size_t file_size = 256u * 1024u;
+    size_t seek_num = 1000u;
+
+    (void) command;
+    (void) params;
+
+    param = PARSER_getNextParam();
+    if (param)
+    {
+        file_size = strtoul(param, NULL, 0);
+        param = PARSER_getNextParam();
+        if (param)
+        {
+            seek_num = strtoul(param, NULL, 0);
+        }
+    }
+    pifs_bench_seek(file_size, seek_num);
+}
+#endif
+
 void cmdTestPifsDelta (char* command, char* params)
 {
     char * filename;
@@ -1497,6 +1637,14 @@ void cmdFreeSpaceInfo (char* command, char* params)
     pifs_print_free_space_info();
 }
 
+void cmdCacheInfo (char* command, char* params)
+{
+    (void) command;
+    (void) params;
+
+    pifs_print_cache_info();
+}
+
 const char * block_type2str(pifs_block_address_t a_block_address)
 {
     const char * str = "Data";
@@ -1745,6 +1893,7 @@ parserCommand_t parserCommands[] =
     {"i",           "Print info of Pi file system",     cmdPifsInfo},
     {"free",        "Print info of free space",         cmdFreeSpaceInfo},
     {"f",           "Print info of free space",         cmdFreeSpaceInfo},
+    {"ci",          "Print info of page cache",         cmdCacheInfo},
     {"bi",          "Print info of block",              cmdBlockInfo},
     {"pi",          "Check if page is free/to be released/erased", cmdPageInfo},
     {"w",           "Print wear level list",            cmdWearLevel},
@@ -1767,6 +1916,15 @@ parserCommand_t parserCommands[] =
 #if PIFS_ENABLE_DIRECTORIES
     {"tdir",        "Test Pi file system: directories", cmdTestPifsDir},
 #endif
+#if ENABLE_BENCHMARK
+    {"bra",         "Benchmark: read-ahead",            cmdBenchReadAhead},
+    {"bfs",         "Benchmark: free space bitmap scan", cmdBenchFsbmScan},
+    {"bfr",         "Benchmark: allocation on fragmented free space", cmdBenchFragment},
+    {"bil",         "Benchmark: interleaved appending of files", cmdBenchInterleave},
+    {"bdl",         "Benchmark: reading file with delta pages", cmdBenchDelta},
+    {"bcn",         "Benchmark: updating counter in a file", cmdBenchCounter},
+    {"bsk",         "Benchmark: random seeks in a file", cmdBenchSeek},
+#endif
 #if tskKERNEL_VERSION_MAJOR >= 8
     {"tskl",        "Task list",                        cmdTaskList},
 #endif
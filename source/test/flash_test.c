@@ -258,6 +258,74 @@ pifs_status_t flash_test_addressable(void)
     return ret;
 }
 
+#if PIFS_FLASH_ASYNC_ENABLED
+pifs_status_t flash_test_async(void)
+{
+    pifs_status_t        ret;
+    pifs_block_address_t ba;
+    pifs_flash_request_t write_request;
+    pifs_flash_request_t erase_request;
+    bool_t               is_erase_done;
+
+    printf("Testing asynchronous requests...\r\n");
+    ba = PIFS_FLASH_BLOCK_RESERVED_NUM;
+    ret = pifs_flash_erase(ba);
+    PIFS_ASSERT(ret == PIFS_SUCCESS);
+    ret = pifs_flash_erase(ba + 1);
+    PIFS_ASSERT(ret == PIFS_SUCCESS);
+
+    /* Read of a block shall wait for program request of the same block */
+    fill_buffer(test_buf_w, sizeof(test_buf_w), FILL_TYPE_SEQUENCE_BYTE, 0);
+    write_request.op = PIFS_FLASH_OP_WRITE;
+    write_request.block_address = ba;
+    write_request.page_address = 0;
+    write_request.page_offset = 0;
+    write_request.buf = test_buf_w;
+    write_request.buf_size = sizeof(test_buf_w);
+    ret = pifs_flash_async_submit(&write_request);
+    PIFS_ASSERT(ret == PIFS_SUCCESS);
+    ret = pifs_flash_read(ba, 0, 0, test_buf_r, sizeof(test_buf_r));
+    PIFS_ASSERT(ret == PIFS_SUCCESS);
+    PIFS_ASSERT(pifs_flash_async_is_done(&write_request));
+    ret = pifs_flash_async_wait(&write_request);
+    PIFS_ASSERT(ret == PIFS_SUCCESS);
+    ret = compare_buffer(test_buf_w, sizeof(test_buf_w), test_buf_r);
+    PIFS_ASSERT(ret == PIFS_SUCCESS);
+
+    /* Read of a block shall wait for erase request of the same block */
+    fill_buffer(test_buf_w, sizeof(test_buf_w), FILL_TYPE_SIMPLE_BYTE, 0xFF);
+    erase_request.op = PIFS_FLASH_OP_ERASE;
+    erase_request.block_address = ba;
+    ret = pifs_flash_async_submit(&erase_request);
+    PIFS_ASSERT(ret == PIFS_SUCCESS);
+    ret = pifs_flash_read(ba, 0, 0, test_buf_r, sizeof(test_buf_r));
+    PIFS_ASSERT(ret == PIFS_SUCCESS);
+    PIFS_ASSERT(pifs_flash_async_is_done(&erase_request));
+    ret = pifs_flash_async_wait(&erase_request);
+    PIFS_ASSERT(ret == PIFS_SUCCESS);
+    ret = compare_buffer(test_buf_w, sizeof(test_buf_w), test_buf_r);
+    PIFS_ASSERT(ret == PIFS_SUCCESS);
+
+    /* Read of other block shall not wait for erase request. Erase is held */
+    /* in the queue, so the read would never return if it waited. */
+    pifs_flash_async_hold(TRUE);
+    ret = pifs_flash_async_submit(&erase_request);
+    PIFS_ASSERT(ret == PIFS_SUCCESS);
+    ret = pifs_flash_read(ba + 1, 0, 0, test_buf_r, sizeof(test_buf_r));
+    PIFS_ASSERT(ret == PIFS_SUCCESS);
+    is_erase_done = pifs_flash_async_is_done(&erase_request);
+    pifs_flash_async_hold(FALSE);
+    ret = pifs_flash_async_wait(&erase_request);
+    PIFS_ASSERT(ret == PIFS_SUCCESS);
+    PIFS_ASSERT(!is_erase_done);
+    ret = compare_buffer(test_buf_w, sizeof(test_buf_w), test_buf_r);
+    PIFS_ASSERT(ret == PIFS_SUCCESS);
+    printf("Done.\r\n");
+
+    return ret;
+}
+#endif
+
 pifs_status_t flash_test(void)
 {
     pifs_status_t ret = PIFS_ERROR_FLASH_INIT;
@@ -282,6 +350,12 @@ pifs_status_t flash_test(void)
     {
         ret = flash_test_pattern();
     }
+#if PIFS_FLASH_ASYNC_ENABLED
+    if (ret == PIFS_SUCCESS)
+    {
+        ret = flash_test_async();
+    }
+#endif
 
     return ret;
 }